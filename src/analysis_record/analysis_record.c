@@ -1,9 +1,79 @@
 #include <string.h>
+#include <ctype.h>
 #include <czmq.h>
+#include "util.h"
+#include "log.h"
+#include "hash.h"
+#include "properties.h"
+#include "metrics.h"
 #include "analysis_record.h"
 
+typedef struct _analysisRecordFieldProjection analysisRecordFieldProjection;
+typedef analysisRecordFieldProjection *analysisRecordFieldProjectionPtr;
+
+/* Field projection of analysis record type */
+struct _analysisRecordFieldProjection {
+    char *type;                         /**< Analysis record type */
+    char *(*getFields) (void);          /**< Fields list getter of analysis record type */
+    hashTablePtr fields;                /**< Fields selected, NULL for all fields */
+};
+
+/* Monotonic ingress timestamp of packet in process of current thread */
+static __thread u_long_long analysisRecordIngressTime = 0;
+
+/* Field projections of analysis record types */
+static analysisRecordFieldProjection fieldProjections [] = {
+    {ANALYSIS_RECORD_TYPE_TOPOLOGY_ENTRY, getPropertiesTopologyEntryFields, NULL},
+    {ANALYSIS_RECORD_TYPE_APP_SERVICE, getPropertiesAppServiceFields, NULL},
+    {ANALYSIS_RECORD_TYPE_ICMP_ERROR, getPropertiesIcmpErrorFields, NULL},
+    {ANALYSIS_RECORD_TYPE_TCP_BREAKDOWN, getPropertiesTcpBreakdownFields, NULL},
+};
+
 /**
- * @brief Publish analysis record to analysis record service.
+ * @brief Check whether field of analysis record is selected by
+ *        field projection of analysis record type, timestamp and
+ *        type are always selected.
+ *
+ * @param type -- analysis record type
+ * @param key -- field json key
+ *
+ * @return True if selected, else False
+ */
+boolean
+analysisRecordFieldSelected (char *type, char *key) {
+    u_int i;
+
+    for (i = 0; i < TABLE_SIZE (fieldProjections); i++) {
+        if (fieldProjections [i].type == type ||
+            strEqual (fieldProjections [i].type, type)) {
+            if (fieldProjections [i].fields == NULL ||
+                strEqual (key, ANALYSIS_RECORD_TIMESTAMP) ||
+                strEqual (key, ANALYSIS_RECORD_TYPE) ||
+                hashLookup (fieldProjections [i].fields, key))
+                return True;
+
+            return False;
+        }
+    }
+
+    return True;
+}
+
+/**
+ * @brief Set monotonic ingress timestamp of packet in process, analysis
+ *        records published by current thread will carry it.
+ *
+ * @param ingressTime -- Monotonic ingress timestamp, 0 if unknown
+ */
+void
+setAnalysisRecordIngressTime (u_long_long ingressTime) {
+    analysisRecordIngressTime = ingressTime;
+}
+
+/**
+ * @brief Publish analysis record with timestamp to analysis record
+ *        service. Both frames are built before sending, so the
+ *        multipart message is never left open by allocation failure.
  *
  * @param sendSock -- sock to send analysis record
  * @param analysisRecord -- analysis record
@@ -12,11 +82,122 @@
  */
 int
 publishAnalysisRecord (void *sendSock, char *analysisRecord) {
-    zframe_t *frame;
+    int ret;
+    analysisRecordTimestamp timestamp;
+    zframe_t *timestampFrame = NULL;
+    zframe_t *recordFrame = NULL;
+
+    timestamp.ingressTime = analysisRecordIngressTime;
+    timestamp.publishTime = getMonotonicTime ();
+
+    timestampFrame = zframe_new (&timestamp, sizeof (analysisRecordTimestamp));
+    if (timestampFrame == NULL)
+        goto dropAnalysisRecord;
+
+    recordFrame = zframe_new (analysisRecord, strlen (analysisRecord));
+    if (recordFrame == NULL)
+        goto dropAnalysisRecord;
+
+    ret = zframe_send (&timestampFrame, sendSock, ZFRAME_MORE);
+    if (ret < 0)
+        goto dropAnalysisRecord;
+
+    /* The rest part of multipart message is always accepted by zmq */
+    ret = zframe_send (&recordFrame, sendSock, 0);
+    if (ret < 0)
+        goto dropAnalysisRecord;
+
+    METRICS_COUNTER_INC (METRIC_RECORDS_PUBLISHED);
+    METRICS_COUNTER_INC (METRIC_RECORD_QUEUE_ENQUEUED);
+    return 0;
+
+dropAnalysisRecord:
+    zframe_destroy (&timestampFrame);
+    zframe_destroy (&recordFrame);
+    METRICS_COUNTER_INC (METRIC_RECORDS_DROPPED);
+    return -1;
+}
+
+/* Build fields hash table from comma separated fields list */
+static hashTablePtr
+newAnalysisRecordFields (char *fieldsList) {
+    int ret;
+    char *list, *field, *end, *saveptr, *data;
+    hashTablePtr fields;
+
+    list = strdup (fieldsList);
+    if (list == NULL)
+        return NULL;
+
+    fields = hashNew (0);
+    if (fields == NULL) {
+        free (list);
+        return NULL;
+    }
+
+    for (field = strtok_r (list, ",", &saveptr); field;
+         field = strtok_r (NULL, ",", &saveptr)) {
+        while (isspace (*field))
+            field++;
+        end = field + strlen (field);
+        while (end > field && isspace (*(end - 1)))
+            end--;
+        *end = '\0';
+
+        if (*field == '\0' || hashLookup (fields, field))
+            continue;
+
+        data = strdup (field);
+        if (data == NULL) {
+            hashDestroy (fields);
+            free (list);
+            return NULL;
+        }
+
+        ret = hashInsert (fields, field, data, free);
+        if (ret < 0) {
+            hashDestroy (fields);
+            free (list);
+            return NULL;
+        }
+    }
+
+    free (list);
+    return fields;
+}
+
+/* Init field projections of analysis record types */
+int
+initAnalysisRecordFieldProjection (void) {
+    u_int i;
+    char *fieldsList;
+
+    for (i = 0; i < TABLE_SIZE (fieldProjections); i++) {
+        fieldsList = fieldProjections [i].getFields ();
+        if (fieldsList == NULL)
+            continue;
+
+        fieldProjections [i].fields = newAnalysisRecordFields (fieldsList);
+        if (fieldProjections [i].fields == NULL) {
+            LOGE ("Create field projection of %s error.\n", fieldProjections [i].type);
+            destroyAnalysisRecordFieldProjection ();
+            return -1;
+        }
+        LOGI ("Field projection of %s: %s.\n", fieldProjections [i].type, fieldsList);
+    }
+
+    return 0;
+}
 
-    frame = zframe_new (analysisRecord, strlen (analysisRecord));
-    if (frame == NULL)
-        return -1;
+/* Destroy field projections of analysis record types */
+void
+destroyAnalysisRecordFieldProjection (void) {
+    u_int i;
 
-    return zframe_send (&frame, sendSock, 0);
+    for (i = 0; i < TABLE_SIZE (fieldProjections); i++) {
+        if (fieldProjections [i].fields) {
+            hashDestroy (fieldProjections [i].fields);
+            fieldProjections [i].fields = NULL;
+        }
+    }
 }
@@ -1,6 +1,8 @@
 #ifndef __ANALYSIS_RECORD_H__
 #define __ANALYSIS_RECORD_H__
 
+#include "util.h"
+
 /* Analysis record json key definitions */
 #define ANALYSIS_RECORD_TIMESTAMP "timestamp"
 #define ANALYSIS_RECORD_TYPE "type"
@@ -10,10 +12,32 @@
 #define ANALYSIS_RECORD_TYPE_APP_SERVICE "APP_SERVICE"
 #define ANALYSIS_RECORD_TYPE_ICMP_ERROR "ICMP_ERROR"
 #define ANALYSIS_RECORD_TYPE_TCP_BREAKDOWN "TCP_BREAKDOWN"
+#define ANALYSIS_RECORD_TYPE_PIPELINE_HEALTH "PIPELINE_HEALTH"
+
+typedef struct _analysisRecordTimestamp analysisRecordTimestamp;
+typedef analysisRecordTimestamp *analysisRecordTimestampPtr;
+
+/* Analysis record timestamp zframe sent ahead of analysis record */
+struct _analysisRecordTimestamp {
+    u_long_long ingressTime;            /**< Monotonic ingress timestamp of packet, 0 if unknown */
+    u_long_long publishTime;            /**< Monotonic timestamp published */
+};
+
+/* Check whether field of tcp breakdown record is selected */
+#define tcpBreakdownFieldSelected(key)                                  \
+    analysisRecordFieldSelected (ANALYSIS_RECORD_TYPE_TCP_BREAKDOWN, key)
 
 /*========================Interfaces definition============================*/
+boolean
+analysisRecordFieldSelected (char *type, char *key);
+void
+setAnalysisRecordIngressTime (u_long_long ingressTime);
 int
 publishAnalysisRecord (void *sendSock, char *analysisRecord);
+int
+initAnalysisRecordFieldProjection (void);
+void
+destroyAnalysisRecordFieldProjection (void);
 /*=======================Interfaces definition end=========================*/
 
 #endif /* __ANALYSIS_RECORD_H__ */
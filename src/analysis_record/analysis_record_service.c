@@ -1,6 +1,11 @@
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/time.h>
+#include <zlib.h>
 #include <czmq.h>
 #include <unistd.h>
 #include "list.h"
@@ -8,21 +13,32 @@
 #include "properties.h"
 #include "signals.h"
 #include "log.h"
+#include "metrics.h"
+#include "probes.h"
 #include "zmq_hub.h"
 #include "task_manager.h"
 #include "http_client.h"
 #include "splunk_forwarder.h"
+#include "es_forwarder.h"
+#include "record_store.h"
+#include "analysis_record.h"
 #include "analysis_record_service.h"
 
+/* Analysis record service poll timeout in milliseconds */
+#define ANALYSIS_RECORD_SERVICE_POLL_TIMEOUT 500
+/* Max analysis records to receive before checking timer */
+#define ANALYSIS_RECORD_SERVICE_RECV_BATCH 1024
+
 /* Analysis record output devices list */
 static listHead analysisRecordOutputDevices;
 
 typedef struct _analysisRecordOutputDev analysisRecordOutputDev;
 typedef analysisRecordOutputDev *analysisRecordOutputDevPtr;
 /*
- * Analysis record output dev, every dev has three interfaces, you can
- * add new analysis record output dev to analysisRecordOutputDevices
- * list with analysisRecordOutputDevAdd interface.
+ * Analysis record output dev, every dev has three interfaces and one
+ * optional timer interface, you can add new analysis record output dev
+ * to analysisRecordOutputDevices list with analysisRecordOutputDevAdd
+ * interface.
  */
 struct _analysisRecordOutputDev {
     /* AnalysisRecord output dev private data */
@@ -35,22 +51,268 @@ struct _analysisRecordOutputDev {
     /* AnalysisRecord output dev write operation */
     void (*write) (void *analysisRecord, u_int len,
                    analysisRecordOutputDevPtr dev);
+    /* AnalysisRecord output dev timer operation, called every second */
+    void (*timer) (analysisRecordOutputDevPtr dev);
     /* AnalysisRecord output dev list node of global AnalysisRecord output devices */
     listHead node;
 };
 
 /*===========================AnalysisRecord output file dev===========================*/
 
+#define OUTPUT_FILE_BUFFER_SIZE (4 << 20)
+#define OUTPUT_FILE_BUFFER_ALIGNMENT 4096
+#define OUTPUT_FILE_FLUSH_INTERVAL 1
+#define OUTPUT_FILE_PATH_MAX_LEN 512
+#define OUTPUT_FILE_GZIP_WINDOW_BITS (15 + 16)
+#define OUTPUT_FILE_GZIP_MEM_LEVEL 8
+
+typedef enum {
+    OUTPUT_FILE_SYNC_NEVER = 0,         /**< Leave write back to kernel */
+    OUTPUT_FILE_SYNC_ROTATE,            /**< Sync segment before sealing it */
+    OUTPUT_FILE_SYNC_INTERVAL           /**< Sync segment periodically and before sealing it */
+} outputFileSyncPolicy;
+
 typedef struct _analysisRecordOutputFile analysisRecordOutputFile;
 typedef analysisRecordOutputFile *analysisRecordOutputFilePtr;
 
+/*
+ * AnalysisRecord output file, analysis records are appended to an aligned
+ * buffer and written to the active segment at filePath only when buffer is
+ * full or idle for OUTPUT_FILE_FLUSH_INTERVAL. Once the active segment is
+ * oversize or expired, it will be sealed by renaming it to filePath with
+ * timestamp suffix, rename is atomic so consumers will never see partial
+ * sealed segment.
+ */
 struct _analysisRecordOutputFile {
-    FILE *file;                         /**< AnalysisRecord output file descriptor */
-    char *filePath;                     /**< AnalysisRecord output file path */
+    int fd;                             /**< Active segment file descriptor */
+    char *filePath;                     /**< Active segment file path */
+    u_long_long rotateSize;             /**< Segment rotate size in bytes, 0 for unlimited */
+    u_int rotateInterval;               /**< Segment rotate interval in seconds, 0 for unlimited */
+    u_int compressLevel;                /**< Gzip compress level, 0 for no compression */
+    outputFileSyncPolicy syncPolicy;    /**< Segment fsync policy */
+    u_int syncInterval;                 /**< Segment fsync interval in seconds */
+    z_stream zstrm;                     /**< Gzip deflate stream of active segment */
+    u_char *buf;                        /**< Aligned analysis record buffer */
+    u_int bufLen;                       /**< Data length of analysis record buffer */
+    u_char *zbuf;                       /**< Aligned compressed data buffer */
+    u_long_long segmentSize;            /**< Bytes written to active segment */
+    time_t segmentCreateTime;           /**< Active segment create time */
+    time_t lastFlushTime;               /**< Last buffer flush time */
+    time_t lastSyncTime;                /**< Last active segment fsync time */
 };
 
+static outputFileSyncPolicy
+getOutputFileSyncPolicy (char *policy) {
+    if (policy == NULL || strEqualIgnoreCase (policy, OUTPUT_FILE_SYNC_POLICY_ROTATE))
+        return OUTPUT_FILE_SYNC_ROTATE;
+    else if (strEqualIgnoreCase (policy, OUTPUT_FILE_SYNC_POLICY_INTERVAL))
+        return OUTPUT_FILE_SYNC_INTERVAL;
+    else
+        return OUTPUT_FILE_SYNC_NEVER;
+}
+
+static boolean
+outputFileSegmentIsGzip (char *filePath) {
+    int fd;
+    u_char magic [2];
+    ssize_t n;
+
+    fd = open (filePath, O_RDONLY);
+    if (fd < 0)
+        return False;
+
+    n = safeRead (fd, magic, sizeof (magic));
+    close (fd);
+
+    if (n == sizeof (magic) && magic [0] == 0x1f && magic [1] == 0x8b)
+        return True;
+    else
+        return False;
+}
+
+/*
+ * @brief Seal segment by renaming it to filePath.YYYYmmddHHMMSS[.N][.gz],
+ *        empty segment will be removed directly.
+ *
+ * @param filePath -- segment file path to seal
+ *
+ * @return 0 if success else -1
+ */
+static int
+sealOutputFileSegment (char *filePath) {
+    int ret;
+    u_int seq;
+    time_t now;
+    struct tm localTime;
+    char timeStr [32];
+    char *suffix;
+    char sealedFilePath [OUTPUT_FILE_PATH_MAX_LEN];
+
+    if (!fileExist (filePath))
+        return 0;
+
+    if (fileIsEmpty (filePath)) {
+        unlink (filePath);
+        return 0;
+    }
+
+    now = time (NULL);
+    localtime_r (&now, &localTime);
+    strftime (timeStr, sizeof (timeStr), "%Y%m%d%H%M%S", &localTime);
+    suffix = outputFileSegmentIsGzip (filePath) ? ".gz" : "";
+
+    snprintf (sealedFilePath, sizeof (sealedFilePath), "%s.%s%s", filePath, timeStr, suffix);
+    for (seq = 1; fileExist (sealedFilePath); seq++)
+        snprintf (sealedFilePath, sizeof (sealedFilePath),
+                  "%s.%s.%u%s", filePath, timeStr, seq, suffix);
+
+    ret = rename (filePath, sealedFilePath);
+    if (ret < 0) {
+        LOGE ("Rename %s to %s error: %s.\n", filePath, sealedFilePath, strerror (errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+openOutputFileSegment (analysisRecordOutputFilePtr outputFile) {
+    int ret;
+
+    /* Seal segment left by last run instead of truncating it */
+    ret = sealOutputFileSegment (outputFile->filePath);
+    if (ret < 0)
+        return -1;
+
+    outputFile->fd = open (outputFile->filePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (outputFile->fd < 0) {
+        LOGE ("Open analysis record output file error: %s.\n", strerror (errno));
+        return -1;
+    }
+
+    if (outputFile->compressLevel) {
+        memset (&outputFile->zstrm, 0, sizeof (outputFile->zstrm));
+        ret = deflateInit2 (&outputFile->zstrm, outputFile->compressLevel, Z_DEFLATED,
+                            OUTPUT_FILE_GZIP_WINDOW_BITS, OUTPUT_FILE_GZIP_MEM_LEVEL,
+                            Z_DEFAULT_STRATEGY);
+        if (ret != Z_OK) {
+            LOGE ("Init deflate stream error: %d.\n", ret);
+            close (outputFile->fd);
+            outputFile->fd = -1;
+            return -1;
+        }
+    }
+
+    outputFile->segmentSize = 0;
+    outputFile->segmentCreateTime = time (NULL);
+    outputFile->lastSyncTime = outputFile->segmentCreateTime;
+    return 0;
+}
+
+/*
+ * @brief Write data to active segment, data will be compressed if
+ *        compression is enabled.
+ *
+ * @param outputFile -- analysis record output file
+ * @param data -- data to write
+ * @param len -- data length
+ * @param flush -- deflate flush mode, Z_NO_FLUSH, Z_SYNC_FLUSH or Z_FINISH
+ *
+ * @return 0 if success else -1
+ */
+static int
+writeOutputFileSegment (analysisRecordOutputFilePtr outputFile,
+                        u_char *data, u_int len, int flush) {
+    int ret;
+    u_int outLen;
+    z_streamp zstrm;
+
+    if (!outputFile->compressLevel) {
+        if (len == 0)
+            return 0;
+
+        ret = safeWrite (outputFile->fd, data, len);
+        if (ret != len) {
+            LOGE ("Write analysis record output file error: %s.\n", strerror (errno));
+            return -1;
+        }
+        outputFile->segmentSize += len;
+        return 0;
+    }
+
+    zstrm = &outputFile->zstrm;
+    zstrm->next_in = data;
+    zstrm->avail_in = len;
+    do {
+        zstrm->next_out = outputFile->zbuf;
+        zstrm->avail_out = OUTPUT_FILE_BUFFER_SIZE;
+        ret = deflate (zstrm, flush);
+        if (ret == Z_STREAM_ERROR) {
+            LOGE ("Deflate analysis record error.\n");
+            return -1;
+        }
+
+        outLen = OUTPUT_FILE_BUFFER_SIZE - zstrm->avail_out;
+        if (outLen) {
+            ret = safeWrite (outputFile->fd, outputFile->zbuf, outLen);
+            if (ret != outLen) {
+                LOGE ("Write analysis record output file error: %s.\n", strerror (errno));
+                return -1;
+            }
+            outputFile->segmentSize += outLen;
+        }
+    } while (zstrm->avail_out == 0);
+
+    return 0;
+}
+
+static int
+flushOutputFileBuffer (analysisRecordOutputFilePtr outputFile, int flush) {
+    int ret;
+
+    ret = writeOutputFileSegment (outputFile, outputFile->buf, outputFile->bufLen, flush);
+    outputFile->bufLen = 0;
+    outputFile->lastFlushTime = time (NULL);
+
+    return ret;
+}
+
+static int
+closeOutputFileSegment (analysisRecordOutputFilePtr outputFile) {
+    int ret;
+
+    if (outputFile->fd < 0)
+        return 0;
+
+    ret = flushOutputFileBuffer (outputFile, Z_FINISH);
+    if (outputFile->compressLevel)
+        deflateEnd (&outputFile->zstrm);
+
+    if (outputFile->syncPolicy != OUTPUT_FILE_SYNC_NEVER)
+        fdatasync (outputFile->fd);
+    close (outputFile->fd);
+    outputFile->fd = -1;
+
+    if (ret < 0)
+        return -1;
+
+    return sealOutputFileSegment (outputFile->filePath);
+}
+
+static int
+rotateOutputFileSegment (analysisRecordOutputFilePtr outputFile) {
+    int ret;
+
+    ret = closeOutputFileSegment (outputFile);
+    if (ret < 0)
+        LOGE ("Close analysis record output file segment error.\n");
+
+    return openOutputFileSegment (outputFile);
+}
+
 static int
 initAnalysisRecordOutputFile (analysisRecordOutputDevPtr dev) {
+    int ret;
     analysisRecordOutputFilePtr outputFile
             = (analysisRecordOutputFilePtr) malloc (sizeof (analysisRecordOutputFile));
     if (outputFile == NULL) {
@@ -58,34 +320,81 @@ initAnalysisRecordOutputFile (analysisRecordOutputDevPtr dev) {
         return -1;
     }
 
+    outputFile->fd = -1;
+    outputFile->rotateSize = (u_long_long) getPropertiesOutputFileRotateSize () << 20;
+    outputFile->rotateInterval = getPropertiesOutputFileRotateInterval ();
+    outputFile->compressLevel = getPropertiesOutputFileCompressLevel ();
+    outputFile->syncPolicy = getOutputFileSyncPolicy (getPropertiesOutputFileSyncPolicy ());
+    outputFile->syncInterval = getPropertiesOutputFileSyncInterval ();
+    outputFile->bufLen = 0;
+    outputFile->buf = NULL;
+    outputFile->zbuf = NULL;
+    outputFile->lastFlushTime = time (NULL);
+
     outputFile->filePath = strdup (getPropertiesOutputFile ());
     if (outputFile->filePath == NULL) {
         LOGE ("Strdup analysis record output file path error.\n");
-        free (outputFile);
-        return -1;
+        goto freeOutputFile;
     }
-    outputFile->file = fopen (outputFile->filePath, "w");
-    if (outputFile->file == NULL) {
-        LOGE ("Open analysis record output file error: %s.\n", strerror (errno));
-        free (outputFile->filePath);
-        free (outputFile);
-        return -1;
+
+    ret = posix_memalign ((void **) &outputFile->buf,
+                          OUTPUT_FILE_BUFFER_ALIGNMENT, OUTPUT_FILE_BUFFER_SIZE);
+    if (ret) {
+        LOGE ("Alloc analysis record output file buffer error: %s.\n", strerror (ret));
+        outputFile->buf = NULL;
+        goto freeOutputFile;
+    }
+
+    if (outputFile->compressLevel) {
+        ret = posix_memalign ((void **) &outputFile->zbuf,
+                              OUTPUT_FILE_BUFFER_ALIGNMENT, OUTPUT_FILE_BUFFER_SIZE);
+        if (ret) {
+            LOGE ("Alloc analysis record output file compress buffer error: %s.\n",
+                  strerror (ret));
+            outputFile->zbuf = NULL;
+            goto freeOutputFile;
+        }
+    }
+
+    ret = openOutputFileSegment (outputFile);
+    if (ret < 0) {
+        LOGE ("Open analysis record output file segment error.\n");
+        goto freeOutputFile;
     }
 
     dev->data = outputFile;
     return 0;
+
+freeOutputFile:
+    free (outputFile->zbuf);
+    free (outputFile->buf);
+    free (outputFile->filePath);
+    free (outputFile);
+    return -1;
 }
 
 static void
 destroyAnalysisRecordOutputFile (analysisRecordOutputDevPtr dev) {
+    int ret;
     analysisRecordOutputFilePtr outputFile =
             (analysisRecordOutputFilePtr) dev->data;
 
-    fclose (outputFile->file);
-    outputFile->file = NULL;
+    /* Output file has been destroyed by failed reset */
+    if (outputFile == NULL)
+        return;
+
+    ret = closeOutputFileSegment (outputFile);
+    if (ret < 0)
+        LOGE ("Close analysis record output file segment error.\n");
+
+    free (outputFile->zbuf);
+    outputFile->zbuf = NULL;
+    free (outputFile->buf);
+    outputFile->buf = NULL;
     free (outputFile->filePath);
     outputFile->filePath = NULL;
     free (outputFile);
+    dev->data = NULL;
 }
 
 static int
@@ -94,28 +403,108 @@ resetAnalysisRecordOutputFile (analysisRecordOutputDevPtr dev) {
     return initAnalysisRecordOutputFile (dev);
 }
 
+/*
+ * @brief Get output file of dev, retry to init it if it has been
+ *        destroyed by failed reset.
+ *
+ * @param dev -- output file dev
+ *
+ * @return output file if success else NULL
+ */
+static analysisRecordOutputFilePtr
+getAnalysisRecordOutputFile (analysisRecordOutputDevPtr dev) {
+    int ret;
+
+    if (dev->data == NULL) {
+        ret = initAnalysisRecordOutputFile (dev);
+        if (ret < 0) {
+            LOGE_RL ("Reinit analysis record output file error.\n");
+            return NULL;
+        }
+    }
+
+    return (analysisRecordOutputFilePtr) dev->data;
+}
+
 static void
 writeAnalysisRecordOutputFile (void *analysisRecord, u_int len,
                                analysisRecordOutputDevPtr dev) {
     int ret;
     analysisRecordOutputFilePtr outputFile;
 
-    outputFile = (analysisRecordOutputFilePtr) dev->data;
-    ret = fwrite (analysisRecord, len, 1, outputFile->file);
-    if (ret != 1) {
-        ret = resetAnalysisRecordOutputFile (dev);
-        if (ret < 0)
-            LOGE ("Reset analysis record output file error.\n");
+    outputFile = getAnalysisRecordOutputFile (dev);
+    if (outputFile == NULL)
         return;
+
+    /* Flush buffer if there is no room for analysis record and '\n' */
+    if (outputFile->bufLen + len + 1 > OUTPUT_FILE_BUFFER_SIZE) {
+        ret = flushOutputFileBuffer (outputFile, Z_NO_FLUSH);
+        if (ret < 0)
+            goto resetOutputFile;
+
+        if (outputFile->rotateSize && outputFile->segmentSize >= outputFile->rotateSize) {
+            ret = rotateOutputFileSegment (outputFile);
+            if (ret < 0)
+                goto resetOutputFile;
+        }
     }
 
-    ret = fputc ('\n', outputFile->file);
-    if (ret != (int) '\n') {
-        ret = resetAnalysisRecordOutputFile (dev);
+    /* Write oversize analysis record directly */
+    if (len + 1 > OUTPUT_FILE_BUFFER_SIZE) {
+        ret = writeOutputFileSegment (outputFile, analysisRecord, len, Z_NO_FLUSH);
         if (ret < 0)
-            LOGE ("Reset analysis record output file error.\n");
+            goto resetOutputFile;
+    } else {
+        memcpy (outputFile->buf + outputFile->bufLen, analysisRecord, len);
+        outputFile->bufLen += len;
+    }
+    outputFile->buf [outputFile->bufLen++] = '\n';
+    return;
+
+resetOutputFile:
+    ret = resetAnalysisRecordOutputFile (dev);
+    if (ret < 0)
+        LOGE ("Reset analysis record output file error.\n");
+}
+
+static void
+timerAnalysisRecordOutputFile (analysisRecordOutputDevPtr dev) {
+    int ret;
+    time_t now;
+    analysisRecordOutputFilePtr outputFile;
+
+    outputFile = getAnalysisRecordOutputFile (dev);
+    if (outputFile == NULL)
         return;
+    now = time (NULL);
+
+    /* Flush idle buffer to make analysis records visible */
+    if (outputFile->bufLen &&
+        now - outputFile->lastFlushTime >= OUTPUT_FILE_FLUSH_INTERVAL) {
+        ret = flushOutputFileBuffer (outputFile, Z_SYNC_FLUSH);
+        if (ret < 0)
+            goto resetOutputFile;
     }
+
+    if (outputFile->syncPolicy == OUTPUT_FILE_SYNC_INTERVAL &&
+        now - outputFile->lastSyncTime >= outputFile->syncInterval) {
+        fdatasync (outputFile->fd);
+        outputFile->lastSyncTime = now;
+    }
+
+    if ((outputFile->rotateSize && outputFile->segmentSize >= outputFile->rotateSize) ||
+        (outputFile->rotateInterval && outputFile->segmentSize &&
+         now - outputFile->segmentCreateTime >= outputFile->rotateInterval)) {
+        ret = rotateOutputFileSegment (outputFile);
+        if (ret < 0)
+            goto resetOutputFile;
+    }
+    return;
+
+resetOutputFile:
+    ret = resetAnalysisRecordOutputFile (dev);
+    if (ret < 0)
+        LOGE ("Reset analysis record output file error.\n");
 }
 
 /*===========================AnalysisRecord output file dev===========================*/
@@ -242,6 +631,311 @@ writeAnalysisRecordOutputSplunk (void *analysisRecord, u_int len,
 
 /*==========================AnalysisRecord output splunk dev==========================*/
 
+/*
+ * @brief Get string value of top level key from analysis record
+ *        without parsing the whole json.
+ *
+ * @param analysisRecord -- analysis record
+ * @param len -- analysis record length
+ * @param key -- json key
+ * @param value -- buffer to return string value
+ * @param valueLen -- value buffer length
+ *
+ * @return 0 if success else -1
+ */
+static int
+getAnalysisRecordStrValue (char *analysisRecord, u_int len, char *key,
+                           char *value, u_int valueLen) {
+    u_int n;
+    int keyLen;
+    char keyStr [64];
+    char *from, *to;
+
+    keyLen = snprintf (keyStr, sizeof (keyStr), "\"%s\":\"", key);
+    if (keyLen >= sizeof (keyStr))
+        return -1;
+
+    from = memmem (analysisRecord, len, keyStr, keyLen);
+    if (from == NULL)
+        return -1;
+    from += keyLen;
+
+    to = memchr (from, '"', len - (from - analysisRecord));
+    if (to == NULL)
+        return -1;
+
+    n = MIN_NUM (to - from, valueLen - 1);
+    memcpy (value, from, n);
+    value [n] = 0;
+
+    return 0;
+}
+
+/*======================AnalysisRecord output elasticsearch dev=======================*/
+
+#define ES_DEFAULT_INDEX_PREFIX "ntrace"
+#define ES_INDEX_MAX_LENGTH 128
+
+/*
+ * @brief Get elasticsearch index of analysis record, every analysis
+ *        record type will be routed to index indexPrefix_type.
+ *
+ * @param analysisRecord -- analysis record
+ * @param len -- analysis record length
+ * @param index -- buffer to return index
+ * @param indexLen -- index buffer length
+ */
+static void
+getAnalysisRecordEsIndex (char *analysisRecord, u_int len, char *index, u_int indexLen) {
+    int ret;
+    u_int i;
+    char *prefix;
+    char type [ES_INDEX_MAX_LENGTH];
+
+    prefix = getPropertiesEsIndexPrefix ();
+    if (prefix == NULL)
+        prefix = ES_DEFAULT_INDEX_PREFIX;
+
+    ret = getAnalysisRecordStrValue (analysisRecord, len, ANALYSIS_RECORD_TYPE,
+                                     type, sizeof (type));
+    if (ret < 0)
+        snprintf (type, sizeof (type), "unknown");
+
+    /* Elasticsearch index must be lowercase */
+    for (i = 0; type [i]; i++)
+        type [i] = tolower (type [i]);
+
+    snprintf (index, indexLen, "%s_%s", prefix, type);
+}
+
+static int
+initAnalysisRecordOutputEs (analysisRecordOutputDevPtr dev) {
+    esForwarderPtr forwarder;
+
+    forwarder = newEsForwarder (getPropertiesEsUrl (),
+                                getPropertiesEsBulkSize (),
+                                getPropertiesEsBulkBytes () << 10,
+                                getPropertiesEsFlushInterval () * 1000,
+                                getPropertiesEsMaxInflight ());
+    if (forwarder == NULL) {
+        LOGE ("Create elasticsearch forwarder error.\n");
+        return -1;
+    }
+
+    dev->data = forwarder;
+    return 0;
+}
+
+static void
+destroyAnalysisRecordOutputEs (analysisRecordOutputDevPtr dev) {
+    freeEsForwarder ((esForwarderPtr) dev->data);
+}
+
+static void
+writeAnalysisRecordOutputEs (void *analysisRecord, u_int len,
+                             analysisRecordOutputDevPtr dev) {
+    int ret;
+    char index [ES_INDEX_MAX_LENGTH];
+
+    getAnalysisRecordEsIndex ((char *) analysisRecord, len, index, sizeof (index));
+    ret = esForwarderAppend ((esForwarderPtr) dev->data, index, (char *) analysisRecord, len);
+    if (ret < 0)
+        LOGE ("Append analysis record to elasticsearch forwarder error.\n");
+}
+
+static void
+timerAnalysisRecordOutputEs (analysisRecordOutputDevPtr dev) {
+    esForwarderFlush ((esForwarderPtr) dev->data, False);
+}
+
+/*======================AnalysisRecord output elasticsearch dev=======================*/
+
+/*=========================AnalysisRecord output pub dev==========================*/
+
+#define ANALYSIS_RECORD_TOPIC_MAX_LENGTH 64
+#define ANALYSIS_RECORD_PROTO_KEY "proto"
+
+typedef struct _analysisRecordOutputPub analysisRecordOutputPub;
+typedef analysisRecordOutputPub *analysisRecordOutputPubPtr;
+
+struct _analysisRecordOutputPub {
+    void *pubSock;                      /**< AnalysisRecord pub sock */
+    u_long_long published;              /**< Analysis records published */
+    u_long_long dropped;                /**< Analysis records dropped for slow subscribers */
+    u_long_long droppedReported;        /**< Analysis records dropped reported */
+};
+
+/*
+ * @brief Get pub topic of analysis record, topic is analysis record
+ *        type, for tcp breakdown, proto is appended like TCP_BREAKDOWN:HTTP.
+ *
+ * @param analysisRecord -- analysis record
+ * @param len -- analysis record length
+ * @param topic -- buffer to return topic
+ * @param topicLen -- topic buffer length
+ *
+ * @return topic length
+ */
+static u_int
+getAnalysisRecordTopic (char *analysisRecord, u_int len, char *topic, u_int topicLen) {
+    int ret;
+    u_int n;
+
+    ret = getAnalysisRecordStrValue (analysisRecord, len, ANALYSIS_RECORD_TYPE,
+                                     topic, topicLen);
+    if (ret < 0)
+        return snprintf (topic, topicLen, "UNKNOWN");
+
+    n = strlen (topic);
+    if (strEqual (topic, ANALYSIS_RECORD_TYPE_TCP_BREAKDOWN) && n + 1 < topicLen) {
+        topic [n] = ':';
+        ret = getAnalysisRecordStrValue (analysisRecord, len, ANALYSIS_RECORD_PROTO_KEY,
+                                         topic + n + 1, topicLen - n - 1);
+        if (ret < 0)
+            topic [n] = 0;
+        else
+            n = strlen (topic);
+    }
+
+    return n;
+}
+
+static int
+initAnalysisRecordOutputPub (analysisRecordOutputDevPtr dev) {
+    analysisRecordOutputPubPtr outputPub;
+
+    outputPub = (analysisRecordOutputPubPtr) malloc (sizeof (analysisRecordOutputPub));
+    if (outputPub == NULL) {
+        LOGE ("Malloc analysisRecordOutputPub error.\n");
+        return -1;
+    }
+
+    outputPub->pubSock = getAnalysisRecordPubSock ();
+    outputPub->published = 0;
+    outputPub->dropped = 0;
+    outputPub->droppedReported = 0;
+
+    dev->data = outputPub;
+    return 0;
+}
+
+static void
+destroyAnalysisRecordOutputPub (analysisRecordOutputDevPtr dev) {
+    analysisRecordOutputPubPtr outputPub = (analysisRecordOutputPubPtr) dev->data;
+
+    LOGI ("AnalysisRecord published: %llu, dropped for slow subscribers: %llu\n",
+          outputPub->published, outputPub->dropped);
+    free (outputPub);
+}
+
+static void
+writeAnalysisRecordOutputPub (void *analysisRecord, u_int len,
+                              analysisRecordOutputDevPtr dev) {
+    int ret;
+    u_int topicLen;
+    char topic [ANALYSIS_RECORD_TOPIC_MAX_LENGTH];
+    analysisRecordOutputPubPtr outputPub = (analysisRecordOutputPubPtr) dev->data;
+
+    topicLen = getAnalysisRecordTopic ((char *) analysisRecord, len, topic, sizeof (topic));
+
+    /*
+     * With pubOutput noDrop, pub sock will fail with EAGAIN if any subscriber
+     * reaches high water mark and record is dropped for all subscribers, once
+     * topic frame is queued the record frame will be queued as well.
+     */
+    ret = zmq_send (outputPub->pubSock, topic, topicLen, ZMQ_SNDMORE | ZMQ_DONTWAIT);
+    if (ret < 0) {
+        if (errno == EAGAIN)
+            outputPub->dropped++;
+        else
+            LOGE ("Publish analysis record error: %s.\n", zmq_strerror (errno));
+        return;
+    }
+
+    ret = zmq_send (outputPub->pubSock, analysisRecord, len, ZMQ_DONTWAIT);
+    if (ret < 0)
+        LOGE ("Publish analysis record error: %s.\n", zmq_strerror (errno));
+    else
+        outputPub->published++;
+}
+
+static void
+timerAnalysisRecordOutputPub (analysisRecordOutputDevPtr dev) {
+    zframe_t *frame;
+    u_char *data;
+    analysisRecordOutputPubPtr outputPub = (analysisRecordOutputPubPtr) dev->data;
+
+    /* Drain subscription messages */
+    while ((frame = zframe_recv_nowait (outputPub->pubSock)) != NULL) {
+        data = zframe_data (frame);
+        if (zframe_size (frame) && (data [0] == 0 || data [0] == 1))
+            LOGI ("Subscriber %s analysis record topic: \"%.*s\".\n",
+                  data [0] ? "subscribe" : "unsubscribe",
+                  (int) zframe_size (frame) - 1, data + 1);
+        zframe_destroy (&frame);
+    }
+
+    if (outputPub->dropped != outputPub->droppedReported) {
+        LOGW ("Drop %llu analysis records for slow subscribers.\n",
+              outputPub->dropped - outputPub->droppedReported);
+        outputPub->droppedReported = outputPub->dropped;
+    }
+}
+
+/*=========================AnalysisRecord output pub dev==========================*/
+
+/*========================AnalysisRecord output store dev=========================*/
+
+static int
+initAnalysisRecordOutputStore (analysisRecordOutputDevPtr dev) {
+    return 0;
+}
+
+static void
+destroyAnalysisRecordOutputStore (analysisRecordOutputDevPtr dev) {
+    return;
+}
+
+static void
+writeAnalysisRecordOutputStore (void *analysisRecord, u_int len,
+                                analysisRecordOutputDevPtr dev) {
+    int ret;
+    char type [64];
+
+    /* Record type is tagged for replay to filter without parsing */
+    ret = getAnalysisRecordStrValue (analysisRecord, len, ANALYSIS_RECORD_TYPE,
+                                     type, sizeof (type));
+    recordStoreAppend ((char *) analysisRecord, len, ret < 0 ? NULL : type);
+}
+
+static void
+timerAnalysisRecordOutputStore (analysisRecordOutputDevPtr dev) {
+    recordStoreRetain ();
+}
+
+/*========================AnalysisRecord output store dev=========================*/
+
+/*=========================AnalysisRecord output null dev=========================*/
+
+/* Null dev discards analysis records, used by replay benchmark */
+static int
+initAnalysisRecordOutputNull (analysisRecordOutputDevPtr dev) {
+    return 0;
+}
+
+static void
+destroyAnalysisRecordOutputNull (analysisRecordOutputDevPtr dev) {
+    return;
+}
+
+static void
+writeAnalysisRecordOutputNull (void *analysisRecord, u_int len,
+                               analysisRecordOutputDevPtr dev) {
+    return;
+}
+
+/*=========================AnalysisRecord output null dev=========================*/
+
 static int
 analysisRecordOutputDevAdd (analysisRecordOutputDevPtr dev) {
     int ret;
@@ -283,12 +977,63 @@ analysisRecordOutputDevWrite (listHeadPtr analysisRecordOutputDevices,
     }
 }
 
+/* Write pipeline health analysis record to output devices */
+static void
+analysisRecordOutputPipelineHealth (listHeadPtr analysisRecordOutputDevices) {
+    timeVal tm;
+    struct timeval now;
+    char *healthRecord;
+
+    gettimeofday (&now, NULL);
+    tm.tvSec = now.tv_sec;
+    tm.tvUsec = now.tv_usec;
+
+    healthRecord = pipelineHealthAnalysisRecord (&tm);
+    if (healthRecord == NULL) {
+        LOGE ("Get pipeline health analysis record error.\n");
+        return;
+    }
+
+    analysisRecordOutputDevWrite (analysisRecordOutputDevices,
+                                  healthRecord, strlen (healthRecord));
+    METRICS_COUNTER_INC (METRIC_RECORDS_EMITTED);
+    free (healthRecord);
+}
+
+static void
+analysisRecordOutputDevTimer (listHeadPtr analysisRecordOutputDevices) {
+    analysisRecordOutputDevPtr dev;
+    listHeadPtr pos;
+
+    listForEachEntry (dev, pos, analysisRecordOutputDevices, node) {
+        if (dev->timer)
+            dev->timer (dev);
+    }
+}
+
+/* Discard frame and the rest frames of its multipart message */
+static void
+discardAnalysisRecordFrames (void *analysisRecordRecvSock, zframe_t **frame) {
+    while (*frame && zframe_more (*frame)) {
+        zframe_destroy (frame);
+        *frame = zframe_recv (analysisRecordRecvSock);
+    }
+    zframe_destroy (frame);
+}
+
 /* Analysis record service */
 void *
 analysisRecordService (void *args) {
     int ret;
     void *analysisRecordRecvSock;
+    zframe_t *timestampFrame;
     zframe_t *analysisRecord;
+    analysisRecordTimestampPtr timestamp;
+    u_long_long writeTime;
+    zmq_pollitem_t pollItems [1];
+    u_int batchCount;
+    time_t now, lastTimerTime, lastHealthRecordTime;
+    u_int healthRecordInterval;
     u_long_long analysisRecordCount = 0;
 
     /* Reset signals flag */
@@ -300,6 +1045,14 @@ analysisRecordService (void *args) {
         fprintf (stderr, "Init log context error.\n");
         goto exit;
     }
+    setLogComponent ("AnalysisRecordService");
+
+    /* Init metrics context */
+    ret = initMetricsContext ("AnalysisRecordService");
+    if (ret < 0) {
+        LOGE ("Init metrics context error.\n");
+        goto destroyLogContext;
+    }
 
     /* Display task schedule policy info */
     displayTaskSchedPolicyInfo ("AnalysisRecordService");
@@ -310,6 +1063,7 @@ analysisRecordService (void *args) {
         .init = initAnalysisRecordOutputFile,
         .destroy = destroyAnalysisRecordOutputFile,
         .write = writeAnalysisRecordOutputFile,
+        .timer = timerAnalysisRecordOutputFile,
     };
 
     /* Init analysis record output splunk dev */
@@ -318,41 +1072,167 @@ analysisRecordService (void *args) {
         .init = initAnalysisRecordOutputSplunk,
         .destroy = destroyAnalysisRecordOutputSplunk,
         .write = writeAnalysisRecordOutputSplunk,
+        .timer = NULL,
+    };
+
+    /* Init analysis record output elasticsearch dev */
+    analysisRecordOutputDev analysisRecordOutputEsDev = {
+        .data = NULL,
+        .init = initAnalysisRecordOutputEs,
+        .destroy = destroyAnalysisRecordOutputEs,
+        .write = writeAnalysisRecordOutputEs,
+        .timer = timerAnalysisRecordOutputEs,
+    };
+
+    /* Init analysis record output pub dev */
+    analysisRecordOutputDev analysisRecordOutputPubDev = {
+        .data = NULL,
+        .init = initAnalysisRecordOutputPub,
+        .destroy = destroyAnalysisRecordOutputPub,
+        .write = writeAnalysisRecordOutputPub,
+        .timer = timerAnalysisRecordOutputPub,
+    };
+
+    /* Init analysis record output store dev */
+    analysisRecordOutputDev analysisRecordOutputStoreDev = {
+        .data = NULL,
+        .init = initAnalysisRecordOutputStore,
+        .destroy = destroyAnalysisRecordOutputStore,
+        .write = writeAnalysisRecordOutputStore,
+        .timer = timerAnalysisRecordOutputStore,
+    };
+
+    /* Init analysis record output null dev */
+    analysisRecordOutputDev analysisRecordOutputNullDev = {
+        .data = NULL,
+        .init = initAnalysisRecordOutputNull,
+        .destroy = destroyAnalysisRecordOutputNull,
+        .write = writeAnalysisRecordOutputNull,
+        .timer = NULL,
     };
 
     initListHead (&analysisRecordOutputDevices);
 
-    /* Add analysis record output file dev */
-    if (getPropertiesOutputFile ()) {
-        ret = analysisRecordOutputDevAdd (&analysisRecordOutputFileDev);
+    if (getPropertiesBenchMode ()) {
+        /* Replay benchmark sends analysis records to null dev only */
+        ret = analysisRecordOutputDevAdd (&analysisRecordOutputNullDev);
         if (ret < 0)
             goto destroyAnalysisRecordOutputDev;
-    }
+    } else {
+        /* Add analysis record output file dev */
+        if (getPropertiesOutputFile ()) {
+            ret = analysisRecordOutputDevAdd (&analysisRecordOutputFileDev);
+            if (ret < 0)
+                goto destroyAnalysisRecordOutputDev;
+        }
 
-    /* Add analysis record output splunk dev */
-    if (getPropertiesSplunkIndex ()) {
-        ret = analysisRecordOutputDevAdd (&analysisRecordOutputSplunkDev);
-        if (ret < 0)
-            goto destroyAnalysisRecordOutputDev;
+        /* Add analysis record output splunk dev */
+        if (getPropertiesSplunkIndex ()) {
+            ret = analysisRecordOutputDevAdd (&analysisRecordOutputSplunkDev);
+            if (ret < 0)
+                goto destroyAnalysisRecordOutputDev;
+        }
+
+        /* Add analysis record output elasticsearch dev */
+        if (getPropertiesEsUrl ()) {
+            ret = analysisRecordOutputDevAdd (&analysisRecordOutputEsDev);
+            if (ret < 0)
+                goto destroyAnalysisRecordOutputDev;
+        }
+
+        /* Add analysis record output pub dev */
+        if (getAnalysisRecordPubSock ()) {
+            ret = analysisRecordOutputDevAdd (&analysisRecordOutputPubDev);
+            if (ret < 0)
+                goto destroyAnalysisRecordOutputDev;
+        }
+
+        /* Add analysis record output store dev */
+        if (recordStoreEnabled ()) {
+            ret = analysisRecordOutputDevAdd (&analysisRecordOutputStoreDev);
+            if (ret < 0)
+                goto destroyAnalysisRecordOutputDev;
+        }
     }
 
     /* Get analysisRecordRecvSock */
     analysisRecordRecvSock = getAnalysisRecordRecvSock ();
 
+    pollItems [0].socket = analysisRecordRecvSock;
+    pollItems [0].fd = 0;
+    pollItems [0].events = ZMQ_POLLIN;
+    lastTimerTime = time (NULL);
+    lastHealthRecordTime = lastTimerTime;
+    healthRecordInterval = getPropertiesHealthRecordInterval ();
+
     while (!taskShouldExit ()) {
-        /* Receive analysis record */
-        analysisRecord = zframe_recv (analysisRecordRecvSock);
-        if (analysisRecord == NULL) {
+        ret = zmq_poll (pollItems, 1, ANALYSIS_RECORD_SERVICE_POLL_TIMEOUT * ZMQ_POLL_MSEC);
+        if (ret < 0) {
             if (!taskShouldExit ())
-                LOGE ("Receive analysis record zframe with fatal error.\n");
+                LOGE ("Poll analysis record with fatal error.\n");
             break;
         }
 
-        analysisRecordOutputDevWrite (&analysisRecordOutputDevices,
-                                      zframe_data (analysisRecord),
-                                      zframe_size (analysisRecord));
-        analysisRecordCount++;
-        zframe_destroy (&analysisRecord);
+        /* Receive analysis records in batch */
+        for (batchCount = 0;
+             (pollItems [0].revents & ZMQ_POLLIN) &&
+                     batchCount < ANALYSIS_RECORD_SERVICE_RECV_BATCH;
+             batchCount++) {
+            timestampFrame = zframe_recv_nowait (analysisRecordRecvSock);
+            if (timestampFrame == NULL)
+                break;
+
+            /* Analysis record follows analysis record timestamp */
+            if (!zframe_more (timestampFrame) ||
+                zframe_size (timestampFrame) != sizeof (analysisRecordTimestamp)) {
+                LOGE_RL ("Wrong analysis record timestamp zframe.\n");
+                discardAnalysisRecordFrames (analysisRecordRecvSock, &timestampFrame);
+                continue;
+            }
+
+            analysisRecord = zframe_recv (analysisRecordRecvSock);
+            if (analysisRecord == NULL) {
+                zframe_destroy (&timestampFrame);
+                break;
+            }
+
+            /* Analysis record must be the final frame */
+            if (zframe_more (analysisRecord)) {
+                LOGE_RL ("Wrong analysis record zframe with more frames.\n");
+                zframe_destroy (&timestampFrame);
+                discardAnalysisRecordFrames (analysisRecordRecvSock, &analysisRecord);
+                continue;
+            }
+
+            timestamp = (analysisRecordTimestampPtr) zframe_data (timestampFrame);
+            METRICS_LATENCY_RECORD_SINCE (LATENCY_RECORD_QUEUE, timestamp->publishTime);
+
+            writeTime = getMonotonicTime ();
+            analysisRecordOutputDevWrite (&analysisRecordOutputDevices,
+                                          zframe_data (analysisRecord),
+                                          zframe_size (analysisRecord));
+            METRICS_LATENCY_RECORD_SINCE (LATENCY_SINK_WRITE, writeTime);
+            NTRACE_PROBE1 (record__written, zframe_size (analysisRecord));
+            METRICS_LATENCY_RECORD_SINCE (LATENCY_END_TO_END, timestamp->ingressTime);
+
+            analysisRecordCount++;
+            METRICS_COUNTER_INC (METRIC_RECORD_QUEUE_DEQUEUED);
+            METRICS_COUNTER_INC (METRIC_RECORDS_EMITTED);
+            zframe_destroy (&timestampFrame);
+            zframe_destroy (&analysisRecord);
+        }
+
+        now = time (NULL);
+        if (now != lastTimerTime) {
+            analysisRecordOutputDevTimer (&analysisRecordOutputDevices);
+            lastTimerTime = now;
+        }
+
+        if (healthRecordInterval &&
+            now - lastHealthRecordTime >= healthRecordInterval) {
+            analysisRecordOutputPipelineHealth (&analysisRecordOutputDevices);
+            lastHealthRecordTime = now;
+        }
     }
 
     /* Display analysis record statistic info */
@@ -361,6 +1241,8 @@ analysisRecordService (void *args) {
     LOGI ("AnalysisRecordService will exit ... .. .\n");
 destroyAnalysisRecordOutputDev:
     analysisRecordOutputDevDestroy ();
+    destroyMetricsContext ();
+destroyLogContext:
     destroyLogContext ();
 exit:
     if (!taskShouldExit ())
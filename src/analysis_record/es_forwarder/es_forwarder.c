@@ -0,0 +1,597 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <curl/curl.h>
+#include <jansson.h>
+#include "util.h"
+#include "list.h"
+#include "log.h"
+#include "es_forwarder.h"
+
+/* Max retries of bulk items failed with retryable status */
+#define ES_BULK_MAX_RETRIES 3
+/* Backoff of first bulk retry in milliseconds, doubled for each retry */
+#define ES_BULK_RETRY_BACKOFF 500
+/* Max bulk batches waiting to be sent, oldest batch will be dropped if exceeded */
+#define ES_MAX_PENDING_BATCHES 64
+/* Drive bulk requests in flight every ES_PERFORM_INTERVAL documents appended */
+#define ES_PERFORM_INTERVAL 64
+/* Max milliseconds to drive bulk requests in flight for each flush */
+#define ES_FLUSH_DRIVE_TIME 100
+/* Max milliseconds to drain bulk requests before forwarder destroyed */
+#define ES_DRAIN_TIMEOUT 5000
+/* Max milliseconds to wait for bulk requests activity */
+#define ES_MULTI_WAIT_TIMEOUT 10
+#define ES_BULK_DATA_MIN_SIZE (64 << 10)
+#define ES_BULK_ITEMS_MIN_SIZE 256
+#define ES_BULK_ACTION_MAX_LENGTH 256
+#define ES_BULK_RESPONSE_MIN_SIZE 4096
+
+static inline boolean
+esStatusRetryable (long status) {
+    if (status == 429 || status >= 500)
+        return True;
+    else
+        return False;
+}
+
+static esBulkBatchPtr
+newEsBulkBatch (void) {
+    esBulkBatchPtr batch;
+
+    batch = (esBulkBatchPtr) malloc (sizeof (esBulkBatch));
+    if (batch == NULL)
+        return NULL;
+
+    batch->data = NULL;
+    batch->dataLen = 0;
+    batch->dataSize = 0;
+    batch->items = NULL;
+    batch->itemsNum = 0;
+    batch->itemsSize = 0;
+    batch->retries = 0;
+    batch->sendTime = 0;
+    initListHead (&batch->node);
+    return batch;
+}
+
+static void
+freeEsBulkBatch (esBulkBatchPtr batch) {
+    free (batch->data);
+    batch->data = NULL;
+    free (batch->items);
+    batch->items = NULL;
+    free (batch);
+}
+
+/*
+ * @brief Alloc a new item in bulk batch.
+ *
+ * @param batch -- bulk batch
+ * @param itemLen -- item length
+ *
+ * @return Item data buffer if success else NULL
+ */
+static char *
+esBulkBatchNewItem (esBulkBatchPtr batch, u_int itemLen) {
+    u_int newSize;
+    char *newData;
+    esBulkItemPtr newItems;
+    esBulkItemPtr item;
+    char *itemData;
+
+    if (batch->dataLen + itemLen > batch->dataSize) {
+        newSize = MAX_NUM (batch->dataSize, ES_BULK_DATA_MIN_SIZE);
+        while (newSize < batch->dataLen + itemLen)
+            newSize *= 2;
+
+        newData = (char *) realloc (batch->data, newSize);
+        if (newData == NULL)
+            return NULL;
+        batch->data = newData;
+        batch->dataSize = newSize;
+    }
+
+    if (batch->itemsNum == batch->itemsSize) {
+        newSize = batch->itemsSize ? batch->itemsSize * 2 : ES_BULK_ITEMS_MIN_SIZE;
+        newItems = (esBulkItemPtr) realloc (batch->items, newSize * sizeof (esBulkItem));
+        if (newItems == NULL)
+            return NULL;
+        batch->items = newItems;
+        batch->itemsSize = newSize;
+    }
+
+    item = &batch->items [batch->itemsNum++];
+    item->offset = batch->dataLen;
+    item->len = itemLen;
+    itemData = batch->data + batch->dataLen;
+    batch->dataLen += itemLen;
+
+    return itemData;
+}
+
+static size_t
+esBulkResponseCallback (char *ptr, size_t size, size_t nmemb, void *userdata) {
+    u_int newSize;
+    char *newResp;
+    size_t len = size * nmemb;
+    esBulkRequestPtr request = (esBulkRequestPtr) userdata;
+
+    if (request->respLen + len + 1 > request->respSize) {
+        newSize = MAX_NUM (request->respSize, ES_BULK_RESPONSE_MIN_SIZE);
+        while (newSize < request->respLen + len + 1)
+            newSize *= 2;
+
+        newResp = (char *) realloc (request->resp, newSize);
+        if (newResp == NULL)
+            return 0;
+        request->resp = newResp;
+        request->respSize = newSize;
+    }
+
+    memcpy (request->resp + request->respLen, ptr, len);
+    request->respLen += len;
+    request->resp [request->respLen] = 0;
+
+    return len;
+}
+
+static void
+queueEsBulkBatch (esForwarderPtr forwarder, esBulkBatchPtr batch) {
+    esBulkBatchPtr oldest;
+
+    listAddTail (&batch->node, &forwarder->pendingBatches);
+    forwarder->pendingBatchesNum++;
+
+    if (forwarder->pendingBatchesNum > ES_MAX_PENDING_BATCHES) {
+        oldest = listHeadEntry (&forwarder->pendingBatches, esBulkBatch, node);
+        listDel (&oldest->node);
+        forwarder->pendingBatchesNum--;
+        forwarder->stat.docsDropped += oldest->itemsNum;
+        LOGW ("Too many pending bulk batches, drop %u documents.\n", oldest->itemsNum);
+        freeEsBulkBatch (oldest);
+    }
+}
+
+static void
+retryEsBulkBatch (esForwarderPtr forwarder, esBulkBatchPtr batch) {
+    if (batch->retries >= ES_BULK_MAX_RETRIES) {
+        forwarder->stat.docsDropped += batch->itemsNum;
+        LOGE ("Bulk batch exceeds max retries, drop %u documents.\n", batch->itemsNum);
+        freeEsBulkBatch (batch);
+        return;
+    }
+
+    batch->retries++;
+    batch->sendTime = getSysTime () + (ES_BULK_RETRY_BACKOFF << (batch->retries - 1));
+    forwarder->stat.docsRetried += batch->itemsNum;
+    queueEsBulkBatch (forwarder, batch);
+}
+
+static int
+sendEsBulkBatch (esForwarderPtr forwarder, esBulkRequestPtr request,
+                 esBulkBatchPtr batch) {
+    CURLMcode ret;
+
+    request->batch = batch;
+    request->respLen = 0;
+    curl_easy_setopt (request->handle, CURLOPT_POSTFIELDS, batch->data);
+    curl_easy_setopt (request->handle, CURLOPT_POSTFIELDSIZE, (long) batch->dataLen);
+
+    ret = curl_multi_add_handle (forwarder->multi, request->handle);
+    if (ret != CURLM_OK) {
+        LOGE ("Add bulk request error: %s.\n", curl_multi_strerror (ret));
+        request->batch = NULL;
+        return -1;
+    }
+
+    forwarder->inflight++;
+    forwarder->stat.bulkRequests++;
+    return 0;
+}
+
+static void
+dispatchEsBulkBatches (esForwarderPtr forwarder) {
+    int ret;
+    u_int i;
+    u_long_long now;
+    esBulkBatchPtr batch;
+    listHeadPtr pos, npos;
+
+    now = getSysTime ();
+    i = 0;
+    listForEachEntrySafe (batch, pos, npos, &forwarder->pendingBatches, node) {
+        if (forwarder->inflight == forwarder->maxInflight)
+            break;
+
+        /* Wait for retry backoff */
+        if (batch->sendTime > now)
+            continue;
+
+        /* Get idle request slot */
+        while (forwarder->requests [i].batch)
+            i++;
+
+        listDel (&batch->node);
+        forwarder->pendingBatchesNum--;
+        ret = sendEsBulkBatch (forwarder, &forwarder->requests [i], batch);
+        if (ret < 0) {
+            listAdd (&batch->node, &forwarder->pendingBatches);
+            forwarder->pendingBatchesNum++;
+            break;
+        }
+    }
+}
+
+static void
+handleEsBulkResponse (esForwarderPtr forwarder, esBulkRequestPtr request, CURLcode result) {
+    u_int i;
+    long status;
+    long itemStatus;
+    json_t *root, *items, *item, *action;
+    json_error_t error;
+    esBulkBatchPtr batch, retryBatch;
+    esBulkItemPtr bulkItem;
+    char *itemData;
+
+    batch = request->batch;
+    request->batch = NULL;
+
+    if (result != CURLE_OK) {
+        LOGE ("Bulk request error: %s.\n", curl_easy_strerror (result));
+        forwarder->stat.bulkErrors++;
+        retryEsBulkBatch (forwarder, batch);
+        return;
+    }
+
+    curl_easy_getinfo (request->handle, CURLINFO_RESPONSE_CODE, &status);
+    if (esStatusRetryable (status)) {
+        LOGE ("Bulk request failed with status: %ld.\n", status);
+        forwarder->stat.bulkErrors++;
+        retryEsBulkBatch (forwarder, batch);
+        return;
+    }
+
+    if (status < 200 || status >= 300) {
+        LOGE ("Bulk request rejected with status: %ld, drop %u documents.\n",
+              status, batch->itemsNum);
+        forwarder->stat.bulkErrors++;
+        forwarder->stat.docsDropped += batch->itemsNum;
+        freeEsBulkBatch (batch);
+        return;
+    }
+
+    root = json_loadb (request->resp ? request->resp : "", request->respLen, 0, &error);
+    if (root == NULL) {
+        /* Documents indexed are unknown, retry may index them twice */
+        LOGE ("Parse bulk response error: %s, drop %u documents.\n",
+              error.text, batch->itemsNum);
+        forwarder->stat.bulkErrors++;
+        forwarder->stat.docsDropped += batch->itemsNum;
+        freeEsBulkBatch (batch);
+        return;
+    }
+
+    if (!json_is_true (json_object_get (root, "errors"))) {
+        forwarder->stat.docsIndexed += batch->itemsNum;
+        json_decref (root);
+        freeEsBulkBatch (batch);
+        return;
+    }
+
+    /* Collect items failed with retryable status */
+    retryBatch = NULL;
+    items = json_object_get (root, "items");
+    for (i = 0; i < batch->itemsNum; i++) {
+        item = json_array_get (items, i);
+        action = item ? json_object_iter_value (json_object_iter (item)) : NULL;
+        itemStatus = action ? json_integer_value (json_object_get (action, "status")) : 0;
+
+        if (itemStatus >= 200 && itemStatus < 300) {
+            forwarder->stat.docsIndexed++;
+            continue;
+        }
+
+        if (!esStatusRetryable (itemStatus)) {
+            forwarder->stat.docsDropped++;
+            continue;
+        }
+
+        if (retryBatch == NULL) {
+            retryBatch = newEsBulkBatch ();
+            if (retryBatch == NULL) {
+                LOGE ("Create bulk retry batch error.\n");
+                forwarder->stat.docsDropped += batch->itemsNum - i;
+                break;
+            }
+            retryBatch->retries = batch->retries;
+        }
+
+        bulkItem = &batch->items [i];
+        itemData = esBulkBatchNewItem (retryBatch, bulkItem->len);
+        if (itemData == NULL) {
+            forwarder->stat.docsDropped++;
+            continue;
+        }
+        memcpy (itemData, batch->data + bulkItem->offset, bulkItem->len);
+    }
+
+    if (retryBatch) {
+        if (retryBatch->itemsNum)
+            retryEsBulkBatch (forwarder, retryBatch);
+        else
+            freeEsBulkBatch (retryBatch);
+    }
+
+    json_decref (root);
+    freeEsBulkBatch (batch);
+}
+
+static void
+performEsBulkRequests (esForwarderPtr forwarder) {
+    u_int i;
+    int running;
+    int msgsLeft;
+    CURLMsg *msg;
+
+    dispatchEsBulkBatches (forwarder);
+    if (forwarder->inflight == 0)
+        return;
+
+    curl_multi_perform (forwarder->multi, &running);
+    while ((msg = curl_multi_info_read (forwarder->multi, &msgsLeft))) {
+        if (msg->msg != CURLMSG_DONE)
+            continue;
+
+        for (i = 0; i < forwarder->maxInflight; i++) {
+            if (forwarder->requests [i].handle == msg->easy_handle)
+                break;
+        }
+        if (i == forwarder->maxInflight)
+            continue;
+
+        curl_multi_remove_handle (forwarder->multi, msg->easy_handle);
+        forwarder->inflight--;
+        handleEsBulkResponse (forwarder, &forwarder->requests [i], msg->data.result);
+    }
+
+    dispatchEsBulkBatches (forwarder);
+}
+
+/*
+ * @brief Append document to bulk batch, bulk batch will be sent
+ *        when it reaches bulkSize documents or bulkBytes bytes.
+ *
+ * @param forwarder -- elasticsearch forwarder
+ * @param index -- index of document
+ * @param doc -- document
+ * @param docLen -- document length
+ *
+ * @return 0 if success else -1
+ */
+int
+esForwarderAppend (esForwarderPtr forwarder, char *index, char *doc, u_int docLen) {
+    int actionLen;
+    char action [ES_BULK_ACTION_MAX_LENGTH];
+    char *itemData;
+
+    if (forwarder->batch == NULL) {
+        forwarder->batch = newEsBulkBatch ();
+        if (forwarder->batch == NULL) {
+            LOGE ("Create bulk batch error.\n");
+            return -1;
+        }
+        forwarder->batchCreateTime = getSysTime ();
+    }
+
+    actionLen = snprintf (action, sizeof (action), "{\"index\":{\"_index\":\"%s\"}}\n", index);
+    if (actionLen >= sizeof (action)) {
+        LOGE ("Bulk index: %s is too long.\n", index);
+        return -1;
+    }
+
+    itemData = esBulkBatchNewItem (forwarder->batch, actionLen + docLen + 1);
+    if (itemData == NULL) {
+        LOGE ("Alloc bulk item error.\n");
+        return -1;
+    }
+    memcpy (itemData, action, actionLen);
+    memcpy (itemData + actionLen, doc, docLen);
+    itemData [actionLen + docLen] = '\n';
+
+    if (forwarder->batch->itemsNum >= forwarder->bulkSize ||
+        forwarder->batch->dataLen >= forwarder->bulkBytes) {
+        queueEsBulkBatch (forwarder, forwarder->batch);
+        forwarder->batch = NULL;
+        performEsBulkRequests (forwarder);
+    } else if (++forwarder->appendCount % ES_PERFORM_INTERVAL == 0)
+        performEsBulkRequests (forwarder);
+
+    return 0;
+}
+
+/*
+ * @brief Send bulk batch held longer than flushInterval and drive
+ *        bulk requests in flight.
+ *
+ * @param forwarder -- elasticsearch forwarder
+ * @param force -- send bulk batches immediately and wait until all
+ *                 bulk requests complete or ES_DRAIN_TIMEOUT expires
+ */
+void
+esForwarderFlush (esForwarderPtr forwarder, boolean force) {
+    u_long_long now;
+    u_long_long deadline;
+    esBulkBatchPtr batch;
+    listHeadPtr pos;
+
+    now = getSysTime ();
+    if (forwarder->batch &&
+        (force || now - forwarder->batchCreateTime >= forwarder->flushInterval)) {
+        queueEsBulkBatch (forwarder, forwarder->batch);
+        forwarder->batch = NULL;
+    }
+
+    if (force) {
+        listForEachEntry (batch, pos, &forwarder->pendingBatches, node) {
+            batch->sendTime = 0;
+        }
+        deadline = now + ES_DRAIN_TIMEOUT;
+    } else
+        deadline = now + ES_FLUSH_DRIVE_TIME;
+
+    do {
+        performEsBulkRequests (forwarder);
+        if (forwarder->inflight == 0 &&
+            (!force || listIsEmpty (&forwarder->pendingBatches)))
+            break;
+
+        curl_multi_wait (forwarder->multi, NULL, 0, ES_MULTI_WAIT_TIMEOUT, NULL);
+    } while (getSysTime () < deadline);
+}
+
+esForwarderPtr
+newEsForwarder (char *url, u_int bulkSize, u_int bulkBytes,
+                u_int flushInterval, u_int maxInflight) {
+    u_int i;
+    size_t urlLen;
+    CURL *handle;
+    esForwarderPtr forwarder;
+
+    if (url == NULL || !bulkSize || !bulkBytes || !maxInflight) {
+        LOGE ("Wrong elasticsearch forwarder parameters.\n");
+        return NULL;
+    }
+
+    forwarder = (esForwarderPtr) malloc (sizeof (esForwarder));
+    if (forwarder == NULL) {
+        LOGE ("Malloc esForwarder error: %s.\n", strerror (errno));
+        return NULL;
+    }
+
+    /* Strip tailing '/' of url */
+    urlLen = strlen (url);
+    while (urlLen && url [urlLen - 1] == '/')
+        urlLen--;
+    snprintf (forwarder->url, sizeof (forwarder->url), "%.*s/_bulk", (int) urlLen, url);
+
+    forwarder->bulkSize = bulkSize;
+    forwarder->bulkBytes = bulkBytes;
+    forwarder->flushInterval = flushInterval;
+    forwarder->maxInflight = maxInflight;
+    forwarder->multi = NULL;
+    forwarder->headers = NULL;
+    forwarder->requests = NULL;
+    forwarder->inflight = 0;
+    forwarder->batch = NULL;
+    forwarder->batchCreateTime = 0;
+    initListHead (&forwarder->pendingBatches);
+    forwarder->pendingBatchesNum = 0;
+    forwarder->appendCount = 0;
+    memset (&forwarder->stat, 0, sizeof (forwarder->stat));
+
+    curl_global_init (CURL_GLOBAL_ALL);
+
+    forwarder->multi = curl_multi_init ();
+    if (forwarder->multi == NULL) {
+        LOGE ("Create curl multi handle error.\n");
+        goto freeForwarder;
+    }
+
+    forwarder->headers = curl_slist_append (NULL, "Content-Type: application/x-ndjson");
+    if (forwarder->headers == NULL) {
+        LOGE ("Create bulk request headers error.\n");
+        goto freeForwarder;
+    }
+
+    forwarder->requests = (esBulkRequestPtr) calloc (maxInflight, sizeof (esBulkRequest));
+    if (forwarder->requests == NULL) {
+        LOGE ("Alloc bulk requests error: %s.\n", strerror (errno));
+        goto freeForwarder;
+    }
+
+    for (i = 0; i < maxInflight; i++) {
+        handle = curl_easy_init ();
+        if (handle == NULL) {
+            LOGE ("Create curl easy handle error.\n");
+            goto freeForwarder;
+        }
+        forwarder->requests [i].handle = handle;
+
+        /* Ignore cert verification */
+        if (!strncasecmp (forwarder->url, "https://", 8)) {
+            curl_easy_setopt (handle, CURLOPT_SSL_VERIFYPEER, 0L);
+            curl_easy_setopt (handle, CURLOPT_SSL_VERIFYHOST, 0L);
+        }
+
+        curl_easy_setopt (handle, CURLOPT_URL, forwarder->url);
+        curl_easy_setopt (handle, CURLOPT_HTTPHEADER, forwarder->headers);
+        curl_easy_setopt (handle, CURLOPT_WRITEFUNCTION, esBulkResponseCallback);
+        curl_easy_setopt (handle, CURLOPT_WRITEDATA, &forwarder->requests [i]);
+        curl_easy_setopt (handle, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt (handle, CURLOPT_CONNECTTIMEOUT, 10);
+        curl_easy_setopt (handle, CURLOPT_TIMEOUT, 60);
+    }
+
+    return forwarder;
+
+freeForwarder:
+    if (forwarder->requests) {
+        for (i = 0; i < maxInflight; i++) {
+            if (forwarder->requests [i].handle)
+                curl_easy_cleanup (forwarder->requests [i].handle);
+        }
+        free (forwarder->requests);
+    }
+    curl_slist_free_all (forwarder->headers);
+    if (forwarder->multi)
+        curl_multi_cleanup (forwarder->multi);
+    curl_global_cleanup ();
+    free (forwarder);
+    return NULL;
+}
+
+void
+freeEsForwarder (esForwarderPtr forwarder) {
+    u_int i;
+    esBulkRequestPtr request;
+    esBulkBatchPtr batch;
+    listHeadPtr pos, npos;
+
+    if (forwarder == NULL)
+        return;
+
+    /* Drain bulk batches */
+    esForwarderFlush (forwarder, True);
+
+    for (i = 0; i < forwarder->maxInflight; i++) {
+        request = &forwarder->requests [i];
+        if (request->batch) {
+            curl_multi_remove_handle (forwarder->multi, request->handle);
+            forwarder->stat.docsDropped += request->batch->itemsNum;
+            freeEsBulkBatch (request->batch);
+            request->batch = NULL;
+        }
+        curl_easy_cleanup (request->handle);
+        free (request->resp);
+    }
+    free (forwarder->requests);
+
+    listForEachEntrySafe (batch, pos, npos, &forwarder->pendingBatches, node) {
+        listDel (&batch->node);
+        forwarder->stat.docsDropped += batch->itemsNum;
+        freeEsBulkBatch (batch);
+    }
+
+    curl_slist_free_all (forwarder->headers);
+    curl_multi_cleanup (forwarder->multi);
+    curl_global_cleanup ();
+
+    LOGI ("Elasticsearch forwarder bulkRequests: %llu, bulkErrors: %llu, "
+          "docsIndexed: %llu, docsRetried: %llu, docsDropped: %llu\n",
+          forwarder->stat.bulkRequests, forwarder->stat.bulkErrors,
+          forwarder->stat.docsIndexed, forwarder->stat.docsRetried,
+          forwarder->stat.docsDropped);
+    free (forwarder);
+}
@@ -0,0 +1,91 @@
+#ifndef __ES_FORWARDER_H__
+#define __ES_FORWARDER_H__
+
+#include <curl/curl.h>
+#include "util.h"
+#include "list.h"
+
+#define ES_URL_MAX_LENGTH 256
+
+typedef struct _esBulkItem esBulkItem;
+typedef esBulkItem *esBulkItemPtr;
+
+/* Bulk item, action line and document line of one document */
+struct _esBulkItem {
+    u_int offset;                       /**< Item offset in bulk data */
+    u_int len;                          /**< Item length in bulk data */
+};
+
+typedef struct _esBulkBatch esBulkBatch;
+typedef esBulkBatch *esBulkBatchPtr;
+
+/* Bulk batch, body of one bulk request */
+struct _esBulkBatch {
+    char *data;                         /**< Bulk NDJSON data */
+    u_int dataLen;                      /**< Bulk data length */
+    u_int dataSize;                     /**< Bulk data buffer size */
+    esBulkItemPtr items;                /**< Bulk items */
+    u_int itemsNum;                     /**< Bulk items number */
+    u_int itemsSize;                    /**< Bulk items buffer size */
+    u_int retries;                      /**< Retried times of bulk batch */
+    u_long_long sendTime;               /**< Earliest send time in milliseconds */
+    listHead node;                      /**< Bulk batch list node of pending batches */
+};
+
+typedef struct _esBulkRequest esBulkRequest;
+typedef esBulkRequest *esBulkRequestPtr;
+
+/* Bulk request slot */
+struct _esBulkRequest {
+    CURL *handle;                       /**< Curl easy handle */
+    esBulkBatchPtr batch;               /**< Bulk batch in flight, NULL for idle slot */
+    char *resp;                         /**< Bulk response */
+    u_int respLen;                      /**< Bulk response length */
+    u_int respSize;                     /**< Bulk response buffer size */
+};
+
+typedef struct _esForwarderStat esForwarderStat;
+typedef esForwarderStat *esForwarderStatPtr;
+
+struct _esForwarderStat {
+    u_long_long bulkRequests;           /**< Bulk requests sent */
+    u_long_long bulkErrors;             /**< Bulk requests failed */
+    u_long_long docsIndexed;            /**< Documents indexed */
+    u_long_long docsRetried;            /**< Documents retried */
+    u_long_long docsDropped;            /**< Documents dropped */
+};
+
+typedef struct _esForwarder esForwarder;
+typedef esForwarder *esForwarderPtr;
+
+struct _esForwarder {
+    char url [ES_URL_MAX_LENGTH];       /**< Bulk api url */
+    u_int bulkSize;                     /**< Max documents of bulk batch */
+    u_int bulkBytes;                    /**< Max bytes of bulk batch */
+    u_int flushInterval;                /**< Max milliseconds to hold bulk batch */
+    u_int maxInflight;                  /**< Max bulk requests in flight */
+    CURLM *multi;                       /**< Curl multi handle */
+    struct curl_slist *headers;         /**< Bulk request headers */
+    esBulkRequestPtr requests;          /**< Bulk request slots */
+    u_int inflight;                     /**< Bulk requests in flight */
+    esBulkBatchPtr batch;               /**< Bulk batch being filled */
+    u_long_long batchCreateTime;        /**< Create time of bulk batch being filled */
+    listHead pendingBatches;            /**< Bulk batches waiting to be sent */
+    u_int pendingBatchesNum;            /**< Bulk batches number waiting to be sent */
+    u_int appendCount;                  /**< Documents appended */
+    esForwarderStat stat;               /**< Forwarder statistic info */
+};
+
+/*========================Interfaces definition============================*/
+esForwarderPtr
+newEsForwarder (char *url, u_int bulkSize, u_int bulkBytes,
+                u_int flushInterval, u_int maxInflight);
+void
+freeEsForwarder (esForwarderPtr forwarder);
+int
+esForwarderAppend (esForwarderPtr forwarder, char *index, char *doc, u_int docLen);
+void
+esForwarderFlush (esForwarderPtr forwarder, boolean force);
+/*=======================Interfaces definition end=========================*/
+
+#endif /* __ES_FORWARDER_H__ */
@@ -0,0 +1,832 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <jansson.h>
+#include "util.h"
+#include "list.h"
+#include "log.h"
+#include "properties.h"
+#include "analysis_record.h"
+#include "record_store.h"
+
+#define RECORD_STORE_SEGMENT_SUFFIX ".seg"
+#define RECORD_STORE_INDEX_SUFFIX ".idx"
+#define RECORD_STORE_PATH_MAX_LENGTH 512
+
+/* Record size in segment with record header, padded to 8 bytes */
+#define RECORD_STORE_RECORD_SIZE(len)                                   \
+    ((sizeof (recordStoreRecordHeader) + (len) + 7) & ~((u_long_long) 7))
+
+/* Max record bytes scanned by one replay call under segments lock */
+#define RECORD_STORE_REPLAY_SCAN_BYTES (16 << 20)
+/* Initial size of buffer to copy records replayed */
+#define RECORD_STORE_REPLAY_BUFFER_SIZE (64 << 10)
+
+/* Record store instance */
+static recordStorePtr recordStoreInstance = NULL;
+
+static void
+getRecordStoreSegmentPath (u_long_long id, char *suffix, char *path, u_int pathLen) {
+    snprintf (path, pathLen, "%s/%020llu%s", recordStoreInstance->dir, id, suffix);
+}
+
+static inline recordStoreSegmentHeaderPtr
+getRecordStoreSegmentHeader (recordStoreSegmentPtr segment) {
+    return (recordStoreSegmentHeaderPtr) segment->data;
+}
+
+static recordStoreSegmentPtr
+allocRecordStoreSegment (u_long_long id) {
+    recordStoreSegmentPtr segment;
+
+    segment = (recordStoreSegmentPtr) malloc (sizeof (recordStoreSegment));
+    if (segment == NULL)
+        return NULL;
+
+    segment->id = id;
+    segment->data = NULL;
+    segment->dataCapacity = 0;
+    segment->size = 0;
+    segment->index = NULL;
+    segment->indexCapacity = 0;
+    segment->indexNum = 0;
+    segment->nextIndexOffset = 0;
+    initListHead (&segment->node);
+    return segment;
+}
+
+static void
+freeRecordStoreSegment (recordStoreSegmentPtr segment) {
+    if (segment->data)
+        munmap (segment->data, segment->dataCapacity);
+    if (segment->index)
+        munmap (segment->index, segment->indexCapacity * sizeof (recordStoreIndexEntry));
+    free (segment);
+}
+
+static void
+removeRecordStoreSegmentFiles (u_long_long id) {
+    char path [RECORD_STORE_PATH_MAX_LENGTH];
+
+    getRecordStoreSegmentPath (id, RECORD_STORE_SEGMENT_SUFFIX, path, sizeof (path));
+    unlink (path);
+    getRecordStoreSegmentPath (id, RECORD_STORE_INDEX_SUFFIX, path, sizeof (path));
+    unlink (path);
+}
+
+/*
+ * @brief Create and map file of record store segment.
+ *
+ * @param path -- file path
+ * @param size -- file size to preallocate
+ *
+ * @return Address mapped if success else NULL
+ */
+static void *
+createRecordStoreSegmentFile (char *path, u_long_long size) {
+    int fd;
+    int ret;
+    void *addr;
+
+    fd = open (path, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        LOGE ("Create record store file %s error: %s.\n", path, strerror (errno));
+        return NULL;
+    }
+
+    /* Preallocate blocks, so that no SIGBUS on disk full for mapped writes */
+    ret = posix_fallocate (fd, 0, size);
+    if (ret) {
+        LOGE ("Preallocate record store file %s error: %s.\n", path, strerror (ret));
+        close (fd);
+        unlink (path);
+        return NULL;
+    }
+
+    addr = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (addr == MAP_FAILED) {
+        LOGE ("Mmap record store file %s error: %s.\n", path, strerror (errno));
+        unlink (path);
+        return NULL;
+    }
+
+    return addr;
+}
+
+/*
+ * @brief Map file of record store segment.
+ *
+ * @param path -- file path
+ * @param size -- buffer to return file size
+ *
+ * @return Address mapped if success, NULL for empty file or error
+ */
+static void *
+mapRecordStoreSegmentFile (char *path, u_long_long *size) {
+    int fd;
+    struct stat st;
+    void *addr;
+
+    *size = 0;
+    fd = open (path, O_RDWR);
+    if (fd < 0) {
+        LOGE ("Open record store file %s error: %s.\n", path, strerror (errno));
+        return NULL;
+    }
+
+    if (fstat (fd, &st) < 0 || st.st_size == 0) {
+        close (fd);
+        return NULL;
+    }
+
+    addr = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (addr == MAP_FAILED) {
+        LOGE ("Mmap record store file %s error: %s.\n", path, strerror (errno));
+        return NULL;
+    }
+
+    *size = st.st_size;
+    return addr;
+}
+
+/* Create new segment with preallocated data and index files */
+static recordStoreSegmentPtr
+newRecordStoreSegment (u_long_long id) {
+    recordStoreSegmentPtr segment;
+    recordStoreSegmentHeaderPtr header;
+    char path [RECORD_STORE_PATH_MAX_LENGTH];
+
+    segment = allocRecordStoreSegment (id);
+    if (segment == NULL) {
+        LOGE ("Alloc record store segment error.\n");
+        return NULL;
+    }
+
+    segment->dataCapacity = recordStoreInstance->segmentSize;
+    getRecordStoreSegmentPath (id, RECORD_STORE_SEGMENT_SUFFIX, path, sizeof (path));
+    segment->data = createRecordStoreSegmentFile (path, segment->dataCapacity);
+    if (segment->data == NULL)
+        goto freeSegment;
+
+    /* Every index interval holds one index entry at most */
+    segment->indexCapacity = segment->dataCapacity / recordStoreInstance->indexInterval + 1;
+    getRecordStoreSegmentPath (id, RECORD_STORE_INDEX_SUFFIX, path, sizeof (path));
+    segment->index = createRecordStoreSegmentFile (
+        path, segment->indexCapacity * sizeof (recordStoreIndexEntry));
+    if (segment->index == NULL)
+        goto removeSegmentFiles;
+
+    header = getRecordStoreSegmentHeader (segment);
+    header->magic = RECORD_STORE_SEGMENT_MAGIC;
+    header->version = RECORD_STORE_SEGMENT_VERSION;
+    header->sealed = 0;
+    header->reserved = 0;
+    header->firstTime = 0;
+    header->lastTime = 0;
+
+    segment->size = sizeof (recordStoreSegmentHeader);
+    segment->nextIndexOffset = segment->size;
+    return segment;
+
+removeSegmentFiles:
+    removeRecordStoreSegmentFiles (id);
+freeSegment:
+    freeRecordStoreSegment (segment);
+    return NULL;
+}
+
+/* Seal segment, truncate data and index files to size committed */
+static void
+sealRecordStoreSegment (recordStoreSegmentPtr segment) {
+    int ret;
+    char path [RECORD_STORE_PATH_MAX_LENGTH];
+
+    getRecordStoreSegmentPath (segment->id, RECORD_STORE_SEGMENT_SUFFIX, path, sizeof (path));
+    ret = truncate (path, segment->size);
+    if (ret < 0)
+        LOGE ("Truncate record store file %s error: %s.\n", path, strerror (errno));
+
+    getRecordStoreSegmentPath (segment->id, RECORD_STORE_INDEX_SUFFIX, path, sizeof (path));
+    ret = truncate (path, segment->indexNum * sizeof (recordStoreIndexEntry));
+    if (ret < 0)
+        LOGE ("Truncate record store file %s error: %s.\n", path, strerror (errno));
+
+    getRecordStoreSegmentHeader (segment)->sealed = 1;
+}
+
+/*
+ * @brief Open segment left by previous run, segment not sealed will be
+ *        recovered by scanning records and sealed.
+ *
+ * @param id -- segment id
+ *
+ * @return Segment if success, NULL for empty segment or error
+ */
+static recordStoreSegmentPtr
+openRecordStoreSegment (u_long_long id) {
+    u_int i;
+    u_long_long indexSize;
+    recordStoreSegmentPtr segment;
+    recordStoreSegmentHeaderPtr header;
+    recordStoreRecordHeaderPtr recordHeader;
+    char path [RECORD_STORE_PATH_MAX_LENGTH];
+
+    segment = allocRecordStoreSegment (id);
+    if (segment == NULL) {
+        LOGE ("Alloc record store segment error.\n");
+        return NULL;
+    }
+
+    getRecordStoreSegmentPath (id, RECORD_STORE_SEGMENT_SUFFIX, path, sizeof (path));
+    segment->data = mapRecordStoreSegmentFile (path, &segment->dataCapacity);
+    if (segment->data == NULL ||
+        segment->dataCapacity < sizeof (recordStoreSegmentHeader) ||
+        getRecordStoreSegmentHeader (segment)->magic != RECORD_STORE_SEGMENT_MAGIC) {
+        LOGW ("Skip invalid record store segment %s.\n", path);
+        freeRecordStoreSegment (segment);
+        return NULL;
+    }
+
+    getRecordStoreSegmentPath (id, RECORD_STORE_INDEX_SUFFIX, path, sizeof (path));
+    segment->index = mapRecordStoreSegmentFile (path, &indexSize);
+    segment->indexCapacity = indexSize / sizeof (recordStoreIndexEntry);
+
+    header = getRecordStoreSegmentHeader (segment);
+    if (header->sealed) {
+        segment->size = segment->dataCapacity;
+        segment->indexNum = segment->indexCapacity;
+    } else {
+        /* Find end of records appended before crash */
+        segment->size = sizeof (recordStoreSegmentHeader);
+        while (segment->size + sizeof (recordStoreRecordHeader) <= segment->dataCapacity) {
+            recordHeader = (recordStoreRecordHeaderPtr) (segment->data + segment->size);
+            if (recordHeader->len == 0 ||
+                segment->size + RECORD_STORE_RECORD_SIZE (recordHeader->len) > segment->dataCapacity)
+                break;
+            header->lastTime = recordHeader->timestamp;
+            segment->size += RECORD_STORE_RECORD_SIZE (recordHeader->len);
+        }
+
+        for (i = 0; i < segment->indexCapacity; i++) {
+            if (segment->index [i].timestamp == 0 ||
+                segment->index [i].offset >= segment->size)
+                break;
+        }
+        segment->indexNum = i;
+
+        LOGI ("Recover record store segment %020llu with %llu bytes.\n", id, segment->size);
+        sealRecordStoreSegment (segment);
+    }
+
+    if (segment->size == sizeof (recordStoreSegmentHeader)) {
+        freeRecordStoreSegment (segment);
+        removeRecordStoreSegmentFiles (id);
+        return NULL;
+    }
+
+    return segment;
+}
+
+/* Get type tag of record type, FNV-1a hash of type, 0 for unknown */
+static u_int
+getRecordStoreTypeTag (char *type) {
+    u_int hash = 2166136261U;
+
+    if (type == NULL)
+        return 0;
+
+    while (*type) {
+        hash ^= (u_char) *type++;
+        hash *= 16777619U;
+    }
+
+    return hash ? hash : 1;
+}
+
+/* Seal active segment and switch to new one */
+static recordStoreSegmentPtr
+rollRecordStoreSegment (void) {
+    u_long_long id;
+    recordStoreSegmentPtr segment, tail;
+
+    tail = listTailEntry (&recordStoreInstance->segments, recordStoreSegment, node);
+    id = tail ? tail->id + 1 : 1;
+
+    segment = newRecordStoreSegment (id);
+    if (segment == NULL)
+        return NULL;
+
+    pthread_rwlock_wrlock (&recordStoreInstance->lock);
+    if (recordStoreInstance->active)
+        sealRecordStoreSegment (recordStoreInstance->active);
+    listAddTail (&segment->node, &recordStoreInstance->segments);
+    recordStoreInstance->segmentsNum++;
+    recordStoreInstance->active = segment;
+    recordStoreInstance->totalSize += segment->size;
+    pthread_rwlock_unlock (&recordStoreInstance->lock);
+
+    return segment;
+}
+
+/*
+ * @brief Append record to active segment of record store, only called
+ *        by analysis record service.
+ *
+ * @param record -- record to append
+ * @param len -- record length
+ * @param type -- record type, NULL for unknown
+ *
+ * @return 0 if success else -1
+ */
+int
+recordStoreAppend (char *record, u_int len, char *type) {
+    u_long_long now, recordSize;
+    recordStoreSegmentPtr segment;
+    recordStoreSegmentHeaderPtr header;
+    recordStoreRecordHeaderPtr recordHeader;
+
+    recordSize = RECORD_STORE_RECORD_SIZE (len);
+    if (len == 0 ||
+        sizeof (recordStoreSegmentHeader) + recordSize > recordStoreInstance->segmentSize) {
+        recordStoreInstance->dropped++;
+        return -1;
+    }
+
+    segment = recordStoreInstance->active;
+    if (segment == NULL || segment->size + recordSize > segment->dataCapacity) {
+        segment = rollRecordStoreSegment ();
+        if (segment == NULL) {
+            recordStoreInstance->dropped++;
+            return -1;
+        }
+    }
+
+    /* Keep store time monotonic in segment for sparse time index */
+    header = getRecordStoreSegmentHeader (segment);
+    now = getSysTime ();
+    if (now < header->lastTime)
+        now = header->lastTime;
+
+    recordHeader = (recordStoreRecordHeaderPtr) (segment->data + segment->size);
+    recordHeader->len = len;
+    recordHeader->typeTag = getRecordStoreTypeTag (type);
+    recordHeader->timestamp = now;
+    memcpy (recordHeader + 1, record, len);
+
+    if (header->firstTime == 0)
+        header->firstTime = now;
+    header->lastTime = now;
+
+    if (segment->size >= segment->nextIndexOffset &&
+        segment->indexNum < segment->indexCapacity) {
+        segment->index [segment->indexNum].timestamp = now;
+        segment->index [segment->indexNum].offset = segment->size;
+        __sync_synchronize ();
+        segment->indexNum++;
+        segment->nextIndexOffset = segment->size + recordStoreInstance->indexInterval;
+    }
+
+    /* Commit record to readers after record written */
+    __sync_synchronize ();
+    segment->size += recordSize;
+    recordStoreInstance->totalSize += recordSize;
+    recordStoreInstance->appended++;
+
+    return 0;
+}
+
+static boolean
+recordStoreSegmentExpired (recordStoreSegmentPtr segment, u_long_long now) {
+    if (segment == recordStoreInstance->active)
+        return False;
+
+    if (recordStoreInstance->retentionSize &&
+        recordStoreInstance->totalSize > recordStoreInstance->retentionSize)
+        return True;
+
+    if (recordStoreInstance->retentionTime &&
+        getRecordStoreSegmentHeader (segment)->lastTime + recordStoreInstance->retentionTime < now)
+        return True;
+
+    return False;
+}
+
+/*
+ * Remove oldest segments exceeding retention size or retention time,
+ * only called by analysis record service.
+ */
+void
+recordStoreRetain (void) {
+    u_long_long now;
+    recordStoreSegmentPtr segment;
+
+    now = getSysTime ();
+    for (;;) {
+        segment = listHeadEntry (&recordStoreInstance->segments, recordStoreSegment, node);
+        if (segment == NULL || !recordStoreSegmentExpired (segment, now))
+            break;
+
+        pthread_rwlock_wrlock (&recordStoreInstance->lock);
+        listDel (&segment->node);
+        recordStoreInstance->segmentsNum--;
+        recordStoreInstance->totalSize -= segment->size;
+        pthread_rwlock_unlock (&recordStoreInstance->lock);
+
+        LOGD ("Remove record store segment %020llu.\n", segment->id);
+        removeRecordStoreSegmentFiles (segment->id);
+        freeRecordStoreSegment (segment);
+    }
+}
+
+/* Get offset of the first record which may be stored not earlier than from */
+static u_long_long
+recordStoreSegmentSeek (recordStoreSegmentPtr segment, u_long_long from) {
+    u_int low, high, mid;
+    u_long_long offset;
+
+    offset = sizeof (recordStoreSegmentHeader);
+    low = 0;
+    high = segment->indexNum;
+    __sync_synchronize ();
+
+    /* Find the last index entry earlier than from */
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (segment->index [mid].timestamp < from) {
+            offset = segment->index [mid].offset;
+            low = mid + 1;
+        } else
+            high = mid;
+    }
+
+    return offset;
+}
+
+/* Whether a whole record with non-zero length is stored at offset of segment */
+static boolean
+recordStoreRecordValid (recordStoreSegmentPtr segment, u_long_long offset, u_long_long size) {
+    recordStoreRecordHeaderPtr recordHeader;
+
+    if (offset + sizeof (recordStoreRecordHeader) > size)
+        return False;
+
+    recordHeader = (recordStoreRecordHeaderPtr) (segment->data + offset);
+    if (recordHeader->len == 0 ||
+        recordHeader->len > size - offset - sizeof (recordStoreRecordHeader) ||
+        offset + RECORD_STORE_RECORD_SIZE (recordHeader->len) > size)
+        return False;
+
+    return True;
+}
+
+/*
+ * @brief Check replay cursor offset from management request, it must be
+ *        the offset of a record, found by walking records from the last
+ *        index entry not after it.
+ *
+ * @param segment -- segment of cursor
+ * @param offset -- cursor offset to check
+ * @param size -- segment data size committed
+ *
+ * @return True if cursor offset is valid else False
+ */
+static boolean
+recordStoreCursorValid (recordStoreSegmentPtr segment, u_long_long offset, u_long_long size) {
+    u_int low, high, mid;
+    u_long_long pos;
+
+    if (offset < sizeof (recordStoreSegmentHeader) || offset >= size || offset & 7)
+        return False;
+
+    pos = sizeof (recordStoreSegmentHeader);
+    low = 0;
+    high = segment->indexNum;
+    __sync_synchronize ();
+
+    /* Find the last index entry not after offset */
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (segment->index [mid].offset <= offset) {
+            pos = segment->index [mid].offset;
+            low = mid + 1;
+        } else
+            high = mid;
+    }
+
+    while (pos < offset && recordStoreRecordValid (segment, pos, size))
+        pos += RECORD_STORE_RECORD_SIZE (((recordStoreRecordHeaderPtr) (segment->data + pos))->len);
+
+    return pos == offset ? True : False;
+}
+
+static boolean
+recordStoreRecordTypeMatch (json_t *record, char *type) {
+    const char *recordType;
+
+    if (type == NULL)
+        return True;
+
+    recordType = json_string_value (json_object_get (record, ANALYSIS_RECORD_TYPE));
+    if (recordType && strEqual ((char *) recordType, type))
+        return True;
+    else
+        return False;
+}
+
+/*
+ * @brief Copy stored record with record header to replay buffer.
+ *
+ * @param buf -- pointer of replay buffer, grown if no room
+ * @param bufSize -- pointer of replay buffer size
+ * @param bufLen -- pointer of replay buffer bytes used
+ * @param recordHeader -- stored record to copy
+ *
+ * @return 0 if success else -1
+ */
+static int
+copyRecordStoreRecord (u_char **buf, u_long_long *bufSize, u_long_long *bufLen,
+                       recordStoreRecordHeaderPtr recordHeader) {
+    u_long_long recordSize, newSize;
+    u_char *newBuf;
+
+    recordSize = RECORD_STORE_RECORD_SIZE (recordHeader->len);
+    if (*bufLen + recordSize > *bufSize) {
+        newSize = *bufSize ? *bufSize : RECORD_STORE_REPLAY_BUFFER_SIZE;
+        while (*bufLen + recordSize > newSize)
+            newSize *= 2;
+
+        newBuf = (u_char *) realloc (*buf, newSize);
+        if (newBuf == NULL)
+            return -1;
+        *buf = newBuf;
+        *bufSize = newSize;
+    }
+
+    memcpy (*buf + *bufLen, recordHeader, sizeof (recordStoreRecordHeader) + recordHeader->len);
+    *bufLen += recordSize;
+    return 0;
+}
+
+/*
+ * @brief Replay records stored in time range, called by management
+ *        service. Records are copied under segments lock and parsed
+ *        after the lock released. Records of other types are skipped
+ *        by type tag without parsing. Replay stops with cursor after
+ *        scanning RECORD_STORE_REPLAY_SCAN_BYTES, so fewer records than
+ *        limit may be returned with more records to replay.
+ *
+ * @param from -- store time in milliseconds to replay from
+ * @param to -- store time in milliseconds to replay to
+ * @param type -- record type to replay, NULL for all types
+ * @param limit -- max records to replay
+ * @param cursor -- cursor to replay from, updated to continue replay
+ * @param records -- json array to return records
+ *
+ * @return 1 if more records to replay, 0 if replay done, else -1
+ */
+int
+recordStoreReplay (u_long_long from, u_long_long to, char *type, u_int limit,
+                   recordStoreCursorPtr cursor, json_t *records) {
+    int ret = 0;
+    u_int count = 0;
+    u_int typeTag;
+    u_long_long size, offset, scanned = 0;
+    u_char *buf = NULL;
+    u_long_long bufSize = 0, bufLen = 0;
+    json_t *record;
+    json_error_t error;
+    listHeadPtr pos;
+    recordStoreSegmentPtr segment;
+    recordStoreSegmentHeaderPtr header;
+    recordStoreRecordHeaderPtr recordHeader;
+
+    if (recordStoreInstance == NULL)
+        return -1;
+
+    typeTag = getRecordStoreTypeTag (type);
+
+    pthread_rwlock_rdlock (&recordStoreInstance->lock);
+    listForEachEntry (segment, pos, &recordStoreInstance->segments, node) {
+        if (segment->id < cursor->segment)
+            continue;
+
+        size = segment->size;
+        __sync_synchronize ();
+        header = getRecordStoreSegmentHeader (segment);
+        if (size == sizeof (recordStoreSegmentHeader) || header->lastTime < from)
+            continue;
+        if (header->firstTime > to)
+            break;
+
+        if (segment->id == cursor->segment && cursor->offset) {
+            if (!recordStoreCursorValid (segment, cursor->offset, size)) {
+                LOGW ("Invalid record store replay cursor %llu:%llu.\n",
+                      cursor->segment, cursor->offset);
+                ret = -1;
+                goto unlock;
+            }
+            offset = cursor->offset;
+        } else
+            offset = recordStoreSegmentSeek (segment, from);
+
+        while (offset < size) {
+            /* Stop scanning segment at end of records or corrupted record */
+            if (!recordStoreRecordValid (segment, offset, size))
+                break;
+
+            recordHeader = (recordStoreRecordHeaderPtr) (segment->data + offset);
+            if (recordHeader->timestamp > to)
+                goto unlock;
+
+            if (count >= limit || scanned >= RECORD_STORE_REPLAY_SCAN_BYTES) {
+                cursor->segment = segment->id;
+                cursor->offset = offset;
+                ret = 1;
+                goto unlock;
+            }
+            scanned += RECORD_STORE_RECORD_SIZE (recordHeader->len);
+
+            /* Records without type tag are checked after parsed */
+            if (recordHeader->timestamp >= from &&
+                (typeTag == 0 || recordHeader->typeTag == 0 ||
+                 recordHeader->typeTag == typeTag)) {
+                if (copyRecordStoreRecord (&buf, &bufSize, &bufLen, recordHeader) < 0) {
+                    LOGE ("Alloc record store replay buffer error.\n");
+                    ret = -1;
+                    goto unlock;
+                }
+                count++;
+            }
+
+            offset += RECORD_STORE_RECORD_SIZE (recordHeader->len);
+        }
+    }
+
+unlock:
+    pthread_rwlock_unlock (&recordStoreInstance->lock);
+
+    /* Parse records copied out of segments */
+    for (offset = 0; ret >= 0 && offset < bufLen;
+         offset += RECORD_STORE_RECORD_SIZE (recordHeader->len)) {
+        recordHeader = (recordStoreRecordHeaderPtr) (buf + offset);
+        record = json_loadb ((const char *) (recordHeader + 1), recordHeader->len,
+                             0, &error);
+        if (record == NULL)
+            LOGW ("Load stored record error: %s.\n", error.text);
+        else if (recordStoreRecordTypeMatch (record, type))
+            json_array_append_new (records, record);
+        else
+            json_decref (record);
+    }
+
+    free (buf);
+    return ret;
+}
+
+boolean
+recordStoreEnabled (void) {
+    if (recordStoreInstance)
+        return True;
+    else
+        return False;
+}
+
+static int
+recordStoreSegmentFilter (const struct dirent *entry) {
+    size_t len;
+
+    len = strlen (entry->d_name);
+    if (len > strlen (RECORD_STORE_SEGMENT_SUFFIX) &&
+        strEqual ((char *) entry->d_name + len - strlen (RECORD_STORE_SEGMENT_SUFFIX),
+                  RECORD_STORE_SEGMENT_SUFFIX))
+        return 1;
+    else
+        return 0;
+}
+
+/* Load segments left by previous run */
+static int
+loadRecordStoreSegments (void) {
+    int i, n;
+    u_long_long id;
+    struct dirent **entries;
+    recordStoreSegmentPtr segment;
+
+    n = scandir (recordStoreInstance->dir, &entries, recordStoreSegmentFilter, alphasort);
+    if (n < 0) {
+        LOGE ("Scan record store dir %s error: %s.\n",
+              recordStoreInstance->dir, strerror (errno));
+        return -1;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (sscanf (entries [i]->d_name, "%llu", &id) == 1) {
+            segment = openRecordStoreSegment (id);
+            if (segment) {
+                listAddTail (&segment->node, &recordStoreInstance->segments);
+                recordStoreInstance->segmentsNum++;
+                recordStoreInstance->totalSize += segment->size;
+            }
+        }
+        free (entries [i]);
+    }
+    free (entries);
+
+    return 0;
+}
+
+/* Init record store */
+int
+initRecordStore (void) {
+    int ret;
+
+    if (getPropertiesRecordStoreDir () == NULL)
+        return 0;
+
+    recordStoreInstance = (recordStorePtr) malloc (sizeof (recordStore));
+    if (recordStoreInstance == NULL) {
+        LOGE ("Malloc recordStore error.\n");
+        return -1;
+    }
+
+    snprintf (recordStoreInstance->dir, sizeof (recordStoreInstance->dir),
+              "%s", getPropertiesRecordStoreDir ());
+    recordStoreInstance->segmentSize = (u_long_long) getPropertiesRecordStoreSegmentSize () << 20;
+    recordStoreInstance->indexInterval = getPropertiesRecordStoreIndexInterval () << 10;
+    recordStoreInstance->retentionSize = (u_long_long) getPropertiesRecordStoreRetentionSize () << 20;
+    recordStoreInstance->retentionTime = (u_long_long) getPropertiesRecordStoreRetentionTime () * 1000;
+    initListHead (&recordStoreInstance->segments);
+    recordStoreInstance->segmentsNum = 0;
+    recordStoreInstance->active = NULL;
+    recordStoreInstance->totalSize = 0;
+    recordStoreInstance->appended = 0;
+    recordStoreInstance->dropped = 0;
+
+    ret = pthread_rwlock_init (&recordStoreInstance->lock, NULL);
+    if (ret) {
+        LOGE ("Init record store rwlock error.\n");
+        goto freeRecordStoreInstance;
+    }
+
+    ret = mkdir (recordStoreInstance->dir, 0755);
+    if (ret < 0 && errno != EEXIST) {
+        LOGE ("Create record store dir %s error: %s.\n",
+              recordStoreInstance->dir, strerror (errno));
+        goto destroyLock;
+    }
+
+    ret = loadRecordStoreSegments ();
+    if (ret < 0)
+        goto destroyRecordStoreSegments;
+
+    LOGI ("Record store %s loaded with %u segments, %llu bytes.\n",
+          recordStoreInstance->dir, recordStoreInstance->segmentsNum,
+          recordStoreInstance->totalSize);
+    return 0;
+
+destroyRecordStoreSegments:
+    destroyRecordStore ();
+    return -1;
+destroyLock:
+    pthread_rwlock_destroy (&recordStoreInstance->lock);
+freeRecordStoreInstance:
+    free (recordStoreInstance);
+    recordStoreInstance = NULL;
+    return -1;
+}
+
+/* Destroy record store */
+void
+destroyRecordStore (void) {
+    recordStoreSegmentPtr entry;
+    listHeadPtr pos, npos;
+
+    if (recordStoreInstance == NULL)
+        return;
+
+    LOGI ("Record store appended: %llu, dropped: %llu\n",
+          recordStoreInstance->appended, recordStoreInstance->dropped);
+
+    listForEachEntrySafe (entry, pos, npos, &recordStoreInstance->segments, node) {
+        listDel (&entry->node);
+        if (entry == recordStoreInstance->active) {
+            if (entry->size == sizeof (recordStoreSegmentHeader))
+                removeRecordStoreSegmentFiles (entry->id);
+            else
+                sealRecordStoreSegment (entry);
+        }
+        freeRecordStoreSegment (entry);
+    }
+
+    pthread_rwlock_destroy (&recordStoreInstance->lock);
+    free (recordStoreInstance);
+    recordStoreInstance = NULL;
+}
@@ -0,0 +1,106 @@
+#ifndef __RECORD_STORE_H__
+#define __RECORD_STORE_H__
+
+#include <pthread.h>
+#include <jansson.h>
+#include "util.h"
+#include "list.h"
+
+#define RECORD_STORE_DIR_MAX_LENGTH 256
+
+/* Record store segment magic "NTRS" */
+#define RECORD_STORE_SEGMENT_MAGIC 0x5352544e
+#define RECORD_STORE_SEGMENT_VERSION 1
+
+typedef struct _recordStoreSegmentHeader recordStoreSegmentHeader;
+typedef recordStoreSegmentHeader *recordStoreSegmentHeaderPtr;
+
+/* Record store segment file header */
+struct _recordStoreSegmentHeader {
+    u_int magic;                        /**< Segment magic */
+    u_int version;                      /**< Segment version */
+    u_int sealed;                       /**< Segment sealed flag */
+    u_int reserved;                     /**< Reserved */
+    u_long_long firstTime;              /**< Store time of first record in milliseconds */
+    u_long_long lastTime;               /**< Store time of last record in milliseconds */
+};
+
+typedef struct _recordStoreRecordHeader recordStoreRecordHeader;
+typedef recordStoreRecordHeader *recordStoreRecordHeaderPtr;
+
+/* Record store record header, followed by record and padded to 8 bytes */
+struct _recordStoreRecordHeader {
+    u_int len;                          /**< Record length, 0 for end of segment */
+    u_int typeTag;                      /**< Hash of record type, 0 for unknown */
+    u_long_long timestamp;              /**< Store time of record in milliseconds */
+};
+
+typedef struct _recordStoreIndexEntry recordStoreIndexEntry;
+typedef recordStoreIndexEntry *recordStoreIndexEntryPtr;
+
+/* Record store sparse time index entry */
+struct _recordStoreIndexEntry {
+    u_long_long timestamp;              /**< Store time of record in milliseconds */
+    u_long_long offset;                 /**< Record offset in segment */
+};
+
+typedef struct _recordStoreSegment recordStoreSegment;
+typedef recordStoreSegment *recordStoreSegmentPtr;
+
+/* Record store segment, data and index files mapped in memory */
+struct _recordStoreSegment {
+    u_long_long id;                     /**< Segment id */
+    u_char *data;                       /**< Segment data mapped */
+    u_long_long dataCapacity;           /**< Segment data mapped size */
+    volatile u_long_long size;          /**< Segment data size committed */
+    recordStoreIndexEntryPtr index;     /**< Segment index mapped */
+    u_int indexCapacity;                /**< Segment index entries mapped */
+    volatile u_int indexNum;            /**< Segment index entries committed */
+    u_long_long nextIndexOffset;        /**< Offset to add next index entry */
+    listHead node;                      /**< Segments list node */
+};
+
+typedef struct _recordStoreCursor recordStoreCursor;
+typedef recordStoreCursor *recordStoreCursorPtr;
+
+/* Record store replay cursor, zero for beginning of replay */
+struct _recordStoreCursor {
+    u_long_long segment;                /**< Segment id */
+    u_long_long offset;                 /**< Record offset in segment */
+};
+
+typedef struct _recordStore recordStore;
+typedef recordStore *recordStorePtr;
+
+struct _recordStore {
+    char dir [RECORD_STORE_DIR_MAX_LENGTH]; /**< Record store dir */
+    u_long_long segmentSize;            /**< Max bytes of segment */
+    u_int indexInterval;                /**< Bytes between sparse index entries */
+    u_long_long retentionSize;          /**< Max bytes of record store */
+    u_long_long retentionTime;          /**< Max milliseconds to retain records */
+    pthread_rwlock_t lock;              /**< Segments list rwlock */
+    listHead segments;                  /**< Segments list ordered by id */
+    u_int segmentsNum;                  /**< Segments number */
+    recordStoreSegmentPtr active;       /**< Active segment to append */
+    u_long_long totalSize;              /**< Bytes of all segments */
+    u_long_long appended;               /**< Records appended */
+    u_long_long dropped;                /**< Records dropped */
+};
+
+/*========================Interfaces definition============================*/
+int
+recordStoreAppend (char *record, u_int len, char *type);
+void
+recordStoreRetain (void);
+int
+recordStoreReplay (u_long_long from, u_long_long to, char *type, u_int limit,
+                   recordStoreCursorPtr cursor, json_t *records);
+boolean
+recordStoreEnabled (void);
+int
+initRecordStore (void);
+void
+destroyRecordStore (void);
+/*=======================Interfaces definition end=========================*/
+
+#endif /* __RECORD_STORE_H__ */
@@ -2,6 +2,7 @@
 #include <string.h>
 #include <jansson.h>
 #include "util.h"
+#include "analysis_record.h"
 #include "default_analyzer.h"
 
 static int
@@ -72,11 +73,13 @@ static void
 defaultSessionBreakdown2Json (json_t *root, void *sd, void *sbd) {
     defaultSessionBreakdownPtr dsbd = (defaultSessionBreakdownPtr) sbd;
 
-    json_object_set_new (root, DEFAULT_SBKD_EXCHANGE_SIZE,
-                         json_integer (dsbd->exchangeSize));
+    if (tcpBreakdownFieldSelected (DEFAULT_SBKD_EXCHANGE_SIZE))
+        json_object_set_new (root, DEFAULT_SBKD_EXCHANGE_SIZE,
+                             json_integer (dsbd->exchangeSize));
 
-    json_object_set_new (root, DEFAULT_SBKD_SERVER_LATENCY,
-                         json_integer (dsbd->serverLatency));
+    if (tcpBreakdownFieldSelected (DEFAULT_SBKD_SERVER_LATENCY))
+        json_object_set_new (root, DEFAULT_SBKD_SERVER_LATENCY,
+                             json_integer (dsbd->serverLatency));
 }
 
 static void
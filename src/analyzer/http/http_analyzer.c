@@ -4,6 +4,7 @@
 #include <jansson.h>
 #include "util.h"
 #include "log.h"
+#include "analysis_record.h"
 #include "http_analyzer.h"
 
 /* Current timestamp */
@@ -15,6 +16,17 @@ static __thread httpHeaderType currHeaderType;
 /* Current http session detail */
 static __thread httpSessionDetailPtr currSessionDetail;
 
+/* Http request line fields to capture */
+static boolean captureMethod;
+static boolean captureUri;
+static boolean captureReqVer;
+/* Http response version to capture */
+static boolean captureRespVer;
+/* Http request headers to capture */
+static boolean captureReqHeaders [HTTP_HEADER_IGNORE + 1];
+/* Http response headers to capture */
+static boolean captureRespHeaders [HTTP_HEADER_IGNORE + 1];
+
 static char *
 getHttpBreakdownStateName (httpBreakdownState state) {
     switch (state) {
@@ -84,10 +96,17 @@ onReqUrl (http_parser *parser, const char *from, size_t length) {
     if (currNode == NULL)
         return 0;
 
-    currNode->method = strdup (http_method_str (parser->method));
-    currNode->uri = strndup (from, length);
-    if (currNode->uri == NULL)
-        LOGE ("Get http request uri error.\n");
+    if (captureMethod) {
+        currNode->method = strdup (http_method_str (parser->method));
+        if (currNode->method == NULL)
+            LOGE ("Get http request method error.\n");
+    }
+
+    if (captureUri) {
+        currNode->uri = strndup (from, length);
+        if (currNode->uri == NULL)
+            LOGE ("Get http request uri error.\n");
+    }
 
     return 0;
 }
@@ -117,6 +136,10 @@ onReqHeaderField (http_parser *parser, const char* from, size_t length) {
     else if (httpHeaderEqualWithLen (HTTP_HEADER_CONNECTION_STRING, from, length))
         currHeaderType = HTTP_HEADER_CONNECTION;
 
+    /* Skip http request header not selected */
+    if (!captureReqHeaders [currHeaderType])
+        currHeaderType = HTTP_HEADER_IGNORE;
+
     return 0;
 }
 
@@ -195,10 +218,12 @@ onReqHeadersComplete (http_parser *parser) {
         return 0;
 
     currNode->state = HTTP_REQUEST_HEADER_COMPLETE;
-    snprintf (verStr, sizeof (verStr), "HTTP/%d.%d", parser->http_major, parser->http_minor);
-    currNode->reqVer = strdup (verStr);
-    if (currNode->reqVer == NULL)
-        LOGE ("Get request protocol version error.\n");
+    if (captureReqVer) {
+        snprintf (verStr, sizeof (verStr), "HTTP/%d.%d", parser->http_major, parser->http_minor);
+        currNode->reqVer = strdup (verStr);
+        if (currNode->reqVer == NULL)
+            LOGE ("Get request protocol version error.\n");
+    }
     currNode->reqHeaderSize = parser->nread;
 
     return 0;
@@ -268,6 +293,10 @@ onRespHeaderField (http_parser *parser, const char* from, size_t length) {
     else if (httpHeaderEqualWithLen (HTTP_HEADER_CONNECTION_STRING, from, length))
         currHeaderType = HTTP_HEADER_CONNECTION;
 
+    /* Skip http response header not selected */
+    if (!captureRespHeaders [currHeaderType])
+        currHeaderType = HTTP_HEADER_IGNORE;
+
     return 0;
 }
 
@@ -321,10 +350,12 @@ onRespHeadersComplete (http_parser *parser) {
     if (currNode == NULL)
         return 0;
 
-    snprintf (verStr, sizeof (verStr), "HTTP/%d.%d", parser->http_major, parser->http_minor);
-    currNode->respVer = strdup (verStr);
-    if (currNode->respVer == NULL)
-        LOGE ("Get response protocol version error.\n");
+    if (captureRespVer) {
+        snprintf (verStr, sizeof (verStr), "HTTP/%d.%d", parser->http_major, parser->http_minor);
+        currNode->respVer = strdup (verStr);
+        if (currNode->respVer == NULL)
+            LOGE ("Get response protocol version error.\n");
+    }
     currNode->state = HTTP_RESPONSE_HEADER_COMPLETE;
     currNode->statusCode = parser->status_code;
     currNode->respHeaderSize = parser->nread;
@@ -364,6 +395,44 @@ onRespMessageComplete (http_parser *parser) {
 
 static int
 initHttpAnalyzer (void) {
+    /* Host and request line fields are also needed by composed fields */
+    captureMethod = tcpBreakdownFieldSelected (HTTP_SBKD_METHOD) ||
+                    tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_LINE);
+    captureUri = tcpBreakdownFieldSelected (HTTP_SBKD_URI) ||
+                 tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_URL) ||
+                 tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_LINE);
+    captureReqVer = tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_VERSION) ||
+                    tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_LINE);
+    captureRespVer = tcpBreakdownFieldSelected (HTTP_SBKD_RESPONSE_VERSION);
+
+    captureReqHeaders [HTTP_HEADER_HOST] =
+            tcpBreakdownFieldSelected (HTTP_SBKD_HOST) ||
+            tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_URL) ||
+            tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_LINE);
+    captureReqHeaders [HTTP_HEADER_USER_AGENT] =
+            tcpBreakdownFieldSelected (HTTP_SBKD_USER_AGENT);
+    captureReqHeaders [HTTP_HEADER_REFERER] =
+            tcpBreakdownFieldSelected (HTTP_SBKD_REFERER);
+    captureReqHeaders [HTTP_HEADER_ACCEPT] =
+            tcpBreakdownFieldSelected (HTTP_SBKD_ACCEPT);
+    captureReqHeaders [HTTP_HEADER_ACCEPT_LANGUAGE] =
+            tcpBreakdownFieldSelected (HTTP_SBKD_ACCEPT_LANGUAGE);
+    captureReqHeaders [HTTP_HEADER_ACCEPT_ENCODING] =
+            tcpBreakdownFieldSelected (HTTP_SBKD_ACCEPT_ENCODING);
+    captureReqHeaders [HTTP_HEADER_X_FORWARDED_FOR] =
+            tcpBreakdownFieldSelected (HTTP_SBKD_X_FORWARDED_FOR);
+    captureReqHeaders [HTTP_HEADER_CONNECTION] =
+            tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_CONNECTION);
+
+    captureRespHeaders [HTTP_HEADER_CONTENT_TYPE] =
+            tcpBreakdownFieldSelected (HTTP_SBKD_CONTENT_TYPE);
+    captureRespHeaders [HTTP_HEADER_CONTENT_DISPOSITION] =
+            tcpBreakdownFieldSelected (HTTP_SBKD_CONTENT_DISPOSITION);
+    captureRespHeaders [HTTP_HEADER_TRANSFER_ENCODING] =
+            tcpBreakdownFieldSelected (HTTP_SBKD_TRANSFER_ENCODING);
+    captureRespHeaders [HTTP_HEADER_CONNECTION] =
+            tcpBreakdownFieldSelected (HTTP_SBKD_RESPONSE_CONNECTION);
+
     return 0;
 }
 
@@ -805,7 +874,7 @@ generateHttpSessionBreakdown (void *sd, void *sbd) {
             break;
 
         default:
-            LOGE ("Wrong http state for breakdown.\n");
+            LOGE_RL ("Wrong http state for breakdown.\n");
             freeHttpSessionDetailNode (hsdn);
             return -1;
     }
@@ -822,27 +891,32 @@ httpSessionBreakdown2Json (json_t *root, void *sd, void *sbd) {
 
     if (hsbd->state != HTTP_BREAKDOWN_RESET_TYPE4) {
         /* Http request version */
-        if (hsbd->reqVer)
+        if (hsbd->reqVer &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_VERSION))
             json_object_set_new (root, HTTP_SBKD_REQUEST_VERSION,
                                  json_string (hsbd->reqVer));
 
         /* Http request method */
-        if (hsbd->method)
+        if (hsbd->method &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_METHOD))
             json_object_set_new (root, HTTP_SBKD_METHOD,
                                  json_string (hsbd->method));
 
         /* Http request uri */
-        if (hsbd->uri)
+        if (hsbd->uri &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_URI))
             json_object_set_new (root, HTTP_SBKD_URI,
                                  json_string (hsbd->uri));
 
         /* Http request host */
-        if (hsbd->host)
+        if (hsbd->host &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_HOST))
             json_object_set_new (root, HTTP_SBKD_HOST,
                                  json_string (hsbd->host));
 
         /* Http request url */
-        if (hsbd->uri && hsbd->host) {
+        if (hsbd->uri && hsbd->host &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_URL)) {
             snprintf (buf, sizeof (buf), "http://%s%s",
                       hsbd->host, hsbd->uri);
             json_object_set_new (root, HTTP_SBKD_REQUEST_URL,
@@ -850,7 +924,8 @@ httpSessionBreakdown2Json (json_t *root, void *sd, void *sbd) {
         }
 
         /* Http request line */
-        if (hsbd->reqVer && hsbd->method && hsbd->uri && hsbd->host) {
+        if (hsbd->reqVer && hsbd->method && hsbd->uri && hsbd->host &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_LINE)) {
             snprintf (buf, sizeof (buf), "%s http://%s%s %s",
                       hsbd->method, hsbd->host, hsbd->uri, hsbd->reqVer);
             json_object_set_new (root, HTTP_SBKD_REQUEST_LINE,
@@ -858,92 +933,113 @@ httpSessionBreakdown2Json (json_t *root, void *sd, void *sbd) {
         }
 
         /* Http request user agent */
-        if (hsbd->userAgent)
+        if (hsbd->userAgent &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_USER_AGENT))
             json_object_set_new (root, HTTP_SBKD_USER_AGENT,
                                  json_string (hsbd->userAgent));
 
         /* Http referer url */
-        if (hsbd->referer)
+        if (hsbd->referer &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_REFERER))
             json_object_set_new (root, HTTP_SBKD_REFERER,
                                  json_string (hsbd->referer));
 
         /* Http request accept source */
-        if (hsbd->accept)
+        if (hsbd->accept &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_ACCEPT))
             json_object_set_new (root, HTTP_SBKD_ACCEPT,
                                  json_string (hsbd->accept));
 
         /* Http request accept Language */
-        if (hsbd->acceptLanguage)
+        if (hsbd->acceptLanguage &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_ACCEPT_LANGUAGE))
             json_object_set_new (root, HTTP_SBKD_ACCEPT_LANGUAGE,
                                  json_string (hsbd->acceptLanguage));
 
         /* Http request accept encoding */
-        if (hsbd->acceptEncoding)
+        if (hsbd->acceptEncoding &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_ACCEPT_ENCODING))
             json_object_set_new (root, HTTP_SBKD_ACCEPT_ENCODING,
                                  json_string (hsbd->acceptEncoding));
 
         /* Http request X-Forwarded-For */
-        if (hsbd->xForwardedFor)
+        if (hsbd->xForwardedFor &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_X_FORWARDED_FOR))
             json_object_set_new (root, HTTP_SBKD_X_FORWARDED_FOR,
                                  json_string (hsbd->xForwardedFor));
 
         /* Http request connection type */
-        if (hsbd->reqConnection)
+        if (hsbd->reqConnection &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_CONNECTION))
             json_object_set_new (root, HTTP_SBKD_REQUEST_CONNECTION,
                                  json_string (hsbd->reqConnection));
 
         /* Http response version */
-        if (hsbd->respVer)
+        if (hsbd->respVer &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_RESPONSE_VERSION))
             json_object_set_new (root, HTTP_SBKD_RESPONSE_VERSION,
                                  json_string (hsbd->respVer));
 
         /* Http response connection type */
-        if (hsbd->contentType)
+        if (hsbd->contentType &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_CONTENT_TYPE))
             json_object_set_new (root, HTTP_SBKD_CONTENT_TYPE,
                                  json_string (hsbd->contentType));
 
         /* Http response content Disposition */
-        if (hsbd->contentDisposition)
+        if (hsbd->contentDisposition &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_CONTENT_DISPOSITION))
             json_object_set_new (root, HTTP_SBKD_CONTENT_DISPOSITION,
                                  json_string (hsbd->contentDisposition));
 
         /* Http response transfer Encoding */
-        if (hsbd->transferEncoding)
+        if (hsbd->transferEncoding &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_TRANSFER_ENCODING))
             json_object_set_new (root, HTTP_SBKD_TRANSFER_ENCODING,
                                  json_string (hsbd->transferEncoding));
 
         /* Http response connection type */
-        if (hsbd->respConnection)
+        if (hsbd->respConnection &&
+            tcpBreakdownFieldSelected (HTTP_SBKD_RESPONSE_CONNECTION))
             json_object_set_new (root, HTTP_SBKD_RESPONSE_CONNECTION,
                                  json_string (hsbd->respConnection));
 
         /* Http state */
-        json_object_set_new (root, HTTP_SBKD_STATE,
-                             json_string (getHttpBreakdownStateName (hsbd->state)));
+        if (tcpBreakdownFieldSelected (HTTP_SBKD_STATE))
+            json_object_set_new (root, HTTP_SBKD_STATE,
+                                 json_string (getHttpBreakdownStateName (hsbd->state)));
         /* Http status code */
-        json_object_set_new (root, HTTP_SBKD_STATUS_CODE,
-                             json_integer (hsbd->statusCode));
+        if (tcpBreakdownFieldSelected (HTTP_SBKD_STATUS_CODE))
+            json_object_set_new (root, HTTP_SBKD_STATUS_CODE,
+                                 json_integer (hsbd->statusCode));
         /* Http request header size */
-        json_object_set_new (root, HTTP_SBKD_REQUEST_HEADER_SIZE,
-                             json_integer (hsbd->reqHeaderSize));
+        if (tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_HEADER_SIZE))
+            json_object_set_new (root, HTTP_SBKD_REQUEST_HEADER_SIZE,
+                                 json_integer (hsbd->reqHeaderSize));
         /* Http request body size */
-        json_object_set_new (root, HTTP_SBKD_REQUEST_BODY_SIZE,
-                             json_integer (hsbd->reqBodySize));
+        if (tcpBreakdownFieldSelected (HTTP_SBKD_REQUEST_BODY_SIZE))
+            json_object_set_new (root, HTTP_SBKD_REQUEST_BODY_SIZE,
+                                 json_integer (hsbd->reqBodySize));
         /* Http response header size */
-        json_object_set_new (root, HTTP_SBKD_RESPONSE_HEADER_SIZE,
-                             json_integer (hsbd->respHeaderSize));
+        if (tcpBreakdownFieldSelected (HTTP_SBKD_RESPONSE_HEADER_SIZE))
+            json_object_set_new (root, HTTP_SBKD_RESPONSE_HEADER_SIZE,
+                                 json_integer (hsbd->respHeaderSize));
         /* Http response body size */
-        json_object_set_new (root, HTTP_SBKD_RESPONSE_BODY_SIZE,
-                             json_integer (hsbd->respBodySize));
+        if (tcpBreakdownFieldSelected (HTTP_SBKD_RESPONSE_BODY_SIZE))
+            json_object_set_new (root, HTTP_SBKD_RESPONSE_BODY_SIZE,
+                                 json_integer (hsbd->respBodySize));
         /* Http server latency */
-        json_object_set_new (root, HTTP_SBKD_SERVER_LATENCY,
-                             json_integer (hsbd->serverLatency));
+        if (tcpBreakdownFieldSelected (HTTP_SBKD_SERVER_LATENCY))
+            json_object_set_new (root, HTTP_SBKD_SERVER_LATENCY,
+                                 json_integer (hsbd->serverLatency));
         /* Http download latency */
-        json_object_set_new (root, HTTP_SBKD_DOWNLOAD_LATENCY,
-                             json_integer (hsbd->downloadLatency));
+        if (tcpBreakdownFieldSelected (HTTP_SBKD_DOWNLOAD_LATENCY))
+            json_object_set_new (root, HTTP_SBKD_DOWNLOAD_LATENCY,
+                                 json_integer (hsbd->downloadLatency));
         /* Http response latency */
-        json_object_set_new (root, HTTP_SBKD_RESPONSE_LATENCY,
-                             json_integer (hsbd->respLatency));
+        if (tcpBreakdownFieldSelected (HTTP_SBKD_RESPONSE_LATENCY))
+            json_object_set_new (root, HTTP_SBKD_RESPONSE_LATENCY,
+                                 json_integer (hsbd->respLatency));
     }
 }
 
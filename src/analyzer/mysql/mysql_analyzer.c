@@ -6,6 +6,7 @@
 #include <jansson.h>
 #include "util.h"
 #include "log.h"
+#include "analysis_record.h"
 #include "mysql_analyzer.h"
 
 /* Mysql indention for info display */
@@ -338,7 +339,7 @@ pktServerHandshake (mysqlEvent event, u_char *payload, u_int payloadLen,
 
     /* Only support v10 protocol */
     if (!MATCH (*pkt, 0x0A)) {
-        LOGE ("Only support v10 protocol\n", MYSQL_INFO_DISPLAY_INDENT1);
+        LOGE_RL ("Only support v10 protocol\n", MYSQL_INFO_DISPLAY_INDENT1);
         return EVENT_HANDLE_ERROR;
     }
 
@@ -2101,7 +2102,7 @@ mysqlParserExecute (u_char *data, u_int dataLen, streamDirection direction) {
     u_char *compPayload;
 
     if (currSharedInfo->doSSL) {
-        LOGW ("Doesn't support ssl for mysql analyzer.\n");
+        LOGW_RL ("Doesn't support ssl for mysql analyzer.\n");
         return dataLen;
     }
 
@@ -2156,7 +2157,7 @@ mysqlParserExecute (u_char *data, u_int dataLen, streamDirection direction) {
                     uncompPayloadLen = payloadLen;
                     if (uncompress ((u_char *) uncompPkt, (u_long *) &uncompPayloadLen,
                                     compPayload, compPayloadLen) != Z_OK) {
-                        LOGE ("Uncompress packet error.\n");
+                        LOGE_RL ("Uncompress packet error.\n");
                         free (uncompPkt);
                         uncompPkt = NULL;
                         parseCount += compPktLen;
@@ -2686,7 +2687,7 @@ generateMysqlSessionBreakdown (void *sd, void *sbd) {
             return -1;
         }
     } else {
-        LOGE ("Mysql server version is NULL.\n");
+        LOGE_RL ("Mysql server version is NULL.\n");
         return -1;
     }
 
@@ -2697,7 +2698,7 @@ generateMysqlSessionBreakdown (void *sd, void *sbd) {
             return -1;
         }
     } else {
-        LOGE ("Mysql user name is NULL.\n");
+        LOGE_RL ("Mysql user name is NULL.\n");
         return -1;
     }
 
@@ -2732,7 +2733,7 @@ generateMysqlSessionBreakdown (void *sd, void *sbd) {
                         return -1;
                     }
                 } else {
-                    LOGE ("Mysql errMsg is NULL.\n");
+                    LOGE_RL ("Mysql errMsg is NULL.\n");
                     return -1;
                 }
             }
@@ -2784,7 +2785,7 @@ generateMysqlSessionBreakdown (void *sd, void *sbd) {
             break;
 
         default:
-            LOGE ("Wrong mysql state for breakdown.\n");
+            LOGE_RL ("Wrong mysql state for breakdown.\n");
             return -1;
     }
 
@@ -2796,57 +2797,70 @@ mysqlSessionBreakdown2Json (json_t *root, void *sd, void *sbd) {
     mysqlSessionBreakdownPtr msbd = (mysqlSessionBreakdownPtr) sbd;
 
     /* Mysql server version */
-    json_object_set_new (root, MYSQL_SBKD_SERVER_VERSION,
-                         json_string (msbd->serverVer));
+    if (tcpBreakdownFieldSelected (MYSQL_SBKD_SERVER_VERSION))
+        json_object_set_new (root, MYSQL_SBKD_SERVER_VERSION,
+                             json_string (msbd->serverVer));
 
     /* Mysql user name */
-    json_object_set_new (root, MYSQL_SBKD_USER_NAME,
-                         json_string (msbd->userName));
+    if (tcpBreakdownFieldSelected (MYSQL_SBKD_USER_NAME))
+        json_object_set_new (root, MYSQL_SBKD_USER_NAME,
+                             json_string (msbd->userName));
 
     /* Mysql connection id */
-    json_object_set_new (root, MYSQL_SBKD_CONNECTION_ID,
-                         json_integer (msbd->conId));
+    if (tcpBreakdownFieldSelected (MYSQL_SBKD_CONNECTION_ID))
+        json_object_set_new (root, MYSQL_SBKD_CONNECTION_ID,
+                             json_integer (msbd->conId));
 
     /* Mysql request statement */
-    if (msbd->reqStmt)
+    if (msbd->reqStmt &&
+        tcpBreakdownFieldSelected (MYSQL_SBKD_REQUEST_STATEMENT))
         json_object_set_new (root, MYSQL_SBKD_REQUEST_STATEMENT,
                              json_string (msbd->reqStmt));
 
     /* Mysql state */
-    json_object_set_new (root, MYSQL_SBKD_STATE,
-                         json_string (getMysqlBreakdownStateName (msbd->state)));
+    if (tcpBreakdownFieldSelected (MYSQL_SBKD_STATE))
+        json_object_set_new (root, MYSQL_SBKD_STATE,
+                             json_string (getMysqlBreakdownStateName (msbd->state)));
 
     /* Mysql error code */
-    json_object_set_new (root, MYSQL_SBKD_ERROR_CODE,
-                         json_integer (msbd->errCode));
+    if (tcpBreakdownFieldSelected (MYSQL_SBKD_ERROR_CODE))
+        json_object_set_new (root, MYSQL_SBKD_ERROR_CODE,
+                             json_integer (msbd->errCode));
 
     /* Mysql sql state */
-    json_object_set_new (root, MYSQL_SBKD_SQL_STATE,
-                         json_integer (msbd->sqlState));
+    if (tcpBreakdownFieldSelected (MYSQL_SBKD_SQL_STATE))
+        json_object_set_new (root, MYSQL_SBKD_SQL_STATE,
+                             json_integer (msbd->sqlState));
     /* Mysql error message */
-    if (msbd->errMsg)
+    if (msbd->errMsg &&
+        tcpBreakdownFieldSelected (MYSQL_SBKD_ERROR_MESSAGE))
         json_object_set_new (root, MYSQL_SBKD_ERROR_MESSAGE,
                              json_string (msbd->errMsg));
 
     /* Mysql request size */
-    json_object_set_new (root, MYSQL_SBKD_REQUEST_SIZE,
-                         json_integer (msbd->reqSize));
+    if (tcpBreakdownFieldSelected (MYSQL_SBKD_REQUEST_SIZE))
+        json_object_set_new (root, MYSQL_SBKD_REQUEST_SIZE,
+                             json_integer (msbd->reqSize));
 
     /* Mysql response size */
-    json_object_set_new (root, MYSQL_SBKD_RESPONSE_SIZE,
-                         json_integer (msbd->respSize));
+    if (tcpBreakdownFieldSelected (MYSQL_SBKD_RESPONSE_SIZE))
+        json_object_set_new (root, MYSQL_SBKD_RESPONSE_SIZE,
+                             json_integer (msbd->respSize));
 
     /* Mysql server latency */
-    json_object_set_new (root, MYSQL_SBKD_SERVER_LATENCY,
-                         json_integer (msbd->serverLatency));
+    if (tcpBreakdownFieldSelected (MYSQL_SBKD_SERVER_LATENCY))
+        json_object_set_new (root, MYSQL_SBKD_SERVER_LATENCY,
+                             json_integer (msbd->serverLatency));
 
     /* Mysql download latency */
-    json_object_set_new (root, MYSQL_SBKD_DOWNLOAD_LATENCY,
-                         json_integer (msbd->downloadLatency));
+    if (tcpBreakdownFieldSelected (MYSQL_SBKD_DOWNLOAD_LATENCY))
+        json_object_set_new (root, MYSQL_SBKD_DOWNLOAD_LATENCY,
+                             json_integer (msbd->downloadLatency));
 
     /* Mysql response latency */
-    json_object_set_new (root, MYSQL_SBKD_RESPONSE_LATENCY,
-                         json_integer (msbd->respLatency));
+    if (tcpBreakdownFieldSelected (MYSQL_SBKD_RESPONSE_LATENCY))
+        json_object_set_new (root, MYSQL_SBKD_RESPONSE_LATENCY,
+                             json_integer (msbd->respLatency));
 }
 
 static void
@@ -55,6 +55,19 @@ getProtoAnalyzer (char *proto) {
     return NULL;
 }
 
+/* Get index of proto analyzer in registered proto analyzers */
+int
+getProtoAnalyzerIndex (protoAnalyzerPtr analyzer) {
+    u_int i;
+
+    for (i = 0; i < registeredProtoAnalyzerNum; i++) {
+        if (protoAnalyzerContextTable [i].analyzer == analyzer)
+            return i;
+    }
+
+    return -1;
+}
+
 char *
 protoDetect (streamDirection direction, timeValPtr tm,
              u_char *data, u_int dataLen) {
@@ -198,6 +198,8 @@ int
 getProtoAnalyzerInfo (protoAnalyzerInfoPtr info);
 protoAnalyzerPtr
 getProtoAnalyzer (char *proto);
+int
+getProtoAnalyzerIndex (protoAnalyzerPtr analyzer);
 char *
 protoDetect (streamDirection direction, timeValPtr tm,
              u_char *data, u_int dataLen);
@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <jansson.h>
+#include "util.h"
+#include "log.h"
+#include "proto_analyzer.h"
+#include "proto_analyzer_stats.h"
+
+/* Thread local proto analyzer stats slot */
+static __thread protoAnalyzerStatsSlotPtr protoAnalyzerStatsSlotInstance = NULL;
+
+/* Proto analyzer stats slots of all threads */
+static protoAnalyzerStatsSlotPtr protoAnalyzerStatsSlots [MAX_PROTO_ANALYZER_STATS_SLOTS];
+static volatile u_int protoAnalyzerStatsSlotsNum = 0;
+/* Proto analyzer stats slots register lock */
+static pthread_mutex_t protoAnalyzerStatsSlotsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Proto analyzer dispatch point names, ordered by protoAnalyzerCall */
+static char *protoAnalyzerCallNames [] = {
+    "estb",
+    "data",
+    "reset",
+    "fin",
+    "breakdown",
+};
+
+/**
+ * @brief Get proto analyzer stats of current thread.
+ *
+ * @param analyzer -- Proto analyzer
+ *
+ * @return Proto analyzer stats if current thread has stats slot else NULL
+ */
+protoAnalyzerStatsPtr
+getProtoAnalyzerStats (protoAnalyzerPtr analyzer) {
+    int index;
+
+    if (protoAnalyzerStatsSlotInstance == NULL || analyzer == NULL)
+        return NULL;
+
+    index = getProtoAnalyzerIndex (analyzer);
+    if (index < 0)
+        return NULL;
+
+    return &protoAnalyzerStatsSlotInstance->stats [index];
+}
+
+/**
+ * @brief Begin proto analyzer call, one of every
+ *        PROTO_ANALYZER_STATS_SAMPLE_RATE calls is sampled for time.
+ *
+ * @param stats -- Proto analyzer stats of current thread
+ * @param call -- Proto analyzer dispatch point
+ *
+ * @return Monotonic start time if call is sampled else 0
+ */
+u_long_long
+protoAnalyzerStatsBegin (protoAnalyzerStatsPtr stats, protoAnalyzerCall call) {
+    if (stats == NULL)
+        return 0;
+
+    if ((stats->calls [call].calls++ & (PROTO_ANALYZER_STATS_SAMPLE_RATE - 1)) == 0)
+        return getMonotonicTime ();
+
+    return 0;
+}
+
+/**
+ * @brief End proto analyzer call.
+ *
+ * @param stats -- Proto analyzer stats of current thread
+ * @param call -- Proto analyzer dispatch point
+ * @param startTime -- Start time returned by protoAnalyzerStatsBegin
+ * @param bytes -- Bytes passed to proto analyzer
+ */
+void
+protoAnalyzerStatsEnd (protoAnalyzerStatsPtr stats, protoAnalyzerCall call,
+                       u_long_long startTime, u_int bytes) {
+    u_long_long now;
+
+    if (stats == NULL)
+        return;
+
+    stats->calls [call].bytes += bytes;
+    if (startTime) {
+        now = getMonotonicTime ();
+        stats->calls [call].sampledCalls++;
+        stats->calls [call].sampledTime += now - startTime;
+    }
+}
+
+/* Estimate total time in nanoseconds of calls from sampled calls */
+static u_long_long
+protoAnalyzerCallStatsTime (protoAnalyzerCallStatsPtr callStats) {
+    if (callStats->sampledCalls == 0)
+        return 0;
+
+    return (u_long_long) ((double) callStats->sampledTime /
+                          callStats->sampledCalls * callStats->calls);
+}
+
+/* Accumulate proto analyzer call stats */
+static void
+protoAnalyzerCallStatsAdd (protoAnalyzerCallStatsPtr dst, protoAnalyzerCallStatsPtr src) {
+    dst->calls += src->calls;
+    dst->sampledCalls += src->sampledCalls;
+    dst->sampledTime += src->sampledTime;
+    dst->bytes += src->bytes;
+}
+
+/* Get json of proto analyzer stats */
+static json_t *
+protoAnalyzerStatsJson (protoAnalyzerStatsPtr stats) {
+    u_int i;
+    u_long_long time, totalTime = 0, totalBytes = 0;
+    protoAnalyzerCallStatsPtr callStats;
+    json_t *root, *calls, *call;
+
+    root = json_object ();
+    if (root == NULL)
+        return NULL;
+
+    calls = json_object ();
+    if (calls == NULL) {
+        json_object_clear (root);
+        return NULL;
+    }
+
+    for (i = 0; i < PROTO_ANALYZER_CALL_MAX; i++) {
+        callStats = &stats->calls [i];
+        if (callStats->calls == 0)
+            continue;
+
+        call = json_object ();
+        if (call == NULL) {
+            json_object_clear (calls);
+            json_object_clear (root);
+            return NULL;
+        }
+
+        time = protoAnalyzerCallStatsTime (callStats);
+        json_object_set_new (call, "calls", json_integer (callStats->calls));
+        json_object_set_new (call, "bytes", json_integer (callStats->bytes));
+        json_object_set_new (call, "time_us", json_integer (time / 1000));
+        json_object_set_new (call, "avg_ns",
+                             json_integer (callStats->sampledCalls ?
+                                           callStats->sampledTime / callStats->sampledCalls : 0));
+        json_object_set_new (calls, protoAnalyzerCallNames [i], call);
+
+        totalTime += time;
+        totalBytes += callStats->bytes;
+    }
+
+    json_object_set_new (root, "time_us", json_integer (totalTime / 1000));
+    json_object_set_new (root, "bytes", json_integer (totalBytes));
+    json_object_set_new (root, "ns_per_byte",
+                         json_real (totalBytes ? (double) totalTime / totalBytes : 0));
+    json_object_set_new (root, "calls", calls);
+
+    return root;
+}
+
+/**
+ * @brief Get proto analyzer stats of all threads in json, stats are
+ *        grouped by proto analyzer, with total stats and stats of each
+ *        thread. Proto analyzers never called are skipped.
+ *
+ * @return Proto analyzer stats json object if success else NULL
+ */
+json_t *
+protoAnalyzerStatsToJson (void) {
+    int ret;
+    u_int i, j, k, num;
+    protoAnalyzerInfo info;
+    protoAnalyzerStats total;
+    protoAnalyzerStatsPtr stats;
+    protoAnalyzerStatsSlotPtr slot;
+    json_t *root, *analyzer, *threads, *item;
+
+    ret = getProtoAnalyzerInfo (&info);
+    if (ret < 0)
+        return NULL;
+
+    root = json_object ();
+    if (root == NULL)
+        return NULL;
+
+    num = MIN_NUM (protoAnalyzerStatsSlotsNum, MAX_PROTO_ANALYZER_STATS_SLOTS);
+    for (i = 0; i < info.protoNum; i++) {
+        memset (&total, 0, sizeof (total));
+
+        threads = json_object ();
+        if (threads == NULL)
+            goto error;
+
+        for (j = 0; j < num; j++) {
+            slot = protoAnalyzerStatsSlots [j];
+            if (slot == NULL)
+                continue;
+
+            stats = &slot->stats [i];
+            for (k = 0; k < PROTO_ANALYZER_CALL_MAX; k++) {
+                if (stats->calls [k].calls)
+                    break;
+            }
+            if (k == PROTO_ANALYZER_CALL_MAX)
+                continue;
+
+            for (k = 0; k < PROTO_ANALYZER_CALL_MAX; k++)
+                protoAnalyzerCallStatsAdd (&total.calls [k], &stats->calls [k]);
+
+            item = protoAnalyzerStatsJson (stats);
+            if (item == NULL) {
+                json_object_clear (threads);
+                goto error;
+            }
+            json_object_set_new (threads, slot->component, item);
+        }
+
+        if (json_object_size (threads) == 0) {
+            json_decref (threads);
+            continue;
+        }
+
+        analyzer = protoAnalyzerStatsJson (&total);
+        if (analyzer == NULL) {
+            json_object_clear (threads);
+            goto error;
+        }
+        json_object_set_new (analyzer, "threads", threads);
+        json_object_set_new (root, info.protos [i], analyzer);
+    }
+
+    return root;
+
+error:
+    json_object_clear (root);
+    return NULL;
+}
+
+/* Find stats slot of component, must be called with protoAnalyzerStatsSlotsLock */
+static protoAnalyzerStatsSlotPtr
+findProtoAnalyzerStatsSlot (char *component) {
+    u_int i;
+
+    for (i = 0; i < protoAnalyzerStatsSlotsNum; i++) {
+        if (strEqual (protoAnalyzerStatsSlots [i]->component, component))
+            return protoAnalyzerStatsSlots [i];
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Init proto analyzer stats context of current thread, it will
+ *        register a stats slot for current thread, slot is kept after
+ *        thread exit so stats are still reported. Slot released by
+ *        thread of the same component is reused by restarted thread,
+ *        component of running thread is suffixed with "#n".
+ *
+ * @param component -- Stats component format, like "TcpProcessService:3"
+ *
+ * @return 0 if success else -1
+ */
+int
+initProtoAnalyzerStatsContext (const char *component, ...) {
+    u_int n;
+    boolean newSlot = False;
+    va_list va;
+    char name [PROTO_ANALYZER_STATS_COMPONENT_MAX_LENGTH];
+    char uniqueName [PROTO_ANALYZER_STATS_COMPONENT_MAX_LENGTH];
+    protoAnalyzerStatsSlotPtr slot;
+
+    va_start (va, component);
+    vsnprintf (name, sizeof (name), component, va);
+    va_end (va);
+
+    pthread_mutex_lock (&protoAnalyzerStatsSlotsLock);
+
+    snprintf (uniqueName, sizeof (uniqueName), "%s", name);
+    for (n = 2; (slot = findProtoAnalyzerStatsSlot (uniqueName)) && slot->active; n++)
+        snprintf (uniqueName, sizeof (uniqueName), "%s#%u", name, n);
+
+    if (slot == NULL) {
+        if (protoAnalyzerStatsSlotsNum >= MAX_PROTO_ANALYZER_STATS_SLOTS) {
+            pthread_mutex_unlock (&protoAnalyzerStatsSlotsLock);
+            LOGE ("Too many proto analyzer stats slots.\n");
+            return -1;
+        }
+
+        slot = (protoAnalyzerStatsSlotPtr) calloc (1, sizeof (protoAnalyzerStatsSlot));
+        if (slot == NULL) {
+            pthread_mutex_unlock (&protoAnalyzerStatsSlotsLock);
+            LOGE ("Alloc proto analyzer stats slot error.\n");
+            return -1;
+        }
+        snprintf (slot->component, sizeof (slot->component), "%s", uniqueName);
+        newSlot = True;
+    }
+    slot->active = True;
+
+    /* Publish new slot after it has been initialized */
+    if (newSlot) {
+        __sync_synchronize ();
+        protoAnalyzerStatsSlots [protoAnalyzerStatsSlotsNum] = slot;
+        __sync_synchronize ();
+        protoAnalyzerStatsSlotsNum++;
+    }
+    protoAnalyzerStatsSlotInstance = slot;
+
+    pthread_mutex_unlock (&protoAnalyzerStatsSlotsLock);
+    return 0;
+}
+
+/* Destroy proto analyzer stats context of current thread, slot is released for reuse */
+void
+destroyProtoAnalyzerStatsContext (void) {
+    pthread_mutex_lock (&protoAnalyzerStatsSlotsLock);
+    if (protoAnalyzerStatsSlotInstance)
+        protoAnalyzerStatsSlotInstance->active = False;
+    protoAnalyzerStatsSlotInstance = NULL;
+    pthread_mutex_unlock (&protoAnalyzerStatsSlotsLock);
+}
+
+/* Destroy proto analyzer stats, must be called after all threads exit */
+void
+destroyProtoAnalyzerStats (void) {
+    u_int i, num;
+
+    num = MIN_NUM (protoAnalyzerStatsSlotsNum, MAX_PROTO_ANALYZER_STATS_SLOTS);
+    for (i = 0; i < num; i++) {
+        free (protoAnalyzerStatsSlots [i]);
+        protoAnalyzerStatsSlots [i] = NULL;
+    }
+    protoAnalyzerStatsSlotsNum = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef __PROTO_ANALYZER_STATS_H__
+#define __PROTO_ANALYZER_STATS_H__
+
+#include <jansson.h>
+#include "util.h"
+#include "proto_analyzer.h"
+
+/* Max proto analyzer stats slots, one slot for each tcpProcessService */
+#define MAX_PROTO_ANALYZER_STATS_SLOTS 256
+/* Sample one of every PROTO_ANALYZER_STATS_SAMPLE_RATE calls, must be power of 2 */
+#define PROTO_ANALYZER_STATS_SAMPLE_RATE 16
+#define PROTO_ANALYZER_STATS_COMPONENT_MAX_LENGTH 64
+
+/* Proto analyzer dispatch points */
+typedef enum {
+    PROTO_ANALYZER_CALL_ESTB,
+    PROTO_ANALYZER_CALL_DATA,
+    PROTO_ANALYZER_CALL_RESET,
+    PROTO_ANALYZER_CALL_FIN,
+    PROTO_ANALYZER_CALL_BREAKDOWN,
+    PROTO_ANALYZER_CALL_MAX
+} protoAnalyzerCall;
+
+typedef struct _protoAnalyzerCallStats protoAnalyzerCallStats;
+typedef protoAnalyzerCallStats *protoAnalyzerCallStatsPtr;
+
+struct _protoAnalyzerCallStats {
+    volatile u_long_long calls;         /**< Calls of dispatch point */
+    volatile u_long_long sampledCalls;  /**< Calls sampled for time */
+    volatile u_long_long sampledTime;   /**< Time of calls sampled in nanoseconds */
+    volatile u_long_long bytes;         /**< Bytes passed to proto analyzer */
+};
+
+typedef struct _protoAnalyzerStats protoAnalyzerStats;
+typedef protoAnalyzerStats *protoAnalyzerStatsPtr;
+
+/* Stats of one proto analyzer in one thread */
+struct _protoAnalyzerStats {
+    protoAnalyzerCallStats calls [PROTO_ANALYZER_CALL_MAX]; /**< Stats of dispatch points */
+};
+
+typedef struct _protoAnalyzerStatsSlot protoAnalyzerStatsSlot;
+typedef protoAnalyzerStatsSlot *protoAnalyzerStatsSlotPtr;
+
+/*
+ * Proto analyzer stats slot of one thread, written by owner thread only
+ * without lock and read by management service.
+ */
+struct _protoAnalyzerStatsSlot {
+    char component [PROTO_ANALYZER_STATS_COMPONENT_MAX_LENGTH]; /**< Stats component */
+    boolean active;                     /**< Slot is owned by a running thread */
+    protoAnalyzerStats stats [MAX_PROTO_ANALYZER_NUM]; /**< Stats indexed by proto analyzer */
+};
+
+/*========================Interfaces definition============================*/
+protoAnalyzerStatsPtr
+getProtoAnalyzerStats (protoAnalyzerPtr analyzer);
+u_long_long
+protoAnalyzerStatsBegin (protoAnalyzerStatsPtr stats, protoAnalyzerCall call);
+void
+protoAnalyzerStatsEnd (protoAnalyzerStatsPtr stats, protoAnalyzerCall call,
+                       u_long_long startTime, u_int bytes);
+json_t *
+protoAnalyzerStatsToJson (void);
+int
+initProtoAnalyzerStatsContext (const char *component, ...);
+void
+destroyProtoAnalyzerStatsContext (void);
+void
+destroyProtoAnalyzerStats (void);
+/*=======================Interfaces definition end=========================*/
+
+#endif /* __PROTO_ANALYZER_STATS_H__ */
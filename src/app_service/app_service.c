@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -5,9 +6,19 @@
 #include <string.h>
 #include <jansson.h>
 #include "log.h"
+#include "hash.h"
 #include "analysis_record.h"
 #include "app_service.h"
 
+/* AppService ipv4 filter */
+#define APP_SERVICE_BPF_FILTER "ip host %s or "
+/* AppService ipv6 filter */
+#define APP_SERVICE_IP6_BPF_FILTER "ip6 host %s or "
+/* AppService filter length */
+#define APP_SERVICE_BPF_FILTER_LENGTH 64
+/* AppServices filter tail, non-first ipv6 fragments have no tcp header */
+#define APP_SERVICES_BPF_FILTER_TAIL ") and (tcp or ip6[6] == 44)) or icmp or icmp6"
+
 static appServicePtr
 newAppServiceInternal (void) {
     appServicePtr svc;
@@ -109,6 +120,60 @@ copyAppService (appServicePtr appService) {
     return tmp;
 }
 
+static int
+getBpfFilterForEachAppService (void *data, void *args) {
+    u_int len;
+    appServicePtr svc = (appServicePtr) data;
+    char *filter = (char *) args;
+
+    len = strlen (filter);
+    if (strchr (svc->ip, ':'))
+        snprintf (filter + len, APP_SERVICE_BPF_FILTER_LENGTH, APP_SERVICE_IP6_BPF_FILTER,
+                  svc->ip);
+    else
+        snprintf (filter + len, APP_SERVICE_BPF_FILTER_LENGTH, APP_SERVICE_BPF_FILTER,
+                  svc->ip);
+    return 0;
+}
+
+/**
+ * @brief Get bpf filter of appServices.
+ *        Ipv4 appService is filtered with ip host and ipv6 appService
+ *        with ip6 host, ipv6 fragments and icmp of both are kept.
+ *
+ * @param appServices -- appServices hash table, must not be empty
+ *
+ * @return appServices filter if success, else NULL
+ */
+char *
+getAppServicesBpfFilter (hashTablePtr appServices) {
+    int ret;
+    char *filter;
+    u_int filterLen, len;
+
+    filterLen = APP_SERVICE_BPF_FILTER_LENGTH * (hashSize (appServices) + 1);
+    filter = (char *) malloc (filterLen);
+    if (filter == NULL) {
+        LOGE ("Alloc filter buffer error: %s.\n", strerror (errno));
+        return NULL;
+    }
+    memset (filter, 0, filterLen);
+
+    strcat (filter, "((");
+    ret = hashLoopDo (appServices, getBpfFilterForEachAppService, filter);
+    if (ret < 0) {
+        LOGE ("Get BPF filter from each appService error.\n");
+        free (filter);
+        return NULL;
+    }
+
+    /* Replace the last " or " with filter tail */
+    len = strlen (filter);
+    snprintf (filter + len - 4, filterLen - len + 4, APP_SERVICES_BPF_FILTER_TAIL);
+
+    return filter;
+}
+
 /**
  * @brief Convert appService to json.
  *
@@ -149,6 +214,7 @@ json2AppService (json_t *json) {
     appServicePtr svc;
     protoAnalyzerPtr analyzer;
     struct in_addr sa;
+    struct in6_addr sa6;
 
     svc = newAppServiceInternal ();
     if (svc == NULL) {
@@ -180,7 +246,8 @@ json2AppService (json_t *json) {
         free (svc);
         return NULL;
     }
-    if (!inet_aton (json_string_value (tmp), &sa)) {
+    if (inet_pton (AF_INET, json_string_value (tmp), &sa) != 1 &&
+        inet_pton (AF_INET6, json_string_value (tmp), &sa6) != 1) {
         LOGE ("Wrong appService ip format: %s.\n",
               (json_string_value (tmp)));
         freeAppService (svc);
@@ -238,13 +305,16 @@ appServiceAnalysisRecord (timeValPtr tm, char *proto, char *ip, u_short port) {
                          json_string (ANALYSIS_RECORD_TYPE_APP_SERVICE));
 
     /* AppService proto */
-    json_object_set_new (root, APP_SERVICE_PROTO, json_string (proto));
+    if (analysisRecordFieldSelected (ANALYSIS_RECORD_TYPE_APP_SERVICE, APP_SERVICE_PROTO))
+        json_object_set_new (root, APP_SERVICE_PROTO, json_string (proto));
 
     /* AppService ip */
-    json_object_set_new (root, APP_SERVICE_IP, json_string (ip));
+    if (analysisRecordFieldSelected (ANALYSIS_RECORD_TYPE_APP_SERVICE, APP_SERVICE_IP))
+        json_object_set_new (root, APP_SERVICE_IP, json_string (ip));
 
     /* AppService port */
-    json_object_set_new (root, APP_SERVICE_PORT, json_integer (port));
+    if (analysisRecordFieldSelected (ANALYSIS_RECORD_TYPE_APP_SERVICE, APP_SERVICE_PORT))
+        json_object_set_new (root, APP_SERVICE_PORT, json_integer (port));
 
     out = json_dumps (root, JSON_COMPACT | JSON_PRESERVE_ORDER);
     json_object_clear (root);
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <jansson.h>
+#include "hash.h"
 #include "proto_analyzer.h"
 
 typedef struct _appService appService;
@@ -30,6 +31,8 @@ appServicePtr
 copyAppService (appServicePtr appService);
 void
 freeAppServiceForHash (void *data);
+char *
+getAppServicesBpfFilter (hashTablePtr appServices);
 json_t *
 appService2Json (appServicePtr svc);
 appServicePtr
@@ -16,10 +16,6 @@
 
 /* AppService padding filter */
 #define APP_SERVICE_PADDING_BPF_FILTER "icmp"
-/* AppService filter */
-#define APP_SERVICE_BPF_FILTER "ip host %s or "
-/* AppService filter length */
-#define APP_SERVICE_BPF_FILTER_LENGTH 64
 
 /* AppService master hash table rwlock */
 static pthread_rwlock_t appServiceHashTableMasterRWLock;
@@ -49,7 +45,7 @@ static hashTablePtr appServiceBlacklistHashTable = NULL;
  */
 protoAnalyzerPtr
 getAppServiceProtoAnalyzer (char *ip, u_short port) {
-    char key [32];
+    char key [64];
     appServicePtr svc;
     protoAnalyzerPtr analyzer;
 
@@ -76,7 +72,7 @@ getAppServiceProtoAnalyzer (char *ip, u_short port) {
  */
 appServicePtr
 getAppServiceDetected (char *ip, u_short port) {
-    char key [32];
+    char key [64];
     appServicePtr svc;
 
     snprintf (key, sizeof (key), "%s:%u", ip, port);
@@ -98,7 +94,7 @@ getAppServiceDetected (char *ip, u_short port) {
  */
 appServicePtr
 getAppServiceFromBlacklist (char *ip, u_short port) {
-    char key [32];
+    char key [64];
     appServicePtr svc;
 
     snprintf (key, sizeof (key), "%s:%u", ip, port);
@@ -120,18 +116,6 @@ getAppServicesPaddingFilter (void) {
     return strdup (APP_SERVICE_PADDING_BPF_FILTER);
 }
 
-static int
-getFilterForEachAppService (void *data, void *args) {
-    u_int len;
-    appServicePtr appSvc = (appServicePtr) data;
-    char *filter = (char *) args;
-
-    len = strlen (filter);
-    snprintf (filter + len, APP_SERVICE_BPF_FILTER_LENGTH, APP_SERVICE_BPF_FILTER,
-              appSvc->ip);
-    return 0;
-}
-
 /**
  * @brief Get appServices filter.
  *        Get appServices filter from appService map, it will loop
@@ -141,40 +125,17 @@ getFilterForEachAppService (void *data, void *args) {
  */
 char *
 getAppServicesFilter (void) {
-    int ret;
-    u_int svcNum;
     char *filter;
-    u_int filterLen, len;
 
     pthread_rwlock_rdlock (&appServiceHashTableMasterRWLock);
+    if (hashSize (appServiceHashTableMaster))
+        filter = getAppServicesBpfFilter (appServiceHashTableMaster);
+    else
+        filter = strdup (APP_SERVICE_PADDING_BPF_FILTER);
+    pthread_rwlock_unlock (&appServiceHashTableMasterRWLock);
 
-    svcNum = hashSize (appServiceHashTableMaster);
-    filterLen = APP_SERVICE_BPF_FILTER_LENGTH * (svcNum + 1);
-    filter = (char *) malloc (filterLen);
-    if (filter == NULL) {
-        LOGE ("Alloc filter buffer error: %s.\n", strerror (errno));
-        pthread_rwlock_unlock (&appServiceHashTableMasterRWLock);
-        return NULL;
-    }
-    memset (filter, 0, filterLen);
-
-    if (svcNum) {
-        strcat (filter, "((");
-        ret = hashLoopDo (appServiceHashTableMaster, getFilterForEachAppService, filter);
-        if (ret < 0) {
-            pthread_rwlock_unlock (&appServiceHashTableMasterRWLock);
-            LOGE ("Get BPF filter from each appService error.\n");
-            free (filter);
-            return NULL;
-        }
-        pthread_rwlock_unlock (&appServiceHashTableMasterRWLock);
-
-        len = strlen (filter);
-        snprintf (filter + len - 4, 32, ") and tcp) or icmp");
-    } else {
-        pthread_rwlock_unlock (&appServiceHashTableMasterRWLock);
-        strcat (filter, APP_SERVICE_PADDING_BPF_FILTER);
-    }
+    if (filter == NULL)
+        LOGE ("Get appServices filter error.\n");
 
     return filter;
 }
@@ -199,7 +160,7 @@ getJsonForEachAppServiceNotInBlacklist (void *data, void *args) {
     json_t *root = (json_t *) args;
     json_t *svc;
     appServicePtr appSvc, tmp;
-    char key [32];
+    char key [64];
 
     appSvc = (appServicePtr) data;
 
@@ -409,7 +370,7 @@ error:
 static int
 addAppServiceToSlave (appServicePtr svc) {
     int ret;
-    char key [32];
+    char key [64];
 
     snprintf (key, sizeof (key), "%s:%u", svc->ip, svc->port);
     if (hashLookup (appServiceHashTableSlave, key)) {
@@ -428,7 +389,7 @@ addAppServiceToSlave (appServicePtr svc) {
 
 static void
 removeAppServiceFromSlave (char *ip, u_short port) {
-    char key [32];
+    char key [64];
 
     snprintf (key, sizeof (key), "%s:%u", ip, port);
     hashRemove (appServiceHashTableSlave, key);
@@ -560,7 +521,7 @@ updateAppServicesBlacklistFromJson (json_t *root) {
     appServicePtr svc;
     appServicePtr *appServices;
     u_int appServicesNum;
-    char key [32];
+    char key [64];
 
     /* Get appServices from json */
     appServices = getAppServicesFromJson (root, &appServicesNum);
@@ -809,7 +770,7 @@ int
 addAppServiceDetected (char *ip, u_short port, char *proto) {
     int ret;
     appServicePtr svc, svcCopy;
-    char key [32];
+    char key [64];
 
     if (getAppServiceDetected (ip, port) == NULL) {
         /* Add to appService detected map */
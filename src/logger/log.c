@@ -3,10 +3,13 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
-#include <czmq.h>
+#include <stdarg.h>
+#include <pthread.h>
 #include "util.h"
-#include "zmq_hub.h"
+#include "atomic.h"
+#include "list.h"
 #include "properties.h"
+#include "log_ring.h"
 #include "log.h"
 
 #define MAX_LOG_MESSAGE_LENGTH 8192
@@ -15,16 +18,210 @@ typedef struct _logContext logContext;
 typedef logContext *logContextPtr;
 
 struct _logContext {
-    zctx_t *zmqCtxt;                    /**< Zmq context */
-    void *logSock;                      /**< Log zmq sock */
+    logRingPtr ring;                    /**< Log ring */
+    u_int tid;                          /**< Thread id */
     u_int logLevel;                     /**< Log level */
+    char component [LOG_COMPONENT_MAX_LENGTH]; /**< Log component */
+    time_t cachedSeconds;               /**< Cached clock seconds */
+    char cachedTimeStr [32];            /**< Cached clock time string */
+    listHead rateLimits;                /**< Rate limited call sites of thread */
+    listHead node;                      /**< Log contexts list node */
 };
 
 /* Thread local log context */
 static __thread logContextPtr logCtxtInstance = NULL;
 
+/* Log contexts list lock, for rate limited call sites registered */
+static pthread_mutex_t logContextsLock = PTHREAD_MUTEX_INITIALIZER;
+/* Log contexts list */
+static listHead logContexts = {&logContexts, &logContexts};
+
+static char *
+getLogLevelStr (u_char logLevel) {
+    switch (logLevel) {
+        case LOG_ERR_LEVEL:
+            return "ERROR";
+
+        case LOG_WARN_LEVEL:
+            return "WARNING";
+
+        case LOG_INFO_LEVEL:
+            return "INFO";
+
+        case LOG_DEBUG_LEVEL:
+            return "DEBUG";
+
+        case LOG_TRACE_LEVEL:
+            return "TRACE";
+
+        default:
+            return NULL;
+    }
+}
+
+/* Get time string from cached clock, refreshed once a second */
+static char *
+getCachedTimeStr (logContextPtr context) {
+    time_t seconds;
+    struct tm localTime;
+
+    seconds = time (NULL);
+    if (seconds != context->cachedSeconds) {
+        localtime_r (&seconds, &localTime);
+        snprintf (context->cachedTimeStr, sizeof (context->cachedTimeStr),
+                  "%04d-%02d-%02d %02d:%02d:%02d",
+                  (localTime.tm_year + 1900), localTime.tm_mon + 1, localTime.tm_mday,
+                  localTime.tm_hour, localTime.tm_min, localTime.tm_sec);
+        context->cachedSeconds = seconds;
+    }
+
+    return context->cachedTimeStr;
+}
+
+/* Check whether log message of logLevel will be logged by current thread */
+boolean
+logLevelEnabled (u_char logLevel) {
+    if (logCtxtInstance == NULL || logLevel > logCtxtInstance->logLevel)
+        return False;
+
+    return True;
+}
+
 /**
- * @brief Format log message and send log message to log service.
+ * @brief Check whether log message of rate limited call site can be
+ *        logged, tokens are refilled at LOG_RATE_LIMIT_RATE per second
+ *        up to LOG_RATE_LIMIT_BURST, and suppressed messages are
+ *        summarized at most once every LOG_RATE_LIMIT_SUMMARY_INTERVAL
+ *        seconds, here if call site fires again or else by log service
+ *        with logRateLimitsFlush.
+ *
+ * @param rateLimit -- Token bucket of call site
+ * @param logLevel -- Log level
+ * @param file -- Source file name
+ * @param line -- Line number
+ * @param func -- Function name
+ *
+ * @return True if log message can be logged else False
+ */
+boolean
+logRateLimitCheck (logRateLimitPtr rateLimit, u_char logLevel,
+                   const char *file, u_int line, const char *func) {
+    time_t now;
+    u_long_long tokens;
+
+    u_int suppressed;
+
+    if (!logLevelEnabled (logLevel))
+        return False;
+
+    /* Register call site, so that log service can summarize it */
+    if (!rateLimit->registered) {
+        rateLimit->logLevel = logLevel;
+        rateLimit->file = file;
+        rateLimit->line = line;
+        rateLimit->func = func;
+        pthread_mutex_lock (&logContextsLock);
+        listAddTail (&rateLimit->node, &logCtxtInstance->rateLimits);
+        pthread_mutex_unlock (&logContextsLock);
+        rateLimit->registered = True;
+    }
+
+    now = time (NULL);
+    if (now > rateLimit->lastRefillTime) {
+        tokens = rateLimit->tokens +
+                 (u_long_long) (now - rateLimit->lastRefillTime) * LOG_RATE_LIMIT_RATE;
+        rateLimit->tokens = MIN_NUM (tokens, LOG_RATE_LIMIT_BURST);
+        rateLimit->lastRefillTime = now;
+    }
+
+    if (rateLimit->suppressed &&
+        (now - rateLimit->lastSummaryTime) >= LOG_RATE_LIMIT_SUMMARY_INTERVAL) {
+        /* Take suppressed count, log service may summarize it concurrently */
+        suppressed = ATOMIC_FETCH_AND_AND (&rateLimit->suppressed, 0);
+        if (suppressed)
+            doLog (logLevel, file, line, func, "Suppressed %u similar messages.\n", suppressed);
+        rateLimit->lastSummaryTime = now;
+    }
+
+    if (rateLimit->tokens) {
+        rateLimit->tokens--;
+        return True;
+    }
+
+    if (rateLimit->suppressed == 0)
+        rateLimit->lastSummaryTime = now;
+    ATOMIC_INC (&rateLimit->suppressed);
+    return False;
+}
+
+/* Summarize messages suppressed by rate limited call site of log context */
+static void
+logRateLimitSummarize (logContextPtr context, logRateLimitPtr rateLimit, u_int suppressed,
+                       logRingDrainCB fun, void *args) {
+    time_t seconds;
+    struct tm localTime;
+    char *fileName;
+    char topic [LOG_TOPIC_MAX_LENGTH];
+    char logMsg [512];
+
+    seconds = time (NULL);
+    localtime_r (&seconds, &localTime);
+    fileName = strrchr (rateLimit->file, '/');
+    fileName = fileName ? (fileName + 1) : (char *) rateLimit->file;
+    snprintf (topic, sizeof (topic), "%s%c%s%c", getLogLevelStr (rateLimit->logLevel),
+              LOG_TOPIC_SEPARATOR, context->component, LOG_TOPIC_SEPARATOR);
+    snprintf (logMsg, sizeof (logMsg),
+              "%04d-%02d-%02d %02d:%02d:%02d [thread:%u] %s file=%s (line=%u, func=%s): "
+              "Suppressed %u similar messages.\n",
+              (localTime.tm_year + 1900), localTime.tm_mon + 1, localTime.tm_mday,
+              localTime.tm_hour, localTime.tm_min, localTime.tm_sec,
+              context->tid, getLogLevelStr (rateLimit->logLevel), fileName,
+              rateLimit->line, rateLimit->func, suppressed);
+    fun (topic, logMsg, args);
+}
+
+/**
+ * @brief Summarize messages suppressed by rate limited call sites of all
+ *        threads, which have not fired again for LOG_RATE_LIMIT_SUMMARY_INTERVAL
+ *        seconds since messages were suppressed, called by log service timer.
+ *
+ * @param fun -- Callback for each summary log message
+ * @param args -- Callback arguments
+ */
+void
+logRateLimitsFlush (logRingDrainCB fun, void *args) {
+    u_int suppressed;
+    time_t now;
+    logContextPtr context;
+    logRateLimitPtr rateLimit;
+    listHeadPtr pos, rpos;
+
+    now = time (NULL);
+    pthread_mutex_lock (&logContextsLock);
+    listForEachEntry (context, pos, &logContexts, node) {
+        listForEachEntry (rateLimit, rpos, &context->rateLimits, node) {
+            if (rateLimit->suppressed == 0 ||
+                (now - rateLimit->lastSummaryTime) < LOG_RATE_LIMIT_SUMMARY_INTERVAL)
+                continue;
+
+            suppressed = ATOMIC_FETCH_AND_AND (&rateLimit->suppressed, 0);
+            if (suppressed)
+                logRateLimitSummarize (context, rateLimit, suppressed, fun, args);
+            rateLimit->lastSummaryTime = now;
+        }
+    }
+    pthread_mutex_unlock (&logContextsLock);
+}
+
+/* Log ring write callback for summaries of current thread */
+static void
+logRingWriteFromSummary (char *logTopic, char *logMsg, void *args) {
+    logRingWrite ((logRingPtr) args, logTopic, strlen (logTopic), logMsg, strlen (logMsg));
+}
+
+/**
+ * @brief Format log message and write log message to log ring of
+ *        current thread, log message will be drained by log service.
  *
  * @param file -- Source file name
  * @param line -- Line number
@@ -34,114 +231,78 @@ static __thread logContextPtr logCtxtInstance = NULL;
 void
 doLog (u_char logLevel, const char *file, u_int line, const char *func, char *msg, ...) {
     int ret;
-    time_t seconds;
-    struct tm *localTime;
-    char timeStr [32];
     va_list va;
     char *fileName;
-    u_int retries = 3;
+    char *logLevelStr;
+    int topicLen;
     /* Thread local message buffer */
     static __thread char tmp [MAX_LOG_MESSAGE_LENGTH];
     static __thread char buf [MAX_LOG_MESSAGE_LENGTH];
-    static __thread char logLevelStr [16];
+    static __thread char topic [LOG_TOPIC_MAX_LENGTH];
 
     if (logCtxtInstance == NULL) {
         fprintf (stderr, "Log context has not been initialized.\n");
         return;
     }
 
-    seconds = time (NULL);
-    localTime = localtime (&seconds);
-    snprintf (timeStr, sizeof (timeStr), "%04d-%02d-%02d %02d:%02d:%02d",
-              (localTime->tm_year + 1900), localTime->tm_mon + 1, localTime->tm_mday,
-              localTime->tm_hour, localTime->tm_min, localTime->tm_sec);
+    /* Check log level before formatting log message */
+    if (logLevel > logCtxtInstance->logLevel)
+        return;
+
+    logLevelStr = getLogLevelStr (logLevel);
+    if (logLevelStr == NULL) {
+        fprintf (stderr, "Unknown log level!\n");
+        return;
+    }
 
     va_start (va, msg);
     vsnprintf (tmp, sizeof (tmp), msg, va);
     va_end (va);
 
-    switch (logLevel) {
-        case LOG_ERR_LEVEL:
-            snprintf (logLevelStr, sizeof (logLevelStr), "ERROR");
-            break;
-
-        case LOG_WARN_LEVEL:
-            snprintf (logLevelStr, sizeof (logLevelStr), "WARNING");
-            break;
-
-        case LOG_INFO_LEVEL:
-            snprintf (logLevelStr, sizeof (logLevelStr), "INFO");
-            break;
-
-        case LOG_DEBUG_LEVEL:
-            snprintf (logLevelStr, sizeof (logLevelStr), "DEBUG");
-            break;
-
-        case LOG_TRACE_LEVEL:
-            snprintf (logLevelStr, sizeof (logLevelStr), "TRACE");
-            break;
-
-        default:
-            fprintf (stderr, "Unknown log level!\n");
-            return;
-    }
-
-    fileName = strrchr (file, '/') + 1;
-    snprintf (buf, sizeof (buf), "%s [thread:%u] %s file=%s (line=%u, func=%s): %s",
-              timeStr, gettid (), logLevelStr, fileName, line, func, tmp);
-    buf [MAX_LOG_MESSAGE_LENGTH - 1] = 0;
+    fileName = strrchr (file, '/');
+    fileName = fileName ? (fileName + 1) : (char *) file;
+    ret = snprintf (buf, sizeof (buf), "%s [thread:%u] %s file=%s (line=%u, func=%s): %s",
+                    getCachedTimeStr (logCtxtInstance), logCtxtInstance->tid,
+                    logLevelStr, fileName, line, func, tmp);
+    if (ret < 0)
+        return;
+    if (ret >= sizeof (buf))
+        ret = sizeof (buf) - 1;
 
     /* Send log to console if doesn't run in daemon mode */
     if (!getPropertiesDaemonMode ())
         fprintf (stdout, "%s", tmp);
 
-    if (logLevel > logCtxtInstance->logLevel)
-        return;
-
-    do {
-        ret = zstr_send (logCtxtInstance->logSock, buf);
-        retries -= 1;
-    } while (ret < 0 && retries);
+    /* Log topic with log level and component for log subscribers */
+    topicLen = snprintf (topic, sizeof (topic), "%s%c%s%c",
+                         logLevelStr, LOG_TOPIC_SEPARATOR, logCtxtInstance->component,
+                         LOG_TOPIC_SEPARATOR);
+    if (topicLen >= sizeof (topic))
+        topicLen = sizeof (topic) - 1;
 
-    if (ret < 0)
-        fprintf (stderr, "Send log message error.\n");
+    logRingWrite (logCtxtInstance->ring, topic, topicLen, buf, ret);
 }
 
 /**
  * @brief Init log context.
- *        It will create a thread local log context, every thread want to
- *        use log function must init log context first.
+ *        It will create a thread local log context with log ring,
+ *        every thread want to use log function must init log context
+ *        first.
  * @param logLevel -- Log level
  *
  * @return 0 if success else -1
  */
 int
 initLogContext (u_int logLevel) {
-    int ret;
-
     logCtxtInstance = (logContextPtr) malloc (sizeof (logContext));
     if (logCtxtInstance == NULL)
         return -1;
 
-    logCtxtInstance->zmqCtxt = zctx_new ();
-    if (logCtxtInstance->zmqCtxt == NULL) {
-        free (logCtxtInstance);
-        return -1;
-    }
-    zctx_set_linger (logCtxtInstance->zmqCtxt, 0);
-
-    logCtxtInstance->logSock = zsocket_new (logCtxtInstance->zmqCtxt, ZMQ_PUSH);
-    if (logCtxtInstance->logSock == NULL) {
-        zctx_destroy (&logCtxtInstance->zmqCtxt);
-        free (logCtxtInstance);
-        return -1;
-    }
-
-    ret = zsocket_connect (logCtxtInstance->logSock,
-                           "tcp://localhost:%u", LOG_RECV_PORT);
-    if (ret < 0) {
-        zctx_destroy (&logCtxtInstance->zmqCtxt);
+    logCtxtInstance->tid = gettid ();
+    logCtxtInstance->ring = logRingAcquire (logCtxtInstance->tid);
+    if (logCtxtInstance->ring == NULL) {
         free (logCtxtInstance);
+        logCtxtInstance = NULL;
         return -1;
     }
 
@@ -152,13 +313,60 @@ initLogContext (u_int logLevel) {
     else
         logCtxtInstance->logLevel = logLevel;
 
+    snprintf (logCtxtInstance->component, sizeof (logCtxtInstance->component),
+              "%s", LOG_DEFAULT_COMPONENT);
+    logCtxtInstance->cachedSeconds = 0;
+    logCtxtInstance->cachedTimeStr [0] = 0;
+    initListHead (&logCtxtInstance->rateLimits);
+
+    pthread_mutex_lock (&logContextsLock);
+    listAddTail (&logCtxtInstance->node, &logContexts);
+    pthread_mutex_unlock (&logContextsLock);
+
     return 0;
 }
 
-/* Destroy log context */
+/**
+ * @brief Set log component of current thread, it will be used as
+ *        log topic with log level, like "ERROR/TcpProcessService:3/".
+ *
+ * @param component -- Log component format
+ */
+void
+setLogComponent (const char *component, ...) {
+    va_list va;
+
+    if (logCtxtInstance == NULL)
+        return;
+
+    va_start (va, component);
+    vsnprintf (logCtxtInstance->component, sizeof (logCtxtInstance->component),
+               component, va);
+    va_end (va);
+}
+
+/* Destroy log context, messages suppressed by rate limited call sites are summarized */
 void
 destroyLogContext (void) {
-    zctx_destroy (&logCtxtInstance->zmqCtxt);
+    u_int suppressed;
+    logRateLimitPtr rateLimit;
+    listHeadPtr pos;
+
+    /* Rate limited call sites are thread local, unregister them before thread exits */
+    pthread_mutex_lock (&logContextsLock);
+    listDel (&logCtxtInstance->node);
+    pthread_mutex_unlock (&logContextsLock);
+
+    listForEachEntry (rateLimit, pos, &logCtxtInstance->rateLimits, node) {
+        suppressed = rateLimit->suppressed;
+        if (suppressed)
+            logRateLimitSummarize (logCtxtInstance, rateLimit, suppressed,
+                                   logRingWriteFromSummary, logCtxtInstance->ring);
+        rateLimit->suppressed = 0;
+        rateLimit->registered = False;
+    }
+
+    logRingRelease (logCtxtInstance->ring);
     free (logCtxtInstance);
     logCtxtInstance = NULL;
 }
@@ -2,6 +2,10 @@
 #define __LOG_H__
 
 #include <stdlib.h>
+#include <time.h>
+#include "util.h"
+#include "list.h"
+#include "log_ring.h"
 
 #define LOG_ERR_LEVEL 0
 #define LOG_WARN_LEVEL 1
@@ -9,6 +13,46 @@
 #define LOG_DEBUG_LEVEL 3
 #define LOG_TRACE_LEVEL 4
 
+/*
+ * Log messages are published with log topic "level/component/", like
+ * "ERROR/TcpProcessService:3/", so log subscribers can subscribe log
+ * messages of specified level and component, the trailing separator
+ * keeps component "TcpProcessService:1" from matching
+ * "TcpProcessService:10" by topic prefix.
+ */
+#define LOG_TOPIC_SEPARATOR '/'
+#define LOG_TOPIC_MAX_LENGTH 96
+#define LOG_COMPONENT_MAX_LENGTH 64
+#define LOG_DEFAULT_COMPONENT "Ntrace"
+
+/* Rate limited log tokens refilled per second of each call site */
+#define LOG_RATE_LIMIT_RATE 1
+/* Rate limited log max tokens of each call site */
+#define LOG_RATE_LIMIT_BURST 10
+/* Min seconds between two suppressed messages summaries of each call site */
+#define LOG_RATE_LIMIT_SUMMARY_INTERVAL 60
+
+typedef struct _logRateLimit logRateLimit;
+typedef logRateLimit *logRateLimitPtr;
+
+/*
+ * Token bucket of rate limited log call site, one per thread, registered
+ * to log context of thread on first use, so that suppressed messages can
+ * be summarized by log service after messages burst stops.
+ */
+struct _logRateLimit {
+    u_int tokens;                       /**< Tokens left */
+    time_t lastRefillTime;              /**< Last tokens refill time */
+    volatile time_t lastSummaryTime;    /**< Last suppressed messages summary time */
+    volatile u_int suppressed;          /**< Messages suppressed since last summary */
+    boolean registered;                 /**< Registered to log context */
+    u_char logLevel;                    /**< Log level of call site */
+    const char *file;                   /**< Source file name of call site */
+    u_int line;                         /**< Line number of call site */
+    const char *func;                   /**< Function name of call site */
+    listHead node;                      /**< Rate limited call sites list node */
+};
+
 /*========================Interfaces definition============================*/
 void
 doLog (u_char logLevel, const char *file, u_int line, const char *func, char *msg, ...);
@@ -23,9 +67,41 @@ doLog (u_char logLevel, const char *file, u_int line, const char *func, char *ms
 
 #define LOGT(...) doLog (LOG_TRACE_LEVEL, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
 
+/*
+ * Rate limited log macros for packet processing paths, every call site
+ * has its own token bucket in each thread, messages exceeding limit are
+ * suppressed and summarized periodically, by the next message of call
+ * site or by log service timer.
+ */
+#define doRateLimitedLog(logLevel, ...) do {                            \
+        static __thread logRateLimit logRateLimitInstance = {           \
+            LOG_RATE_LIMIT_BURST, 0, 0, 0                               \
+        };                                                              \
+        if (logRateLimitCheck (&logRateLimitInstance, logLevel,         \
+                               __FILE__, __LINE__, __FUNCTION__))       \
+            doLog (logLevel, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__); \
+    } while (0)
+
+#define LOGE_RL(...) doRateLimitedLog (LOG_ERR_LEVEL, __VA_ARGS__)
+
+#define LOGW_RL(...) doRateLimitedLog (LOG_WARN_LEVEL, __VA_ARGS__)
+
+#define LOGI_RL(...) doRateLimitedLog (LOG_INFO_LEVEL, __VA_ARGS__)
+
+#define LOGD_RL(...) doRateLimitedLog (LOG_DEBUG_LEVEL, __VA_ARGS__)
+
+boolean
+logLevelEnabled (u_char logLevel);
+boolean
+logRateLimitCheck (logRateLimitPtr rateLimit, u_char logLevel,
+                   const char *file, u_int line, const char *func);
+void
+logRateLimitsFlush (logRingDrainCB fun, void *args);
 int
 initLogContext (u_int logLevel);
 void
+setLogComponent (const char *component, ...);
+void
 destroyLogContext (void);
 /*=======================Interfaces definition end=========================*/
 
@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "util.h"
+#include "list.h"
+#include "log_ring.h"
+
+#define LOG_RING_ALIGN(len) (((len) + 3) & ~3)
+
+/* Log rings list lock, only for ring acquire, release and drain */
+static pthread_mutex_t logRingsLock = PTHREAD_MUTEX_INITIALIZER;
+/* Log rings list */
+static listHead logRings = {&logRings, &logRings};
+/* Log service is draining log rings */
+static boolean logRingsConsumerAttached = False;
+
+/**
+ * @brief Write log message to log ring, only called by owner thread
+ *        of log ring, it will never block.
+ *
+ * @param ring -- Log ring to write
+ * @param logTopic -- Log topic to write
+ * @param topicLen -- Log topic length without terminating null byte
+ * @param logMsg -- Log message to write
+ * @param msgLen -- Log message length without terminating null byte
+ *
+ * @return 0 if success, -1 if log ring is full and log message is dropped
+ */
+int
+logRingWrite (logRingPtr ring, char *logTopic, u_int topicLen, char *logMsg, u_int msgLen) {
+    u_int head, tail;
+    u_int pos, contiguous;
+    u_int len, total, needed;
+    char *data;
+
+    len = topicLen + 1 + msgLen + 1;
+    total = LOG_RING_ALIGN (sizeof (u_int) + len);
+    head = ring->head;
+    tail = ring->tail;
+    /* Read tail before writing buffer released by log service */
+    __sync_synchronize ();
+
+    pos = head & (ring->size - 1);
+    contiguous = ring->size - pos;
+    needed = (contiguous < total) ? (contiguous + total) : total;
+    if ((head - tail) + needed > ring->size) {
+        ring->dropped++;
+        return -1;
+    }
+
+    /* Skip remaining bytes to the end of ring */
+    if (contiguous < total) {
+        *((u_int *) (ring->buf + pos)) = LOG_RING_WRAP_MARKER;
+        head += contiguous;
+        pos = 0;
+    }
+
+    *((u_int *) (ring->buf + pos)) = len;
+    data = ring->buf + pos + sizeof (u_int);
+    memcpy (data, logTopic, topicLen);
+    data [topicLen] = 0;
+    memcpy (data + topicLen + 1, logMsg, msgLen);
+    data [topicLen + 1 + msgLen] = 0;
+
+    /* Commit log message after it has been written */
+    __sync_synchronize ();
+    ring->head = head + total;
+
+    return 0;
+}
+
+/* Report log messages dropped by log ring */
+static void
+logRingReportDropped (logRingPtr ring, logRingDrainCB fun, void *args) {
+    u_long_long dropped;
+    time_t seconds;
+    struct tm localTime;
+    char logMsg [256];
+
+    dropped = ring->dropped;
+    if (dropped == ring->droppedReported)
+        return;
+
+    seconds = time (NULL);
+    localtime_r (&seconds, &localTime);
+    snprintf (logMsg, sizeof (logMsg),
+              "%04d-%02d-%02d %02d:%02d:%02d [thread:%u] WARNING file=log_ring.c "
+              "(line=%u, func=%s): Log ring dropped %llu log messages.\n",
+              (localTime.tm_year + 1900), localTime.tm_mon + 1, localTime.tm_mday,
+              localTime.tm_hour, localTime.tm_min, localTime.tm_sec,
+              ring->tid, __LINE__, __FUNCTION__, dropped - ring->droppedReported);
+    ring->droppedReported = dropped;
+    fun ("WARNING/LogService", logMsg, args);
+}
+
+/* Drain log messages committed in log ring */
+static u_int
+logRingDrain (logRingPtr ring, logRingDrainCB fun, void *args) {
+    u_int head, tail;
+    u_int pos, len;
+    char *logTopic;
+    u_int count = 0;
+
+    head = ring->head;
+    tail = ring->tail;
+    /* Read head before reading log messages committed */
+    __sync_synchronize ();
+
+    while (tail != head) {
+        pos = tail & (ring->size - 1);
+        len = *((u_int *) (ring->buf + pos));
+        if (len == LOG_RING_WRAP_MARKER) {
+            tail += ring->size - pos;
+            continue;
+        }
+
+        logTopic = ring->buf + pos + sizeof (u_int);
+        fun (logTopic, logTopic + strlen (logTopic) + 1, args);
+        tail += LOG_RING_ALIGN (sizeof (u_int) + len);
+        count++;
+    }
+
+    /* Release buffer after log messages have been read */
+    __sync_synchronize ();
+    ring->tail = tail;
+
+    logRingReportDropped (ring, fun, args);
+
+    return count;
+}
+
+static void
+freeLogRing (logRingPtr ring) {
+    free (ring->buf);
+    free (ring);
+}
+
+/**
+ * @brief Acquire a new log ring for current thread.
+ *
+ * @param tid -- Owner thread id
+ *
+ * @return Log ring if success else NULL
+ */
+logRingPtr
+logRingAcquire (u_int tid) {
+    logRingPtr ring;
+
+    ring = (logRingPtr) malloc (sizeof (logRing));
+    if (ring == NULL)
+        return NULL;
+
+    ring->buf = (char *) malloc (LOG_RING_SIZE);
+    if (ring->buf == NULL) {
+        free (ring);
+        return NULL;
+    }
+    ring->size = LOG_RING_SIZE;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+    ring->droppedReported = 0;
+    ring->tid = tid;
+    ring->closed = False;
+
+    pthread_mutex_lock (&logRingsLock);
+    listAddTail (&ring->node, &logRings);
+    pthread_mutex_unlock (&logRingsLock);
+
+    return ring;
+}
+
+/**
+ * @brief Release log ring of current thread, if log service is draining
+ *        log rings, log ring will be freed by log service after all log
+ *        messages in it have been drained.
+ *
+ * @param ring -- Log ring to release
+ */
+void
+logRingRelease (logRingPtr ring) {
+    pthread_mutex_lock (&logRingsLock);
+    if (logRingsConsumerAttached)
+        ring->closed = True;
+    else {
+        listDel (&ring->node);
+        freeLogRing (ring);
+    }
+    pthread_mutex_unlock (&logRingsLock);
+}
+
+/**
+ * @brief Drain log messages from all log rings, log rings released
+ *        will be freed after drained.
+ *
+ * @param fun -- Callback for each log message
+ * @param args -- Callback arguments
+ *
+ * @return Log messages drained
+ */
+u_int
+logRingsDrain (logRingDrainCB fun, void *args) {
+    u_int count = 0;
+    logRingPtr ring;
+    listHeadPtr pos, npos;
+
+    pthread_mutex_lock (&logRingsLock);
+    listForEachEntrySafe (ring, pos, npos, &logRings, node) {
+        count += logRingDrain (ring, fun, args);
+        if (ring->closed && ring->head == ring->tail) {
+            listDel (&ring->node);
+            freeLogRing (ring);
+        }
+    }
+    pthread_mutex_unlock (&logRingsLock);
+
+    return count;
+}
+
+/* Attach log service as consumer of log rings */
+void
+logRingsAttachConsumer (void) {
+    pthread_mutex_lock (&logRingsLock);
+    logRingsConsumerAttached = True;
+    pthread_mutex_unlock (&logRingsLock);
+}
+
+/**
+ * @brief Detach log service from log rings, drain log messages left
+ *        and free log rings released, log rings released after detached
+ *        will be freed directly.
+ *
+ * @param fun -- Callback for each log message left
+ * @param args -- Callback arguments
+ */
+void
+logRingsDetachConsumer (logRingDrainCB fun, void *args) {
+    logRingsDrain (fun, args);
+
+    pthread_mutex_lock (&logRingsLock);
+    logRingsConsumerAttached = False;
+    pthread_mutex_unlock (&logRingsLock);
+}
@@ -0,0 +1,51 @@
+#ifndef __LOG_RING_H__
+#define __LOG_RING_H__
+
+#include <pthread.h>
+#include "util.h"
+#include "list.h"
+
+/* Log ring size of each thread, must be power of 2 */
+#define LOG_RING_SIZE (256 << 10)
+/* Log ring wrap marker, remaining bytes to the end of ring are skipped */
+#define LOG_RING_WRAP_MARKER 0xFFFFFFFF
+
+typedef struct _logRing logRing;
+typedef logRing *logRingPtr;
+
+/*
+ * Single producer single consumer log ring, owner thread writes log
+ * messages to ring and log service drains log messages from ring.
+ * Every log message is stored as 4 bytes length followed by log topic
+ * and message, both with terminating null byte, and padded to 4 bytes.
+ */
+struct _logRing {
+    char *buf;                          /**< Log ring buffer */
+    u_int size;                         /**< Log ring buffer size */
+    volatile u_int head;                /**< Write position, updated by owner thread only */
+    volatile u_int tail;                /**< Read position, updated by log service only */
+    volatile u_long_long dropped;       /**< Log messages dropped for ring full */
+    u_long_long droppedReported;        /**< Log messages dropped and reported */
+    u_int tid;                          /**< Owner thread id */
+    boolean closed;                     /**< Owner thread has released log ring */
+    listHead node;                      /**< Log rings list node */
+};
+
+typedef void (*logRingDrainCB) (char *logTopic, char *logMsg, void *args);
+
+/*========================Interfaces definition============================*/
+int
+logRingWrite (logRingPtr ring, char *logTopic, u_int topicLen, char *logMsg, u_int msgLen);
+logRingPtr
+logRingAcquire (u_int tid);
+void
+logRingRelease (logRingPtr ring);
+u_int
+logRingsDrain (logRingDrainCB fun, void *args);
+void
+logRingsAttachConsumer (void);
+void
+logRingsDetachConsumer (logRingDrainCB fun, void *args);
+/*=======================Interfaces definition end=========================*/
+
+#endif /* __LOG_RING_H__ */
@@ -15,19 +15,23 @@
 #include "properties.h"
 #include "signals.h"
 #include "log.h"
+#include "log_ring.h"
 #include "zmq_hub.h"
 #include "task_manager.h"
 #include "log_service.h"
 
+/* Log service sleep interval in microseconds when log rings are empty */
+#define LOG_SERVICE_IDLE_INTERVAL 10000
+
 /* Log devices list */
 static listHead logDevices;
 
 typedef struct _logDev logDev;
 typedef logDev *logDevPtr;
 /*
- * Log service output dev, every dev has three interfaces,
- * you can add new log dev to logDevices list with logDevAdd
- * interface.
+ * Log service output dev, every dev has three interfaces and one
+ * optional timer interface, you can add new log dev to logDevices
+ * list with logDevAdd interface.
  */
 struct _logDev {
     /* Log dev private data */
@@ -38,7 +42,9 @@ struct _logDev {
     /* Log dev destroy operation */
     void (*destroy) (logDevPtr dev);
     /* Log dev write operation */
-    void (*write) (char *logMsg, logDevPtr dev);
+    void (*write) (char *logTopic, char *logMsg, logDevPtr dev);
+    /* Log dev timer operation, called every second */
+    void (*timer) (logDevPtr dev);
 
     /* Log dev list node of global log devices */
     listHead node;
@@ -48,8 +54,15 @@ struct _logDev {
 
 #define LOG_FILE_MAX_SIZE (512 << 20)
 #define LOG_FILE_ROTATION_COUNT 16
-#define LOG_FILE_SIZE_CHECK_THRESHOLD 500
 #define LOG_FILE_PATH_MAX_LEN 512
+/* Log file buffer size, log messages are written in batch */
+#define LOG_FILE_BUFFER_SIZE (256 << 10)
+/* Max seconds to hold log messages in buffer */
+#define LOG_FILE_FLUSH_INTERVAL 1
+/* Max seconds to hold log messages written but not synced */
+#define LOG_FILE_SYNC_INTERVAL 5
+/* Log messages at this level or more severe are synced immediately */
+#define LOG_FILE_SYNC_LEVEL LOG_ERR_LEVEL
 
 typedef struct _logFile logFile;
 typedef logFile *logFilePtr;
@@ -57,22 +70,29 @@ typedef logFile *logFilePtr;
 struct _logFile {
     int fd;                             /**< Log file fd */
     char *filePath;                     /**< Log file path */
-    u_int checkCount;                   /**< Log file size check count */
+    u_long_long fileSize;               /**< Log file size */
+    char *buf;                          /**< Log file buffer */
+    u_int bufLen;                       /**< Log file buffer data length */
+    boolean unsynced;                   /**< Log file has data not synced */
+    time_t lastFlushTime;               /**< Log file last flush time */
+    time_t lastSyncTime;                /**< Log file last sync time */
 };
 
-static boolean
-logFileOversize (char *filePath) {
-    int ret;
-    struct stat fileStat;
-
-    ret = stat (filePath, &fileStat);
-    if (ret < 0)
-        return True;
-
-    if (fileStat.st_size >= LOG_FILE_MAX_SIZE)
-        return True;
+/* Get log level from log topic */
+static u_int
+getLogTopicLevel (char *logTopic) {
+    char *level = logTopic;
+
+    if (STRPREFIX (level, "ERROR"))
+        return LOG_ERR_LEVEL;
+    else if (STRPREFIX (level, "WARNING"))
+        return LOG_WARN_LEVEL;
+    else if (STRPREFIX (level, "INFO"))
+        return LOG_INFO_LEVEL;
+    else if (STRPREFIX (level, "DEBUG"))
+        return LOG_DEBUG_LEVEL;
     else
-        return False;
+        return LOG_TRACE_LEVEL;
 }
 
 static int
@@ -123,11 +143,59 @@ logFileRotate (char *logFileName) {
     return 0;
 }
 
+static int
+logFileOpen (logFilePtr logfile) {
+    struct stat fileStat;
+
+    logfile->fd = open (logfile->filePath, O_WRONLY | O_APPEND | O_CREAT, 0755);
+    if (logfile->fd < 0) {
+        fprintf (stderr, "Open log file error.\n");
+        return -1;
+    }
+
+    /* Track log file size in memory after open */
+    if (fstat (logfile->fd, &fileStat) < 0)
+        logfile->fileSize = 0;
+    else
+        logfile->fileSize = fileStat.st_size;
+    logfile->unsynced = False;
+
+    return 0;
+}
+
+/* Write log messages in buffer to log file */
+static int
+logFileFlush (logFilePtr logfile) {
+    int ret;
+
+    if (logfile->bufLen == 0)
+        return 0;
+
+    ret = safeWrite (logfile->fd, logfile->buf, logfile->bufLen);
+    if (ret < 0 || ret != logfile->bufLen)
+        return -1;
+
+    logfile->bufLen = 0;
+    logfile->unsynced = True;
+    return 0;
+}
+
+/* Sync log file data, only log file fd is synced */
+static void
+logFileSync (logFilePtr logfile) {
+    if (logfile->unsynced && fdatasync (logfile->fd) < 0)
+        fprintf (stderr, "Sync log file error: %s.\n", strerror (errno));
+
+    logfile->unsynced = False;
+    logfile->lastSyncTime = time (NULL);
+}
+
 static int
 logFileUpdate (logDevPtr dev) {
     int ret;
     logFilePtr logfile = (logFilePtr) dev->data;
 
+    logFileSync (logfile);
     close (logfile->fd);
     ret = logFileRotate (logfile->filePath);
     if (ret < 0) {
@@ -135,18 +203,12 @@ logFileUpdate (logDevPtr dev) {
         return -1;
     }
 
-    logfile->fd = open (logfile->filePath, O_WRONLY | O_APPEND | O_CREAT, 0755);
-    if (logfile->fd < 0) {
-        fprintf (stderr, "Open log file error.\n");
-        return -1;
-    }
-
-    logfile->checkCount = 0;
-    return 0;
+    return logFileOpen (logfile);
 }
 
 static int
 initLogFile (logDevPtr dev) {
+    int ret;
     char logFilePath [LOG_FILE_PATH_MAX_LEN];
     logFilePtr logfile;
 
@@ -162,22 +224,33 @@ initLogFile (logDevPtr dev) {
         return -1;
     }
 
+    logfile->buf = (char *) malloc (LOG_FILE_BUFFER_SIZE);
+    if (logfile->buf == NULL) {
+        fprintf (stderr, "Malloc logFile buffer error.\n");
+        free (logfile);
+        return -1;
+    }
+    logfile->bufLen = 0;
+
     snprintf (logFilePath, sizeof (logFilePath), "%s/%s",
               getPropertiesLogDir (), getPropertiesLogFileName ());
     logfile->filePath = strdup (logFilePath);
     if (logfile->filePath == NULL) {
         fprintf (stderr, "Join log file path error.\n");
+        free (logfile->buf);
         free (logfile);
         return -1;
     }
-    logfile->fd = open (logfile->filePath, O_WRONLY | O_APPEND | O_CREAT, 0755);
-    if (logfile->fd < 0) {
-        fprintf (stderr, "Open log file error.\n");
+
+    ret = logFileOpen (logfile);
+    if (ret < 0) {
         free (logfile->filePath);
+        free (logfile->buf);
         free (logfile);
         return -1;
     }
-    logfile->checkCount = 0;
+    logfile->lastFlushTime = time (NULL);
+    logfile->lastSyncTime = logfile->lastFlushTime;
 
     dev->data = logfile;
     return 0;
@@ -187,39 +260,99 @@ static void
 destroyLogFile (logDevPtr dev) {
     logFilePtr logfile = (logFilePtr) dev->data;
 
+    if (logFileFlush (logfile) < 0)
+        fprintf (stderr, "Flush log file error.\n");
+    logFileSync (logfile);
     close (logfile->fd);
     free (logfile->filePath);
+    free (logfile->buf);
     free (logfile);
 }
 
 static int
 resetLogFile (logDevPtr dev) {
+    logFilePtr logfile = (logFilePtr) dev->data;
+
+    /* Drop log messages can't be written */
+    logfile->bufLen = 0;
     destroyLogFile (dev);
     return initLogFile (dev);
 }
 
 static void
-writeLogFile (char *logMsg, logDevPtr dev) {
+writeLogFile (char *logTopic, char *logMsg, logDevPtr dev) {
     int ret;
+    u_int len;
     logFilePtr logfile;
 
     logfile = (logFilePtr) dev->data;
-    ret = safeWrite (logfile->fd, logMsg, strlen (logMsg));
-    if (ret < 0 || ret != strlen (logMsg)) {
-        ret = resetLogFile (dev);
+    len = strlen (logMsg);
+
+    if (logfile->bufLen + len > LOG_FILE_BUFFER_SIZE) {
+        ret = logFileFlush (logfile);
         if (ret < 0)
-            fprintf (stderr, "Reset log file error.\n");
-        return;
+            goto resetLogFile;
+    }
+
+    if (len > LOG_FILE_BUFFER_SIZE) {
+        ret = safeWrite (logfile->fd, logMsg, len);
+        if (ret < 0 || ret != len)
+            goto resetLogFile;
+        logfile->unsynced = True;
+    } else {
+        memcpy (logfile->buf + logfile->bufLen, logMsg, len);
+        logfile->bufLen += len;
     }
+    logfile->fileSize += len;
+
+    /* Severe log messages are written and synced immediately */
+    if (getLogTopicLevel (logTopic) <= LOG_FILE_SYNC_LEVEL) {
+        ret = logFileFlush (logfile);
+        if (ret < 0)
+            goto resetLogFile;
+        logFileSync (logfile);
+    }
+
+    if (logfile->fileSize >= LOG_FILE_MAX_SIZE) {
+        ret = logFileFlush (logfile);
+        if (ret < 0)
+            goto resetLogFile;
 
-    logfile->checkCount++;
-    if (logfile->checkCount >= LOG_FILE_SIZE_CHECK_THRESHOLD &&
-        logFileOversize (logfile->filePath)) {
         ret = logFileUpdate (dev);
         if (ret < 0)
             fprintf (stderr, "Log file update error.\n");
     }
-    sync ();
+
+    return;
+
+resetLogFile:
+    ret = resetLogFile (dev);
+    if (ret < 0)
+        fprintf (stderr, "Reset log file error.\n");
+}
+
+static void
+timerLogFile (logDevPtr dev) {
+    int ret;
+    time_t now;
+    logFilePtr logfile;
+
+    logfile = (logFilePtr) dev->data;
+    now = time (NULL);
+
+    if (now - logfile->lastFlushTime >= LOG_FILE_FLUSH_INTERVAL) {
+        ret = logFileFlush (logfile);
+        if (ret < 0) {
+            ret = resetLogFile (dev);
+            if (ret < 0)
+                fprintf (stderr, "Reset log file error.\n");
+            return;
+        }
+        logfile->lastFlushTime = now;
+    }
+
+    if (now - logfile->lastSyncTime >= LOG_FILE_SYNC_INTERVAL)
+        logFileSync (logfile);
 }
 
 /*=================================Log file dev=================================*/
@@ -255,16 +388,15 @@ destroyLogNet (logDevPtr dev) {
 }
 
 static void
-writeLogNet (char *logMsg, logDevPtr dev) {
+writeLogNet (char *logTopic, char *logMsg, logDevPtr dev) {
     int ret;
     logNetPtr lognet;
-    u_int retries = 3;
 
     lognet = (logNetPtr) dev->data;
-    do {
+    /* Publish log topic frame first, subscribers filter by log topic */
+    ret = zstr_sendm (lognet->pubSock, logTopic);
+    if (ret == 0)
         ret = zstr_send (lognet->pubSock, logMsg);
-        retries -= 1;
-    } while (ret < 0 && retries);
 
     if (ret < 0)
         fprintf (stderr, "Publish log message error.\n");
@@ -299,20 +431,37 @@ logDevDestroy (void) {
 }
 
 static void
-logDevWrite (listHeadPtr logDevices, char *logMsg) {
+logDevWrite (listHeadPtr logDevices, char *logTopic, char *logMsg) {
+    logDevPtr dev;
+    listHeadPtr pos;
+
+    listForEachEntry (dev, pos, logDevices, node) {
+        dev->write (logTopic, logMsg, dev);
+    }
+}
+
+/* Log ring drain callback */
+static void
+logDevWriteFromRing (char *logTopic, char *logMsg, void *args) {
+    logDevWrite ((listHeadPtr) args, logTopic, logMsg);
+}
+
+static void
+logDevTimer (listHeadPtr logDevices) {
     logDevPtr dev;
     listHeadPtr pos;
 
     listForEachEntry (dev, pos, logDevices, node) {
-        dev->write (logMsg, dev);
+        if (dev->timer)
+            dev->timer (dev);
     }
 }
 
 void *
 logService (void *args) {
     int ret;
-    void *logRecvSock;
-    char *logMsg;
+    u_int count;
+    time_t now, lastTimerTime;
 
     /* Reset signals flag */
     resetSignalsFlag ();
@@ -323,6 +472,7 @@ logService (void *args) {
         .init = initLogFile,
         .destroy = destroyLogFile,
         .write = writeLogFile,
+        .timer = timerLogFile,
     };
 
     /* Init log net dev */
@@ -331,6 +481,7 @@ logService (void *args) {
         .init = initLogNet,
         .destroy = destroyLogNet,
         .write = writeLogNet,
+        .timer = NULL,
     };
 
     initListHead (&logDevices);
@@ -345,19 +496,27 @@ logService (void *args) {
     if (ret < 0)
         goto destroyLogDev;
 
-    logRecvSock = getLogRecvSock ();
+    /* Drain log messages from log rings of all threads */
+    logRingsAttachConsumer ();
+    lastTimerTime = time (NULL);
+
     while (!taskShouldExit ()) {
-        logMsg = zstr_recv (logRecvSock);
-        if (logMsg == NULL) {
-            if (!taskShouldExit ())
-                LOGE ("Receive log message with fatal error.\n");
-            break;
+        count = logRingsDrain (logDevWriteFromRing, &logDevices);
+
+        now = time (NULL);
+        if (now != lastTimerTime) {
+            logRateLimitsFlush (logDevWriteFromRing, &logDevices);
+            logDevTimer (&logDevices);
+            lastTimerTime = now;
         }
 
-        logDevWrite (&logDevices, logMsg);
-        free (logMsg);
+        if (count == 0)
+            usleep (LOG_SERVICE_IDLE_INTERVAL);
     }
 
+    /* Drain log messages left */
+    logRingsDetachConsumer (logDevWriteFromRing, &logDevices);
+
     fprintf (stdout, "LogService will exit... .. .\n");
 destroyLogDev:
     logDevDestroy ();
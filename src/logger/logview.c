@@ -9,10 +9,19 @@
 static char *logServerIp = NULL;
 static boolean showInDetail  = False;
 static char *logLevel = NULL;
+static char *logComponent = NULL;
 
 static zctx_t *zmqContext = NULL;
 static void *subSock = NULL;
 
+static char *logLevels [] = {
+    "ERROR",
+    "WARNING",
+    "INFO",
+    "DEBUG",
+    "TRACE"
+};
+
 static boolean
 checkLogLevel (char *logLevel) {
     if (strEqual ("ERROR", logLevel) ||
@@ -28,6 +37,7 @@ checkLogLevel (char *logLevel) {
 static struct option logviewOptions [] = {
     {"server", required_argument, NULL, 's'},
     {"level", required_argument, NULL, 'l'},
+    {"component", required_argument, NULL, 'c'},
     {"verbose", no_argument, NULL, 'v'},
     {"help", no_argument, NULL, 'h'},
     {NULL, no_argument, NULL, 0}
@@ -48,6 +58,7 @@ showHelp (char *cmd) {
             "Options:\n"
             "  -s|--server <ip>, ip addr of logd server\n"
             "  -l|--level <logLevel>, optional log level: ERROR, WARNING, INFO, DEBUG, TRACE\n"
+            "  -c|--component <component>, optional log component, like TcpProcessService:3\n"
             "  -v|--verbose, display log in detail\n"
             "  -h|--help, help info\n",
             cmdName, cmdName);
@@ -58,7 +69,7 @@ parseCmdline (int argc, char *argv []) {
     int ret = 0;
     char option;
 
-    while ((option = getopt_long (argc, argv, "s:p:l:vh?", logviewOptions, NULL)) != -1) {
+    while ((option = getopt_long (argc, argv, "s:p:l:c:vh?", logviewOptions, NULL)) != -1) {
         switch (option) {
             case 's':
                 logServerIp = strdup (optarg);
@@ -70,13 +81,18 @@ parseCmdline (int argc, char *argv []) {
                 logLevel = strdup (optarg);
                 if (logLevel == NULL)
                     return -1;
-                ret = checkLogLevel (logLevel);
-                if (ret < 0) {
+                if (!checkLogLevel (logLevel)) {
                     fprintf (stderr, "Wrong log level.\n");
                     ret = -1;
                 }
                 break;
 
+            case 'c':
+                logComponent = strdup (optarg);
+                if (logComponent == NULL)
+                    return -1;
+                break;
+
             case 'v':
                 showInDetail = 1;
                 break;
@@ -99,12 +115,41 @@ freeCmdlineArgs (void) {
     logServerIp = NULL;
     free (logLevel);
     logLevel = NULL;
+    free (logComponent);
+    logComponent = NULL;
+}
+
+/*
+ * Subscribe log messages with log topic "level/component/", log messages
+ * not subscribed will be filtered by log server.
+ */
+static void
+subscribeLogTopics (void) {
+    u_int i;
+    char topic [128];
+
+    if (logLevel == NULL && logComponent == NULL) {
+        zsocket_set_subscribe (subSock, "");
+        return;
+    }
+
+    for (i = 0; i < TABLE_SIZE (logLevels); i++) {
+        if (logLevel && !strEqual (logLevel, logLevels [i]))
+            continue;
+
+        if (logComponent)
+            snprintf (topic, sizeof (topic), "%s%c%s%c", logLevels [i],
+                      LOG_TOPIC_SEPARATOR, logComponent, LOG_TOPIC_SEPARATOR);
+        else
+            snprintf (topic, sizeof (topic), "%s%c", logLevels [i], LOG_TOPIC_SEPARATOR);
+        zsocket_set_subscribe (subSock, topic);
+    }
 }
 
 int
 main (int argc, char *argv []) {
     int ret;
-    char *logMsg, *realLogMsg;
+    char *logTopic, *logMsg, *realLogMsg;
 
     /* Parse command line */
     ret = parseCmdline (argc, argv);
@@ -132,25 +177,31 @@ main (int argc, char *argv []) {
         freeCmdlineArgs ();
         return -1;
     }
-    zsocket_set_subscribe (subSock, "");
+    subscribeLogTopics ();
 
     while (!zctx_interrupted) {
+        /* Log topic frame */
+        logTopic = zstr_recv (subSock);
+        if (logTopic == NULL)
+            break;
+        free (logTopic);
+
+        /* Log message frame */
         logMsg = zstr_recv (subSock);
+        if (logMsg == NULL)
+            break;
 
-        if (logMsg && (logLevel == NULL ||
-                       (logLevel && strstr (logMsg, logLevel)))) {
-            if (showInDetail)
-                realLogMsg = logMsg;
-            else if (strstr (logMsg, "): "))
-                realLogMsg = strstr (logMsg, "): ") + strlen ("): ");
-            else
-                realLogMsg = NULL;
+        if (showInDetail)
+            realLogMsg = logMsg;
+        else if (strstr (logMsg, "): "))
+            realLogMsg = strstr (logMsg, "): ") + strlen ("): ");
+        else
+            realLogMsg = NULL;
 
-            if (realLogMsg)
-                printf ("%s", realLogMsg);
+        if (realLogMsg)
+            printf ("%s", realLogMsg);
 
-            free (logMsg);
-        }
+        free (logMsg);
     }
 
     zctx_destroy (&zmqContext);
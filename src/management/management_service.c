@@ -1,3 +1,12 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include <jansson.h>
 #include "config.h"
 #include "properties.h"
@@ -9,6 +18,10 @@
 #include "topology_manager.h"
 #include "netdev.h"
 #include "proto_analyzer.h"
+#include "proto_analyzer_stats.h"
+#include "heavy_hitter.h"
+#include "record_store.h"
+#include "metrics.h"
 #include "management_service.h"
 
 /* Packets statistic related variables */
@@ -30,6 +43,20 @@ static json_t *detectedServices = NULL;
 /* Topology entries information */
 static json_t *topologyEntries = NULL;
 
+/* Records replayed information */
+static json_t *replayRecords = NULL;
+static recordStoreCursor replayCursor;
+static boolean replayMore = False;
+
+/* Metrics information */
+static json_t *metrics = NULL;
+
+/* Proto analyzer stats information */
+static json_t *analyzerStats = NULL;
+
+/* Heavy hitters information */
+static json_t *heavyHitters = NULL;
+
 /* Error message for response */
 static char errMsg [256];
 
@@ -231,6 +258,69 @@ handleGetTopologyEntriesInfoRequest (json_t *body) {
     return 0;
 }
 
+/**
+ * @brief Get metrics info request handler.
+ *
+ * @param body -- data to handle
+ *
+ * @return 0 if success else -1
+ */
+static int
+handleGetMetricsInfoRequest (json_t *body) {
+    metrics = metricsToJson ();
+    if (metrics == NULL) {
+        snprintf (errMsg, sizeof (errMsg), "Get metrics info error.");
+        LOGE ("%s\n", errMsg);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get proto analyzer stats info request handler.
+ *
+ * @param body -- data to handle
+ *
+ * @return 0 if success else -1
+ */
+static int
+handleGetAnalyzerStatsInfoRequest (json_t *body) {
+    analyzerStats = protoAnalyzerStatsToJson ();
+    if (analyzerStats == NULL) {
+        snprintf (errMsg, sizeof (errMsg), "Get proto analyzer stats info error.");
+        LOGE ("%s\n", errMsg);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get heavy hitters info request handler, sketches will be reset
+ *        after report if body has reset flag.
+ *
+ * @param body -- data to handle
+ *
+ * @return 0 if success else -1
+ */
+static int
+handleGetHeavyHittersInfoRequest (json_t *body) {
+    json_t *reset = NULL;
+
+    if (body)
+        reset = json_object_get (body, MANAGEMENT_REQUEST_BODY_HEAVY_HITTERS_RESET);
+
+    heavyHitters = heavyHitterToJson ((reset && json_is_true (reset)) ? True : False);
+    if (heavyHitters == NULL) {
+        snprintf (errMsg, sizeof (errMsg), "Get heavy hitters info error.");
+        LOGE ("%s\n", errMsg);
+        return -1;
+    }
+
+    return 0;
+}
+
 /**
  * @brief Update services request handler
  *
@@ -347,6 +437,108 @@ handleUpdateServicesBlacklistRequest (json_t *body) {
     return 0;
 }
 
+/*
+ * @brief Get replay time from request body, time could be milliseconds
+ *        or local time string like 2016-01-01T00:00:00.000+08:00.
+ *
+ * @param body -- request body
+ * @param key -- time key
+ * @param time -- buffer to return time in milliseconds
+ *
+ * @return 0 if success else -1
+ */
+static int
+getReplayTime (json_t *body, char *key, u_long_long *time) {
+    json_t *value;
+
+    value = json_object_get (body, key);
+    if (value == NULL)
+        return 0;
+
+    if (json_is_integer (value) && json_integer_value (value) >= 0)
+        *time = json_integer_value (value);
+    else if (json_is_string (value))
+        *time = (u_long_long) decodeLocalTimeStr ((char *) json_string_value (value)) * 1000;
+    else
+        return -1;
+
+    return 0;
+}
+
+/**
+ * @brief Replay records request handler
+ *
+ * @param body -- data to handle
+ *
+ * @return 0 if success else -1
+ */
+static int
+handleReplayRecordsRequest (json_t *body) {
+    int ret;
+    u_long_long from = 0, to = (u_long_long) -1;
+    u_int limit = MANAGEMENT_REPLAY_DEFAULT_LIMIT;
+    char *type = NULL;
+    json_t *value, *cursor, *segment, *offset;
+
+    if (!recordStoreEnabled ()) {
+        snprintf (errMsg, sizeof (errMsg), "Record store is not enabled.");
+        LOGE ("%s\n", errMsg);
+        return -1;
+    }
+
+    replayCursor.segment = 0;
+    replayCursor.offset = 0;
+    if (body) {
+        if (getReplayTime (body, MANAGEMENT_REQUEST_BODY_REPLAY_FROM, &from) < 0 ||
+            getReplayTime (body, MANAGEMENT_REQUEST_BODY_REPLAY_TO, &to) < 0) {
+            snprintf (errMsg, sizeof (errMsg), "Invalid time range of replay records request.");
+            LOGE ("%s\n", errMsg);
+            return -1;
+        }
+
+        value = json_object_get (body, MANAGEMENT_REQUEST_BODY_REPLAY_TYPE);
+        if (value && json_is_string (value))
+            type = (char *) json_string_value (value);
+
+        value = json_object_get (body, MANAGEMENT_REQUEST_BODY_REPLAY_LIMIT);
+        if (value && json_is_integer (value) && json_integer_value (value) > 0)
+            limit = MIN_NUM (json_integer_value (value), MANAGEMENT_REPLAY_MAX_LIMIT);
+
+        cursor = json_object_get (body, MANAGEMENT_REQUEST_BODY_REPLAY_CURSOR);
+        if (cursor) {
+            segment = json_object_get (cursor, MANAGEMENT_REQUEST_BODY_REPLAY_CURSOR_SEGMENT);
+            offset = json_object_get (cursor, MANAGEMENT_REQUEST_BODY_REPLAY_CURSOR_OFFSET);
+            if (!json_is_integer (segment) || json_integer_value (segment) < 0 ||
+                !json_is_integer (offset) || json_integer_value (offset) < 0) {
+                snprintf (errMsg, sizeof (errMsg), "Invalid cursor of replay records request.");
+                LOGE ("%s\n", errMsg);
+                return -1;
+            }
+            replayCursor.segment = json_integer_value (segment);
+            replayCursor.offset = json_integer_value (offset);
+        }
+    }
+
+    replayRecords = json_array ();
+    if (replayRecords == NULL) {
+        snprintf (errMsg, sizeof (errMsg), "Create json array records error.");
+        LOGE ("%s\n", errMsg);
+        return -1;
+    }
+
+    ret = recordStoreReplay (from, to, type, limit, &replayCursor, replayRecords);
+    if (ret < 0) {
+        snprintf (errMsg, sizeof (errMsg), "Replay records error.");
+        LOGE ("%s\n", errMsg);
+        json_decref (replayRecords);
+        replayRecords = NULL;
+        return -1;
+    }
+    replayMore = ret ? True : False;
+
+    return 0;
+}
+
 /**
  * @brief Build management response based on command.
  *
@@ -358,7 +550,7 @@ static char *
 buildManagementResponse (char *cmd, int code) {
     u_int i;
     char *response;
-    json_t *root, *body, *protos;
+    json_t *root, *body, *protos, *cursor;
     char buf [128];
 
     root = json_object ();
@@ -408,6 +600,30 @@ buildManagementResponse (char *cmd, int code) {
         } else if (strEqual (cmd, MANAGEMENT_REQUEST_COMMAND_TOPOLOGY_ENTRIES_INFO)) {
             json_object_set_new (body, MANAGEMENT_RESPONSE_BODY_TOPOLOGY_ENTRIES, topologyEntries);
             topologyEntries = NULL;
+        } else if (strEqual (cmd, MANAGEMENT_REQUEST_COMMAND_REPLAY_RECORDS)) {
+            json_object_set_new (body, MANAGEMENT_RESPONSE_BODY_RECORDS, replayRecords);
+            replayRecords = NULL;
+
+            /* Cursor to continue replay if more records remain */
+            if (replayMore) {
+                cursor = json_object ();
+                if (cursor) {
+                    json_object_set_new (cursor, MANAGEMENT_REQUEST_BODY_REPLAY_CURSOR_SEGMENT,
+                                         json_integer (replayCursor.segment));
+                    json_object_set_new (cursor, MANAGEMENT_REQUEST_BODY_REPLAY_CURSOR_OFFSET,
+                                         json_integer (replayCursor.offset));
+                    json_object_set_new (body, MANAGEMENT_RESPONSE_BODY_CURSOR, cursor);
+                }
+            }
+        } else if (strEqual (cmd, MANAGEMENT_REQUEST_COMMAND_METRICS_INFO)) {
+            json_object_set_new (body, MANAGEMENT_RESPONSE_BODY_METRICS, metrics);
+            metrics = NULL;
+        } else if (strEqual (cmd, MANAGEMENT_REQUEST_COMMAND_ANALYZER_STATS_INFO)) {
+            json_object_set_new (body, MANAGEMENT_RESPONSE_BODY_ANALYZER_STATS, analyzerStats);
+            analyzerStats = NULL;
+        } else if (strEqual (cmd, MANAGEMENT_REQUEST_COMMAND_HEAVY_HITTERS_INFO)) {
+            json_object_set_new (body, MANAGEMENT_RESPONSE_BODY_HEAVY_HITTERS, heavyHitters);
+            heavyHitters = NULL;
         }
 
         json_object_set_new (root, MANAGEMENT_RESPONSE_CODE, json_integer (0));
@@ -430,6 +646,211 @@ buildManagementResponse (char *cmd, int code) {
     return response;
 }
 
+/**
+ * @brief Handle management request from management reply sock.
+ *
+ * @param managementReplySock -- management reply sock
+ *
+ * @return 0 if success else -1
+ */
+static int
+handleManagementRequest (void *managementReplySock) {
+    int ret;
+    char *request, *cmdStr, *response;
+    json_t *root, *cmd, *body;
+    json_error_t error;
+
+    request = zstr_recv (managementReplySock);
+    if (request == NULL) {
+        if (!taskShouldExit ())
+            LOGE ("Receive management request with fatal error.\n");
+        return -1;
+    }
+
+    LOGI ("Management request: %s\n", request);
+
+    root = json_loads (request, JSON_DISABLE_EOF_CHECK, &error);
+    if (root == NULL) {
+        LOGE ("Management request parse error: %s\n", error.text);
+        zstr_send (managementReplySock, DEFAULT_MANAGEMENT_ERROR_RESPONSE);
+    } else {
+        cmd = json_object_get (root, MANAGEMENT_REQUEST_COMMAND);
+        body = json_object_get (root, MANAGEMENT_REQUEST_BODY);
+
+        if (cmd == NULL) {
+            LOGE ("Invalid format of management request: %s.\n", request);
+            zstr_send (managementReplySock, DEFAULT_MANAGEMENT_ERROR_RESPONSE);
+        } else {
+            cmdStr = (char *) json_string_value (cmd);
+            if (strEqual (MANAGEMENT_REQUEST_COMMAND_RESUME, cmdStr))
+                ret = handleResumeRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_PAUSE, cmdStr))
+                ret = handlePauseRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_HEARTBEAT, cmdStr))
+                ret = handleHeartbeatRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_PACKETS_STATISTIC_INFO, cmdStr))
+                ret = handleGetPacketsStatisticInfoRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_PROTOS_INFO, cmdStr))
+                ret = handleGetProtosInfoRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_SERVICES_INFO, cmdStr))
+                ret = handleGetServicesInfoRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_SERVICES_BLACKLIST_INFO, cmdStr))
+                ret = handleGetServicesBlacklistInfoRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_DETECTED_SERVICES_INFO, cmdStr))
+                ret = handleGetDetectedServicesInfoRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_TOPOLOGY_ENTRIES_INFO, cmdStr))
+                ret = handleGetTopologyEntriesInfoRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_UPDATE_SERVICES, cmdStr))
+                ret = handleUpdateServicesRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_UPDATE_SERVICES_BLACKLIST, cmdStr))
+                ret = handleUpdateServicesBlacklistRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_REPLAY_RECORDS, cmdStr))
+                ret = handleReplayRecordsRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_METRICS_INFO, cmdStr))
+                ret = handleGetMetricsInfoRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_ANALYZER_STATS_INFO, cmdStr))
+                ret = handleGetAnalyzerStatsInfoRequest (body);
+            else if (strEqual (MANAGEMENT_REQUEST_COMMAND_HEAVY_HITTERS_INFO, cmdStr))
+                ret = handleGetHeavyHittersInfoRequest (body);
+            else {
+                LOGE ("Unknown management request command: %s.\n", cmdStr);
+                ret = 1;
+            }
+
+            response = buildManagementResponse (cmdStr, ret);
+            if (response == NULL) {
+                LOGE ("Build management response error.\n");
+                zstr_send (managementReplySock, DEFAULT_MANAGEMENT_ERROR_RESPONSE);
+            } else {
+                zstr_send (managementReplySock, response);
+                free (response);
+            }
+        }
+
+        json_object_clear (root);
+    }
+
+    free (request);
+    return 0;
+}
+
+/**
+ * @brief Create metrics http listen sock bound to loopback address.
+ *
+ * @param port -- metrics http port
+ *
+ * @return listen sock if success else -1
+ */
+static int
+newMetricsHttpSock (u_short port) {
+    int ret;
+    int sock;
+    int reuseAddr = 1;
+    struct sockaddr_in addr;
+
+    sock = socket (AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        LOGE ("Create metrics http sock error: %s.\n", strerror (errno));
+        return -1;
+    }
+
+    ret = setsockopt (sock, SOL_SOCKET, SO_REUSEADDR, &reuseAddr, sizeof (reuseAddr));
+    if (ret < 0) {
+        LOGE ("Set metrics http sock SO_REUSEADDR error: %s.\n", strerror (errno));
+        close (sock);
+        return -1;
+    }
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons (port);
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    ret = bind (sock, (struct sockaddr *) &addr, sizeof (addr));
+    if (ret < 0) {
+        LOGE ("Bind metrics http sock to 127.0.0.1:%u error: %s.\n", port, strerror (errno));
+        close (sock);
+        return -1;
+    }
+
+    ret = listen (sock, 16);
+    if (ret < 0) {
+        LOGE ("Listen metrics http sock error: %s.\n", strerror (errno));
+        close (sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+/* Send metrics http response with body */
+static void
+sendMetricsHttpResponse (int sock, char *status, char *body) {
+    char header [256];
+
+    snprintf (header, sizeof (header),
+              "HTTP/1.0 %s\r\n"
+              "Content-Type: text/plain; version=0.0.4\r\n"
+              "Content-Length: %u\r\n"
+              "Connection: close\r\n"
+              "\r\n",
+              status, (u_int) strlen (body));
+    if (safeWrite (sock, header, strlen (header)) < 0 ||
+        safeWrite (sock, body, strlen (body)) < 0)
+        LOGE ("Send metrics http response error.\n");
+}
+
+/**
+ * @brief Handle metrics http request, only "GET /metrics" is served
+ *        with metrics in prometheus text format.
+ *
+ * @param listenSock -- metrics http listen sock
+ */
+static void
+handleMetricsHttpRequest (int listenSock) {
+    int sock;
+    ssize_t n;
+    u_int len = 0;
+    char *text;
+    char request [METRICS_HTTP_REQUEST_MAX_SIZE];
+    struct timeval timeout;
+
+    sock = accept (listenSock, NULL, NULL);
+    if (sock < 0) {
+        if (errno != EINTR)
+            LOGE ("Accept metrics http request error: %s.\n", strerror (errno));
+        return;
+    }
+
+    timeout.tv_sec = METRICS_HTTP_RECV_TIMEOUT / 1000;
+    timeout.tv_usec = (METRICS_HTTP_RECV_TIMEOUT % 1000) * 1000;
+    setsockopt (sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+
+    /* Read request line and headers */
+    while (len < sizeof (request) - 1) {
+        n = recv (sock, request + len, sizeof (request) - 1 - len, 0);
+        if (n <= 0)
+            break;
+        len += n;
+        request [len] = 0;
+        if (strstr (request, "\r\n\r\n") || strstr (request, "\n\n"))
+            break;
+    }
+    request [len] = 0;
+
+    if (STRPREFIX (request, "GET /metrics ") || STRPREFIX (request, "GET /metrics\r")) {
+        text = metricsToPrometheusText ();
+        if (text == NULL)
+            sendMetricsHttpResponse (sock, "500 Internal Server Error", "");
+        else {
+            sendMetricsHttpResponse (sock, "200 OK", text);
+            free (text);
+        }
+    } else
+        sendMetricsHttpResponse (sock, "404 Not Found", "");
+
+    close (sock);
+}
+
 /*
  * Management service.
  */
@@ -437,9 +858,10 @@ void *
 managementService (void *args) {
     int ret;
     void *managementReplySock;
-    char *request, *cmdStr, *response;
-    json_t *root, *cmd, *body;
-    json_error_t error;
+    int metricsHttpSock = -1;
+    u_short metricsHttpPort;
+    zmq_pollitem_t items [2];
+    int itemsNum;
 
     /* Reset signals flag */
     resetSignalsFlag ();
@@ -450,77 +872,53 @@ managementService (void *args) {
         fprintf (stderr, "Init log context error.\n");
         goto exit;
     }
+    setLogComponent ("ManagementService");
 
     /* Get management reply sock */
     managementReplySock = getManagementReplySock ();
 
+    /* Metrics http endpoint is optional */
+    metricsHttpPort = getPropertiesMetricsHttpPort ();
+    if (metricsHttpPort) {
+        metricsHttpSock = newMetricsHttpSock (metricsHttpPort);
+        if (metricsHttpSock < 0)
+            LOGE ("Create metrics http endpoint error, metrics http endpoint is disabled.\n");
+        else
+            LOGI ("Metrics http endpoint: http://127.0.0.1:%u/metrics\n", metricsHttpPort);
+    }
+
+    items [0].socket = managementReplySock;
+    items [0].fd = 0;
+    items [0].events = ZMQ_POLLIN;
+    itemsNum = 1;
+    if (metricsHttpSock >= 0) {
+        items [1].socket = NULL;
+        items [1].fd = metricsHttpSock;
+        items [1].events = ZMQ_POLLIN;
+        itemsNum = 2;
+    }
+
     while (!taskShouldExit ()) {
-        request = zstr_recv (managementReplySock);
-        if (request == NULL) {
+        ret = zmq_poll (items, itemsNum, -1);
+        if (ret < 0) {
             if (!taskShouldExit ())
-                LOGE ("Receive management request with fatal error.\n");
+                LOGE ("Poll management request with fatal error.\n");
             break;
         }
 
-        LOGI ("Management request: %s\n", request);
-
-        root = json_loads (request, JSON_DISABLE_EOF_CHECK, &error);
-        if (root == NULL) {
-            LOGE ("Management request parse error: %s\n", error.text);
-            zstr_send (managementReplySock, DEFAULT_MANAGEMENT_ERROR_RESPONSE);
-        } else {
-            cmd = json_object_get (root, MANAGEMENT_REQUEST_COMMAND);
-            body = json_object_get (root, MANAGEMENT_REQUEST_BODY);
-
-            if (cmd == NULL) {
-                LOGE ("Invalid format of management request: %s.\n", request);
-                zstr_send (managementReplySock, DEFAULT_MANAGEMENT_ERROR_RESPONSE);
-            } else {
-                cmdStr = (char *) json_string_value (cmd);
-                if (strEqual (MANAGEMENT_REQUEST_COMMAND_RESUME, cmdStr))
-                    ret = handleResumeRequest (body);
-                else if (strEqual (MANAGEMENT_REQUEST_COMMAND_PAUSE, cmdStr))
-                    ret = handlePauseRequest (body);
-                else if (strEqual (MANAGEMENT_REQUEST_COMMAND_HEARTBEAT, cmdStr))
-                    ret = handleHeartbeatRequest (body);
-                else if (strEqual (MANAGEMENT_REQUEST_COMMAND_PACKETS_STATISTIC_INFO, cmdStr))
-                    ret = handleGetPacketsStatisticInfoRequest (body);
-                else if (strEqual (MANAGEMENT_REQUEST_COMMAND_PROTOS_INFO, cmdStr))
-                    ret = handleGetProtosInfoRequest (body);
-                else if (strEqual (MANAGEMENT_REQUEST_COMMAND_SERVICES_INFO, cmdStr))
-                    ret = handleGetServicesInfoRequest (body);
-                else if (strEqual (MANAGEMENT_REQUEST_COMMAND_SERVICES_BLACKLIST_INFO, cmdStr))
-                    ret = handleGetServicesBlacklistInfoRequest (body);
-                else if (strEqual (MANAGEMENT_REQUEST_COMMAND_DETECTED_SERVICES_INFO, cmdStr))
-                    ret = handleGetDetectedServicesInfoRequest (body);
-                else if (strEqual (MANAGEMENT_REQUEST_COMMAND_TOPOLOGY_ENTRIES_INFO, cmdStr))
-                    ret = handleGetTopologyEntriesInfoRequest (body);
-                else if (strEqual (MANAGEMENT_REQUEST_COMMAND_UPDATE_SERVICES, cmdStr))
-                    ret = handleUpdateServicesRequest (body);
-                else if (strEqual (MANAGEMENT_REQUEST_COMMAND_UPDATE_SERVICES_BLACKLIST, cmdStr))
-                    ret = handleUpdateServicesBlacklistRequest (body);
-                else {
-                    LOGE ("Unknown management request command: %s.\n", cmdStr);
-                    ret = 1;
-                }
-
-                response = buildManagementResponse (cmdStr, ret);
-                if (response == NULL) {
-                    LOGE ("Build management response error.\n");
-                    zstr_send (managementReplySock, DEFAULT_MANAGEMENT_ERROR_RESPONSE);
-                } else {
-                    zstr_send (managementReplySock, response);
-                    free (response);
-                }
-            }
-
-            json_object_clear (root);
+        if (items [0].revents & ZMQ_POLLIN) {
+            ret = handleManagementRequest (managementReplySock);
+            if (ret < 0)
+                break;
         }
 
-        free (request);
+        if (itemsNum > 1 && (items [1].revents & ZMQ_POLLIN))
+            handleMetricsHttpRequest (metricsHttpSock);
     }
 
     LOGI ("ManagementService will exit... .. .\n");
+    if (metricsHttpSock >= 0)
+        close (metricsHttpSock);
     destroyLogContext ();
 exit:
     if (!taskShouldExit ())
@@ -21,12 +21,30 @@
 #define MANAGEMENT_REQUEST_COMMAND_TOPOLOGY_ENTRIES_INFO "topology_entries_info"
 #define MANAGEMENT_REQUEST_COMMAND_UPDATE_SERVICES "update_services"
 #define MANAGEMENT_REQUEST_COMMAND_UPDATE_SERVICES_BLACKLIST "update_services_blacklist"
+#define MANAGEMENT_REQUEST_COMMAND_REPLAY_RECORDS "replay_records"
+#define MANAGEMENT_REQUEST_COMMAND_METRICS_INFO "metrics_info"
+#define MANAGEMENT_REQUEST_COMMAND_ANALYZER_STATS_INFO "analyzer_stats_info"
+#define MANAGEMENT_REQUEST_COMMAND_HEAVY_HITTERS_INFO "heavy_hitters_info"
 
 /* Management request body json key definitions */
 #define MANAGEMENT_REQUEST_BODY_SERVICES "services"
 
 #define MANAGEMENT_REQUEST_BODY_SERVICES_BLACKLIST "services_blacklist"
 
+#define MANAGEMENT_REQUEST_BODY_REPLAY_FROM "from"
+#define MANAGEMENT_REQUEST_BODY_REPLAY_TO "to"
+#define MANAGEMENT_REQUEST_BODY_REPLAY_TYPE "type"
+#define MANAGEMENT_REQUEST_BODY_REPLAY_LIMIT "limit"
+#define MANAGEMENT_REQUEST_BODY_REPLAY_CURSOR "cursor"
+#define MANAGEMENT_REQUEST_BODY_REPLAY_CURSOR_SEGMENT "segment"
+#define MANAGEMENT_REQUEST_BODY_REPLAY_CURSOR_OFFSET "offset"
+
+#define MANAGEMENT_REQUEST_BODY_HEAVY_HITTERS_RESET "reset"
+
+/* Default and max records of one replay_records request */
+#define MANAGEMENT_REPLAY_DEFAULT_LIMIT 1000
+#define MANAGEMENT_REPLAY_MAX_LIMIT 10000
+
 /* Management response json key definitions */
 #define MANAGEMENT_RESPONSE_CODE "code"
 #define MANAGEMENT_RESPONSE_BODY "body"
@@ -47,6 +65,19 @@
 
 #define MANAGEMENT_RESPONSE_BODY_TOPOLOGY_ENTRIES "topology_entries"
 
+#define MANAGEMENT_RESPONSE_BODY_RECORDS "records"
+#define MANAGEMENT_RESPONSE_BODY_CURSOR "cursor"
+
+#define MANAGEMENT_RESPONSE_BODY_METRICS "metrics"
+
+#define MANAGEMENT_RESPONSE_BODY_ANALYZER_STATS "analyzer_stats"
+
+#define MANAGEMENT_RESPONSE_BODY_HEAVY_HITTERS "heavy_hitters"
+
+/* Metrics http request max size and receive timeout in milliseconds */
+#define METRICS_HTTP_REQUEST_MAX_SIZE 4096
+#define METRICS_HTTP_RECV_TIMEOUT 1000
+
 /* Default management error response */
 #define DEFAULT_MANAGEMENT_ERROR_RESPONSE           \
     "{\"code\":1, \"error_message\":\"internal error\"}"
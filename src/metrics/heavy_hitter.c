@@ -0,0 +1,499 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <jansson.h>
+#include "util.h"
+#include "atomic.h"
+#include "log.h"
+#include "ip_packet.h"
+#include "heavy_hitter.h"
+
+/* Thread local heavy hitter slot */
+static __thread heavyHitterSlotPtr heavyHitterSlotInstance = NULL;
+
+/* Heavy hitter slots of all threads */
+static heavyHitterSlotPtr heavyHitterSlots [HEAVY_HITTER_MAX_SLOTS];
+static volatile u_int heavyHitterSlotsNum = 0;
+/* Heavy hitter slots register lock */
+static pthread_mutex_t heavyHitterSlotsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Reset epoch, slots of older epoch are cleared before next update */
+static volatile u_int heavyHitterEpoch = 0;
+
+/* Heavy hitter key kind names, ordered by heavyHitterKind */
+static char *heavyHitterKindNames [] = {
+    "flows",
+    "services",
+};
+
+/* Heavy hitter rank names, ordered by heavyHitterRank */
+static char *heavyHitterRankNames [] = {
+    "by_packets",
+    "by_bytes",
+};
+
+typedef struct _heavyHitterEntry heavyHitterEntry;
+typedef heavyHitterEntry *heavyHitterEntryPtr;
+
+/* Heavy hitter merged from all threads */
+struct _heavyHitterEntry {
+    heavyHitterKey key;                 /**< Heavy hitter key */
+    heavyHitterCounter estimate;        /**< Estimate of packets and bytes */
+};
+
+static u_long_long
+heavyHitterKeyHash (heavyHitterKeyPtr key) {
+    u_long_long hash;
+
+    hash = (((u_long_long) ipAddrHash (&key->clientIp) << 32) |
+            ipAddrHash (&key->serverIp)) ^
+           ((((u_long_long) key->clientPort << 16) | key->serverPort) * 0x9E3779B97F4A7C15ULL);
+
+    /* Finalizer of murmurhash3 */
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+static boolean
+heavyHitterKeyEqual (heavyHitterKeyPtr key1, heavyHitterKeyPtr key2) {
+    return (key1->clientPort == key2->clientPort &&
+            key1->serverPort == key2->serverPort &&
+            ipAddrIsEqual (&key1->clientIp, &key2->clientIp) &&
+            ipAddrIsEqual (&key1->serverIp, &key2->serverIp));
+}
+
+/* Order ip addresses by family then address bytes */
+static int
+heavyHitterIpAddrCompare (ipAddrPtr addr1, ipAddrPtr addr2) {
+    if (addr1->family != addr2->family)
+        return addr1->family < addr2->family ? -1 : 1;
+
+    if (addr1->family == AF_INET)
+        return memcmp (&addr1->u.ip4, &addr2->u.ip4, sizeof (struct in_addr));
+    else if (addr1->family == AF_INET6)
+        return memcmp (&addr1->u.ip6, &addr2->u.ip6, sizeof (struct in6_addr));
+
+    return 0;
+}
+
+static int
+heavyHitterKeyCompare (heavyHitterKeyPtr key1, heavyHitterKeyPtr key2) {
+    int ret;
+
+    ret = heavyHitterIpAddrCompare (&key1->clientIp, &key2->clientIp);
+    if (ret)
+        return ret;
+    ret = heavyHitterIpAddrCompare (&key1->serverIp, &key2->serverIp);
+    if (ret)
+        return ret;
+    if (key1->clientPort != key2->clientPort)
+        return key1->clientPort < key2->clientPort ? -1 : 1;
+    if (key1->serverPort != key2->serverPort)
+        return key1->serverPort < key2->serverPort ? -1 : 1;
+
+    return 0;
+}
+
+/* Find candidate with min estimate */
+static void
+heavyHitterTopKUpdateMin (heavyHitterTopKPtr topK) {
+    u_int i, minIndex = 0;
+
+    for (i = 1; i < topK->num; i++) {
+        if (topK->estimates [i] < topK->estimates [minIndex])
+            minIndex = i;
+    }
+    topK->minIndex = minIndex;
+}
+
+/* Offer key with estimate to top-K candidates */
+static void
+heavyHitterTopKOffer (heavyHitterTopKPtr topK, u_int hash,
+                      heavyHitterKeyPtr key, u_long_long estimate) {
+    u_int i;
+
+    /* Estimate of candidate only grows, so keys below min are not candidates */
+    if (topK->num == HEAVY_HITTER_TOP_K && estimate <= topK->estimates [topK->minIndex])
+        return;
+
+    for (i = 0; i < topK->num; i++) {
+        if (topK->hashes [i] == hash && heavyHitterKeyEqual (&topK->keys [i], key)) {
+            topK->estimates [i] = estimate;
+            if (i == topK->minIndex)
+                heavyHitterTopKUpdateMin (topK);
+            return;
+        }
+    }
+
+    /* Add new candidate or replace candidate with min estimate */
+    if (topK->num < HEAVY_HITTER_TOP_K)
+        i = topK->num++;
+    else
+        i = topK->minIndex;
+
+    topK->hashes [i] = hash;
+    topK->keys [i] = *key;
+    topK->estimates [i] = estimate;
+    heavyHitterTopKUpdateMin (topK);
+}
+
+/* Update sketch with one packet of key */
+static void
+heavyHitterSketchUpdate (heavyHitterSketchPtr sketch, heavyHitterKeyPtr key, u_int bytes) {
+    u_int i;
+    u_long_long hash;
+    heavyHitterCounterPtr counter;
+    heavyHitterCounter estimate = {~0ULL, ~0ULL};
+
+    hash = heavyHitterKeyHash (key);
+    for (i = 0; i < HEAVY_HITTER_SKETCH_DEPTH; i++) {
+        counter = &sketch->counters [i][(hash >> (i * 16)) & (HEAVY_HITTER_SKETCH_WIDTH - 1)];
+        counter->packets++;
+        counter->bytes += bytes;
+
+        if (counter->packets < estimate.packets)
+            estimate.packets = counter->packets;
+        if (counter->bytes < estimate.bytes)
+            estimate.bytes = counter->bytes;
+    }
+
+    heavyHitterTopKOffer (&sketch->topK [HEAVY_HITTER_BY_PACKETS],
+                          (u_int) (hash >> 32), key, estimate.packets);
+    heavyHitterTopKOffer (&sketch->topK [HEAVY_HITTER_BY_BYTES],
+                          (u_int) (hash >> 32), key, estimate.bytes);
+}
+
+/* Get estimate of packets and bytes of key from sketch */
+static void
+heavyHitterSketchEstimate (heavyHitterSketchPtr sketch, heavyHitterKeyPtr key,
+                           heavyHitterCounterPtr estimate) {
+    u_int i;
+    u_long_long hash;
+    heavyHitterCounterPtr counter;
+
+    estimate->packets = ~0ULL;
+    estimate->bytes = ~0ULL;
+
+    hash = heavyHitterKeyHash (key);
+    for (i = 0; i < HEAVY_HITTER_SKETCH_DEPTH; i++) {
+        counter = &sketch->counters [i][(hash >> (i * 16)) & (HEAVY_HITTER_SKETCH_WIDTH - 1)];
+        if (counter->packets < estimate->packets)
+            estimate->packets = counter->packets;
+        if (counter->bytes < estimate->bytes)
+            estimate->bytes = counter->bytes;
+    }
+}
+
+/**
+ * @brief Update heavy hitter sketches of current thread with one packet,
+ *        both flow and service of packet are counted.
+ *
+ * @param clientIp -- Client ip
+ * @param clientPort -- Client port
+ * @param serverIp -- Server ip
+ * @param serverPort -- Server port
+ * @param bytes -- Bytes of packet
+ */
+void
+heavyHitterUpdate (ipAddrPtr clientIp, u_short clientPort,
+                   ipAddrPtr serverIp, u_short serverPort, u_int bytes) {
+    heavyHitterKey key;
+    heavyHitterSlotPtr slot = heavyHitterSlotInstance;
+
+    if (slot == NULL)
+        return;
+
+    if (slot->epoch != heavyHitterEpoch) {
+        memset (slot->sketches, 0, sizeof (slot->sketches));
+        __sync_synchronize ();
+        slot->epoch = heavyHitterEpoch;
+    }
+
+    key.clientIp = *clientIp;
+    key.serverIp = *serverIp;
+    key.clientPort = clientPort;
+    key.serverPort = serverPort;
+    heavyHitterSketchUpdate (&slot->sketches [HEAVY_HITTER_FLOW], &key, bytes);
+
+    memset (&key.clientIp, 0, sizeof (ipAddr));
+    key.clientPort = 0;
+    heavyHitterSketchUpdate (&slot->sketches [HEAVY_HITTER_SERVICE], &key, bytes);
+}
+
+static int
+heavyHitterEntryKeyCompare (const void *entry1, const void *entry2) {
+    return heavyHitterKeyCompare (&((heavyHitterEntryPtr) entry1)->key,
+                                  &((heavyHitterEntryPtr) entry2)->key);
+}
+
+static int
+heavyHitterEntryPacketsCompare (const void *entry1, const void *entry2) {
+    u_long_long packets1 = ((heavyHitterEntryPtr) entry1)->estimate.packets;
+    u_long_long packets2 = ((heavyHitterEntryPtr) entry2)->estimate.packets;
+
+    return packets1 == packets2 ? 0 : (packets1 < packets2 ? 1 : -1);
+}
+
+static int
+heavyHitterEntryBytesCompare (const void *entry1, const void *entry2) {
+    u_long_long bytes1 = ((heavyHitterEntryPtr) entry1)->estimate.bytes;
+    u_long_long bytes2 = ((heavyHitterEntryPtr) entry2)->estimate.bytes;
+
+    return bytes1 == bytes2 ? 0 : (bytes1 < bytes2 ? 1 : -1);
+}
+
+/* Get json of heavy hitter entry */
+static json_t *
+heavyHitterEntryJson (heavyHitterKind kind, heavyHitterEntryPtr entry) {
+    json_t *item;
+    char ipStr [IP_ADDR_STR_MAX_LENGTH];
+
+    item = json_object ();
+    if (item == NULL)
+        return NULL;
+
+    if (kind == HEAVY_HITTER_FLOW) {
+        ipAddrToStr (&entry->key.clientIp, ipStr, sizeof (ipStr));
+        json_object_set_new (item, "client_ip", json_string (ipStr));
+        json_object_set_new (item, "client_port", json_integer (entry->key.clientPort));
+    }
+    ipAddrToStr (&entry->key.serverIp, ipStr, sizeof (ipStr));
+    json_object_set_new (item, "server_ip", json_string (ipStr));
+    json_object_set_new (item, "server_port", json_integer (entry->key.serverPort));
+    json_object_set_new (item, "packets", json_integer (entry->estimate.packets));
+    json_object_set_new (item, "bytes", json_integer (entry->estimate.bytes));
+
+    return item;
+}
+
+/*
+ * Merge top-K candidates of rank from all threads, estimate of every
+ * candidate is the sum of estimates of all threads.
+ */
+static json_t *
+heavyHitterMergeToJson (heavyHitterKind kind, heavyHitterRank rank,
+                        heavyHitterSlotPtr *slots, u_int slotsNum) {
+    u_int i, j, k, num;
+    heavyHitterTopKPtr topK;
+    heavyHitterEntryPtr entries;
+    heavyHitterCounter estimate;
+    json_t *hitters, *item;
+
+    hitters = json_array ();
+    if (hitters == NULL)
+        return NULL;
+
+    if (slotsNum == 0)
+        return hitters;
+
+    entries = (heavyHitterEntryPtr) malloc (sizeof (heavyHitterEntry) *
+                                            slotsNum * HEAVY_HITTER_TOP_K);
+    if (entries == NULL) {
+        json_decref (hitters);
+        return NULL;
+    }
+
+    /* Collect candidates of all threads */
+    num = 0;
+    for (i = 0; i < slotsNum; i++) {
+        topK = &slots [i]->sketches [kind].topK [rank];
+        for (j = 0; j < MIN_NUM (topK->num, HEAVY_HITTER_TOP_K); j++)
+            entries [num++].key = topK->keys [j];
+    }
+
+    /* Remove duplicated candidates */
+    qsort (entries, num, sizeof (heavyHitterEntry), heavyHitterEntryKeyCompare);
+    for (i = 0, j = 0; i < num; i++) {
+        if (j && heavyHitterKeyEqual (&entries [j - 1].key, &entries [i].key))
+            continue;
+        entries [j++] = entries [i];
+    }
+    num = j;
+
+    /* Merge estimates of all threads */
+    for (i = 0; i < num; i++) {
+        entries [i].estimate.packets = 0;
+        entries [i].estimate.bytes = 0;
+        for (k = 0; k < slotsNum; k++) {
+            heavyHitterSketchEstimate (&slots [k]->sketches [kind], &entries [i].key, &estimate);
+            entries [i].estimate.packets += estimate.packets;
+            entries [i].estimate.bytes += estimate.bytes;
+        }
+    }
+
+    qsort (entries, num, sizeof (heavyHitterEntry),
+           rank == HEAVY_HITTER_BY_PACKETS ?
+           heavyHitterEntryPacketsCompare : heavyHitterEntryBytesCompare);
+
+    for (i = 0; i < MIN_NUM (num, HEAVY_HITTER_TOP_K); i++) {
+        item = heavyHitterEntryJson (kind, &entries [i]);
+        if (item == NULL) {
+            free (entries);
+            json_decref (hitters);
+            return NULL;
+        }
+        json_array_append_new (hitters, item);
+    }
+
+    free (entries);
+    return hitters;
+}
+
+/**
+ * @brief Get heavy hitter flows and services of all threads in json,
+ *        ranked by packets and bytes. Estimates are upper bounds of
+ *        packets and bytes since start or last reset.
+ *
+ * @param reset -- Reset sketches of all threads after report
+ *
+ * @return Heavy hitters json object if success else NULL
+ */
+json_t *
+heavyHitterToJson (boolean reset) {
+    u_int i, j, num, slotsNum;
+    u_int epoch;
+    heavyHitterSlotPtr slots [HEAVY_HITTER_MAX_SLOTS];
+    json_t *root, *kind, *hitters;
+
+    /* Sketches of slots not updated since last reset are stale */
+    epoch = heavyHitterEpoch;
+    slotsNum = 0;
+    num = MIN_NUM (heavyHitterSlotsNum, HEAVY_HITTER_MAX_SLOTS);
+    for (i = 0; i < num; i++) {
+        if (heavyHitterSlots [i] && heavyHitterSlots [i]->epoch == epoch)
+            slots [slotsNum++] = heavyHitterSlots [i];
+    }
+
+    root = json_object ();
+    if (root == NULL)
+        return NULL;
+
+    for (i = 0; i < HEAVY_HITTER_KIND_MAX; i++) {
+        kind = json_object ();
+        if (kind == NULL) {
+            json_object_clear (root);
+            return NULL;
+        }
+        json_object_set_new (root, heavyHitterKindNames [i], kind);
+
+        for (j = 0; j < HEAVY_HITTER_RANK_MAX; j++) {
+            hitters = heavyHitterMergeToJson (i, j, slots, slotsNum);
+            if (hitters == NULL) {
+                json_object_clear (root);
+                return NULL;
+            }
+            json_object_set_new (kind, heavyHitterRankNames [j], hitters);
+        }
+    }
+
+    if (reset)
+        ATOMIC_INC (&heavyHitterEpoch);
+
+    return root;
+}
+
+/* Find heavy hitter slot of component, must be called with heavyHitterSlotsLock */
+static heavyHitterSlotPtr
+findHeavyHitterSlot (char *component) {
+    u_int i;
+
+    for (i = 0; i < heavyHitterSlotsNum; i++) {
+        if (strEqual (heavyHitterSlots [i]->component, component))
+            return heavyHitterSlots [i];
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Init heavy hitter context of current thread, it will register
+ *        a heavy hitter slot for current thread, slot is kept after
+ *        thread exit so heavy hitters are still reported. Slot released
+ *        by thread of the same component is reused by restarted thread,
+ *        component of running thread is suffixed with "#n".
+ *
+ * @param component -- Heavy hitter component format, like "TcpProcessService:3"
+ *
+ * @return 0 if success else -1
+ */
+int
+initHeavyHitterContext (const char *component, ...) {
+    u_int n;
+    boolean newSlot = False;
+    va_list va;
+    char name [HEAVY_HITTER_COMPONENT_MAX_LENGTH];
+    char uniqueName [HEAVY_HITTER_COMPONENT_MAX_LENGTH];
+    heavyHitterSlotPtr slot;
+
+    va_start (va, component);
+    vsnprintf (name, sizeof (name), component, va);
+    va_end (va);
+
+    pthread_mutex_lock (&heavyHitterSlotsLock);
+
+    snprintf (uniqueName, sizeof (uniqueName), "%s", name);
+    for (n = 2; (slot = findHeavyHitterSlot (uniqueName)) && slot->active; n++)
+        snprintf (uniqueName, sizeof (uniqueName), "%s#%u", name, n);
+
+    if (slot == NULL) {
+        if (heavyHitterSlotsNum >= HEAVY_HITTER_MAX_SLOTS) {
+            pthread_mutex_unlock (&heavyHitterSlotsLock);
+            LOGE ("Too many heavy hitter slots.\n");
+            return -1;
+        }
+
+        slot = (heavyHitterSlotPtr) calloc (1, sizeof (heavyHitterSlot));
+        if (slot == NULL) {
+            pthread_mutex_unlock (&heavyHitterSlotsLock);
+            LOGE ("Alloc heavy hitter slot error.\n");
+            return -1;
+        }
+        snprintf (slot->component, sizeof (slot->component), "%s", uniqueName);
+        slot->epoch = heavyHitterEpoch;
+        newSlot = True;
+    }
+    slot->active = True;
+
+    /* Publish new slot after it has been initialized */
+    if (newSlot) {
+        __sync_synchronize ();
+        heavyHitterSlots [heavyHitterSlotsNum] = slot;
+        __sync_synchronize ();
+        heavyHitterSlotsNum++;
+    }
+    heavyHitterSlotInstance = slot;
+
+    pthread_mutex_unlock (&heavyHitterSlotsLock);
+    return 0;
+}
+
+/* Destroy heavy hitter context of current thread, slot is released for reuse */
+void
+destroyHeavyHitterContext (void) {
+    pthread_mutex_lock (&heavyHitterSlotsLock);
+    if (heavyHitterSlotInstance)
+        heavyHitterSlotInstance->active = False;
+    heavyHitterSlotInstance = NULL;
+    pthread_mutex_unlock (&heavyHitterSlotsLock);
+}
+
+/* Destroy heavy hitter slots, must be called after all threads exit */
+void
+destroyHeavyHitter (void) {
+    u_int i, num;
+
+    num = MIN_NUM (heavyHitterSlotsNum, HEAVY_HITTER_MAX_SLOTS);
+    for (i = 0; i < num; i++) {
+        free (heavyHitterSlots [i]);
+        heavyHitterSlots [i] = NULL;
+    }
+    heavyHitterSlotsNum = 0;
+}
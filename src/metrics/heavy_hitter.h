@@ -0,0 +1,104 @@
+#ifndef __HEAVY_HITTER_H__
+#define __HEAVY_HITTER_H__
+
+#include <jansson.h>
+#include "util.h"
+#include "ip.h"
+
+/* Max heavy hitter slots, one slot for each tcpProcessService */
+#define HEAVY_HITTER_MAX_SLOTS 256
+/* Count-min sketch rows, every row is indexed by 16 bits of key hash */
+#define HEAVY_HITTER_SKETCH_DEPTH 4
+/* Count-min sketch counters of each row, must be power of 2 and <= 65536 */
+#define HEAVY_HITTER_SKETCH_WIDTH 1024
+/* Heavy hitter candidates of each rank kept by every thread */
+#define HEAVY_HITTER_TOP_K 32
+#define HEAVY_HITTER_COMPONENT_MAX_LENGTH 64
+
+/* Heavy hitter key kinds */
+typedef enum {
+    HEAVY_HITTER_FLOW,
+    HEAVY_HITTER_SERVICE,
+    HEAVY_HITTER_KIND_MAX
+} heavyHitterKind;
+
+/* Heavy hitter ranks */
+typedef enum {
+    HEAVY_HITTER_BY_PACKETS,
+    HEAVY_HITTER_BY_BYTES,
+    HEAVY_HITTER_RANK_MAX
+} heavyHitterRank;
+
+typedef struct _heavyHitterKey heavyHitterKey;
+typedef heavyHitterKey *heavyHitterKeyPtr;
+
+/* Heavy hitter key, client ip and port are 0 for service */
+struct _heavyHitterKey {
+    ipAddr clientIp;                    /**< Client ip */
+    ipAddr serverIp;                    /**< Server ip */
+    u_short clientPort;                 /**< Client port */
+    u_short serverPort;                 /**< Server port */
+};
+
+typedef struct _heavyHitterCounter heavyHitterCounter;
+typedef heavyHitterCounter *heavyHitterCounterPtr;
+
+struct _heavyHitterCounter {
+    u_long_long packets;                /**< Packets */
+    u_long_long bytes;                  /**< Bytes */
+};
+
+typedef struct _heavyHitterTopK heavyHitterTopK;
+typedef heavyHitterTopK *heavyHitterTopKPtr;
+
+/*
+ * Heavy hitter candidates of one rank, candidate with min estimate is
+ * replaced when a key with larger estimate is offered. Key hashes are
+ * kept in a compact array for fast lookup.
+ */
+struct _heavyHitterTopK {
+    u_int num;                          /**< Candidates number */
+    u_int minIndex;                     /**< Index of candidate with min estimate */
+    u_int hashes [HEAVY_HITTER_TOP_K];  /**< Candidate key hashes */
+    heavyHitterKey keys [HEAVY_HITTER_TOP_K]; /**< Candidate keys */
+    u_long_long estimates [HEAVY_HITTER_TOP_K]; /**< Candidate estimates */
+};
+
+typedef struct _heavyHitterSketch heavyHitterSketch;
+typedef heavyHitterSketch *heavyHitterSketchPtr;
+
+/* Count-min sketch of packets and bytes with top-K candidates */
+struct _heavyHitterSketch {
+    heavyHitterCounter counters [HEAVY_HITTER_SKETCH_DEPTH][HEAVY_HITTER_SKETCH_WIDTH]; /**< Sketch counters */
+    heavyHitterTopK topK [HEAVY_HITTER_RANK_MAX]; /**< Top-K candidates by rank */
+};
+
+typedef struct _heavyHitterSlot heavyHitterSlot;
+typedef heavyHitterSlot *heavyHitterSlotPtr;
+
+/*
+ * Heavy hitter slot of one thread, written by owner thread only without
+ * lock and read by management service, report is approximate.
+ */
+struct _heavyHitterSlot {
+    char component [HEAVY_HITTER_COMPONENT_MAX_LENGTH]; /**< Heavy hitter component */
+    volatile u_int epoch;               /**< Reset epoch of sketches */
+    boolean active;                     /**< Slot is owned by a running thread */
+    heavyHitterSketch sketches [HEAVY_HITTER_KIND_MAX]; /**< Sketches by key kind */
+};
+
+/*========================Interfaces definition============================*/
+void
+heavyHitterUpdate (ipAddrPtr clientIp, u_short clientPort,
+                   ipAddrPtr serverIp, u_short serverPort, u_int bytes);
+json_t *
+heavyHitterToJson (boolean reset);
+int
+initHeavyHitterContext (const char *component, ...);
+void
+destroyHeavyHitterContext (void);
+void
+destroyHeavyHitter (void);
+/*=======================Interfaces definition end=========================*/
+
+#endif /* __HEAVY_HITTER_H__ */
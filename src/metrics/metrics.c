@@ -0,0 +1,972 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <jansson.h>
+#include "util.h"
+#include "log.h"
+#include "analysis_record.h"
+#include "metrics.h"
+
+#define METRICS_TEXT_INIT_SIZE (16 << 10)
+
+/* Thread local metrics slot */
+__thread metricsSlotPtr metricsSlotInstance = NULL;
+
+/* Monotonic clock id of current node */
+static u_long_long metricsClockId = 0;
+
+/* Metrics slots of all threads */
+static metricsSlotPtr metricsSlots [METRICS_MAX_THREADS];
+static volatile u_int metricsSlotsNum = 0;
+/* Metrics slots register lock */
+static pthread_mutex_t metricsSlotsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Metric definitions, ordered by metric id */
+static metricDef metricDefs [] = {
+    {METRIC_PACKETS_RECEIVED, METRIC_TYPE_COUNTER,
+     "ntrace_packets_received_total", NULL, "packets_received",
+     "Packets received by stage."},
+    {METRIC_BYTES_RECEIVED, METRIC_TYPE_COUNTER,
+     "ntrace_bytes_received_total", NULL, "bytes_received",
+     "Bytes of packets received by stage."},
+    {METRIC_PACKETS_SENT, METRIC_TYPE_COUNTER,
+     "ntrace_packets_sent_total", NULL, "packets_sent",
+     "Packets sent to next stage."},
+    {METRIC_IP_QUEUE_ENQUEUED, METRIC_TYPE_COUNTER,
+     "ntrace_queue_enqueued_total", "queue=\"ip\"", "ip_queue_enqueued",
+     "Messages enqueued to queue."},
+    {METRIC_IP_QUEUE_DEQUEUED, METRIC_TYPE_COUNTER,
+     "ntrace_queue_dequeued_total", "queue=\"ip\"", "ip_queue_dequeued",
+     "Messages dequeued from queue."},
+    {METRIC_ICMP_QUEUE_ENQUEUED, METRIC_TYPE_COUNTER,
+     "ntrace_queue_enqueued_total", "queue=\"icmp\"", "icmp_queue_enqueued",
+     "Messages enqueued to queue."},
+    {METRIC_ICMP_QUEUE_DEQUEUED, METRIC_TYPE_COUNTER,
+     "ntrace_queue_dequeued_total", "queue=\"icmp\"", "icmp_queue_dequeued",
+     "Messages dequeued from queue."},
+    {METRIC_TCP_QUEUE_ENQUEUED, METRIC_TYPE_COUNTER,
+     "ntrace_queue_enqueued_total", "queue=\"tcp\"", "tcp_queue_enqueued",
+     "Messages enqueued to queue."},
+    {METRIC_TCP_QUEUE_DEQUEUED, METRIC_TYPE_COUNTER,
+     "ntrace_queue_dequeued_total", "queue=\"tcp\"", "tcp_queue_dequeued",
+     "Messages dequeued from queue."},
+    {METRIC_RECORD_QUEUE_ENQUEUED, METRIC_TYPE_COUNTER,
+     "ntrace_queue_enqueued_total", "queue=\"record\"", "record_queue_enqueued",
+     "Messages enqueued to queue."},
+    {METRIC_RECORD_QUEUE_DEQUEUED, METRIC_TYPE_COUNTER,
+     "ntrace_queue_dequeued_total", "queue=\"record\"", "record_queue_dequeued",
+     "Messages dequeued from queue."},
+    {METRIC_IP_FRAGMENT_QUEUES, METRIC_TYPE_GAUGE,
+     "ntrace_ip_fragment_queues", NULL, "ip_fragment_queues",
+     "Ip fragment queues waiting for defragment."},
+    {METRIC_DEDUP_PACKETS_CHECKED, METRIC_TYPE_COUNTER,
+     "ntrace_dedup_packets_checked_total", NULL, "dedup_packets_checked",
+     "Tcp packets checked by duplicate packet suppression."},
+    {METRIC_DEDUP_PACKETS_DUPLICATED, METRIC_TYPE_COUNTER,
+     "ntrace_dedup_packets_duplicated_total", NULL, "dedup_packets_duplicated",
+     "Duplicate tcp packets of mirror ports suppressed."},
+    {METRIC_DEDUP_ENTRIES_EVICTED, METRIC_TYPE_COUNTER,
+     "ntrace_dedup_entries_evicted_total", NULL, "dedup_entries_evicted",
+     "Dedup table entries replaced within dedup window."},
+    {METRIC_TCP_STREAMS, METRIC_TYPE_GAUGE,
+     "ntrace_tcp_streams", NULL, "tcp_streams",
+     "Tcp streams in flow table."},
+    {METRIC_TCP_STREAMS_ALLOC, METRIC_TYPE_COUNTER,
+     "ntrace_tcp_streams_alloc_total", NULL, "tcp_streams_alloc",
+     "Tcp streams allocated."},
+    {METRIC_TCP_STREAMS_FREE, METRIC_TYPE_COUNTER,
+     "ntrace_tcp_streams_free_total", NULL, "tcp_streams_free",
+     "Tcp streams freed."},
+    {METRIC_TCP_RECEIVE_BUFFER_BYTES, METRIC_TYPE_GAUGE,
+     "ntrace_tcp_receive_buffer_bytes", NULL, "tcp_receive_buffer_bytes",
+     "Bytes allocated for tcp stream receive buffers."},
+    {METRIC_RECORDS_PUBLISHED, METRIC_TYPE_COUNTER,
+     "ntrace_records_published_total", NULL, "records_published",
+     "Analysis records published to analysis record service."},
+    {METRIC_RECORDS_DROPPED, METRIC_TYPE_COUNTER,
+     "ntrace_records_dropped_total", NULL, "records_dropped",
+     "Analysis records dropped for publish error."},
+    {METRIC_RECORDS_EMITTED, METRIC_TYPE_COUNTER,
+     "ntrace_records_emitted_total", NULL, "records_emitted",
+     "Analysis records written to output devices."},
+};
+
+typedef struct _dropReasonDef dropReasonDef;
+typedef dropReasonDef *dropReasonDefPtr;
+
+struct _dropReasonDef {
+    dropReason reason;                  /**< Drop reason */
+    dropCategory category;              /**< Drop reason category */
+    char *name;                         /**< Drop reason name */
+};
+
+/* Drop reason definitions, ordered by drop reason */
+static dropReasonDef dropReasonDefs [] = {
+    {DROP_REASON_INCOMPLETE, DROP_CATEGORY_CAPTURE, "incomplete"},
+    {DROP_REASON_NOT_IP, DROP_CATEGORY_CAPTURE, "not_ip"},
+    {DROP_REASON_IP_HEADER, DROP_CATEGORY_IP, "ip_header"},
+    {DROP_REASON_IP_FILTERED, DROP_CATEGORY_IP, "ip_filtered"},
+    {DROP_REASON_IP_DEFRAG, DROP_CATEGORY_IP, "ip_defrag"},
+    {DROP_REASON_TCP_INVALID, DROP_CATEGORY_TCP, "tcp_invalid"},
+    {DROP_REASON_TCP_NO_SYN, DROP_CATEGORY_TCP, "tcp_no_syn"},
+    {DROP_REASON_TCP_RETRANSMITTED, DROP_CATEGORY_TCP, "tcp_retransmitted"},
+    {DROP_REASON_TCP_OUT_OF_WINDOW, DROP_CATEGORY_TCP, "tcp_out_of_window"},
+    {DROP_REASON_TCP_PAWS, DROP_CATEGORY_TCP, "tcp_paws"},
+    {DROP_REASON_TCP_RCV_BUF_OVERFLOW, DROP_CATEGORY_RESOURCE, "tcp_rcv_buf_overflow"},
+    {DROP_REASON_NO_MEMORY, DROP_CATEGORY_RESOURCE, "no_memory"},
+    {DROP_REASON_SEND, DROP_CATEGORY_TRANSPORT, "send"},
+};
+
+/* Drop category names, ordered by drop category */
+static char *dropCategoryNames [] = {
+    "capture",
+    "ip",
+    "tcp",
+    "resource",
+    "transport",
+};
+
+typedef struct _metricsQueueDef metricsQueueDef;
+typedef metricsQueueDef *metricsQueueDefPtr;
+
+/* Queue depth derived from enqueued and dequeued counters of all threads */
+struct _metricsQueueDef {
+    char *name;                         /**< Queue name */
+    metricId enqueued;                  /**< Enqueued counter */
+    metricId dequeued;                  /**< Dequeued counter */
+};
+
+static metricsQueueDef metricsQueueDefs [] = {
+    {"ip", METRIC_IP_QUEUE_ENQUEUED, METRIC_IP_QUEUE_DEQUEUED},
+    {"icmp", METRIC_ICMP_QUEUE_ENQUEUED, METRIC_ICMP_QUEUE_DEQUEUED},
+    {"tcp", METRIC_TCP_QUEUE_ENQUEUED, METRIC_TCP_QUEUE_DEQUEUED},
+    {"record", METRIC_RECORD_QUEUE_ENQUEUED, METRIC_RECORD_QUEUE_DEQUEUED},
+};
+
+typedef struct _metricsLatencyDef metricsLatencyDef;
+typedef metricsLatencyDef *metricsLatencyDefPtr;
+
+struct _metricsLatencyDef {
+    latencyId id;                       /**< Latency stage id */
+    char *name;                         /**< Latency stage name */
+};
+
+/* Latency stage definitions, ordered by latency id */
+static metricsLatencyDef latencyDefs [] = {
+    {LATENCY_CAPTURE_TO_IP, "capture_to_ip"},
+    {LATENCY_IP_TO_TCP, "ip_to_tcp"},
+    {LATENCY_TCP_PROCESS, "tcp_process"},
+    {LATENCY_RECORD_QUEUE, "record_queue"},
+    {LATENCY_SINK_WRITE, "sink_write"},
+    {LATENCY_END_TO_END, "end_to_end"},
+};
+
+typedef struct _metricsLatencyPercentile metricsLatencyPercentile;
+typedef metricsLatencyPercentile *metricsLatencyPercentilePtr;
+
+struct _metricsLatencyPercentile {
+    double percentile;                  /**< Percentile */
+    char *jsonName;                     /**< Percentile name of management response */
+    char *quantile;                     /**< Quantile label of prometheus text */
+};
+
+/* Latency percentiles reported */
+static metricsLatencyPercentile latencyPercentiles [] = {
+    {50.0, "p50_us", "0.5"},
+    {90.0, "p90_us", "0.9"},
+    {99.0, "p99_us", "0.99"},
+    {99.9, "p999_us", "0.999"},
+};
+
+typedef struct _metricsText metricsText;
+typedef metricsText *metricsTextPtr;
+
+struct _metricsText {
+    char *data;                         /**< Text data */
+    u_int len;                          /**< Text length */
+    u_int size;                         /**< Text buffer size */
+};
+
+static int
+metricsTextAppend (metricsTextPtr text, const char *fmt, ...) {
+    int ret;
+    va_list va;
+    u_int size;
+    char *data;
+
+    while (True) {
+        va_start (va, fmt);
+        ret = vsnprintf (text->data + text->len, text->size - text->len, fmt, va);
+        va_end (va);
+        if (ret < 0)
+            return -1;
+
+        if (ret < text->size - text->len) {
+            text->len += ret;
+            return 0;
+        }
+
+        size = text->size * 2;
+        data = (char *) realloc (text->data, size);
+        if (data == NULL)
+            return -1;
+        text->data = data;
+        text->size = size;
+    }
+}
+
+/* Get sum of metric values of all threads */
+static u_long_long
+metricSum (metricId id) {
+    u_int i, num;
+    u_long_long sum = 0;
+
+    num = MIN_NUM (metricsSlotsNum, METRICS_MAX_THREADS);
+    for (i = 0; i < num; i++) {
+        if (metricsSlots [i])
+            sum += metricsSlots [i]->values [id];
+    }
+
+    return sum;
+}
+
+/* Get metric value summed over all threads */
+u_long_long
+getMetricsTotal (metricId id) {
+    return metricSum (id);
+}
+
+/* Get sum of drop counters of all threads */
+static u_long_long
+dropSum (dropReason reason) {
+    u_int i, num;
+    u_long_long sum = 0;
+
+    num = MIN_NUM (metricsSlotsNum, METRICS_MAX_THREADS);
+    for (i = 0; i < num; i++) {
+        if (metricsSlots [i])
+            sum += metricsSlots [i]->drops [reason];
+    }
+
+    return sum;
+}
+
+static long_long
+metricsQueueDepth (metricsQueueDefPtr queue) {
+    return (long_long) (metricSum (queue->enqueued) - metricSum (queue->dequeued));
+}
+
+/* Get latency histogram bucket index of latency */
+static u_int
+latencyBucketIndex (u_long_long latency) {
+    u_int bits, shift;
+
+    if (latency < LATENCY_HISTOGRAM_SUB_BUCKETS)
+        return (u_int) latency;
+
+    bits = 64 - __builtin_clzll (latency);
+    if (bits > LATENCY_HISTOGRAM_MAX_BITS)
+        return LATENCY_HISTOGRAM_BUCKETS - 1;
+
+    shift = bits - LATENCY_HISTOGRAM_SUB_BITS - 1;
+    return ((shift + 1) << LATENCY_HISTOGRAM_SUB_BITS) +
+            (u_int) ((latency >> shift) - LATENCY_HISTOGRAM_SUB_BUCKETS);
+}
+
+/* Get middle latency of latency histogram bucket */
+static u_long_long
+latencyBucketValue (u_int index) {
+    u_int shift, sub;
+    u_long_long lower;
+
+    if (index < LATENCY_HISTOGRAM_SUB_BUCKETS)
+        return index;
+
+    shift = (index >> LATENCY_HISTOGRAM_SUB_BITS) - 1;
+    sub = index & (LATENCY_HISTOGRAM_SUB_BUCKETS - 1);
+    lower = (u_long_long) (LATENCY_HISTOGRAM_SUB_BUCKETS + sub) << shift;
+
+    return lower + (((u_long_long) 1 << shift) >> 1);
+}
+
+/**
+ * @brief Record latency sample to latency histogram of metrics slot,
+ *        only called by owner thread of metrics slot.
+ *
+ * @param slot -- Metrics slot of current thread
+ * @param id -- Latency stage id
+ * @param latency -- Latency in nanoseconds
+ */
+void
+metricsLatencyRecord (metricsSlotPtr slot, latencyId id, u_long_long latency) {
+    latencyHistogramPtr histogram = &slot->latencies [id];
+
+    histogram->count++;
+    histogram->sum += latency;
+    if (latency > histogram->max)
+        histogram->max = latency;
+    histogram->buckets [latencyBucketIndex (latency)]++;
+}
+
+/* Merge latency histograms of all threads */
+static void
+latencyHistogramMerge (latencyId id, latencyHistogramPtr merged) {
+    u_int i, j, num;
+    latencyHistogramPtr histogram;
+
+    memset (merged, 0, sizeof (latencyHistogram));
+    num = MIN_NUM (metricsSlotsNum, METRICS_MAX_THREADS);
+    for (i = 0; i < num; i++) {
+        if (metricsSlots [i] == NULL)
+            continue;
+
+        histogram = &metricsSlots [i]->latencies [id];
+        if (histogram->count == 0)
+            continue;
+
+        merged->count += histogram->count;
+        merged->sum += histogram->sum;
+        if (histogram->max > merged->max)
+            merged->max = histogram->max;
+        for (j = 0; j < LATENCY_HISTOGRAM_BUCKETS; j++)
+            merged->buckets [j] += histogram->buckets [j];
+    }
+}
+
+/* Get percentile latency in nanoseconds of latency histogram */
+static u_long_long
+latencyHistogramPercentile (latencyHistogramPtr histogram, double percentile) {
+    u_int i;
+    u_long_long total = 0, rank;
+
+    rank = (u_long_long) ((double) histogram->count * percentile / 100.0 + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    for (i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        total += histogram->buckets [i];
+        if (total >= rank)
+            return MIN_NUM (latencyBucketValue (i), histogram->max);
+    }
+
+    return histogram->max;
+}
+
+/* Get latency histograms of all threads merged by stage in json */
+static json_t *
+latencyToJson (void) {
+    u_int i, j;
+    latencyHistogram histogram;
+    json_t *latency, *stage;
+
+    latency = json_object ();
+    if (latency == NULL)
+        return NULL;
+
+    for (i = 0; i < LATENCY_MAX; i++) {
+        latencyHistogramMerge (latencyDefs [i].id, &histogram);
+
+        stage = json_object ();
+        if (stage == NULL) {
+            json_object_clear (latency);
+            return NULL;
+        }
+
+        json_object_set_new (stage, "count", json_integer (histogram.count));
+        if (histogram.count) {
+            json_object_set_new (stage, "mean_us",
+                                 json_real ((double) histogram.sum / histogram.count / 1000));
+            for (j = 0; j < TABLE_SIZE (latencyPercentiles); j++)
+                json_object_set_new (stage, latencyPercentiles [j].jsonName,
+                                     json_real ((double) latencyHistogramPercentile (
+                                         &histogram, latencyPercentiles [j].percentile) / 1000));
+            json_object_set_new (stage, "max_us", json_real ((double) histogram.max / 1000));
+        }
+        json_object_set_new (latency, latencyDefs [i].name, stage);
+    }
+
+    return latency;
+}
+
+/**
+ * @brief Get metrics of all threads in json, metrics of each thread
+ *        are grouped by metrics component and metrics with zero value
+ *        are skipped.
+ *
+ * @return Metrics json object if success else NULL
+ */
+json_t *
+metricsToJson (void) {
+    u_int i, j, num;
+    metricsSlotPtr slot;
+    json_t *root, *threads, *thread, *drops, *queues, *latency;
+
+    root = json_object ();
+    if (root == NULL)
+        return NULL;
+
+    threads = json_object ();
+    if (threads == NULL) {
+        json_object_clear (root);
+        return NULL;
+    }
+    json_object_set_new (root, "threads", threads);
+
+    num = MIN_NUM (metricsSlotsNum, METRICS_MAX_THREADS);
+    for (i = 0; i < num; i++) {
+        slot = metricsSlots [i];
+        if (slot == NULL)
+            continue;
+
+        thread = json_object ();
+        if (thread == NULL) {
+            json_object_clear (root);
+            return NULL;
+        }
+
+        for (j = 0; j < METRIC_MAX; j++) {
+            if (slot->values [j])
+                json_object_set_new (thread, metricDefs [j].jsonName,
+                                     json_integer (slot->values [j]));
+        }
+
+        drops = json_object ();
+        if (drops == NULL) {
+            json_object_clear (thread);
+            json_object_clear (root);
+            return NULL;
+        }
+
+        for (j = 0; j < DROP_REASON_MAX; j++) {
+            if (slot->drops [j])
+                json_object_set_new (drops, dropReasonDefs [j].name,
+                                     json_integer (slot->drops [j]));
+        }
+
+        if (json_object_size (drops))
+            json_object_set_new (thread, "drops", drops);
+        else
+            json_decref (drops);
+        json_object_set_new (threads, slot->component, thread);
+    }
+
+    drops = json_object ();
+    if (drops == NULL) {
+        json_object_clear (root);
+        return NULL;
+    }
+    json_object_set_new (root, "drops", drops);
+
+    for (i = 0; i < DROP_REASON_MAX; i++)
+        json_object_set_new (drops, dropReasonDefs [i].name,
+                             json_integer (dropSum (dropReasonDefs [i].reason)));
+
+    queues = json_object ();
+    if (queues == NULL) {
+        json_object_clear (root);
+        return NULL;
+    }
+    json_object_set_new (root, "queues", queues);
+
+    for (i = 0; i < TABLE_SIZE (metricsQueueDefs); i++)
+        json_object_set_new (queues, metricsQueueDefs [i].name,
+                             json_integer (metricsQueueDepth (&metricsQueueDefs [i])));
+
+    latency = latencyToJson ();
+    if (latency == NULL) {
+        json_object_clear (root);
+        return NULL;
+    }
+    json_object_set_new (root, "latency", latency);
+
+    return root;
+}
+
+/**
+ * @brief Get metrics of all threads in prometheus text exposition
+ *        format, every metric has thread label of metrics component.
+ *
+ * @return Metrics text if success else NULL, caller must free it
+ */
+char *
+metricsToPrometheusText (void) {
+    int ret;
+    u_int i, j, num;
+    metricsSlotPtr slot;
+    metricDefPtr def;
+    metricsText text;
+    latencyHistogram histogram;
+
+    text.data = (char *) malloc (METRICS_TEXT_INIT_SIZE);
+    if (text.data == NULL)
+        return NULL;
+    text.len = 0;
+    text.size = METRICS_TEXT_INIT_SIZE;
+    text.data [0] = 0;
+
+    num = MIN_NUM (metricsSlotsNum, METRICS_MAX_THREADS);
+    for (i = 0; i < METRIC_MAX; i++) {
+        def = &metricDefs [i];
+
+        /* Metrics with the same name share help and type info */
+        if (i == 0 || !strEqual (def->name, metricDefs [i - 1].name)) {
+            ret = metricsTextAppend (&text, "# HELP %s %s\n# TYPE %s %s\n",
+                                     def->name, def->help, def->name,
+                                     def->type == METRIC_TYPE_COUNTER ? "counter" : "gauge");
+            if (ret < 0)
+                goto freeText;
+        }
+
+        for (j = 0; j < num; j++) {
+            slot = metricsSlots [j];
+            if (slot == NULL)
+                continue;
+
+            ret = metricsTextAppend (&text, "%s{thread=\"%s\"%s%s} %llu\n",
+                                     def->name, slot->component,
+                                     def->label ? "," : "", def->label ? def->label : "",
+                                     slot->values [i]);
+            if (ret < 0)
+                goto freeText;
+        }
+    }
+
+    ret = metricsTextAppend (&text, "# HELP ntrace_packets_dropped_total Packets dropped by stage.\n"
+                             "# TYPE ntrace_packets_dropped_total counter\n");
+    if (ret < 0)
+        goto freeText;
+
+    for (i = 0; i < DROP_REASON_MAX; i++) {
+        for (j = 0; j < num; j++) {
+            slot = metricsSlots [j];
+            if (slot == NULL)
+                continue;
+
+            ret = metricsTextAppend (&text, "ntrace_packets_dropped_total{thread=\"%s\",reason=\"%s\",category=\"%s\"} %llu\n",
+                                     slot->component, dropReasonDefs [i].name,
+                                     dropCategoryNames [dropReasonDefs [i].category],
+                                     slot->drops [i]);
+            if (ret < 0)
+                goto freeText;
+        }
+    }
+
+    ret = metricsTextAppend (&text, "# HELP ntrace_queue_depth Messages waiting in queue.\n"
+                             "# TYPE ntrace_queue_depth gauge\n");
+    if (ret < 0)
+        goto freeText;
+
+    for (i = 0; i < TABLE_SIZE (metricsQueueDefs); i++) {
+        ret = metricsTextAppend (&text, "ntrace_queue_depth{queue=\"%s\"} %lld\n",
+                                 metricsQueueDefs [i].name,
+                                 metricsQueueDepth (&metricsQueueDefs [i]));
+        if (ret < 0)
+            goto freeText;
+    }
+
+    ret = metricsTextAppend (&text, "# HELP ntrace_stage_latency_seconds Pipeline stage latency.\n"
+                             "# TYPE ntrace_stage_latency_seconds summary\n");
+    if (ret < 0)
+        goto freeText;
+
+    for (i = 0; i < LATENCY_MAX; i++) {
+        latencyHistogramMerge (latencyDefs [i].id, &histogram);
+
+        for (j = 0; j < TABLE_SIZE (latencyPercentiles) && histogram.count; j++) {
+            ret = metricsTextAppend (&text, "ntrace_stage_latency_seconds{stage=\"%s\",quantile=\"%s\"} %.9f\n",
+                                     latencyDefs [i].name, latencyPercentiles [j].quantile,
+                                     (double) latencyHistogramPercentile (
+                                         &histogram, latencyPercentiles [j].percentile) / 1000000000);
+            if (ret < 0)
+                goto freeText;
+        }
+
+        ret = metricsTextAppend (&text,
+                                 "ntrace_stage_latency_seconds_sum{stage=\"%s\"} %.9f\n"
+                                 "ntrace_stage_latency_seconds_count{stage=\"%s\"} %llu\n",
+                                 latencyDefs [i].name, (double) histogram.sum / 1000000000,
+                                 latencyDefs [i].name, histogram.count);
+        if (ret < 0)
+            goto freeText;
+    }
+
+    return text.data;
+
+freeText:
+    free (text.data);
+    return NULL;
+}
+
+/**
+ * @brief Get pipeline health analysis record, it has packet drops of all
+ *        threads by reason and category and queue depths, drops of
+ *        capture, transport and tcp categories tell capture overload,
+ *        transport backpressure and tcp tracking limits apart.
+ *
+ * @param tm -- Analysis record timestamp
+ *
+ * @return Pipeline health analysis record if success else NULL
+ */
+char *
+pipelineHealthAnalysisRecord (timeValPtr tm) {
+    u_int i;
+    u_long_long drop;
+    u_long_long categories [DROP_CATEGORY_MAX];
+    char buf [64];
+    char *out;
+    json_t *root, *drops, *dropCategories, *queues;
+
+    root = json_object ();
+    if (root == NULL) {
+        LOGE ("Create json object error.\n");
+        return NULL;
+    }
+
+    /* Analysis record timestamp */
+    formatLocalTimeStr (tm, buf, sizeof (buf));
+    json_object_set_new (root, ANALYSIS_RECORD_TIMESTAMP,
+                         json_string (buf));
+
+    /* Analysis record type */
+    json_object_set_new (root, ANALYSIS_RECORD_TYPE,
+                         json_string (ANALYSIS_RECORD_TYPE_PIPELINE_HEALTH));
+
+    drops = json_object ();
+    dropCategories = json_object ();
+    queues = json_object ();
+    if (drops == NULL || dropCategories == NULL || queues == NULL) {
+        LOGE ("Create json object error.\n");
+        if (drops)
+            json_decref (drops);
+        if (dropCategories)
+            json_decref (dropCategories);
+        if (queues)
+            json_decref (queues);
+        json_object_clear (root);
+        return NULL;
+    }
+
+    /* Packet drops by reason and category */
+    memset (categories, 0, sizeof (categories));
+    for (i = 0; i < DROP_REASON_MAX; i++) {
+        drop = dropSum (dropReasonDefs [i].reason);
+        categories [dropReasonDefs [i].category] += drop;
+        json_object_set_new (drops, dropReasonDefs [i].name, json_integer (drop));
+    }
+    for (i = 0; i < DROP_CATEGORY_MAX; i++)
+        json_object_set_new (dropCategories, dropCategoryNames [i],
+                             json_integer (categories [i]));
+    json_object_set_new (root, PIPELINE_HEALTH_DROPS, drops);
+    json_object_set_new (root, PIPELINE_HEALTH_DROP_CATEGORIES, dropCategories);
+
+    /* Queue depths */
+    for (i = 0; i < TABLE_SIZE (metricsQueueDefs); i++)
+        json_object_set_new (queues, metricsQueueDefs [i].name,
+                             json_integer (metricsQueueDepth (&metricsQueueDefs [i])));
+    json_object_set_new (root, PIPELINE_HEALTH_QUEUES, queues);
+
+    /* Tcp streams in flow table */
+    json_object_set_new (root, PIPELINE_HEALTH_TCP_STREAMS,
+                         json_integer (metricSum (METRIC_TCP_STREAMS)));
+
+    /* Analysis records dropped */
+    json_object_set_new (root, PIPELINE_HEALTH_RECORDS_DROPPED,
+                         json_integer (metricSum (METRIC_RECORDS_DROPPED)));
+
+    out = json_dumps (root, JSON_COMPACT | JSON_PRESERVE_ORDER);
+    json_object_clear (root);
+
+    return out;
+}
+
+/* Display latency summary of all pipeline stages */
+void
+displayMetricsLatencySummary (void) {
+    u_int i;
+    latencyHistogram histogram;
+
+    LOGI ("\n==Pipeline latency summary (us)==\n");
+    for (i = 0; i < LATENCY_MAX; i++) {
+        latencyHistogramMerge (latencyDefs [i].id, &histogram);
+        if (histogram.count == 0) {
+            LOGI ("--%s: no samples\n", latencyDefs [i].name);
+            continue;
+        }
+
+        LOGI ("--%s: count=%llu, mean=%.3lf, p50=%.3lf, p90=%.3lf, p99=%.3lf, p999=%.3lf, max=%.3lf\n",
+              latencyDefs [i].name, histogram.count,
+              (double) histogram.sum / histogram.count / 1000,
+              (double) latencyHistogramPercentile (&histogram, 50.0) / 1000,
+              (double) latencyHistogramPercentile (&histogram, 90.0) / 1000,
+              (double) latencyHistogramPercentile (&histogram, 99.0) / 1000,
+              (double) latencyHistogramPercentile (&histogram, 99.9) / 1000,
+              (double) histogram.max / 1000);
+    }
+}
+
+/* Get cpu time in nanoseconds of metrics slot owner thread, 0 if thread has exited */
+static u_long_long
+metricsSlotCpuTime (metricsSlotPtr slot) {
+    int ret;
+    struct timespec ts;
+
+    if (!slot->cpuClockValid)
+        return 0;
+
+    ret = clock_gettime (slot->cpuClock, &ts);
+    if (ret < 0)
+        return 0;
+
+    return (u_long_long) ts.tv_sec * 1000000000ULL + (u_long_long) ts.tv_nsec;
+}
+
+/**
+ * @brief Take snapshot of metric values, drop counters and cpu time
+ *        of all threads.
+ *
+ * @param snapshot -- Metrics snapshot to fill
+ */
+void
+metricsTakeSnapshot (metricsSnapshotPtr snapshot) {
+    u_int i, j;
+    metricsSlotPtr slot;
+
+    memset (snapshot, 0, sizeof (metricsSnapshot));
+    snapshot->time = getMonotonicTime ();
+    snapshot->slotsNum = MIN_NUM (metricsSlotsNum, METRICS_MAX_THREADS);
+    for (i = 0; i < snapshot->slotsNum; i++) {
+        slot = metricsSlots [i];
+        if (slot == NULL)
+            continue;
+
+        for (j = 0; j < METRIC_MAX; j++)
+            snapshot->values [i][j] = slot->values [j];
+        for (j = 0; j < DROP_REASON_MAX; j++)
+            snapshot->drops [i][j] = slot->drops [j];
+        snapshot->cpuTimes [i] = metricsSlotCpuTime (slot);
+    }
+}
+
+/* Get delta of metric value of thread between two snapshots */
+static u_long_long
+metricsSnapshotDelta (metricsSnapshotPtr begin, metricsSnapshotPtr end,
+                      u_int index, metricId id) {
+    if (index >= begin->slotsNum)
+        return end->values [index][id];
+
+    return end->values [index][id] - begin->values [index][id];
+}
+
+/**
+ * @brief Display replay benchmark report of interval between two
+ *        snapshots, packets and bytes are counted by metrics slot of
+ *        current thread which is the source of pipeline, flows and
+ *        records are counted by all threads. Cpu utilisation of every
+ *        thread is cpu time used in interval by interval length.
+ *
+ * @param begin -- Metrics snapshot of interval begin
+ * @param end -- Metrics snapshot of interval end
+ */
+void
+displayMetricsBenchReport (metricsSnapshotPtr begin, metricsSnapshotPtr end) {
+    u_int i, j;
+    double interval;
+    u_long_long packets = 0, bytes = 0, flows = 0, records = 0;
+    u_long_long drop, threadDrops, totalDrops = 0;
+    u_long_long beginCpuTime;
+    u_long_long drops [DROP_REASON_MAX];
+    char cpu [32];
+    metricsSlotPtr slot;
+
+    interval = (double) (end->time - begin->time) / 1000000000;
+    if (interval <= 0)
+        return;
+
+    memset (drops, 0, sizeof (drops));
+    for (i = 0; i < end->slotsNum; i++) {
+        if (metricsSlots [i] == metricsSlotInstance) {
+            packets = metricsSnapshotDelta (begin, end, i, METRIC_PACKETS_RECEIVED);
+            bytes = metricsSnapshotDelta (begin, end, i, METRIC_BYTES_RECEIVED);
+        }
+        flows += metricsSnapshotDelta (begin, end, i, METRIC_TCP_STREAMS_ALLOC);
+        records += metricsSnapshotDelta (begin, end, i, METRIC_RECORDS_EMITTED);
+    }
+
+    LOGI ("\n==Replay benchmark report==\n");
+    LOGI ("--duration: %.3lf s\n", interval);
+    LOGI ("--packets: %llu, %.3lf Mpps\n", packets, (double) packets / interval / 1000000);
+    LOGI ("--bytes: %llu, %.3lf MB/s, %.3lf Gbps\n", bytes,
+          (double) bytes / interval / (1024 * 1024),
+          (double) bytes * 8 / interval / 1000000000);
+    LOGI ("--flows: %llu, %.1lf flows/s\n", flows, (double) flows / interval);
+    LOGI ("--records: %llu, %.1lf records/s\n", records, (double) records / interval);
+
+    LOGI ("--stages:\n");
+    for (i = 0; i < end->slotsNum; i++) {
+        slot = metricsSlots [i];
+        if (slot == NULL)
+            continue;
+
+        threadDrops = 0;
+        for (j = 0; j < DROP_REASON_MAX; j++) {
+            drop = end->drops [i][j] - (i < begin->slotsNum ? begin->drops [i][j] : 0);
+            drops [j] += drop;
+            threadDrops += drop;
+        }
+        totalDrops += threadDrops;
+
+        /* Cpu time is unknown if thread exits in interval */
+        beginCpuTime = i < begin->slotsNum ? begin->cpuTimes [i] : 0;
+        if (end->cpuTimes [i] && (beginCpuTime || i >= begin->slotsNum))
+            snprintf (cpu, sizeof (cpu), "%.1lf%%",
+                      (double) (end->cpuTimes [i] - beginCpuTime) / 10000000 / interval);
+        else
+            snprintf (cpu, sizeof (cpu), "n/a");
+
+        LOGI ("----%s: cpu=%s, packets=%.1lf/s, drops=%llu\n", slot->component, cpu,
+              (double) metricsSnapshotDelta (begin, end, i, METRIC_PACKETS_RECEIVED) / interval,
+              threadDrops);
+    }
+
+    LOGI ("--drops: %llu\n", totalDrops);
+    for (i = 0; i < DROP_REASON_MAX; i++) {
+        if (drops [i])
+            LOGI ("----%s(%s): %llu\n", dropReasonDefs [i].name,
+                  dropCategoryNames [dropReasonDefs [i].category], drops [i]);
+    }
+}
+
+/* Get monotonic clock id of current node */
+u_long_long
+getMetricsClockId (void) {
+    return metricsClockId;
+}
+
+/* Find metrics slot of component, must be called with metricsSlotsLock */
+static metricsSlotPtr
+findMetricsSlot (char *component) {
+    u_int i;
+
+    for (i = 0; i < metricsSlotsNum; i++) {
+        if (strEqual (metricsSlots [i]->component, component))
+            return metricsSlots [i];
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Init metrics context of current thread, it will register a
+ *        metrics slot for current thread, slot is kept after thread
+ *        exit so counters are still reported. Slot released by thread
+ *        of the same component is reused, so restarted thread continues
+ *        its counters, component of running thread is suffixed with
+ *        "#n" to keep it unique.
+ *
+ * @param component -- Metrics component format, like "TcpProcessService:3"
+ *
+ * @return 0 if success else -1
+ */
+int
+initMetricsContext (const char *component, ...) {
+    int ret;
+    u_int n;
+    boolean newSlot = False;
+    va_list va;
+    char name [METRICS_COMPONENT_MAX_LENGTH];
+    char uniqueName [METRICS_COMPONENT_MAX_LENGTH];
+    metricsSlotPtr slot;
+
+    va_start (va, component);
+    vsnprintf (name, sizeof (name), component, va);
+    va_end (va);
+
+    pthread_mutex_lock (&metricsSlotsLock);
+
+    snprintf (uniqueName, sizeof (uniqueName), "%s", name);
+    for (n = 2; (slot = findMetricsSlot (uniqueName)) && slot->active; n++)
+        snprintf (uniqueName, sizeof (uniqueName), "%s#%u", name, n);
+
+    if (slot == NULL) {
+        if (metricsSlotsNum >= METRICS_MAX_THREADS) {
+            pthread_mutex_unlock (&metricsSlotsLock);
+            LOGE ("Too many metrics slots.\n");
+            return -1;
+        }
+
+        ret = posix_memalign ((void **) &slot, METRICS_CACHE_LINE_SIZE, sizeof (metricsSlot));
+        if (ret) {
+            pthread_mutex_unlock (&metricsSlotsLock);
+            LOGE ("Alloc metrics slot error.\n");
+            return -1;
+        }
+        memset (slot, 0, sizeof (metricsSlot));
+        snprintf (slot->component, sizeof (slot->component), "%s", uniqueName);
+        newSlot = True;
+    }
+
+    /* Cpu time clock of current thread */
+    if (pthread_getcpuclockid (pthread_self (), &slot->cpuClock) == 0)
+        slot->cpuClockValid = True;
+    else
+        slot->cpuClockValid = False;
+    slot->active = True;
+
+    /* Publish new slot after it has been initialized */
+    if (newSlot) {
+        __sync_synchronize ();
+        metricsSlots [metricsSlotsNum] = slot;
+        __sync_synchronize ();
+        metricsSlotsNum++;
+    }
+    metricsSlotInstance = slot;
+
+    pthread_mutex_unlock (&metricsSlotsLock);
+    return 0;
+}
+
+/* Destroy metrics context of current thread, slot is released for reuse */
+void
+destroyMetricsContext (void) {
+    pthread_mutex_lock (&metricsSlotsLock);
+    /* Cpu time clock is invalid after thread exits */
+    if (metricsSlotInstance) {
+        metricsSlotInstance->cpuClockValid = False;
+        metricsSlotInstance->active = False;
+    }
+    metricsSlotInstance = NULL;
+    pthread_mutex_unlock (&metricsSlotsLock);
+}
+
+/* Init metrics registry */
+int
+initMetrics (void) {
+    u_int i;
+
+    for (i = 0; i < METRICS_MAX_THREADS; i++)
+        metricsSlots [i] = NULL;
+    metricsSlotsNum = 0;
+
+    /* Monotonic timestamps of other nodes are not comparable */
+    metricsClockId = ((getSysTime () << 16) ^ getMonotonicTime () ^ (u_long_long) getpid ()) | 1;
+
+    return 0;
+}
+
+/* Destroy metrics registry, must be called after all threads exit */
+void
+destroyMetrics (void) {
+    u_int i, num;
+
+    num = MIN_NUM (metricsSlotsNum, METRICS_MAX_THREADS);
+    for (i = 0; i < num; i++) {
+        free (metricsSlots [i]);
+        metricsSlots [i] = NULL;
+    }
+    metricsSlotsNum = 0;
+    metricsSlotInstance = NULL;
+}
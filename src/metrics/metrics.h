@@ -0,0 +1,227 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <time.h>
+#include <jansson.h>
+#include "util.h"
+
+#define METRICS_CACHE_LINE_SIZE 64
+#define METRICS_MAX_THREADS 256
+#define METRICS_COMPONENT_MAX_LENGTH 64
+
+/* Pipeline health analysis record json key definitions */
+#define PIPELINE_HEALTH_DROPS "drops"
+#define PIPELINE_HEALTH_DROP_CATEGORIES "drop_categories"
+#define PIPELINE_HEALTH_QUEUES "queues"
+#define PIPELINE_HEALTH_TCP_STREAMS "tcp_streams"
+#define PIPELINE_HEALTH_RECORDS_DROPPED "records_dropped"
+
+typedef enum {
+    METRIC_TYPE_COUNTER,
+    METRIC_TYPE_GAUGE
+} metricType;
+
+/* Metric ids, every thread has its own value of each metric */
+typedef enum {
+    METRIC_PACKETS_RECEIVED,
+    METRIC_BYTES_RECEIVED,
+    METRIC_PACKETS_SENT,
+    METRIC_IP_QUEUE_ENQUEUED,
+    METRIC_IP_QUEUE_DEQUEUED,
+    METRIC_ICMP_QUEUE_ENQUEUED,
+    METRIC_ICMP_QUEUE_DEQUEUED,
+    METRIC_TCP_QUEUE_ENQUEUED,
+    METRIC_TCP_QUEUE_DEQUEUED,
+    METRIC_RECORD_QUEUE_ENQUEUED,
+    METRIC_RECORD_QUEUE_DEQUEUED,
+    METRIC_IP_FRAGMENT_QUEUES,
+    METRIC_DEDUP_PACKETS_CHECKED,
+    METRIC_DEDUP_PACKETS_DUPLICATED,
+    METRIC_DEDUP_ENTRIES_EVICTED,
+    METRIC_TCP_STREAMS,
+    METRIC_TCP_STREAMS_ALLOC,
+    METRIC_TCP_STREAMS_FREE,
+    METRIC_TCP_RECEIVE_BUFFER_BYTES,
+    METRIC_RECORDS_PUBLISHED,
+    METRIC_RECORDS_DROPPED,
+    METRIC_RECORDS_EMITTED,
+    METRIC_MAX
+} metricId;
+
+/* Packet drop reasons, every thread has its own counter of each reason */
+typedef enum {
+    DROP_REASON_INCOMPLETE,             /**< Packet truncated by capture */
+    DROP_REASON_NOT_IP,                 /**< Not ip packet or bad link layer */
+    DROP_REASON_IP_HEADER,              /**< Invalid ip header */
+    DROP_REASON_IP_FILTERED,            /**< Ip packet of unmonitored service */
+    DROP_REASON_IP_DEFRAG,              /**< Ip defragment error */
+    DROP_REASON_TCP_INVALID,            /**< Invalid tcp header or checksum */
+    DROP_REASON_TCP_NO_SYN,             /**< Tcp packet of unknown flow without syn */
+    DROP_REASON_TCP_RETRANSMITTED,      /**< Tcp retransmitted packet */
+    DROP_REASON_TCP_OUT_OF_WINDOW,      /**< Tcp packet out of receive window */
+    DROP_REASON_TCP_PAWS,               /**< Tcp packet rejected by PAWS */
+    DROP_REASON_TCP_RCV_BUF_OVERFLOW,   /**< Tcp receive buffer overflow */
+    DROP_REASON_NO_MEMORY,              /**< Alloc memory error */
+    DROP_REASON_SEND,                   /**< Send to next stage error, backpressure */
+    DROP_REASON_MAX
+} dropReason;
+
+/* Drop reason categories */
+typedef enum {
+    DROP_CATEGORY_CAPTURE,              /**< Capture overload or bad traffic */
+    DROP_CATEGORY_IP,                   /**< Ip layer check and defragment */
+    DROP_CATEGORY_TCP,                  /**< Tcp tracking limits */
+    DROP_CATEGORY_RESOURCE,             /**< Memory and buffer limits */
+    DROP_CATEGORY_TRANSPORT,            /**< Inter-thread transport backpressure */
+    DROP_CATEGORY_MAX
+} dropCategory;
+
+/* Latency stage ids, every thread has its own histogram of each stage */
+typedef enum {
+    LATENCY_CAPTURE_TO_IP,
+    LATENCY_IP_TO_TCP,
+    LATENCY_TCP_PROCESS,
+    LATENCY_RECORD_QUEUE,
+    LATENCY_SINK_WRITE,
+    LATENCY_END_TO_END,
+    LATENCY_MAX
+} latencyId;
+
+/*
+ * Log-linear latency histogram in nanoseconds, every power of 2 range is
+ * split into 2^LATENCY_HISTOGRAM_SUB_BITS linear sub buckets, so relative
+ * error of percentiles is below 1/2^LATENCY_HISTOGRAM_SUB_BITS.
+ */
+#define LATENCY_HISTOGRAM_SUB_BITS 4
+#define LATENCY_HISTOGRAM_SUB_BUCKETS (1 << LATENCY_HISTOGRAM_SUB_BITS)
+#define LATENCY_HISTOGRAM_MAX_BITS 46
+#define LATENCY_HISTOGRAM_BUCKETS                                       \
+    ((LATENCY_HISTOGRAM_MAX_BITS - LATENCY_HISTOGRAM_SUB_BITS + 1) *    \
+     LATENCY_HISTOGRAM_SUB_BUCKETS)
+
+typedef struct _latencyHistogram latencyHistogram;
+typedef latencyHistogram *latencyHistogramPtr;
+
+struct _latencyHistogram {
+    volatile u_long_long count;         /**< Latency samples count */
+    volatile u_long_long sum;           /**< Latency samples sum */
+    volatile u_long_long max;           /**< Max latency sample */
+    volatile u_long_long buckets [LATENCY_HISTOGRAM_BUCKETS]; /**< Histogram buckets */
+};
+
+typedef struct _metricDef metricDef;
+typedef metricDef *metricDefPtr;
+
+struct _metricDef {
+    metricId id;                        /**< Metric id */
+    metricType type;                    /**< Metric type */
+    char *name;                         /**< Metric name of prometheus text */
+    char *label;                        /**< Metric extra label of prometheus text */
+    char *jsonName;                     /**< Metric name of management response */
+    char *help;                         /**< Metric help info */
+};
+
+typedef struct _metricsSlot metricsSlot;
+typedef metricsSlot *metricsSlotPtr;
+
+/*
+ * Metrics slot of one thread, written by owner thread only without lock
+ * and read by management service, every slot is cache line aligned so
+ * slots of different threads never share cache line.
+ */
+struct _metricsSlot {
+    volatile u_long_long values [METRIC_MAX]; /**< Metric values */
+    volatile u_long_long drops [DROP_REASON_MAX]; /**< Packet drop counters */
+    latencyHistogram latencies [LATENCY_MAX]; /**< Latency histograms */
+    char component [METRICS_COMPONENT_MAX_LENGTH]; /**< Metrics component */
+    clockid_t cpuClock;                 /**< Cpu time clock of owner thread */
+    volatile boolean cpuClockValid;     /**< Cpu time clock is valid until owner thread exits */
+    boolean active;                     /**< Slot is owned by a running thread */
+} __attribute__ ((aligned (METRICS_CACHE_LINE_SIZE)));
+
+typedef struct _metricsSnapshot metricsSnapshot;
+typedef metricsSnapshot *metricsSnapshotPtr;
+
+/* Metrics snapshot of all threads, used to compute rates of an interval */
+struct _metricsSnapshot {
+    u_long_long time;                   /**< Monotonic time of snapshot */
+    u_int slotsNum;                     /**< Metrics slots number */
+    u_long_long values [METRICS_MAX_THREADS][METRIC_MAX]; /**< Metric values of each thread */
+    u_long_long drops [METRICS_MAX_THREADS][DROP_REASON_MAX]; /**< Drop counters of each thread */
+    u_long_long cpuTimes [METRICS_MAX_THREADS]; /**< Cpu time of each thread */
+};
+
+/* Thread local metrics slot */
+extern __thread metricsSlotPtr metricsSlotInstance;
+
+#define METRICS_COUNTER_ADD(id, n) do {                 \
+        if (metricsSlotInstance)                        \
+            metricsSlotInstance->values [id] += (n);    \
+    } while (0)
+
+#define METRICS_COUNTER_INC(id) METRICS_COUNTER_ADD (id, 1)
+
+#define METRICS_GAUGE_ADD(id, n) METRICS_COUNTER_ADD (id, n)
+
+#define METRICS_GAUGE_SUB(id, n) do {                   \
+        if (metricsSlotInstance)                        \
+            metricsSlotInstance->values [id] -= (n);    \
+    } while (0)
+
+#define METRICS_GAUGE_SET(id, v) do {                   \
+        if (metricsSlotInstance)                        \
+            metricsSlotInstance->values [id] = (v);     \
+    } while (0)
+
+/* Count packet dropped for reason */
+#define METRICS_DROP(reason) do {                       \
+        if (metricsSlotInstance)                        \
+            metricsSlotInstance->drops [reason]++;      \
+    } while (0)
+
+/* Record latency sample in nanoseconds */
+#define METRICS_LATENCY_RECORD(id, latency) do {                \
+        if (metricsSlotInstance)                                \
+            metricsLatencyRecord (metricsSlotInstance, id, latency); \
+    } while (0)
+
+/* Record latency sample from monotonic timestamp to now */
+#define METRICS_LATENCY_RECORD_SINCE(id, since) do {            \
+        u_long_long now_;                                       \
+        if (metricsSlotInstance && (since)) {                   \
+            now_ = getMonotonicTime ();                         \
+            if (now_ >= (since))                                \
+                metricsLatencyRecord (metricsSlotInstance, id, now_ - (since)); \
+        }                                                       \
+    } while (0)
+
+/*========================Interfaces definition============================*/
+void
+metricsLatencyRecord (metricsSlotPtr slot, latencyId id, u_long_long latency);
+u_long_long
+getMetricsClockId (void);
+u_long_long
+getMetricsTotal (metricId id);
+void
+displayMetricsLatencySummary (void);
+void
+metricsTakeSnapshot (metricsSnapshotPtr snapshot);
+void
+displayMetricsBenchReport (metricsSnapshotPtr begin, metricsSnapshotPtr end);
+json_t *
+metricsToJson (void);
+char *
+pipelineHealthAnalysisRecord (timeValPtr tm);
+char *
+metricsToPrometheusText (void);
+int
+initMetricsContext (const char *component, ...);
+void
+destroyMetricsContext (void);
+int
+initMetrics (void);
+void
+destroyMetrics (void);
+/*=======================Interfaces definition end=========================*/
+
+#endif /* __METRICS_H__ */
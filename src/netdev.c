@@ -1,6 +1,20 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
 #include <net/if.h>
 #include <pcap.h>
 #include "log.h"
+#include "signals.h"
 #include "properties.h"
 #include "netdev.h"
 
@@ -10,15 +24,49 @@
 #define PCAP_CAPTURE_IN_PROMISC 1
 #define PCAP_CAPTURE_BUFFER_SIZE (32 << 20)
 
-/* Pcap descriptor for sniff */
-static pcap_t *pcapDescForSniff = NULL;
-/* Datalink type for sniff */
-static int datalinkTypeForSniff = -1;
+/* Pcap file name of stdin */
+#define PCAP_STDIN_FILE "-"
 
-/* Pcap descriptor for proto detection */
-static pcap_t *pcapDescForProtoDection = NULL;
-/* Datalink type for proto detection */
-static int datalinkTypeForProtoDetection = -1;
+/* Inotify events buffer size of pcap directory */
+#define PCAP_SEGMENT_EVENTS_BUFFER_SIZE 4096
+/* Seconds without modification after which the newest segment is ready */
+#define PCAP_SEGMENT_QUIESCENT_TIME 60
+
+typedef struct _pcapSegmentDir pcapSegmentDir;
+typedef pcapSegmentDir *pcapSegmentDirPtr;
+
+/* Pcap segments directory follower */
+struct _pcapSegmentDir {
+    int inotifyFd;                      /**< Inotify fd of pcap directory */
+    char lastSegment [NAME_MAX + 1];    /**< Last segment ingested */
+    char closedSegment [NAME_MAX + 1];  /**< Newest segment closed by writer */
+};
+
+/* Stream input flag, pcap directory, fifo or stdin */
+static boolean netDevStreamInput = False;
+
+typedef struct _netDev netDev;
+typedef netDev *netDevPtr;
+
+/* Net device of one input, network interface or offline input */
+struct _netDev {
+    char *interface;                    /**< Network interface, NULL for offline input */
+    pcap_t *pcapDescForSniff;           /**< Pcap descriptor for sniff */
+    int datalinkTypeForSniff;           /**< Datalink type for sniff */
+    pcap_t *pcapDescForProtoDetection;  /**< Pcap descriptor for proto detection */
+    int datalinkTypeForProtoDetection;  /**< Datalink type for proto detection */
+};
+
+/* Pcap descriptors lock for sniff */
+static pthread_mutex_t pcapDescForSniffLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Net devices, one for every network interface */
+static netDevPtr netDevs = NULL;
+static u_int netDevsNum = 0;
+
+/* Pcap directory followers for sniff and proto detection */
+static pcapSegmentDir segmentDirForSniff = {-1, "", ""};
+static pcapSegmentDir segmentDirForProtoDetection = {-1, "", ""};
 
 /**
  * @brief Create a pcap descriptor from pcap file.
@@ -125,28 +173,210 @@ newPcapInterfaceDesc (char *interface) {
     return pcapDesc;
 }
 
+/* Pcap directory entry filter, hidden files are in progress or temporary */
+static int
+pcapSegmentFilter (const struct dirent *entry) {
+    return entry->d_name [0] != '.';
+}
+
+/**
+ * @brief Read pending inotify events of pcap directory and record the
+ *        newest segment closed by writer.
+ *
+ * @param segDir -- pcap directory follower
+ */
+static void
+readPcapSegmentEvents (pcapSegmentDirPtr segDir) {
+    ssize_t len;
+    char *ptr;
+    struct inotify_event *event;
+    char buf [PCAP_SEGMENT_EVENTS_BUFFER_SIZE]
+            __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+
+    while ((len = read (segDir->inotifyFd, buf, sizeof (buf))) > 0) {
+        for (ptr = buf; ptr < buf + len;
+             ptr += sizeof (struct inotify_event) + event->len) {
+            event = (struct inotify_event *) ptr;
+            if (event->len && event->name [0] != '.' &&
+                (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) &&
+                strverscmp (event->name, segDir->closedSegment) > 0)
+                snprintf (segDir->closedSegment, sizeof (segDir->closedSegment),
+                          "%s", event->name);
+        }
+    }
+}
+
+/* Whether segment has not been modified for PCAP_SEGMENT_QUIESCENT_TIME */
+static boolean
+pcapSegmentQuiescent (char *segment) {
+    int ret;
+    struct stat st;
+    char segmentPath [PATH_MAX];
+
+    snprintf (segmentPath, sizeof (segmentPath), "%s/%s", getPropertiesPcapDir (), segment);
+    ret = stat (segmentPath, &st);
+    if (ret < 0)
+        return False;
+
+    return time (NULL) - st.st_mtime >= PCAP_SEGMENT_QUIESCENT_TIME ? True : False;
+}
+
+/**
+ * @brief Get next segment of pcap directory ready to ingest. Segments
+ *        are ordered by name in version order, a segment is ready if it
+ *        has been closed by writer or a newer segment has been created.
+ *        The newest segment closed before pcap directory is watched has
+ *        no close event, it is ready if it has not been modified for
+ *        PCAP_SEGMENT_QUIESCENT_TIME.
+ *
+ * @param segDir -- pcap directory follower
+ * @param segment -- buffer to return segment name
+ * @param segmentLen -- segment buffer length
+ *
+ * @return 1 if ready segment found, 0 if not found, -1 on error
+ */
+static int
+getNextPcapSegment (pcapSegmentDirPtr segDir, char *segment, u_int segmentLen) {
+    int i, n, next;
+    int ret = 0;
+    struct dirent **entries;
+
+    n = scandir (getPropertiesPcapDir (), &entries, pcapSegmentFilter, versionsort);
+    if (n < 0) {
+        LOGE ("Scan pcap directory %s error: %s.\n",
+              getPropertiesPcapDir (), strerror (errno));
+        return -1;
+    }
+
+    for (next = 0; next < n; next++) {
+        if (strverscmp (entries [next]->d_name, segDir->lastSegment) > 0)
+            break;
+    }
+
+    if (next < n &&
+        (next < n - 1 ||
+         (segDir->closedSegment [0] &&
+          strverscmp (entries [next]->d_name, segDir->closedSegment) <= 0) ||
+         pcapSegmentQuiescent (entries [next]->d_name))) {
+        snprintf (segment, segmentLen, "%s", entries [next]->d_name);
+        ret = 1;
+    }
+
+    for (i = 0; i < n; i++)
+        free (entries [i]);
+    free (entries);
+
+    return ret;
+}
+
+/**
+ * @brief Create a pcap descriptor from next segment of pcap directory,
+ *        it will wait until next segment is ready or task is stopped.
+ *
+ * @param segDir -- pcap directory follower
+ *
+ * @return pcap descriptor, NULL if error or task is stopped
+ */
+static pcap_t *
+newPcapSegmentDesc (pcapSegmentDirPtr segDir) {
+    int ret;
+    pcap_t *pcapDesc;
+    struct pollfd pfd;
+    char segment [NAME_MAX + 1];
+    char segmentPath [PATH_MAX];
+
+    /* Init inotify of pcap directory */
+    if (segDir->inotifyFd < 0) {
+        segDir->inotifyFd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+        if (segDir->inotifyFd < 0) {
+            LOGE ("Init inotify error: %s.\n", strerror (errno));
+            return NULL;
+        }
+
+        ret = inotify_add_watch (segDir->inotifyFd, getPropertiesPcapDir (),
+                                 IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (ret < 0) {
+            LOGE ("Watch pcap directory %s error: %s.\n",
+                  getPropertiesPcapDir (), strerror (errno));
+            close (segDir->inotifyFd);
+            segDir->inotifyFd = -1;
+            return NULL;
+        }
+    }
+
+    while (!taskShouldExit ()) {
+        readPcapSegmentEvents (segDir);
+
+        ret = getNextPcapSegment (segDir, segment, sizeof (segment));
+        if (ret < 0)
+            return NULL;
+
+        if (ret) {
+            snprintf (segDir->lastSegment, sizeof (segDir->lastSegment), "%s", segment);
+            snprintf (segmentPath, sizeof (segmentPath), "%s/%s",
+                      getPropertiesPcapDir (), segment);
+            pcapDesc = newPcapFileDesc (segmentPath);
+            if (pcapDesc) {
+                LOGI ("Ingest pcap segment: %s.\n", segmentPath);
+                return pcapDesc;
+            }
+
+            LOGE ("Skip pcap segment: %s.\n", segmentPath);
+            continue;
+        }
+
+        /* Wait for pcap directory events */
+        pfd.fd = segDir->inotifyFd;
+        pfd.events = POLLIN;
+        poll (&pfd, 1, PCAP_CAPTURE_TIMEOUT);
+    }
+
+    return NULL;
+}
+
+/* Destroy pcap directory follower */
+static void
+destroyPcapSegmentDir (pcapSegmentDirPtr segDir) {
+    if (segDir->inotifyFd >= 0) {
+        close (segDir->inotifyFd);
+        segDir->inotifyFd = -1;
+    }
+}
+
+/* Get netDev stream input flag */
+boolean
+getNetDevStreamInput (void) {
+    return netDevStreamInput;
+}
+
+/* Get netDev number */
+u_int
+getNetDevNum (void) {
+    return netDevsNum;
+}
+
 /* Get netDev descriptor for sniff */
 pcap_t *
-getNetDevPcapDescForSniff (void) {
-    return pcapDescForSniff;
+getNetDevPcapDescForSniff (u_int index) {
+    return netDevs [index].pcapDescForSniff;
 }
 
 /* Get netDev descriptor for proto detection */
 pcap_t *
-getNetDevPcapDescForProtoDetection (void) {
-    return pcapDescForProtoDection;
+getNetDevPcapDescForProtoDetection (u_int index) {
+    return netDevs [index].pcapDescForProtoDetection;
 }
 
 /* Get netDev data link type for sniff */
 int
-getNetDevDatalinkTypeForSniff (void) {
-    return datalinkTypeForSniff;
+getNetDevDatalinkTypeForSniff (u_int index) {
+    return netDevs [index].datalinkTypeForSniff;
 }
 
 /* Get netDev data link type for proto detection */
 int
-getNetDevDatalinkTypeForProtoDetection (void) {
-    return datalinkTypeForProtoDetection;
+getNetDevDatalinkTypeForProtoDetection (u_int index) {
+    return netDevs [index].datalinkTypeForProtoDetection;
 }
 
 /**
@@ -163,6 +393,9 @@ getPcapStatisticInfo (pcap_t *pcapDev, u_int *pktsRecv, u_int *pktsDrop) {
     int ret;
     struct pcap_stat ps;
 
+    if (pcapDev == NULL)
+        return -1;
+
     ret = pcap_stats (pcapDev, &ps);
     if (ret < 0)
         return -1;
@@ -172,36 +405,64 @@ getPcapStatisticInfo (pcap_t *pcapDev, u_int *pktsRecv, u_int *pktsDrop) {
     return 0;
 }
 
-/* Get netDev statistic info for sniff */
+/* Get netDev statistic info for sniff, summed over all network interfaces */
 int
 getNetDevStatisticInfoForSniff (u_int *pktsRecv, u_int *pktsDrop) {
-    return getPcapStatisticInfo (pcapDescForSniff, pktsRecv, pktsDrop);
+    int ret = 0;
+    u_int i, recv, drop;
+
+    *pktsRecv = 0;
+    *pktsDrop = 0;
+    pthread_mutex_lock (&pcapDescForSniffLock);
+    for (i = 0; i < netDevsNum; i++) {
+        if (getPcapStatisticInfo (netDevs [i].pcapDescForSniff, &recv, &drop) < 0) {
+            ret = -1;
+            break;
+        }
+        *pktsRecv += recv;
+        *pktsDrop += drop;
+    }
+    pthread_mutex_unlock (&pcapDescForSniffLock);
+
+    return ret;
 }
 
-/* Get netDev statistic info for proto detection */
+/* Get netDev statistic info for proto detection, summed over all network interfaces */
 int
 getNetDevStatisticInfoForProtoDetection (u_int *pktsRecv, u_int *pktsDrop) {
-    return getPcapStatisticInfo (pcapDescForProtoDection, pktsRecv, pktsDrop);
+    u_int i, recv, drop;
+
+    *pktsRecv = 0;
+    *pktsDrop = 0;
+    for (i = 0; i < netDevsNum; i++) {
+        if (getPcapStatisticInfo (netDevs [i].pcapDescForProtoDetection, &recv, &drop) < 0)
+            return -1;
+        *pktsRecv += recv;
+        *pktsDrop += drop;
+    }
+
+    return 0;
 }
 
 /**
  * @brief Update pcapDev BPF filter.
  *
  * @param pcapDev -- pcap descriptor
+ * @param interface -- network interface of pcapDev, NULL for offline input
  * @param filter -- BPF filter to update
  *
  * @return 0 if success else -1
  */
 static int
-updatePcapFilter (pcap_t *pcapDev, char *filter) {
+updatePcapFilter (pcap_t *pcapDev, char *interface, char *filter) {
     int ret;
     bpf_u_int32 net;
     bpf_u_int32 mask;
     struct bpf_program pcapFilter;
     char errBuf [PCAP_ERRBUF_SIZE] = {0};
 
-    if (getPropertiesSniffLive ()) {
-        ret = pcap_lookupnet (getPropertiesInterface (), &net, &mask, errBuf);
+    if (interface) {
+        ret = pcap_lookupnet (interface, &net, &mask, errBuf);
         if (ret < 0) {
             LOGE ("Pcap lookup net error.\n");
             return -1;
@@ -220,90 +481,249 @@ updatePcapFilter (pcap_t *pcapDev, char *filter) {
     return ret;
 }
 
-/* Update netDev BPF filter for sniff */
+/* Update netDev BPF filter for sniff of all network interfaces */
 int
 updateNetDevFilterForSniff (char *filter) {
-    return updatePcapFilter (pcapDescForSniff, filter);
+    int ret = 0;
+    u_int i;
+
+    /* Filter of stream input will be set after pcap descriptor is opened */
+    pthread_mutex_lock (&pcapDescForSniffLock);
+    for (i = 0; i < netDevsNum && ret == 0; i++) {
+        if (netDevs [i].pcapDescForSniff)
+            ret = updatePcapFilter (netDevs [i].pcapDescForSniff,
+                                    netDevs [i].interface, filter);
+    }
+    pthread_mutex_unlock (&pcapDescForSniffLock);
+
+    return ret;
 }
 
-/* Update netDev BPF filter for proto detection */
+/* Update netDev BPF filter for proto detection of all network interfaces */
 int
 updateNetDevFilterForProtoDetection (char *filter) {
-    return updatePcapFilter (pcapDescForProtoDection, filter);
+    int ret = 0;
+    u_int i;
+
+    for (i = 0; i < netDevsNum && ret == 0; i++) {
+        if (netDevs [i].pcapDescForProtoDetection)
+            ret = updatePcapFilter (netDevs [i].pcapDescForProtoDetection,
+                                    netDevs [i].interface, filter);
+    }
+
+    return ret;
 }
 
 /**
- * @brief Reset netDev for sniff, only for pcap file.
+ * @brief Reset netDev for sniff. For pcap directory, it will open next
+ *        segment of directory, for stdin input, it will be complete
+ *        after stdin has been read.
+ *
+ * @param index -- netDev index
  *
  * @return 0 for success, -1 for error, 1 for complete
  */
 int
-resetNetDevForSniff (void) {
-    pcap_t * tmp;
-
-    if (getPropertiesSniffLive ())
-        tmp = newPcapInterfaceDesc (getPropertiesInterface ());
+resetNetDevForSniff (u_int index) {
+    pcap_t *tmp;
+    netDevPtr dev = &netDevs [index];
+
+    if (dev->interface)
+        tmp = newPcapInterfaceDesc (dev->interface);
+    else if (getPropertiesPcapDir ())
+        tmp = newPcapSegmentDesc (&segmentDirForSniff);
+    else if (strEqual (getPropertiesPcapFile (), PCAP_STDIN_FILE) && dev->pcapDescForSniff)
+        return 1;
     else
         tmp = newPcapFileDesc (getPropertiesPcapFile ());
     if (tmp == NULL) {
-        LOGE ("Create pcap descriptor for %s error.\n",
-              getPropertiesSniffLive () ? getPropertiesInterface () : getPropertiesPcapFile ());
+        if (!taskShouldExit ())
+            LOGE ("Create pcap descriptor for %s error.\n",
+                  dev->interface ? dev->interface :
+                  getPropertiesPcapDir () ? getPropertiesPcapDir () : getPropertiesPcapFile ());
         return -1;
     }
 
-    if (pcapDescForSniff)
-        pcap_close (pcapDescForSniff);
+    pthread_mutex_lock (&pcapDescForSniffLock);
+    if (dev->pcapDescForSniff)
+        pcap_close (dev->pcapDescForSniff);
+    dev->pcapDescForSniff = tmp;
+    dev->datalinkTypeForSniff = pcap_datalink (tmp);
+    pthread_mutex_unlock (&pcapDescForSniffLock);
+
+    return 0;
+}
+
+/**
+ * @brief Reset netDev for proto detection, only for pcap directory, it
+ *        will open next segment of directory.
+ *
+ * @return 0 for success, -1 for error, 1 for complete
+ */
+int
+resetNetDevForProtoDetection (void) {
+    pcap_t *tmp;
+
+    if (getPropertiesPcapDir () == NULL)
+        return 1;
+
+    tmp = newPcapSegmentDesc (&segmentDirForProtoDetection);
+    if (tmp == NULL) {
+        if (!taskShouldExit ())
+            LOGE ("Create pcap descriptor for %s error.\n", getPropertiesPcapDir ());
+        return -1;
+    }
+
+    if (netDevs [0].pcapDescForProtoDetection)
+        pcap_close (netDevs [0].pcapDescForProtoDetection);
+    netDevs [0].pcapDescForProtoDetection = tmp;
+    netDevs [0].datalinkTypeForProtoDetection = pcap_datalink (tmp);
+
+    return 0;
+}
+
+/**
+ * @brief Check whether pcap input is stream input, includes pcap
+ *        directory of rotating segments, fifo and stdin.
+ *
+ * @return True if stream input else False
+ */
+static boolean
+pcapStreamInput (void) {
+    struct stat st;
+
+    if (getPropertiesPcapDir ())
+        return True;
+
+    if (getPropertiesPcapFile () == NULL)
+        return False;
+
+    if (strEqual (getPropertiesPcapFile (), PCAP_STDIN_FILE))
+        return True;
+
+    if (stat (getPropertiesPcapFile (), &st) == 0 && S_ISFIFO (st.st_mode))
+        return True;
+
+    return False;
+}
+
+/* Close pcap descriptors of all netDevs */
+static void
+closeNetDevs (void) {
+    u_int i;
+
+    for (i = 0; i < netDevsNum; i++) {
+        if (netDevs [i].pcapDescForSniff) {
+            pcap_close (netDevs [i].pcapDescForSniff);
+            netDevs [i].pcapDescForSniff = NULL;
+        }
+
+        if (netDevs [i].pcapDescForProtoDetection) {
+            pcap_close (netDevs [i].pcapDescForProtoDetection);
+            netDevs [i].pcapDescForProtoDetection = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Init netDev of network interface for sniff and proto detection,
+ *        if there are multiple interfaces, pcap descriptor for proto
+ *        detection is set to nonblock, so proto detection could read
+ *        all interfaces in turn.
+ *
+ * @param dev -- netDev to init
+ *
+ * @return 0 if success else -1
+ */
+static int
+initNetDevInterface (netDevPtr dev) {
+    int ret;
+    char errBuf [PCAP_ERRBUF_SIZE] = {0};
+
+    dev->pcapDescForSniff = newPcapInterfaceDesc (dev->interface);
+    if (dev->pcapDescForSniff == NULL) {
+        LOGE ("Open interface: %s for sniff error.\n", dev->interface);
+        return -1;
+    } else
+        LOGI ("Use interface: %s as input for sniff.\n", dev->interface);
+
+    dev->pcapDescForProtoDetection = newPcapInterfaceDesc (dev->interface);
+    if (dev->pcapDescForProtoDetection == NULL) {
+        LOGE ("Open interface: %s for proto detection error.\n", dev->interface);
+        return -1;
+    } else
+        LOGI ("Use interface: %s as input for proto detection.\n", dev->interface);
+
+    if (netDevsNum > 1) {
+        ret = pcap_setnonblock (dev->pcapDescForProtoDetection, 1, errBuf);
+        if (ret < 0) {
+            LOGE ("Set interface: %s for proto detection nonblock error: %s.\n",
+                  dev->interface, errBuf);
+            return -1;
+        }
+    }
 
-    pcapDescForSniff = tmp;
     return 0;
 }
 
 /**
  * @brief Init netDev.
  *        Init netDev for sniff and proto detection from pcap file
- *        or network interface, if pcap file is configured, it will
- *        create a pcap file descriptor, else if will create a network
- *        Interface descriptor.
+ *        or network interfaces, if pcap file is configured, it will
+ *        create a pcap file descriptor, else it will create network
+ *        Interface descriptors, one netDev for every interface. For
+ *        stream input, pcap descriptors will be opened by capture
+ *        services since opening will block until data is ready.
  *
  * @return 0 if success else -1
  */
 int
 initNetDev (void) {
-    if (getPropertiesSniffLive ()) {
-        pcapDescForSniff = newPcapInterfaceDesc (getPropertiesInterface ());
-        if (pcapDescForSniff == NULL) {
-            LOGE ("Open interface: %s for sniff error.\n",
-                  getPropertiesInterface ());
-            return -1;
-        } else
-            LOGI ("Use interface: %s as input for sniff.\n",
-                  getPropertiesInterface ());
-
-        pcapDescForProtoDection = newPcapInterfaceDesc (getPropertiesInterface ());
-        if (pcapDescForProtoDection == NULL) {
-            pcap_close (pcapDescForSniff);
-            pcapDescForSniff = NULL;
-            LOGE ("Open interface: %s for proto detection error.\n",
-                  getPropertiesInterface ());
-            return -1;
-        } else
-            LOGI ("Use interface: %s as input for proto detection.\n",
-                  getPropertiesInterface ());
+    int ret;
+    u_int i;
+
+    netDevStreamInput = pcapStreamInput ();
+    netDevsNum = getPropertiesSniffLive () ? getPropertiesInterfacesNum () : 1;
+
+    netDevs = (netDevPtr) calloc (netDevsNum, sizeof (netDev));
+    if (netDevs == NULL) {
+        LOGE ("Alloc netDevs error.\n");
+        netDevsNum = 0;
+        return -1;
+    }
+    for (i = 0; i < netDevsNum; i++) {
+        netDevs [i].datalinkTypeForSniff = -1;
+        netDevs [i].datalinkTypeForProtoDetection = -1;
+    }
+
+    if (netDevStreamInput) {
+        if (getPropertiesPcapDir ())
+            LOGI ("Use pcap directory: %s as stream input.\n",
+                  getPropertiesPcapDir ());
+        else
+            LOGI ("Use pcap pipe: %s as stream input.\n",
+                  getPropertiesPcapFile ());
+        return 0;
+    } else if (getPropertiesSniffLive ()) {
+        for (i = 0; i < netDevsNum; i++) {
+            netDevs [i].interface = getPropertiesInterfaces () [i];
+            ret = initNetDevInterface (&netDevs [i]);
+            if (ret < 0)
+                goto destroyNetDev;
+        }
     } else {
-        pcapDescForSniff = newPcapFileDesc (getPropertiesPcapFile ());
-        if (pcapDescForSniff == NULL) {
+        netDevs [0].pcapDescForSniff = newPcapFileDesc (getPropertiesPcapFile ());
+        if (netDevs [0].pcapDescForSniff == NULL) {
             LOGE ("Open pcap file for sniff error.\n");
-            return -1;
+            goto destroyNetDev;
         } else
             LOGI ("Use pcap file: %s as input for sniff.\n",
                   getPropertiesPcapFile ());
 
-        pcapDescForProtoDection = newPcapFileDesc (getPropertiesPcapFile ());
-        if (pcapDescForProtoDection == NULL) {
-            pcap_close (pcapDescForSniff);
-            pcapDescForSniff = NULL;
+        netDevs [0].pcapDescForProtoDetection = newPcapFileDesc (getPropertiesPcapFile ());
+        if (netDevs [0].pcapDescForProtoDetection == NULL) {
             LOGE ("Open pcap file for proto detection error.\n");
-            return -1;
+            goto destroyNetDev;
         } else {
             LOGI ("Use pcap file: %s as input for proto detection.\n",
                   getPropertiesPcapFile ());
@@ -311,33 +731,33 @@ initNetDev (void) {
     }
 
     /* Get datalink type for sniff and proto detection */
-    datalinkTypeForSniff = pcap_datalink (pcapDescForSniff);
-    datalinkTypeForProtoDetection = pcap_datalink (pcapDescForProtoDection);
-
-    if (datalinkTypeForSniff < 0 ||
-        datalinkTypeForProtoDetection < 0) {
-        LOGE ("Get datalink type error.\n");
-
-        pcap_close (pcapDescForSniff);
-        pcapDescForSniff = NULL;
-        pcap_close (pcapDescForProtoDection);
-        pcapDescForProtoDection = NULL;
-        return -1;
+    for (i = 0; i < netDevsNum; i++) {
+        netDevs [i].datalinkTypeForSniff = pcap_datalink (netDevs [i].pcapDescForSniff);
+        netDevs [i].datalinkTypeForProtoDetection =
+                pcap_datalink (netDevs [i].pcapDescForProtoDetection);
+
+        if (netDevs [i].datalinkTypeForSniff < 0 ||
+            netDevs [i].datalinkTypeForProtoDetection < 0) {
+            LOGE ("Get datalink type error.\n");
+            goto destroyNetDev;
+        }
     }
 
     return 0;
+
+destroyNetDev:
+    destroyNetDev ();
+    return -1;
 }
 
 /* Destroy netDev for sniff and proto detection */
 void
 destroyNetDev (void) {
-    if (pcapDescForSniff) {
-        pcap_close (pcapDescForSniff);
-        pcapDescForSniff = NULL;
-    }
+    destroyPcapSegmentDir (&segmentDirForSniff);
+    destroyPcapSegmentDir (&segmentDirForProtoDetection);
 
-    if (pcapDescForProtoDection) {
-        pcap_close (pcapDescForProtoDection);
-        pcapDescForProtoDection = NULL;
-    }
+    closeNetDevs ();
+    free (netDevs);
+    netDevs = NULL;
+    netDevsNum = 0;
 }
@@ -5,14 +5,18 @@
 #include "util.h"
 
 /*========================Interfaces definition============================*/
+boolean
+getNetDevStreamInput (void);
+u_int
+getNetDevNum (void);
 pcap_t *
-getNetDevPcapDescForSniff (void);
+getNetDevPcapDescForSniff (u_int index);
 pcap_t *
-getNetDevPcapDescForProtoDetection (void);
+getNetDevPcapDescForProtoDetection (u_int index);
 int
-getNetDevDatalinkTypeForSniff (void);
+getNetDevDatalinkTypeForSniff (u_int index);
 int
-getNetDevDatalinkTypeForProtoDetection (void);
+getNetDevDatalinkTypeForProtoDetection (u_int index);
 int
 getNetDevStatisticInfoForSniff (u_int *pktsRecv, u_int *pktsDrop);
 int
@@ -22,7 +26,9 @@ updateNetDevFilterForSniff (char *filter);
 int
 updateNetDevFilterForProtoDetection (char *filter);
 int
-resetNetDevForSniff (void);
+resetNetDevForSniff (u_int index);
+int
+resetNetDevForProtoDetection (void);
 int
 initNetDev (void);
 void
@@ -25,6 +25,12 @@
 #include "icmp_process_service.h"
 #include "tcp_dispatch_service.h"
 #include "tcp_process_service.h"
+#include "offline_process_service.h"
+#include "analysis_record.h"
+#include "record_store.h"
+#include "metrics.h"
+#include "proto_analyzer_stats.h"
+#include "heavy_hitter.h"
 #include "analysis_record_service.h"
 #include "proto_detect_service.h"
 
@@ -97,13 +103,34 @@ startServices (void) {
         goto stopAllTask;
     }
 
-    /* Start rawCaptureService */
-    ret = newRealTask ("RawCaptureService", rawCaptureService, NULL);
+    /* Start analysisRecordService */
+    ret = newRealTask ("AnalysisRecordService", analysisRecordService, NULL);
     if (ret < 0) {
-        LOGE ("Create rawCaptureService error.\n");
+        LOGE ("Create analysisRecordService error.\n");
         goto stopAllTask;
     }
 
+    /* Start offlineProcessService instead of capture pipeline */
+    if (offlineProcessEnabled ()) {
+        ret = newRealTask ("OfflineProcessService", offlineProcessService, NULL);
+        if (ret < 0) {
+            LOGE ("Create offlineProcessService error.\n");
+            goto stopAllTask;
+        }
+
+        return 0;
+    }
+
+    /* Start rawCaptureServices, one for every network interface */
+    for (i = 0; i < getRawCaptureThreadsNum (); i++) {
+        ret = newRealTask ("RawCaptureService", rawCaptureService,
+                           getRawCaptureThreadIDHolder (i));
+        if (ret < 0) {
+            LOGE ("Create rawCaptureService:%u error.\n", i);
+            goto stopAllTask;
+        }
+    }
+
     /* Start ipProcessService */
     ret = newRealTask ("IpProcessService", ipProcessService, NULL);
     if (ret < 0) {
@@ -135,13 +162,6 @@ startServices (void) {
         }
     }
 
-    /* Start analysisRecordService */
-    ret = newRealTask ("AnalysisRecordService", analysisRecordService, NULL);
-    if (ret < 0) {
-        LOGE ("Create analysisRecordService error.\n");
-        goto stopAllTask;
-    }
-
     /* Start protoDetectService */
     ret = newNormalTask ("ProtoDetectService", protoDetectService, NULL);
     if (ret < 0) {
@@ -215,11 +235,35 @@ ntraceService (void) {
         goto destroyZmqHub;
     }
 
+    /* Init metrics */
+    ret = initMetrics ();
+    if (ret < 0) {
+        LOGE ("Init metrics error.\n");
+        ret = -1;
+        goto destroyTaskManager;
+    }
+
+    /* Init analysis record field projection */
+    ret = initAnalysisRecordFieldProjection ();
+    if (ret < 0) {
+        LOGE ("Init analysis record field projection error.\n");
+        ret = -1;
+        goto destroyMetrics;
+    }
+
+    /* Init record store */
+    ret = initRecordStore ();
+    if (ret < 0) {
+        LOGE ("Init record store error.\n");
+        ret = -1;
+        goto destroyAnalysisRecordFieldProjection;
+    }
+
     /* Init proto analyzer */
     ret = initProtoAnalyzer ();
     if (ret < 0) {
         LOGE ("Init proto context error.\n");
-        goto destroyTaskManager;
+        goto destroyRecordStore;
     }
 
     /* Init application service manager */
@@ -284,10 +328,13 @@ ntraceService (void) {
 
     /* Start zloop */
     ret = zloop_start (loop);
-    if (ret)
+    if (taskServiceComplete ())
+        ret = 0;
+    else if (ret)
         LOGE ("nTraceService get error.\n");
 
     LOGI ("nTraceService will exit ... .. .\n");
+    displayMetricsLatencySummary ();
 destroyZloop:
     zloop_destroy (&loop);
 stopServices:
@@ -301,7 +348,15 @@ destroyTopologyManager:
 destroyAppServiceManager:
     destroyAppServiceManager ();
 destroyProtoAnalyzer:
+    destroyProtoAnalyzerStats ();
     destroyProtoAnalyzer ();
+destroyRecordStore:
+    destroyRecordStore ();
+destroyAnalysisRecordFieldProjection:
+    destroyAnalysisRecordFieldProjection ();
+destroyMetrics:
+    destroyHeavyHitter ();
+    destroyMetrics ();
 destroyTaskManager:
     destroyTaskManager ();
 destroyZmqHub:
@@ -407,6 +462,16 @@ main (int argc, char *argv []) {
         return -1;
     }
 
+    /* Replay benchmark mode */
+    if (getBenchPcapFile ()) {
+        ret = setPropertiesBenchMode (getBenchPcapFile (), getBenchDuration ());
+        if (ret < 0) {
+            fprintf (stderr, "Set replay benchmark mode error.\n");
+            destroyProperties ();
+            return -1;
+        }
+    }
+
     /* Run as daemon or normal process */
     if (getPropertiesDaemonMode ())
         ret = ntraceDaemon ();
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <getopt.h>
 #include "config.h"
 #include "util.h"
@@ -6,10 +7,19 @@
 #include "version.h"
 #include "option_parser.h"
 
+/* Default replay benchmark duration in seconds */
+#define DEFAULT_BENCH_DURATION 30
+
 char configFilePath [256] = NTRACE_CONFIG_FILE;
+/* Pcap file of replay benchmark, NULL if not in replay benchmark mode */
+static char *benchPcapFile = NULL;
+/* Replay benchmark duration in seconds */
+static u_int benchDuration = DEFAULT_BENCH_DURATION;
 
 static struct option options [] = {
     {"config", required_argument, NULL, 'C'},
+    {"bench", required_argument, NULL, 'B'},
+    {"bench-duration", required_argument, NULL, 'd'},
     {"version", no_argument, NULL, 'v'},
     {"help", no_argument, NULL, 'h'},
     {NULL, no_argument, NULL, 0},
@@ -21,12 +31,15 @@ showHelpInfo (const char *cmd) {
 
     cmdName = strrchr (cmd, '/') ? (strrchr (cmd, '/') + 1) : cmd;
     fprintf (stdout,
-             "Usage: %s -C <config_file>\n"
+             "Usage: %s -C <config_file> [-B <pcap_file> [-d <seconds>]]\n"
              "Options: \n"
              "  -C|--config, config file\n"
+             "  -B|--bench, replay pcap file in memory through pipeline as fast as possible\n"
+             "              and report throughput, outputs are sent to null sink\n"
+             "  -d|--bench-duration, replay benchmark duration in seconds, default is %u\n"
              "  -v|--version, version of %s\n"
              "  -h|--help, help information\n",
-             cmdName, cmdName);
+             cmdName, DEFAULT_BENCH_DURATION, cmdName);
 }
 
 /* Get config file */
@@ -35,21 +48,48 @@ getConfigFile (void) {
     return configFilePath;
 }
 
+/* Get pcap file of replay benchmark, NULL if not in replay benchmark mode */
+char *
+getBenchPcapFile (void) {
+    return benchPcapFile;
+}
+
+/* Get replay benchmark duration in seconds */
+u_int
+getBenchDuration (void) {
+    return benchDuration;
+}
+
 /* Command line options parser */
 int
 parseOptions (int argc, char *argv []) {
     char option;
+    int duration;
     boolean useDefaultConfig = True;
     boolean showVersion = False;
     boolean showHelp = False;
 
-    while ((option = getopt_long (argc, argv, ":C:vh?", options, NULL)) != -1) {
+    while ((option = getopt_long (argc, argv, ":C:B:d:vh?", options, NULL)) != -1) {
         switch (option) {
             case 'C':
                 snprintf(configFilePath, sizeof (configFilePath), "%s", optarg);
                 useDefaultConfig = False;
                 break;
 
+            case 'B':
+                benchPcapFile = optarg;
+                break;
+
+            case 'd':
+                duration = atoi (optarg);
+                if (duration <= 0) {
+                    fprintf (stderr, "Wrong bench duration, should be greater than 0.\n");
+                    showHelpInfo (argv [0]);
+                    return -1;
+                }
+                benchDuration = duration;
+                break;
+
             case 'v':
                 showVersion = True;
                 break;
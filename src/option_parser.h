@@ -1,9 +1,15 @@
 #ifndef __OPTION_PARSER_H__
 #define __OPTION_PARSER_H__
 
+#include "util.h"
+
 /*========================Interfaces definition============================*/
 char *
 getConfigFile (void);
+char *
+getBenchPcapFile (void);
+u_int
+getBenchDuration (void);
 int
 parseOptions (int argc, char *argv []);
 /*=======================Interfaces definition end=========================*/
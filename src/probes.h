@@ -0,0 +1,39 @@
+#ifndef __PROBES_H__
+#define __PROBES_H__
+
+/*
+ * USDT static tracepoints of provider "ntrace". With sys/sdt.h, every
+ * probe is compiled to a single nop plus an ELF note, so it costs nothing
+ * until bpftrace or perf attaches to it. Without sys/sdt.h, probes are
+ * compiled out. Probe arguments must be cheap to evaluate since they are
+ * always evaluated.
+ */
+#ifdef HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define NTRACE_PROBE(name)                                              \
+    DTRACE_PROBE (ntrace, name)
+#define NTRACE_PROBE1(name, a1)                                         \
+    DTRACE_PROBE1 (ntrace, name, a1)
+#define NTRACE_PROBE2(name, a1, a2)                                     \
+    DTRACE_PROBE2 (ntrace, name, a1, a2)
+#define NTRACE_PROBE3(name, a1, a2, a3)                                 \
+    DTRACE_PROBE3 (ntrace, name, a1, a2, a3)
+#define NTRACE_PROBE4(name, a1, a2, a3, a4)                             \
+    DTRACE_PROBE4 (ntrace, name, a1, a2, a3, a4)
+#define NTRACE_PROBE5(name, a1, a2, a3, a4, a5)                         \
+    DTRACE_PROBE5 (ntrace, name, a1, a2, a3, a4, a5)
+
+#else  /* !HAVE_SYS_SDT_H */
+
+#define NTRACE_PROBE(name) do {} while (0)
+#define NTRACE_PROBE1(name, a1) do {} while (0)
+#define NTRACE_PROBE2(name, a1, a2) do {} while (0)
+#define NTRACE_PROBE3(name, a1, a2, a3) do {} while (0)
+#define NTRACE_PROBE4(name, a1, a2, a3, a4) do {} while (0)
+#define NTRACE_PROBE5(name, a1, a2, a3, a4, a5) do {} while (0)
+
+#endif /* HAVE_SYS_SDT_H */
+
+#endif /* __PROBES_H__ */
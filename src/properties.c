@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include <sched.h>
 #include <ini_config.h>
 #include "config.h"
@@ -21,12 +22,28 @@ newProperties (void) {
     tmp->schedPriority = 0;
 
     tmp->managementServicePort = 0;
+    tmp->metricsHttpPort = 0;
+    tmp->healthRecordInterval = 60;
 
     tmp->interface = NULL;
+    tmp->interfaces = NULL;
+    tmp->interfacesNum = 0;
+    tmp->reorderWindow = 5;
 
     tmp->pcapFile = NULL;
+    tmp->pcapDir = NULL;
+    tmp->offlineParallelThreads = 0;
+    tmp->offlineMergedOutput = False;
+
+    tmp->benchMode = False;
+    tmp->benchDuration = 0;
 
     tmp->outputFile = NULL;
+    tmp->outputFileRotateSize = 0;
+    tmp->outputFileRotateInterval = 0;
+    tmp->outputFileCompressLevel = 0;
+    tmp->outputFileSyncPolicy = NULL;
+    tmp->outputFileSyncInterval = 1;
 
     tmp->splunkIndex = NULL;
     tmp->splunkSource = NULL;
@@ -34,14 +51,98 @@ newProperties (void) {
     tmp->splunkAuthToken = NULL;
     tmp->splunkUrl = NULL;
 
+    tmp->esUrl = NULL;
+    tmp->esIndexPrefix = NULL;
+    tmp->esBulkSize = 5000;
+    tmp->esBulkBytes = 5120;
+    tmp->esFlushInterval = 1;
+    tmp->esMaxInflight = 4;
+
+    tmp->pubOutputPort = 0;
+    tmp->pubOutputNoDrop = False;
+
+    tmp->topologyEntryFields = NULL;
+    tmp->appServiceFields = NULL;
+    tmp->icmpErrorFields = NULL;
+    tmp->tcpBreakdownFields = NULL;
+
+    tmp->recordStoreDir = NULL;
+    tmp->recordStoreSegmentSize = 64;
+    tmp->recordStoreIndexInterval = 4;
+    tmp->recordStoreRetentionSize = 10240;
+    tmp->recordStoreRetentionTime = 86400;
+
     tmp->autoAddService = True;
 
+    tmp->packetDedupWindow = 0;
+
     tmp->logDir = NULL;
     tmp->logFileName = NULL;
     tmp->logLevel = LOG_ERR_LEVEL;
     return tmp;
 }
 
+/* Free network interfaces list */
+static void
+freePropertiesInterfaces (propertiesPtr instance) {
+    u_int i;
+
+    for (i = 0; i < instance->interfacesNum; i++)
+        free (instance->interfaces [i]);
+    free (instance->interfaces);
+    instance->interfaces = NULL;
+    instance->interfacesNum = 0;
+}
+
+/**
+ * @brief Split network interfaces separated by comma or space
+ *        into interfaces list.
+ *
+ * @param instance -- properties instance
+ *
+ * @return 0 if success else -1
+ */
+static int
+splitPropertiesInterfaces (propertiesPtr instance) {
+    u_int i;
+    char *interfaces, *token, *savePtr;
+    char **tmp;
+
+    interfaces = strdup (instance->interface);
+    if (interfaces == NULL)
+        return -1;
+
+    for (token = strtok_r (interfaces, ", ", &savePtr); token;
+         token = strtok_r (NULL, ", ", &savePtr)) {
+        /* Skip duplicated interface */
+        for (i = 0; i < instance->interfacesNum; i++) {
+            if (strEqual (instance->interfaces [i], token))
+                break;
+        }
+        if (i < instance->interfacesNum)
+            continue;
+
+        tmp = (char **) realloc (instance->interfaces,
+                                 sizeof (char *) * (instance->interfacesNum + 1));
+        if (tmp == NULL)
+            goto freeInterfaces;
+        instance->interfaces = tmp;
+
+        instance->interfaces [instance->interfacesNum] = strdup (token);
+        if (instance->interfaces [instance->interfacesNum] == NULL)
+            goto freeInterfaces;
+        instance->interfacesNum++;
+    }
+
+    free (interfaces);
+    return 0;
+
+freeInterfaces:
+    freePropertiesInterfaces (instance);
+    free (interfaces);
+    return -1;
+}
+
 static void
 freeProperties (propertiesPtr instance) {
     if (instance == NULL)
@@ -49,12 +150,17 @@ freeProperties (propertiesPtr instance) {
 
     free (instance->interface);
     instance->interface = NULL;
+    freePropertiesInterfaces (instance);
 
     free (instance->pcapFile);
     instance->pcapFile = NULL;
+    free (instance->pcapDir);
+    instance->pcapDir = NULL;
 
     free (instance->outputFile);
     instance->outputFile = NULL;
+    free (instance->outputFileSyncPolicy);
+    instance->outputFileSyncPolicy = NULL;
 
     free (instance->splunkIndex);
     instance->splunkIndex = NULL;
@@ -67,6 +173,23 @@ freeProperties (propertiesPtr instance) {
     free (instance->splunkUrl);
     instance->splunkUrl = NULL;
 
+    free (instance->esUrl);
+    instance->esUrl = NULL;
+    free (instance->esIndexPrefix);
+    instance->esIndexPrefix = NULL;
+
+    free (instance->topologyEntryFields);
+    instance->topologyEntryFields = NULL;
+    free (instance->appServiceFields);
+    instance->appServiceFields = NULL;
+    free (instance->icmpErrorFields);
+    instance->icmpErrorFields = NULL;
+    free (instance->tcpBreakdownFields);
+    instance->tcpBreakdownFields = NULL;
+
+    free (instance->recordStoreDir);
+    instance->recordStoreDir = NULL;
+
     free (instance->logDir);
     instance->logDir = NULL;
     free (instance->logFileName);
@@ -77,16 +200,51 @@ freeProperties (propertiesPtr instance) {
 
 static int
 validateProperties (propertiesPtr instance) {
-    if (instance->interface == NULL && instance->pcapFile == NULL) {
+    if (instance->interface == NULL && instance->pcapFile == NULL &&
+        instance->pcapDir == NULL) {
         fprintf (stderr, "There is no input.\n");
         return -1;
     }
 
-    if (instance->interface && instance->pcapFile) {
+    if ((instance->interface ? 1 : 0) + (instance->pcapFile ? 1 : 0) +
+        (instance->pcapDir ? 1 : 0) > 1) {
         fprintf (stderr, "Only one input should be specified.\n");
         return -1;
     }
 
+    if (instance->interface && instance->interfacesNum == 0) {
+        fprintf (stderr, "Wrong interface for liveInput.\n");
+        return -1;
+    }
+
+    if (instance->outputFileCompressLevel > 9) {
+        fprintf (stderr, "Wrong compressLevel for fileOutput, should be 0-9.\n");
+        return -1;
+    }
+
+    if (instance->outputFileSyncPolicy &&
+        !strEqualIgnoreCase (instance->outputFileSyncPolicy, OUTPUT_FILE_SYNC_POLICY_NEVER) &&
+        !strEqualIgnoreCase (instance->outputFileSyncPolicy, OUTPUT_FILE_SYNC_POLICY_ROTATE) &&
+        !strEqualIgnoreCase (instance->outputFileSyncPolicy, OUTPUT_FILE_SYNC_POLICY_INTERVAL)) {
+        fprintf (stderr, "Wrong syncPolicy for fileOutput, should be never, rotate or interval.\n");
+        return -1;
+    }
+
+    if (instance->outputFileSyncInterval == 0) {
+        fprintf (stderr, "Wrong syncInterval for fileOutput, should be greater than 0.\n");
+        return -1;
+    }
+
+    if (instance->recordStoreSegmentSize == 0) {
+        fprintf (stderr, "Wrong segmentSize for recordStore, should be greater than 0.\n");
+        return -1;
+    }
+
+    if (instance->recordStoreIndexInterval == 0) {
+        fprintf (stderr, "Wrong indexInterval for recordStore, should be greater than 0.\n");
+        return -1;
+    }
+
     if (!((instance->splunkIndex && instance->splunkSource && instance->splunkSourcetype &&
            instance->splunkAuthToken && instance->splunkUrl) ||
           (!instance->splunkIndex && !instance->splunkSource && !instance->splunkSourcetype &&
@@ -104,6 +262,13 @@ validateProperties (propertiesPtr instance) {
         return -1;
     }
 
+    if (instance->esUrl &&
+        (!instance->esBulkSize || !instance->esBulkBytes || !instance->esMaxInflight)) {
+        fprintf (stderr, "Wrong bulkSize, bulkBytes or maxInflight for esOutput, "
+                 "should be greater than 0.\n");
+        return -1;
+    }
+
     if (!instance->logDir || !instance->logFileName) {
         if (instance->logDir == NULL)
             fprintf (stderr, "Missing logDir for log.\n");
@@ -187,6 +352,26 @@ loadPropertiesFromConfigFile (char *configFile) {
         goto freeProperties;
     }
 
+    /* Get managementService metricsHttpPort */
+    ret = get_config_item ("managementService", "metricsHttpPort", iniConfig, &item);
+    if (!ret && item) {
+        tmp->metricsHttpPort = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"metricsHttpPort\" from \"managementService\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get managementService healthRecordInterval */
+    ret = get_config_item ("managementService", "healthRecordInterval", iniConfig, &item);
+    if (!ret && item) {
+        tmp->healthRecordInterval = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"healthRecordInterval\" from \"managementService\" error.\n");
+            goto freeProperties;
+        }
+    }
+
     /* Get liveInput interface */
     ret = get_config_item ("liveInput", "interface", iniConfig, &item);
     if (!ret && item) {
@@ -195,6 +380,22 @@ loadPropertiesFromConfigFile (char *configFile) {
             fprintf (stderr, "Get \"interface\" from \"liveInput\" error.\n");
             goto freeProperties;
         }
+
+        ret = splitPropertiesInterfaces (tmp);
+        if (ret < 0) {
+            fprintf (stderr, "Split \"interface\" from \"liveInput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get liveInput reorderWindow */
+    ret = get_config_item ("liveInput", "reorderWindow", iniConfig, &item);
+    if (!ret && item) {
+        tmp->reorderWindow = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"reorderWindow\" from \"liveInput\" error.\n");
+            goto freeProperties;
+        }
     }
 
     /* Get offlineInput pcapFile */
@@ -207,6 +408,37 @@ loadPropertiesFromConfigFile (char *configFile) {
         }
     }
 
+    /* Get offlineInput pcapDir */
+    ret = get_config_item ("offlineInput", "pcapDir", iniConfig, &item);
+    if (!ret && item) {
+        tmp->pcapDir = strdup (get_const_string_config_value (item, &error));
+        if (tmp->pcapDir == NULL) {
+            fprintf (stderr, "Get \"pcapDir\" from \"offlineInput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get offlineInput parallelThreads */
+    ret = get_config_item ("offlineInput", "parallelThreads", iniConfig, &item);
+    if (!ret && item) {
+        tmp->offlineParallelThreads = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"parallelThreads\" from \"offlineInput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get offlineInput mergedOutput */
+    ret = get_config_item ("offlineInput", "mergedOutput", iniConfig, &item);
+    if (!ret && item) {
+        ret = get_bool_config_value (item, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"mergedOutput\" from \"offlineInput\" error.\n");
+            goto freeProperties;
+        }
+        tmp->offlineMergedOutput = ret ? True : False;
+    }
+
     /* Get fileOutput outputFile */
     ret = get_config_item ("fileOutput", "outputFile", iniConfig, &item);
     if (!ret && item) {
@@ -217,6 +449,56 @@ loadPropertiesFromConfigFile (char *configFile) {
         }
     }
 
+    /* Get fileOutput rotateSize */
+    ret = get_config_item ("fileOutput", "rotateSize", iniConfig, &item);
+    if (!ret && item) {
+        tmp->outputFileRotateSize = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"rotateSize\" from \"fileOutput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get fileOutput rotateInterval */
+    ret = get_config_item ("fileOutput", "rotateInterval", iniConfig, &item);
+    if (!ret && item) {
+        tmp->outputFileRotateInterval = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"rotateInterval\" from \"fileOutput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get fileOutput compressLevel */
+    ret = get_config_item ("fileOutput", "compressLevel", iniConfig, &item);
+    if (!ret && item) {
+        tmp->outputFileCompressLevel = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"compressLevel\" from \"fileOutput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get fileOutput syncPolicy */
+    ret = get_config_item ("fileOutput", "syncPolicy", iniConfig, &item);
+    if (!ret && item) {
+        tmp->outputFileSyncPolicy = strdup (get_const_string_config_value (item, &error));
+        if (tmp->outputFileSyncPolicy == NULL) {
+            fprintf (stderr, "Get \"syncPolicy\" from \"fileOutput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get fileOutput syncInterval */
+    ret = get_config_item ("fileOutput", "syncInterval", iniConfig, &item);
+    if (!ret && item) {
+        tmp->outputFileSyncInterval = get_int_config_value (item, 1, 1, &error);
+        if (error) {
+            fprintf (stderr, "Get \"syncInterval\" from \"fileOutput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
     /* Get splunkOutput index */
     ret = get_config_item ("splunkOutput", "index", iniConfig, &item);
     if (!ret && item) {
@@ -267,6 +549,177 @@ loadPropertiesFromConfigFile (char *configFile) {
         }
     }
 
+    /* Get esOutput url */
+    ret = get_config_item ("esOutput", "url", iniConfig, &item);
+    if (!ret && item) {
+        tmp->esUrl = strdup (get_const_string_config_value (item, &error));
+        if (tmp->esUrl == NULL) {
+            fprintf (stderr, "Get \"url\" from \"esOutput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get esOutput indexPrefix */
+    ret = get_config_item ("esOutput", "indexPrefix", iniConfig, &item);
+    if (!ret && item) {
+        tmp->esIndexPrefix = strdup (get_const_string_config_value (item, &error));
+        if (tmp->esIndexPrefix == NULL) {
+            fprintf (stderr, "Get \"indexPrefix\" from \"esOutput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get esOutput bulkSize */
+    ret = get_config_item ("esOutput", "bulkSize", iniConfig, &item);
+    if (!ret && item) {
+        tmp->esBulkSize = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"bulkSize\" from \"esOutput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get esOutput bulkBytes */
+    ret = get_config_item ("esOutput", "bulkBytes", iniConfig, &item);
+    if (!ret && item) {
+        tmp->esBulkBytes = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"bulkBytes\" from \"esOutput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get esOutput flushInterval */
+    ret = get_config_item ("esOutput", "flushInterval", iniConfig, &item);
+    if (!ret && item) {
+        tmp->esFlushInterval = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"flushInterval\" from \"esOutput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get esOutput maxInflight */
+    ret = get_config_item ("esOutput", "maxInflight", iniConfig, &item);
+    if (!ret && item) {
+        tmp->esMaxInflight = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"maxInflight\" from \"esOutput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get pubOutput port */
+    ret = get_config_item ("pubOutput", "port", iniConfig, &item);
+    if (!ret && item) {
+        tmp->pubOutputPort = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"port\" from \"pubOutput\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get pubOutput noDrop */
+    ret = get_config_item ("pubOutput", "noDrop", iniConfig, &item);
+    if (!ret && item) {
+        ret = get_bool_config_value (item, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"noDrop\" from \"pubOutput\" error.\n");
+            goto freeProperties;
+        }
+        tmp->pubOutputNoDrop = ret ? True : False;
+    }
+
+    /* Get fieldProjection topologyEntry */
+    ret = get_config_item ("fieldProjection", "topologyEntry", iniConfig, &item);
+    if (!ret && item) {
+        tmp->topologyEntryFields = strdup (get_const_string_config_value (item, &error));
+        if (tmp->topologyEntryFields == NULL) {
+            fprintf (stderr, "Get \"topologyEntry\" from \"fieldProjection\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get fieldProjection appService */
+    ret = get_config_item ("fieldProjection", "appService", iniConfig, &item);
+    if (!ret && item) {
+        tmp->appServiceFields = strdup (get_const_string_config_value (item, &error));
+        if (tmp->appServiceFields == NULL) {
+            fprintf (stderr, "Get \"appService\" from \"fieldProjection\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get fieldProjection icmpError */
+    ret = get_config_item ("fieldProjection", "icmpError", iniConfig, &item);
+    if (!ret && item) {
+        tmp->icmpErrorFields = strdup (get_const_string_config_value (item, &error));
+        if (tmp->icmpErrorFields == NULL) {
+            fprintf (stderr, "Get \"icmpError\" from \"fieldProjection\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get fieldProjection tcpBreakdown */
+    ret = get_config_item ("fieldProjection", "tcpBreakdown", iniConfig, &item);
+    if (!ret && item) {
+        tmp->tcpBreakdownFields = strdup (get_const_string_config_value (item, &error));
+        if (tmp->tcpBreakdownFields == NULL) {
+            fprintf (stderr, "Get \"tcpBreakdown\" from \"fieldProjection\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get recordStore dir */
+    ret = get_config_item ("recordStore", "dir", iniConfig, &item);
+    if (!ret && item) {
+        tmp->recordStoreDir = strdup (get_const_string_config_value (item, &error));
+        if (tmp->recordStoreDir == NULL) {
+            fprintf (stderr, "Get \"dir\" from \"recordStore\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get recordStore segmentSize */
+    ret = get_config_item ("recordStore", "segmentSize", iniConfig, &item);
+    if (!ret && item) {
+        tmp->recordStoreSegmentSize = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"segmentSize\" from \"recordStore\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get recordStore indexInterval */
+    ret = get_config_item ("recordStore", "indexInterval", iniConfig, &item);
+    if (!ret && item) {
+        tmp->recordStoreIndexInterval = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"indexInterval\" from \"recordStore\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get recordStore retentionSize */
+    ret = get_config_item ("recordStore", "retentionSize", iniConfig, &item);
+    if (!ret && item) {
+        tmp->recordStoreRetentionSize = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"retentionSize\" from \"recordStore\" error.\n");
+            goto freeProperties;
+        }
+    }
+
+    /* Get recordStore retentionTime */
+    ret = get_config_item ("recordStore", "retentionTime", iniConfig, &item);
+    if (!ret && item) {
+        tmp->recordStoreRetentionTime = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"retentionTime\" from \"recordStore\" error.\n");
+            goto freeProperties;
+        }
+    }
+
     /* Get protoDetect autoAddService */
     ret = get_config_item ("protoDetect", "autoAddService", iniConfig, &item);
     if (ret || item == NULL) {
@@ -283,6 +736,16 @@ loadPropertiesFromConfigFile (char *configFile) {
     else
         tmp->autoAddService = False;
 
+    /* Get packetDedup window */
+    ret = get_config_item ("packetDedup", "window", iniConfig, &item);
+    if (!ret && item) {
+        tmp->packetDedupWindow = get_int_config_value (item, 1, 0, &error);
+        if (error) {
+            fprintf (stderr, "Get \"window\" from \"packetDedup\" error.\n");
+            goto freeProperties;
+        }
+    }
+
     /* Get log logDir */
     ret = get_config_item ("log", "logDir", iniConfig, &item);
     if (ret || item == NULL) {
@@ -358,9 +821,19 @@ getPropertiesManagementServicePort (void) {
     return propertiesInstance->managementServicePort;
 }
 
+u_short
+getPropertiesMetricsHttpPort (void) {
+    return propertiesInstance->metricsHttpPort;
+}
+
+u_int
+getPropertiesHealthRecordInterval (void) {
+    return propertiesInstance->healthRecordInterval;
+}
+
 boolean
 getPropertiesSniffLive (void) {
-    return propertiesInstance->pcapFile == NULL ? True : False;
+    return propertiesInstance->interface ? True : False;
 }
 
 char *
@@ -368,16 +841,81 @@ getPropertiesInterface (void) {
     return propertiesInstance->interface;
 }
 
+char **
+getPropertiesInterfaces (void) {
+    return propertiesInstance->interfaces;
+}
+
+u_int
+getPropertiesInterfacesNum (void) {
+    return propertiesInstance->interfacesNum;
+}
+
+u_int
+getPropertiesReorderWindow (void) {
+    return propertiesInstance->reorderWindow;
+}
+
 char *
 getPropertiesPcapFile (void) {
     return propertiesInstance->pcapFile;
 }
 
+char *
+getPropertiesPcapDir (void) {
+    return propertiesInstance->pcapDir;
+}
+
+u_int
+getPropertiesOfflineParallelThreads (void) {
+    return propertiesInstance->offlineParallelThreads;
+}
+
+boolean
+getPropertiesOfflineMergedOutput (void) {
+    return propertiesInstance->offlineMergedOutput;
+}
+
+boolean
+getPropertiesBenchMode (void) {
+    return propertiesInstance->benchMode;
+}
+
+u_int
+getPropertiesBenchDuration (void) {
+    return propertiesInstance->benchDuration;
+}
+
 char *
 getPropertiesOutputFile (void) {
     return propertiesInstance->outputFile;
 }
 
+u_int
+getPropertiesOutputFileRotateSize (void) {
+    return propertiesInstance->outputFileRotateSize;
+}
+
+u_int
+getPropertiesOutputFileRotateInterval (void) {
+    return propertiesInstance->outputFileRotateInterval;
+}
+
+u_int
+getPropertiesOutputFileCompressLevel (void) {
+    return propertiesInstance->outputFileCompressLevel;
+}
+
+char *
+getPropertiesOutputFileSyncPolicy (void) {
+    return propertiesInstance->outputFileSyncPolicy;
+}
+
+u_int
+getPropertiesOutputFileSyncInterval (void) {
+    return propertiesInstance->outputFileSyncInterval;
+}
+
 char *
 getPropertiesSplunkIndex (void) {
     return propertiesInstance->splunkIndex;
@@ -403,14 +941,104 @@ getPropertiesSplunkUrl (void) {
     return propertiesInstance->splunkUrl;
 }
 
+char *
+getPropertiesEsUrl (void) {
+    return propertiesInstance->esUrl;
+}
+
+char *
+getPropertiesEsIndexPrefix (void) {
+    return propertiesInstance->esIndexPrefix;
+}
+
+u_int
+getPropertiesEsBulkSize (void) {
+    return propertiesInstance->esBulkSize;
+}
+
+u_int
+getPropertiesEsBulkBytes (void) {
+    return propertiesInstance->esBulkBytes;
+}
+
+u_int
+getPropertiesEsFlushInterval (void) {
+    return propertiesInstance->esFlushInterval;
+}
+
+u_int
+getPropertiesEsMaxInflight (void) {
+    return propertiesInstance->esMaxInflight;
+}
+
+u_short
+getPropertiesPubOutputPort (void) {
+    return propertiesInstance->pubOutputPort;
+}
+
+boolean
+getPropertiesPubOutputNoDrop (void) {
+    return propertiesInstance->pubOutputNoDrop;
+}
+
+char *
+getPropertiesTopologyEntryFields (void) {
+    return propertiesInstance->topologyEntryFields;
+}
+
+char *
+getPropertiesAppServiceFields (void) {
+    return propertiesInstance->appServiceFields;
+}
+
+char *
+getPropertiesIcmpErrorFields (void) {
+    return propertiesInstance->icmpErrorFields;
+}
+
+char *
+getPropertiesTcpBreakdownFields (void) {
+    return propertiesInstance->tcpBreakdownFields;
+}
+
+char *
+getPropertiesRecordStoreDir (void) {
+    return propertiesInstance->recordStoreDir;
+}
+
+u_int
+getPropertiesRecordStoreSegmentSize (void) {
+    return propertiesInstance->recordStoreSegmentSize;
+}
+
+u_int
+getPropertiesRecordStoreIndexInterval (void) {
+    return propertiesInstance->recordStoreIndexInterval;
+}
+
+u_int
+getPropertiesRecordStoreRetentionSize (void) {
+    return propertiesInstance->recordStoreRetentionSize;
+}
+
+u_int
+getPropertiesRecordStoreRetentionTime (void) {
+    return propertiesInstance->recordStoreRetentionTime;
+}
+
 boolean
 getPropertiesAutoAddService (void) {
-    if (propertiesInstance->pcapFile)
+    if (propertiesInstance->pcapFile || propertiesInstance->pcapDir)
         return True;
     else
         return propertiesInstance->autoAddService;
 }
 
+u_int
+getPropertiesPacketDedupWindow (void) {
+    return propertiesInstance->packetDedupWindow;
+}
+
 char *
 getPropertiesLogDir (void) {
     return propertiesInstance->logDir;
@@ -433,16 +1061,47 @@ displayPropertiesDetail (void) {
     LOGI ("    scheduleRealtime: %s\n", getPropertiesSchedPriority () ? "True" : "False");
     LOGI ("    schedulePriority: %u\n", getPropertiesSchedPriority ());
     LOGI ("    managementServicePort: %u\n", getPropertiesManagementServicePort ());
+    LOGI ("    metricsHttpPort: %u\n", getPropertiesMetricsHttpPort ());
+    LOGI ("    healthRecordInterval: %u\n", getPropertiesHealthRecordInterval ());
     LOGI ("    sniffLiveMode : %s\n", getPropertiesSniffLive () ? "True" : "False");
     LOGI ("    interface: %s\n", getPropertiesInterface ());
+    LOGI ("    reorderWindow: %u\n", getPropertiesReorderWindow ());
     LOGI ("    pcapFile: %s\n", getPropertiesPcapFile ());
+    LOGI ("    pcapDir: %s\n", getPropertiesPcapDir ());
+    LOGI ("    offlineParallelThreads: %u\n", getPropertiesOfflineParallelThreads ());
+    LOGI ("    offlineMergedOutput: %s\n", getPropertiesOfflineMergedOutput () ? "True" : "False");
+    LOGI ("    benchMode: %s\n", getPropertiesBenchMode () ? "True" : "False");
+    LOGI ("    benchDuration: %u\n", getPropertiesBenchDuration ());
     LOGI ("    outputFile: %s\n", getPropertiesOutputFile ());
+    LOGI ("    outputFileRotateSize: %u\n", getPropertiesOutputFileRotateSize ());
+    LOGI ("    outputFileRotateInterval: %u\n", getPropertiesOutputFileRotateInterval ());
+    LOGI ("    outputFileCompressLevel: %u\n", getPropertiesOutputFileCompressLevel ());
+    LOGI ("    outputFileSyncPolicy: %s\n", getPropertiesOutputFileSyncPolicy ());
+    LOGI ("    outputFileSyncInterval: %u\n", getPropertiesOutputFileSyncInterval ());
     LOGI ("    splunkIndex: %s\n", getPropertiesSplunkIndex ());
     LOGI ("    splunkSource: %s\n", getPropertiesSplunkSource ());
     LOGI ("    splunkSourcetype: %s\n", getPropertiesSplunkSourcetype ());
     LOGI ("    splunkAuthToken: %s\n", getPropertiesSplunkAuthToken ());
     LOGI ("    splunkUrl: %s\n", getPropertiesSplunkUrl ());
+    LOGI ("    esUrl: %s\n", getPropertiesEsUrl ());
+    LOGI ("    esIndexPrefix: %s\n", getPropertiesEsIndexPrefix ());
+    LOGI ("    esBulkSize: %u\n", getPropertiesEsBulkSize ());
+    LOGI ("    esBulkBytes: %u\n", getPropertiesEsBulkBytes ());
+    LOGI ("    esFlushInterval: %u\n", getPropertiesEsFlushInterval ());
+    LOGI ("    esMaxInflight: %u\n", getPropertiesEsMaxInflight ());
+    LOGI ("    pubOutputPort: %u\n", getPropertiesPubOutputPort ());
+    LOGI ("    pubOutputNoDrop: %s\n", getPropertiesPubOutputNoDrop () ? "True" : "False");
+    LOGI ("    topologyEntryFields: %s\n", getPropertiesTopologyEntryFields ());
+    LOGI ("    appServiceFields: %s\n", getPropertiesAppServiceFields ());
+    LOGI ("    icmpErrorFields: %s\n", getPropertiesIcmpErrorFields ());
+    LOGI ("    tcpBreakdownFields: %s\n", getPropertiesTcpBreakdownFields ());
+    LOGI ("    recordStoreDir: %s\n", getPropertiesRecordStoreDir ());
+    LOGI ("    recordStoreSegmentSize: %u\n", getPropertiesRecordStoreSegmentSize ());
+    LOGI ("    recordStoreIndexInterval: %u\n", getPropertiesRecordStoreIndexInterval ());
+    LOGI ("    recordStoreRetentionSize: %u\n", getPropertiesRecordStoreRetentionSize ());
+    LOGI ("    recordStoreRetentionTime: %u\n", getPropertiesRecordStoreRetentionTime ());
     LOGI ("    autoAddService: %s\n", getPropertiesAutoAddService () ? "True" : "False");
+    LOGI ("    packetDedupWindow: %u\n", getPropertiesPacketDedupWindow ());
     LOGI ("    logDir: %s\n", getPropertiesLogDir ());
     LOGI ("    logFileName: %s\n", getPropertiesLogFileName ());
     LOGI ("    logLevel: ");
@@ -473,6 +1132,40 @@ displayPropertiesDetail (void) {
     LOGI ("}\n");
 }
 
+/**
+ * @brief Switch properties to replay benchmark mode, pcapFile replaces
+ *        input of config file and nTrace runs in foreground.
+ *
+ * @param pcapFile -- Pcap file to replay
+ * @param duration -- Replay benchmark duration in seconds
+ *
+ * @return 0 if success else -1
+ */
+int
+setPropertiesBenchMode (char *pcapFile, u_int duration) {
+    char *tmp;
+
+    tmp = strdup (pcapFile);
+    if (tmp == NULL) {
+        fprintf (stderr, "Duplicate bench pcap file error.\n");
+        return -1;
+    }
+
+    free (propertiesInstance->interface);
+    propertiesInstance->interface = NULL;
+    freePropertiesInterfaces (propertiesInstance);
+    free (propertiesInstance->pcapFile);
+    propertiesInstance->pcapFile = tmp;
+    free (propertiesInstance->pcapDir);
+    propertiesInstance->pcapDir = NULL;
+
+    propertiesInstance->daemonMode = False;
+    propertiesInstance->benchMode = True;
+    propertiesInstance->benchDuration = duration;
+
+    return 0;
+}
+
 /* Init properties form configFile */
 int
 initProperties (char *configFile) {
@@ -4,6 +4,11 @@
 #include <stdlib.h>
 #include "util.h"
 
+/* Analysis record output file fsync policies */
+#define OUTPUT_FILE_SYNC_POLICY_NEVER "never"
+#define OUTPUT_FILE_SYNC_POLICY_ROTATE "rotate"
+#define OUTPUT_FILE_SYNC_POLICY_INTERVAL "interval"
+
 typedef struct _properties properties;
 typedef properties *propertiesPtr;
 
@@ -13,12 +18,28 @@ struct _properties {
     u_int schedPriority;                /**< Schedule priority */
 
     u_short managementServicePort;      /**< Management service port */
+    u_short metricsHttpPort;            /**< Metrics http port, 0 for disabled */
+    u_int healthRecordInterval;         /**< Pipeline health record interval in seconds, 0 for disabled */
+
+    char *interface;                    /**< Network interfaces separated by comma */
+    char **interfaces;                  /**< Network interfaces list */
+    u_int interfacesNum;                /**< Network interfaces number */
+    u_int reorderWindow;                /**< Reorder window of interfaces in ms, 0 for disabled */
 
-    char *interface;                    /**< Network interface */
+    char *pcapFile;                     /**< Pcap offline file, fifo or "-" for stdin */
+    char *pcapDir;                      /**< Pcap directory of rotating segments to follow */
+    u_int offlineParallelThreads;       /**< Offline parallel process threads, 0 for disabled */
+    boolean offlineMergedOutput;        /**< Offline time-ordered merged output */
 
-    char *pcapFile;                     /**< Pcap offline file */
+    boolean benchMode;                  /**< Replay benchmark mode */
+    u_int benchDuration;                /**< Replay benchmark duration in seconds */
 
     char *outputFile;                   /**< Output file for analysis record*/
+    u_int outputFileRotateSize;         /**< Output file rotate size in MB, 0 for unlimited */
+    u_int outputFileRotateInterval;     /**< Output file rotate interval in seconds, 0 for unlimited */
+    u_int outputFileCompressLevel;      /**< Output file gzip compress level, 0 for no compression */
+    char *outputFileSyncPolicy;         /**< Output file fsync policy */
+    u_int outputFileSyncInterval;       /**< Output file fsync interval in seconds */
 
     char *splunkIndex;                  /**< Splunk index for analysis record*/
     char *splunkSource;                 /**< Splunk source for analysis record */
@@ -26,8 +47,31 @@ struct _properties {
     char *splunkAuthToken;              /**< Splunk auth token for http event collector */
     char *splunkUrl;                    /**< Splunk url for http event collector */
 
+    char *esUrl;                        /**< Elasticsearch url for analysis record */
+    char *esIndexPrefix;                /**< Elasticsearch index prefix for analysis record */
+    u_int esBulkSize;                   /**< Elasticsearch max documents of bulk request */
+    u_int esBulkBytes;                  /**< Elasticsearch max KB of bulk request */
+    u_int esFlushInterval;              /**< Elasticsearch max seconds to hold bulk request */
+    u_int esMaxInflight;                /**< Elasticsearch max bulk requests in flight */
+
+    u_short pubOutputPort;              /**< Pub port for analysis record */
+    boolean pubOutputNoDrop;            /**< Drop for all subscribers if any one is slow */
+
+    char *topologyEntryFields;          /**< Fields projection of topology entry record */
+    char *appServiceFields;             /**< Fields projection of application service record */
+    char *icmpErrorFields;              /**< Fields projection of icmp error record */
+    char *tcpBreakdownFields;           /**< Fields projection of tcp breakdown record */
+
+    char *recordStoreDir;               /**< Record store dir */
+    u_int recordStoreSegmentSize;       /**< Record store segment size in MB */
+    u_int recordStoreIndexInterval;     /**< Record store index interval in KB */
+    u_int recordStoreRetentionSize;     /**< Record store retention size in MB, 0 for unlimited */
+    u_int recordStoreRetentionTime;     /**< Record store retention time in seconds, 0 for unlimited */
+
     boolean autoAddService;             /**< Auto add detected service to sniff */
 
+    u_int packetDedupWindow;            /**< Duplicate packet suppression window in ms, 0 for disabled */
+
     char *logDir;                       /**< Log dir */
     char *logFileName;                  /**< Log file name */
     u_int logLevel;                     /**< Log level */
@@ -42,14 +86,44 @@ u_int
 getPropertiesSchedPriority (void);
 u_short
 getPropertiesManagementServicePort (void);
+u_short
+getPropertiesMetricsHttpPort (void);
+u_int
+getPropertiesHealthRecordInterval (void);
 boolean
 getPropertiesSniffLive (void);
 char *
 getPropertiesInterface (void);
+char **
+getPropertiesInterfaces (void);
+u_int
+getPropertiesInterfacesNum (void);
+u_int
+getPropertiesReorderWindow (void);
 char *
 getPropertiesPcapFile (void);
 char *
+getPropertiesPcapDir (void);
+u_int
+getPropertiesOfflineParallelThreads (void);
+boolean
+getPropertiesOfflineMergedOutput (void);
+boolean
+getPropertiesBenchMode (void);
+u_int
+getPropertiesBenchDuration (void);
+char *
 getPropertiesOutputFile (void);
+u_int
+getPropertiesOutputFileRotateSize (void);
+u_int
+getPropertiesOutputFileRotateInterval (void);
+u_int
+getPropertiesOutputFileCompressLevel (void);
+char *
+getPropertiesOutputFileSyncPolicy (void);
+u_int
+getPropertiesOutputFileSyncInterval (void);
 char *
 getPropertiesSplunkIndex (void);
 char *
@@ -60,8 +134,44 @@ char *
 getPropertiesSplunkAuthToken (void);
 char *
 getPropertiesSplunkUrl (void);
+char *
+getPropertiesEsUrl (void);
+char *
+getPropertiesEsIndexPrefix (void);
+u_int
+getPropertiesEsBulkSize (void);
+u_int
+getPropertiesEsBulkBytes (void);
+u_int
+getPropertiesEsFlushInterval (void);
+u_int
+getPropertiesEsMaxInflight (void);
+u_short
+getPropertiesPubOutputPort (void);
+boolean
+getPropertiesPubOutputNoDrop (void);
+char *
+getPropertiesTopologyEntryFields (void);
+char *
+getPropertiesAppServiceFields (void);
+char *
+getPropertiesIcmpErrorFields (void);
+char *
+getPropertiesTcpBreakdownFields (void);
+char *
+getPropertiesRecordStoreDir (void);
+u_int
+getPropertiesRecordStoreSegmentSize (void);
+u_int
+getPropertiesRecordStoreIndexInterval (void);
+u_int
+getPropertiesRecordStoreRetentionSize (void);
+u_int
+getPropertiesRecordStoreRetentionTime (void);
 boolean
 getPropertiesAutoAddService (void);
+u_int
+getPropertiesPacketDedupWindow (void);
 char *
 getPropertiesLogDir (void);
 char *
@@ -71,6 +181,8 @@ getPropertiesLogLevel (void);
 void
 displayPropertiesDetail (void);
 int
+setPropertiesBenchMode (char *pcapFile, u_int duration);
+int
 initProperties (char *configFile);
 void
 destroyProperties (void);
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <pthread.h>
 #include <pcap.h>
 #include "config.h"
@@ -20,6 +21,8 @@
 
 #define PACKETS_OF_PROTO_DETECT_SCAN 1000
 #define INTERVAL_AFTER_PROTO_DETECT_SCAN 5
+/* Sleep interval in microseconds if all network interfaces are idle */
+#define INTERVAL_OF_PROTO_DETECT_IDLE 10000
 
 __thread void *topologyEntrySendSock = NULL;
 __thread void *appServiceSendSock = NULL;
@@ -52,7 +55,8 @@ protoDetectCallback (tcpProcessCallbackArgsPtr callbackArgs) {
             break;
 
         case PUBLISH_APP_SERVICE:
-            if (getPropertiesSniffLive () && getPropertiesAutoAddService ())
+            if ((getPropertiesSniffLive () || getNetDevStreamInput ()) &&
+                getPropertiesAutoAddService ())
                 updateFilterForSniff ();
             publishAnalysisRecord (appServiceSendSock, (char *) callbackArgs->args);
             break;
@@ -65,9 +69,9 @@ protoDetectCallback (tcpProcessCallbackArgsPtr callbackArgs) {
 
 /*
  * Proto detect service.
- * Capture raw packets from pcap file or mirror interface,
- * then do ip defragment and tcp packet process to detect
- * application level proto.
+ * Capture raw packets from pcap file, pcap directory or mirror
+ * interface, then do ip defragment and tcp packet process to
+ * detect application level proto.
  */
 void *
 protoDetectService (void *args) {
@@ -77,9 +81,14 @@ protoDetectService (void *args) {
     struct pcap_pkthdr *capPktHdr;
     u_char *rawPkt;
     boolean captureLive;
+    boolean streamInput;
+    u_int netDevIndex = 0;
+    u_int netDevsNum;
+    u_int netDevsIdle = 0;
     u_long_long packetsScanned = 0;
     timeVal captureTime;
     iphdrPtr iph, newIphdr;
+    ipPktInfo ipInfo;
     boolean exitNormally = False;
 
     /* Reset signals flag */
@@ -91,12 +100,31 @@ protoDetectService (void *args) {
         fprintf (stderr, "Init log context error.\n");
         goto exit;
     }
+    setLogComponent ("ProtoDetectService");
 
     /* Display task schedule policy info */
     displayTaskSchedPolicyInfo ("ProtoDetectService");
 
-    pcapDev = getNetDevPcapDescForProtoDetection ();
-    datalinkType = getNetDevDatalinkTypeForProtoDetection ();
+    captureLive = getPropertiesSniffLive ();
+    streamInput = getNetDevStreamInput ();
+
+    /* Pipe input can be read only once by sniff */
+    if (streamInput && getPropertiesPcapDir () == NULL) {
+        LOGW ("Proto detection is disabled for pipe input.\n");
+        exitNormally = True;
+        goto destroyLogContext;
+    }
+
+    /* Open pcap directory, wait until first pcap segment is ready */
+    if (streamInput) {
+        ret = resetNetDevForProtoDetection ();
+        if (ret < 0)
+            goto destroyLogContext;
+    }
+
+    netDevsNum = getNetDevNum ();
+    pcapDev = getNetDevPcapDescForProtoDetection (netDevIndex);
+    datalinkType = getNetDevDatalinkTypeForProtoDetection (netDevIndex);
     topologyEntrySendSock = getTopologyEntrySendSock ();
     appServiceSendSock = getAppServiceSendSock ();
 
@@ -121,11 +149,18 @@ protoDetectService (void *args) {
         goto destroyIpContext;
     }
 
-    captureLive = getPropertiesSniffLive ();
-
     while (!taskShouldExit ()) {
+        /* Read multiple network interfaces in turn */
+        if (netDevsNum > 1) {
+            netDevIndex = (netDevIndex + 1) % netDevsNum;
+            pcapDev = getNetDevPcapDescForProtoDetection (netDevIndex);
+            datalinkType = getNetDevDatalinkTypeForProtoDetection (netDevIndex);
+        }
+
         ret = pcap_next_ex (pcapDev, &capPktHdr, (const u_char **) &rawPkt);
         if (ret == 1) {
+            netDevsIdle = 0;
+
             /* Filter out incomplete raw packet */
             if (capPktHdr->caplen != capPktHdr->len)
                 continue;
@@ -160,7 +195,9 @@ protoDetectService (void *args) {
             if (ret < 0)
                 LOGE ("Ip packet defragment error.\n");
             else if (newIphdr) {
-                switch (newIphdr->ipProto) {
+                /* Ip header has been validated by ipDefragProcess */
+                getIpPktInfo (newIphdr, &ipInfo);
+                switch (ipInfo.proto) {
                     /* Tcp packet process */
                     case IPPROTO_TCP:
                         tcpProcess (newIphdr, &captureTime);
@@ -174,9 +211,28 @@ protoDetectService (void *args) {
                 if (newIphdr != iph)
                     free (newIphdr);
             }
+        } else if (ret == 0 && netDevsNum > 1) {
+            /* Sleep a while if all network interfaces are idle */
+            if (++netDevsIdle == netDevsNum) {
+                usleep (INTERVAL_OF_PROTO_DETECT_IDLE);
+                netDevsIdle = 0;
+            }
         } else if (ret == -1) {
             LOGE ("Capture raw packets for proto detection with fatal error.\n");
             break;
+        } else if (ret == -2 && streamInput) {
+            /* Carry on with next pcap segment, keep ip and tcp context */
+            ret = resetNetDevForProtoDetection ();
+            if (ret < 0)
+                break;
+            pcapDev = getNetDevPcapDescForProtoDetection (netDevIndex);
+            datalinkType = getNetDevDatalinkTypeForProtoDetection (netDevIndex);
+
+            ret = updateNetDevFilterForProtoDetection ("tcp");
+            if (ret < 0) {
+                LOGE ("Update proto detection filter error.\n");
+                break;
+            }
         } else if (ret == -2) {
             if (!captureLive)
                 zstr_send (getProtoDetectionStatusSendSock (),
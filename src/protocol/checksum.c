@@ -1,5 +1,7 @@
 #include <stdlib.h>
+#include <string.h>
 #include <netinet/in.h>
+#include "util.h"
 #include "checksum.h"
 
 #if ( __i386__ || __i386 )
@@ -186,6 +188,7 @@ u_short
 tcpFastCheckSum (u_char *tcph, int tcpLen, u_int saddr, u_int daddr) {
     u_int i;
     psuedoHeader phdr;
+    u_short words [sizeof (psuedoHeader) / 2];
     int sum = 0;
 
     phdr.saddr = saddr;
@@ -193,11 +196,38 @@ tcpFastCheckSum (u_char *tcph, int tcpLen, u_int saddr, u_int daddr) {
     phdr.zero = 0;
     phdr.protocol = IPPROTO_TCP;
     phdr.len = htons (tcpLen);
-    for (i = 0; i < sizeof (psuedoHeader); i += 2) {
-        sum += *(u_short *) ((u_char *) (&phdr) + i);
+    /* Copy pseudo header out instead of aliasing it as u_short */
+    memcpy (words, &phdr, sizeof (phdr));
+    for (i = 0; i < TABLE_SIZE (words); i++) {
+        sum += words [i];
     }
 
     return ipCheckExt ((u_short *) tcph, tcpLen, sum);
 }
 
 #endif  /* !i386 */
+
+/* Tcp checksum with ipv6 pseudo header, it is portable for all arches */
+u_short
+tcp6FastCheckSum (u_char *tcph, int tcpLen, u_char *saddr, u_char *daddr) {
+    int i;
+    u_int sum = 0;
+
+    for (i = 0; i < 16; i += 2) {
+        sum += (saddr [i] << 8) | saddr [i + 1];
+        sum += (daddr [i] << 8) | daddr [i + 1];
+    }
+    sum += ((u_int) tcpLen >> 16) + ((u_int) tcpLen & 0xffff);
+    sum += IPPROTO_TCP;
+
+    for (i = 0; i + 1 < tcpLen; i += 2)
+        sum += (tcph [i] << 8) | tcph [i + 1];
+    /* Mop up an odd byte, if necessary */
+    if (tcpLen & 1)
+        sum += tcph [tcpLen - 1] << 8;
+
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return (u_short) ~sum;
+}
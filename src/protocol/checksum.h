@@ -8,6 +8,8 @@ u_short
 ipFastCheckSum (u_char *iph, u_int iphLen);
 u_short
 tcpFastCheckSum (u_char *tcph, int tcpLen, u_int saddr, u_int daddr);
+u_short
+tcp6FastCheckSum (u_char *tcph, int tcpLen, u_char *saddr, u_char *daddr);
 /*=======================Interfaces definition end=========================*/
 
 #endif /* __CHECKSUM_H__ */
@@ -93,20 +93,25 @@ icmpError2AnalysisRecord (icmpErrorPtr error) {
                          json_string (ANALYSIS_RECORD_TYPE_ICMP_ERROR));
 
     /* Icmp error type */
-    json_object_set_new (root, ICMP_ERROR_TYPE,
-                         json_string ("ICMP_DEST_UNREACH"));
+    if (analysisRecordFieldSelected (ANALYSIS_RECORD_TYPE_ICMP_ERROR, ICMP_ERROR_TYPE))
+        json_object_set_new (root, ICMP_ERROR_TYPE,
+                             json_string ("ICMP_DEST_UNREACH"));
 
     /* Icmp error code */
-    json_object_set_new (root, ICMP_ERROR_CODE,
-                         json_string (getIcmpDestUnreachCodeName (error->code)));
+    if (analysisRecordFieldSelected (ANALYSIS_RECORD_TYPE_ICMP_ERROR, ICMP_ERROR_CODE))
+        json_object_set_new (root, ICMP_ERROR_CODE,
+                             json_string (getIcmpDestUnreachCodeName (error->code)));
 
     /* Icmp error dest unreach ip */
-    inet_ntop (AF_INET, (void *) &error->ip, ipStr, sizeof (ipStr));
-    json_object_set_new (root, ICMP_ERROR_DEST_UNREACH_IP,
-                         json_string (ipStr));
+    if (analysisRecordFieldSelected (ANALYSIS_RECORD_TYPE_ICMP_ERROR, ICMP_ERROR_DEST_UNREACH_IP)) {
+        inet_ntop (AF_INET, (void *) &error->ip, ipStr, sizeof (ipStr));
+        json_object_set_new (root, ICMP_ERROR_DEST_UNREACH_IP,
+                             json_string (ipStr));
+    }
 
     /* Icmp error dest unreach port */
-    if (error->code == ICMP_PORT_UNREACH)
+    if (error->code == ICMP_PORT_UNREACH &&
+        analysisRecordFieldSelected (ANALYSIS_RECORD_TYPE_ICMP_ERROR, ICMP_ERROR_DEST_UNREACH_PORT))
         json_object_set_new (root, ICMP_ERROR_DEST_UNREACH_PORT,
                              json_integer (error->port));
 
@@ -146,7 +151,7 @@ icmpProcess (iphdrPtr iph, timeValPtr tm) {
 
     len = ntohs (iph->ipLen) - iph->iphLen * 4;
     if (len < sizeof (icmphdr)) {
-        LOGW ("Incomplete icmp packet.\n");
+        LOGW_RL ("Incomplete icmp packet.\n");
         return;
     }
 
@@ -3,6 +3,7 @@
 #include "properties.h"
 #include "signals.h"
 #include "log.h"
+#include "metrics.h"
 #include "zmq_hub.h"
 #include "task_manager.h"
 #include "ip.h"
@@ -37,6 +38,7 @@ icmpProcessService (void *args) {
     void *icmpPktRecvSock;
     zframe_t *tmFrame = NULL;
     zframe_t *ipPktFrame = NULL;
+    pktTimestampPtr timestamp;
     timeValPtr tm;
     iphdrPtr iph;
 
@@ -52,6 +54,14 @@ icmpProcessService (void *args) {
         fprintf (stderr, "Init log context error.\n");
         goto exit;
     }
+    setLogComponent ("IcmpProcessService");
+
+    /* Init metrics context */
+    ret = initMetricsContext ("IcmpProcessService");
+    if (ret < 0) {
+        LOGE ("Init metrics context error.\n");
+        goto destroyLogContext;
+    }
 
     /* Display task schedule policy info */
     displayTaskSchedPolicyInfo ("IcmpProcessService");
@@ -60,7 +70,7 @@ icmpProcessService (void *args) {
     ret = initIcmpContext (icmpProcessCallback);
     if (ret < 0) {
         LOGE ("Init icmp context error.\n");
-        goto destroyLogContext;
+        goto destroyMetricsContext;
     }
 
     while (!taskShouldExit ()) {
@@ -91,9 +101,22 @@ icmpProcessService (void *args) {
             continue;
         }
 
-        tm = (timeValPtr) zframe_data (tmFrame);
+        if (zframe_size (tmFrame) != sizeof (pktTimestamp)) {
+            LOGE_RL ("Wrong packet timestamp zframe size: %u.\n", (u_int) zframe_size (tmFrame));
+            zframe_destroy (&tmFrame);
+            zframe_destroy (&ipPktFrame);
+            continue;
+        }
+
+        timestamp = (pktTimestampPtr) zframe_data (tmFrame);
+        tm = &timestamp->captureTime;
         iph = (iphdrPtr) zframe_data (ipPktFrame);
 
+        METRICS_COUNTER_INC (METRIC_PACKETS_RECEIVED);
+        METRICS_COUNTER_ADD (METRIC_BYTES_RECEIVED, zframe_size (ipPktFrame));
+        METRICS_COUNTER_INC (METRIC_ICMP_QUEUE_DEQUEUED);
+        setAnalysisRecordIngressTime (timestamp->ingressTime);
+
         /* Do icmp process */
         icmpProcess (iph, tm);
 
@@ -104,6 +127,8 @@ icmpProcessService (void *args) {
 
     LOGI ("IcmpProcessService will exit ... .. .\n");
     destroyIcmpContext ();
+destroyMetricsContext:
+    destroyMetricsContext ();
 destroyLogContext:
     destroyLogContext ();
 exit:
@@ -30,4 +30,19 @@ struct _iphdr {
     struct in_addr ipDest;              /**< Ip dest */
 };
 
+/* Max length of ipv4 or ipv6 address string */
+#define IP_ADDR_STR_MAX_LENGTH INET6_ADDRSTRLEN
+
+typedef struct _ipAddr ipAddr;
+typedef ipAddr *ipAddrPtr;
+
+/* Ipv4 or ipv6 address */
+struct _ipAddr {
+    uint8_t family;                     /**< Address family, AF_INET or AF_INET6 */
+    union {
+        struct in_addr ip4;             /**< Ipv4 address */
+        struct in6_addr ip6;            /**< Ipv6 address */
+    } u;
+};
+
 #endif /* __IP_H__ */
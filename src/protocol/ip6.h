@@ -0,0 +1,45 @@
+#ifndef __IP6_H__
+#define __IP6_H__
+
+#include <stdint.h>
+#include <arpa/inet.h>
+
+/* Ipv6 fixed header length */
+#define IP6_HEADER_LEN 40
+
+typedef struct _ip6hdr ip6hdr;
+typedef ip6hdr *ip6hdrPtr;
+
+struct _ip6hdr {
+    uint32_t ip6Flow;                   /**< Ip version, traffic class and flow label */
+#define IP6_FLOW_LABEL_MASK 0x000fffff
+    uint16_t ip6PayloadLen;             /**< Ip payload length */
+    uint8_t ip6NextHeader;              /**< Ip next header */
+    uint8_t ip6HopLimit;                /**< Ip hop limit */
+    struct in6_addr ip6Src;             /**< Ip source */
+    struct in6_addr ip6Dest;            /**< Ip dest */
+};
+
+typedef struct _ip6ExtHdr ip6ExtHdr;
+typedef ip6ExtHdr *ip6ExtHdrPtr;
+
+/* Ipv6 hop-by-hop, routing, destination options and AH extension header */
+struct _ip6ExtHdr {
+    uint8_t ip6eNextHeader;             /**< Next header */
+    uint8_t ip6eLen;                    /**< Extension header length */
+};
+
+typedef struct _ip6FragHdr ip6FragHdr;
+typedef ip6FragHdr *ip6FragHdrPtr;
+
+/* Ipv6 fragment extension header */
+struct _ip6FragHdr {
+    uint8_t ip6fNextHeader;             /**< Next header */
+    uint8_t ip6fReserved;               /**< Reserved */
+    uint16_t ip6fOffLg;                 /**< Fragment offset and flags */
+#define IP6F_OFF_MASK 0xfff8
+#define IP6F_MORE_FRAG 0x0001
+    uint32_t ip6fIdent;                 /**< Fragment identification */
+};
+
+#endif /* __IP6_H__ */
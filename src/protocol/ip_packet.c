@@ -6,11 +6,12 @@
 #include "config.h"
 #include "util.h"
 #include "list.h"
-#include "hash.h"
 #include "checksum.h"
 #include "log.h"
+#include "metrics.h"
 #include "app_service_manager.h"
 #include "ip.h"
+#include "ip6.h"
 #include "tcp.h"
 #include "ip_options.h"
 #include "ip_packet.h"
@@ -19,52 +20,242 @@
 #define MAX_IP_PACKET_SIZE 65535
 /* Default expire timeout of ipQueue */
 #define DEFAULT_IPQUEUE_EXPIRE_TIMEOUT 30
-/* Default ipQueue hash table size */
-#define DEFAULT_IPQUEUE_HASH_TABLE_SIZE 65535
-/* ipQueue hash key format string */
-#define IPQUEUE_HASH_KEY_FORMAT "%s:%s:%u"
-
-/* IpQueue expire timeout list */
+/* Max ipQueues of each thread */
+#define MAX_IPQUEUE_NUM 65535
+/* IpQueue hash buckets, must be power of 2 */
+#define IPQUEUE_HASH_BUCKETS 4096
+/* Max free ip fragments kept in pool of each thread */
+#define IPFRAG_POOL_MAX_SIZE 1024
+
+/* IpQueue expire timeout list, ordered by timeout */
 static __thread listHead ipQueueExpireTimeoutList;
 
-/* Ip host fragment hash table */
-static __thread hashTablePtr ipQueueHashTable = NULL;
+/* IpQueue hash buckets */
+static __thread listHeadPtr ipQueueHashBuckets = NULL;
+
+/* IpQueues number, non-fragment needs no lookup if it is 0 */
+static __thread u_int ipQueueNum = 0;
+
+/* Free ip fragments pool */
+static __thread listHead ipFragPool;
+static __thread u_int ipFragPoolSize = 0;
 
 /* Ip process purpose, for proto analysis or detect */
 static __thread boolean doProtoDetect = False;
 
-static void
-displayIphdr (iphdrPtr iph) {
-    u_short offset, flags;
-    char ipSrcStr [16], ipDestStr [16];
+/* Check whether two ip addresses are equal */
+boolean
+ipAddrIsEqual (ipAddrPtr addr1, ipAddrPtr addr2) {
+    if (addr1->family != addr2->family)
+        return False;
+
+    if (addr1->family == AF_INET)
+        return addr1->u.ip4.s_addr == addr2->u.ip4.s_addr;
+    else if (addr1->family == AF_INET6)
+        return memcmp (&addr1->u.ip6, &addr2->u.ip6, sizeof (struct in6_addr)) == 0;
+
+    return True;
+}
+
+/* Get hash of ip address, hash of ipv4 address is cheap */
+u_int
+ipAddrHash (ipAddrPtr addr) {
+    u_int i, hash;
+    u_int words [4];
+
+    if (addr->family == AF_INET)
+        return addr->u.ip4.s_addr * 0x9E3779B1U;
+    else if (addr->family == AF_INET6) {
+        memcpy (words, &addr->u.ip6, sizeof (words));
+        hash = 0;
+        for (i = 0; i < 4; i++)
+            hash = (hash ^ words [i]) * 0x9E3779B1U;
+        return hash;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Symmetric dispatch hash of tcp packet, both directions of
+ *        flow get the same hash.
+ *
+ * @param iph -- tcp packet
+ * @param info -- ip packet info
+ *
+ * @return Dispatch hash
+ */
+u_int
+ipPktDispatchHash (iphdrPtr iph, ipPktInfoPtr info) {
+    u_int hash1, hash2;
+    tcphdrPtr tcph;
+
+    tcph = (tcphdrPtr) ((u_char *) iph + info->hdrLen);
+    hash1 = ipAddrHash (&info->src) ^ (ntohs (tcph->source) * 0x85EBCA6BU);
+    hash2 = ipAddrHash (&info->dest) ^ (ntohs (tcph->dest) * 0x85EBCA6BU);
+    hash1 ^= hash1 >> 16;
+    hash2 ^= hash2 >> 16;
+
+    return hash1 + hash2;
+}
+
+/**
+ * @brief Convert ip address to string.
+ *
+ * @param addr -- ip address to convert
+ * @param buf -- buffer to return ip address string
+ * @param bufLen -- buffer length, IP_ADDR_STR_MAX_LENGTH is enough
+ *
+ * @return ip address string
+ */
+char *
+ipAddrToStr (ipAddrPtr addr, char *buf, u_int bufLen) {
+    if (inet_ntop (addr->family, (void *) &addr->u, buf, bufLen) == NULL)
+        snprintf (buf, bufLen, "0.0.0.0");
+
+    return buf;
+}
+
+/* Get ip packet length of ipv4 or ipv6 packet */
+u_int
+getIpPktLen (iphdrPtr iph) {
+    if (iph->ipVer == 6)
+        return IP6_HEADER_LEN + ntohs (((ip6hdrPtr) iph)->ip6PayloadLen);
+
+    return ntohs (iph->ipLen);
+}
+
+/* Get ipv6 packet info, walk extension headers */
+static int
+getIp6PktInfo (ip6hdrPtr ip6h, ipPktInfoPtr info) {
+    u_char nextHeader;
+    u_int offset;
+    u_short fragOff;
+    ip6ExtHdrPtr exth;
+    ip6FragHdrPtr fragh;
+
+    memset (&info->src, 0, sizeof (ipAddr));
+    memset (&info->dest, 0, sizeof (ipAddr));
+    info->src.family = AF_INET6;
+    info->src.u.ip6 = ip6h->ip6Src;
+    info->dest.family = AF_INET6;
+    info->dest.u.ip6 = ip6h->ip6Dest;
+    info->len = IP6_HEADER_LEN + ntohs (ip6h->ip6PayloadLen);
+    info->hdrLen = IP6_HEADER_LEN;
+    info->fragOffset = 0;
+    info->moreFrags = False;
+    info->fragId = 0;
+
+    nextHeader = ip6h->ip6NextHeader;
+    offset = IP6_HEADER_LEN;
+    for (;;) {
+        switch (nextHeader) {
+            case IPPROTO_HOPOPTS:
+            case IPPROTO_ROUTING:
+            case IPPROTO_DSTOPTS:
+            case IPPROTO_AH:
+                if (offset + sizeof (ip6ExtHdr) > info->len)
+                    return -1;
+
+                exth = (ip6ExtHdrPtr) ((u_char *) ip6h + offset);
+                /* Length of AH is in 4 octets and others are in 8 octets */
+                if (nextHeader == IPPROTO_AH)
+                    offset += (exth->ip6eLen + 2) * 4;
+                else
+                    offset += (exth->ip6eLen + 1) * 8;
+                nextHeader = exth->ip6eNextHeader;
+                break;
+
+            case IPPROTO_FRAGMENT:
+                if (offset + sizeof (ip6FragHdr) > info->len)
+                    return -1;
+
+                /* Stop at fragment header, the rest is fragmentable part */
+                fragh = (ip6FragHdrPtr) ((u_char *) ip6h + offset);
+                fragOff = ntohs (fragh->ip6fOffLg);
+                info->fragOffset = fragOff & IP6F_OFF_MASK;
+                info->moreFrags = (fragOff & IP6F_MORE_FRAG) ? True : False;
+                info->fragId = ntohl (fragh->ip6fIdent);
+                offset += sizeof (ip6FragHdr);
+                info->proto = fragh->ip6fNextHeader;
+                info->hdrLen = offset;
+                return 0;
+
+            default:
+                if (offset > info->len)
+                    return -1;
+
+                info->proto = nextHeader;
+                info->hdrLen = offset;
+                return 0;
+        }
+    }
+}
+
+/**
+ * @brief Get ipv4 or ipv6 packet info and validate ip header, unused
+ *        bytes of ip addresses are zeroed so they can be compared as
+ *        binary keys.
+ *
+ * @param iph -- ip packet
+ * @param info -- ip packet info to return
+ *
+ * @return 0 if success else -1
+ */
+int
+getIpPktInfo (iphdrPtr iph, ipPktInfoPtr info) {
+    u_short fragOff;
+
+    if (iph->ipVer == 6)
+        return getIp6PktInfo ((ip6hdrPtr) iph, info);
+
+    memset (&info->src, 0, sizeof (ipAddr));
+    memset (&info->dest, 0, sizeof (ipAddr));
+    info->src.family = AF_INET;
+    info->src.u.ip4 = iph->ipSrc;
+    info->dest.family = AF_INET;
+    info->dest.u.ip4 = iph->ipDest;
+    info->proto = iph->ipProto;
+    info->hdrLen = iph->iphLen * 4;
+    info->len = ntohs (iph->ipLen);
+    fragOff = ntohs (iph->ipOff);
+    info->fragOffset = (fragOff & IP_OFFMASK) << 3;
+    info->moreFrags = (fragOff & IP_MF) ? True : False;
+    info->fragId = ntohs (iph->ipId);
+
+    if (iph->ipVer != 4 || info->hdrLen < sizeof (iphdr) || info->len < info->hdrLen)
+        return -1;
+
+    return 0;
+}
 
-    offset = ntohs (iph->ipOff);
-    flags = offset & ~IP_OFFMASK;
-    offset = (offset & IP_OFFMASK) << 3;
+static void
+displayIphdr (ipPktInfoPtr info) {
+    char ipSrcStr [IP_ADDR_STR_MAX_LENGTH], ipDestStr [IP_ADDR_STR_MAX_LENGTH];
 
-    if (flags & IP_MF || offset)
+    if (info->moreFrags || info->fragOffset)
         LOGD ("Fragment ip packet");
     else
         LOGD ("Defragment ip packet");
 
-    inet_ntop (AF_INET, (void *) &iph->ipSrc, ipSrcStr, sizeof (ipSrcStr));
-    inet_ntop (AF_INET, (void *) &iph->ipDest, ipDestStr, sizeof (ipDestStr));
+    ipAddrToStr (&info->src, ipSrcStr, sizeof (ipSrcStr));
+    ipAddrToStr (&info->dest, ipDestStr, sizeof (ipDestStr));
     LOGD (" src: %s ------------> dst: %s\n", ipSrcStr, ipDestStr);
-    LOGD ("Ip header len: %d , ip packet len: %u, offset: %u, IP_MF: %u.\n",
-          (iph->iphLen * 4), ntohs (iph->ipLen), offset, ((flags & IP_MF) ? 1 : 0));
+    LOGD ("Ip header len: %u , ip packet len: %u, offset: %u, IP_MF: %u.\n",
+          info->hdrLen, info->len, info->fragOffset, (info->moreFrags ? 1 : 0));
 }
 
 /* Check ip packet to drop */
 static boolean
-ipPktShouldDrop (iphdrPtr iph) {
+ipPktShouldDrop (iphdrPtr iph, ipPktInfoPtr info) {
     tcphdrPtr tcph;
-    char ipSrcStr [16], ipDestStr [16];
+    char ipSrcStr [IP_ADDR_STR_MAX_LENGTH], ipDestStr [IP_ADDR_STR_MAX_LENGTH];
 
-    if (iph->ipProto == IPPROTO_TCP) {
-        tcph = (tcphdrPtr) ((u_char *) iph + (iph->iphLen * 4));
+    if (info->proto == IPPROTO_TCP) {
+        tcph = (tcphdrPtr) ((u_char *) iph + info->hdrLen);
 
-        inet_ntop (AF_INET, (void *) &iph->ipSrc, ipSrcStr, sizeof (ipSrcStr));
-        inet_ntop (AF_INET, (void *) &iph->ipDest, ipDestStr, sizeof (ipDestStr));
+        ipAddrToStr (&info->src, ipSrcStr, sizeof (ipSrcStr));
+        ipAddrToStr (&info->dest, ipDestStr, sizeof (ipDestStr));
 
         if (getAppServiceProtoAnalyzer (ipSrcStr, ntohs (tcph->source)) ||
             getAppServiceProtoAnalyzer (ipDestStr, ntohs (tcph->dest)))
@@ -76,200 +267,183 @@ ipPktShouldDrop (iphdrPtr iph) {
     return False;
 }
 
+/**
+ * @brief Alloc new ip fragment and copy ip data of packet, ip fragment
+ *        with small data is taken from ip fragment pool.
+ *
+ * @param iph -- ip fragment packet
+ * @param info -- ip fragment packet info
+ *
+ * @return new ip fragment if success else NULL
+ */
 static ipFragPtr
-newIpFrag (iphdrPtr iph) {
-    u_short iphLen, ipLen, offset, end;
-    u_char *skbuf;
-    ipFragPtr ipFragment;
-
-    iphLen = iph->iphLen * 4;
-    ipLen = ntohs (iph->ipLen);
-    offset = (ntohs (iph->ipOff) & IP_OFFMASK) << 3;
-    end = offset + ipLen - iphLen;
-
-    ipFragment = (ipFragPtr) malloc (sizeof (ipFrag));
-    if (ipFragment == NULL)
-        return NULL;
+newIpFrag (iphdrPtr iph, ipPktInfoPtr info) {
+    u_int dataLen, bufSize;
+    ipFragPtr ipf;
 
-    ipFragment->offset = offset;
-    ipFragment->end = end;
-    ipFragment->dataLen = end - offset;
-    skbuf = (u_char *) malloc (ipLen);
-    if (skbuf == NULL) {
-        free (ipFragment);
-        return NULL;
+    dataLen = info->len - info->hdrLen;
+
+    if (dataLen <= IPFRAG_POOL_BUFFER_SIZE && ipFragPoolSize) {
+        ipf = listHeadEntry (&ipFragPool, ipFrag, node);
+        listDel (&ipf->node);
+        ipFragPoolSize--;
+    } else {
+        if (dataLen <= IPFRAG_POOL_BUFFER_SIZE)
+            bufSize = IPFRAG_POOL_BUFFER_SIZE;
+        else
+            bufSize = dataLen;
+
+        ipf = (ipFragPtr) malloc (sizeof (ipFrag) + bufSize);
+        if (ipf == NULL)
+            return NULL;
+        ipf->bufSize = bufSize;
     }
-    memcpy (skbuf, iph, ipLen);
-    ipFragment->dataPtr = skbuf + iphLen;
-    ipFragment->skbuf = skbuf;
-    initListHead (&ipFragment->node);
-    return ipFragment;
+
+    ipf->offset = info->fragOffset;
+    ipf->end = info->fragOffset + dataLen;
+    ipf->dataLen = dataLen;
+    memcpy (ipf->buf, (u_char *) iph + info->hdrLen, ipf->dataLen);
+    ipf->dataPtr = ipf->buf;
+    initListHead (&ipf->node);
+    return ipf;
 }
 
+/* Free ip fragment, return it to ip fragment pool if possible */
 static void
 freeIpFrag (ipFragPtr ipf) {
-    free (ipf->skbuf);
-    free (ipf);
+    if (ipf->bufSize == IPFRAG_POOL_BUFFER_SIZE &&
+        ipFragPoolSize < IPFRAG_POOL_MAX_SIZE) {
+        listAdd (&ipf->node, &ipFragPool);
+        ipFragPoolSize++;
+    } else
+        free (ipf);
 }
 
 static void
-addIpQueueToExpireTimeoutList (ipQueuePtr ipq, timeValPtr tm) {
-    ipQueueTimeoutPtr tmp;
+ipQueueKeyInit (ipQueueKeyPtr key, ipPktInfoPtr info) {
+    key->ipSrc = info->src;
+    key->ipDest = info->dest;
+    key->id = info->fragId;
+    key->proto = info->proto;
+}
 
-    tmp = (ipQueueTimeoutPtr) malloc (sizeof (ipQueueTimeout));
-    if (tmp == NULL) {
-        LOGE ("Alloc ipQueue expire timeout error: %s.\n", strerror (errno));
-        return;
-    }
+static u_int
+ipQueueKeyHash (ipQueueKeyPtr key) {
+    u_int hash;
 
-    tmp->queue = ipq;
-    tmp->timeout = tm->tvSec + DEFAULT_IPQUEUE_EXPIRE_TIMEOUT;
-    listAddTail (&tmp->node, &ipQueueExpireTimeoutList);
-}
+    hash = ipAddrHash (&key->ipSrc);
+    hash ^= ipAddrHash (&key->ipDest) + 0x9E3779B9U + (hash << 6) + (hash >> 2);
+    hash ^= ((key->id << 8) ^ key->proto) + 0x9E3779B9U + (hash << 6) + (hash >> 2);
 
-static void
-delIpQueueFromExpireTimeoutList (ipQueuePtr ipq) {
-    ipQueueTimeoutPtr entry;
-    listHeadPtr pos, npos;
+    return hash & (IPQUEUE_HASH_BUCKETS - 1);
+}
 
-    listForEachEntrySafe (entry, pos, npos, &ipQueueExpireTimeoutList, node) {
-        if (entry->queue == ipq) {
-            listDel (&entry->node);
-            free (entry);
-            return;
-        }
-    }
+static boolean
+ipQueueKeyEqual (ipQueueKeyPtr key1, ipQueueKeyPtr key2) {
+    return (key1->id == key2->id &&
+            key1->proto == key2->proto &&
+            ipAddrIsEqual (&key1->ipSrc, &key2->ipSrc) &&
+            ipAddrIsEqual (&key1->ipDest, &key2->ipDest));
 }
 
-static void
-updateIpQueueExpireTimeout (ipQueuePtr ipq, timeValPtr tm) {
-    ipQueueTimeoutPtr entry;
-    listHeadPtr pos, npos;
+static ipQueuePtr
+findIpQueue (ipQueueKeyPtr key) {
+    ipQueuePtr entry;
+    listHeadPtr pos;
 
-    listForEachEntrySafe (entry, pos, npos, &ipQueueExpireTimeoutList, node) {
-        if (entry->queue == ipq) {
-            listDel (&entry->node);
-            entry->timeout = tm->tvSec + DEFAULT_IPQUEUE_EXPIRE_TIMEOUT;
-            listAddTail (&entry->node, &ipQueueExpireTimeoutList);
-            return;
-        }
+    listForEachEntry (entry, pos, &ipQueueHashBuckets [ipQueueKeyHash (key)], hashNode) {
+        if (ipQueueKeyEqual (&entry->key, key))
+            return entry;
     }
-}
 
-static int
-addIpQueueToHash (ipQueuePtr ipq, hashItemFreeCB fun) {
-    int ret;
-    char ipSrcStr [16], ipDestStr [16];
-    char key [64];
-
-    inet_ntop (AF_INET, (void *) &ipq->ipSrc, ipSrcStr, sizeof (ipSrcStr));
-    inet_ntop (AF_INET, (void *) &ipq->ipDest, ipDestStr, sizeof (ipDestStr));
-    snprintf (key, sizeof (key), IPQUEUE_HASH_KEY_FORMAT, ipSrcStr, ipDestStr, ipq->id);
-    ret = hashInsert (ipQueueHashTable, key, ipq, fun);
-    if (ret < 0)
-        return -1;
-    else
-        return 0;
+    return NULL;
 }
 
+/* Update ipQueue expire timeout, list is kept ordered by timeout */
 static void
-delIpQueueFromHash (ipQueuePtr ipq) {
-    int ret;
-    char ipSrcStr [16], ipDestStr [16];
-    char key [64];
-
-    inet_ntop (AF_INET, (void *) &ipq->ipSrc, ipSrcStr, sizeof (ipSrcStr));
-    inet_ntop (AF_INET, (void *) &ipq->ipDest, ipDestStr, sizeof (ipDestStr));
-    snprintf (key, sizeof (key), IPQUEUE_HASH_KEY_FORMAT, ipSrcStr, ipDestStr, ipq->id);
-    ret = hashRemove (ipQueueHashTable, key);
-    if (ret < 0)
-        LOGE ("Delete ipQueue from hash table error.\n");
-}
-
-static ipQueuePtr
-findIpQueue (iphdrPtr iph) {
-    char ipSrcStr [16], ipDestStr [16];
-    char key [64];
-
-    inet_ntop (AF_INET, (void *) &iph->ipSrc, ipSrcStr, sizeof (ipSrcStr));
-    inet_ntop (AF_INET, (void *) &iph->ipDest, ipDestStr, sizeof (ipDestStr));
-    snprintf (key, sizeof (key), IPQUEUE_HASH_KEY_FORMAT,
-              ipSrcStr, ipDestStr, ntohs (iph->ipId));
-    return (ipQueuePtr) hashLookup (ipQueueHashTable, key);
+updateIpQueueExpireTimeout (ipQueuePtr ipq, timeValPtr tm) {
+    listDel (&ipq->timeoutNode);
+    ipq->timeout = tm->tvSec + DEFAULT_IPQUEUE_EXPIRE_TIMEOUT;
+    listAddTail (&ipq->timeoutNode, &ipQueueExpireTimeoutList);
 }
 
+/* Alloc new ipQueue and add it to hash buckets and expire timeout list */
 static ipQueuePtr
-newIpQueue (iphdrPtr iph) {
+newIpQueue (ipQueueKeyPtr key, timeValPtr tm) {
     ipQueuePtr ipq;
 
     ipq = (ipQueuePtr) malloc (sizeof (ipQueue));
     if (ipq == NULL)
         return NULL;
 
-    ipq->ipSrc = iph->ipSrc;
-    ipq->ipDest = iph->ipDest;
-    ipq->id = ntohs (iph->ipId);
-    /* Allocate memory for the IP header (plus 8 octets for ICMP). */
-    ipq->iph = (iphdrPtr) malloc (64 + 8);
-    if (ipq->iph == NULL) {
-        free (ipq);
-        return NULL;
-    }
+    ipq->key = *key;
     ipq->iphLen = 0;
     ipq->dataLen = 0;
+    ipq->recvLen = 0;
+    ipq->timeout = tm->tvSec + DEFAULT_IPQUEUE_EXPIRE_TIMEOUT;
     initListHead (&ipq->fragments);
+    listAdd (&ipq->hashNode, &ipQueueHashBuckets [ipQueueKeyHash (key)]);
+    listAddTail (&ipq->timeoutNode, &ipQueueExpireTimeoutList);
+
+    ipQueueNum++;
+    METRICS_GAUGE_SET (METRIC_IP_FRAGMENT_QUEUES, ipQueueNum);
     return ipq;
 }
 
+/* Remove ipQueue from hash buckets and expire timeout list and free it */
 static void
-freeIpQueue (void *data) {
+freeIpQueue (ipQueuePtr ipq) {
     ipFragPtr entry;
     listHeadPtr pos, npos;
-    ipQueuePtr ipq = (ipQueuePtr) data;
 
-    delIpQueueFromExpireTimeoutList (ipq);
+    listDel (&ipq->hashNode);
+    listDel (&ipq->timeoutNode);
     listForEachEntrySafe (entry, pos, npos, &ipq->fragments, node) {
         listDel (&entry->node);
         freeIpFrag (entry);
     }
-    free (ipq->iph);
     free (ipq);
+
+    ipQueueNum--;
+    METRICS_GAUGE_SET (METRIC_IP_FRAGMENT_QUEUES, ipQueueNum);
 }
 
 static void
 checkIpQueueExpireTimeoutList (timeValPtr tm) {
-    ipQueueTimeoutPtr entry;
+    ipQueuePtr entry;
     listHeadPtr pos, npos;
 
-    listForEachEntrySafe (entry, pos, npos, &ipQueueExpireTimeoutList, node) {
+    listForEachEntrySafe (entry, pos, npos, &ipQueueExpireTimeoutList, timeoutNode) {
         if (tm->tvSec < entry->timeout)
             return;
         else
-            delIpQueueFromHash (entry->queue);
+            freeIpQueue (entry);
     }
 }
 
+/* Check whether fragments of ipQueue cover ip data without holes */
 static boolean
 ipQueueDone (ipQueuePtr ipq) {
     ipFragPtr entry;
-    listHeadPtr pos, npos;
+    listHeadPtr pos;
     u_short offset;
 
-    if (!ipq->dataLen)
+    if (!ipq->dataLen || ipq->recvLen < ipq->dataLen)
         return False;
 
     offset = 0;
-    listForEachEntrySafe (entry, pos, npos, &ipq->fragments, node) {
+    listForEachEntry (entry, pos, &ipq->fragments, node) {
         if (entry->offset != offset)
             return False;
         offset = entry->end;
     }
 
-    return True;
+    return offset == ipq->dataLen;
 }
 
 /**
- * @brief Glue ip fragments of ipQueue.
+ * @brief Gather ip fragments of ipQueue to new ip packet, ipQueue
+ *        will be freed. Ipv6 packet is glued with fixed header only.
  *
  * @param ipq -- ipQueue to glue
  *
@@ -278,62 +452,75 @@ ipQueueDone (ipQueuePtr ipq) {
 static iphdrPtr
 glueIpQueue (ipQueuePtr ipq) {
     u_int ipLen;
-    char ipStr [16];
+    char ipStr [IP_ADDR_STR_MAX_LENGTH];
     u_char *buf;
     iphdrPtr iph;
     ipFragPtr entry;
-    listHeadPtr pos, npos;
+    listHeadPtr pos;
 
     ipLen = ipq->iphLen + ipq->dataLen;
-    if (ipLen > MAX_IP_PACKET_SIZE) {
-        inet_ntop (AF_INET, (void *) &ipq->ipSrc, ipStr, sizeof (ipStr));
-        LOGE ("Oversized ip packet from %s.\n", ipStr);
-        delIpQueueFromHash (ipq);
+    /* Ipv6 payload length never exceeds MAX_IP_PACKET_SIZE */
+    if (ipq->key.ipSrc.family == AF_INET && ipLen > MAX_IP_PACKET_SIZE) {
+        ipAddrToStr (&ipq->key.ipSrc, ipStr, sizeof (ipStr));
+        LOGE_RL ("Oversized ip packet from %s.\n", ipStr);
+        freeIpQueue (ipq);
         return NULL;
     }
 
     buf = (u_char *) malloc (ipLen);
     if (buf == NULL) {
         LOGE ("Alloc ipQueue buffer error: %s.\n", strerror (errno));
-        delIpQueueFromHash (ipq);
+        freeIpQueue (ipq);
         return NULL;
     }
 
     /* Glue data of all fragments to new ip packet buffer . */
-    memcpy (buf, ((u_char *) ipq->iph), ipq->iphLen);
-    listForEachEntrySafe (entry, pos, npos, &ipq->fragments, node) {
+    memcpy (buf, ipq->iph, ipq->iphLen);
+    listForEachEntry (entry, pos, &ipq->fragments, node) {
+        if (entry->offset + entry->dataLen > ipq->dataLen) {
+            LOGE_RL ("Ip fragment beyond end of ip packet.\n");
+            free (buf);
+            freeIpQueue (ipq);
+            return NULL;
+        }
         memcpy (buf + ipq->iphLen + entry->offset, entry->dataPtr, entry->dataLen);
     }
 
     iph = (iphdrPtr) buf;
-    iph->ipOff = 0;
-    iph->ipLen = htons (ipLen);
-    delIpQueueFromHash (ipq);
+    if (ipq->key.ipSrc.family == AF_INET) {
+        iph->ipOff = 0;
+        iph->ipLen = htons (ipLen);
+    } else
+        ((ip6hdrPtr) iph)->ip6PayloadLen = htons (ipq->dataLen);
+    freeIpQueue (ipq);
 
     return iph;
 }
 
 static int
-checkIpHeader (iphdrPtr iph) {
-    u_char ipVer = iph->ipVer;
-    u_short iphLen = iph->iphLen * 4;
-    u_short ipLen = ntohs (iph->ipLen);
+checkIpHeader (iphdrPtr iph, ipPktInfoPtr info) {
+    int ret;
 
-    if (ipVer != 4 || iphLen < sizeof (iphdr) || ipLen < iphLen) {
-        LOGE ("IpVer: %d, iphLen: %d, ipLen: %d.\n", ipVer, iphLen, ipLen);
+    ret = getIpPktInfo (iph, info);
+    if (ret < 0) {
+        LOGE_RL ("IpVer: %d, iphLen: %u, ipLen: %u.\n", iph->ipVer, info->hdrLen, info->len);
         return -1;
     }
 
+    /* Ip checksum and options are for ipv4 only */
+    if (iph->ipVer != 4)
+        return 0;
+
 #ifdef DO_STRICT_CHECK
     /* Normally don't do ip checksum, we trust kernel */
-    if (ipFastCheckSum ((u_char *) iph, iph->iphl)) {
-        LOGE ("ipFastCheckSum error.\n");
+    if (ipFastCheckSum ((u_char *) iph, iph->iphLen)) {
+        LOGE_RL ("ipFastCheckSum error.\n");
         return -1;
     }
 
     /* Check ip options */
-    if (iphLen > sizeof (iphdr) && ipOptionsCompile ((u_char *) iph)) {
-        LOGE ("IpOptionsCompile error.\n");
+    if (info->hdrLen > sizeof (iphdr) && ipOptionsCompile ((u_char *) iph)) {
+        LOGE_RL ("IpOptionsCompile error.\n");
         return -1;
     }
 #endif
@@ -342,7 +529,8 @@ checkIpHeader (iphdrPtr iph) {
 }
 
 /**
- * @brief Ip packet defragment processor.
+ * @brief Ip packet defragment processor, both ipv4 and ipv6 fragments
+ *        are reassembled.
  *
  * @param iph -- ip packet header
  * @param tm -- packet capture timestamp
@@ -354,86 +542,124 @@ int
 ipDefragProcess (iphdrPtr iph, timeValPtr tm, iphdrPtr *newIph) {
     int ret;
     timeVal timestamp;
-    u_short iphLen, ipLen, offset, end, flags, gap;
-    ipFragPtr ipf, prevEntry, entry;
+    u_short gap;
+    ipPktInfo info;
+    ipQueueKey key;
+    ipFragPtr ipf, prevEntry, entry, tailEntry;
     listHeadPtr pos, npos;
     ipQueuePtr ipq;
     iphdrPtr tmpIph;
 
-    timestamp.tvSec = ntohll (tm->tvSec);
-    timestamp.tvUsec = ntohll (tm->tvUsec);
-
-    /* Check ipQueue expire timeout list */
-    checkIpQueueExpireTimeoutList (&timestamp);
-    ret = checkIpHeader (iph);
+    ret = checkIpHeader (iph, &info);
     if (ret < 0) {
+        METRICS_DROP (DROP_REASON_IP_HEADER);
         *newIph = NULL;
         return -1;
     }
 
-    iphLen = iph->iphLen * 4;
-    ipLen = ntohs (iph->ipLen);
-    offset = ntohs (iph->ipOff);
-    flags = offset & ~IP_OFFMASK;
-    offset = (offset & IP_OFFMASK) << 3;
-    end = offset + ipLen - iphLen;
+    /* Fast path of non-fragment when no fragments are outstanding */
+    if (ipQueueNum == 0 && !info.moreFrags && info.fragOffset == 0) {
+        if (!doProtoDetect && ipPktShouldDrop (iph, &info)) {
+            METRICS_DROP (DROP_REASON_IP_FILTERED);
+            *newIph = NULL;
+        } else
+            *newIph = iph;
+        return 0;
+    }
+
+    timestamp.tvSec = ntohll (tm->tvSec);
+    timestamp.tvUsec = ntohll (tm->tvUsec);
+
+    /* Check ipQueue expire timeout list */
+    checkIpQueueExpireTimeoutList (&timestamp);
 
     /* Get ipQueue */
-    ipq = findIpQueue (iph);
+    ipQueueKeyInit (&key, &info);
+    ipq = ipQueueNum ? findIpQueue (&key) : NULL;
 
     /* Not a ip fragment */
-    if ((flags & IP_MF) == 0 && offset == 0) {
+    if (!info.moreFrags && info.fragOffset == 0) {
         if (ipq)
-            delIpQueueFromHash (ipq);
-        if (!doProtoDetect && ipPktShouldDrop (iph))
+            freeIpQueue (ipq);
+        if (!doProtoDetect && ipPktShouldDrop (iph, &info)) {
+            METRICS_DROP (DROP_REASON_IP_FILTERED);
             *newIph = NULL;
-        else
+        } else
             *newIph = iph;
         return 0;
     }
 
-    displayIphdr (iph);
+    displayIphdr (&info);
+
+    if (info.fragOffset + info.len - info.hdrLen > MAX_IP_PACKET_SIZE) {
+        LOGE_RL ("Oversized ip fragment.\n");
+        METRICS_DROP (DROP_REASON_IP_DEFRAG);
+        *newIph = NULL;
+        return -1;
+    }
 
     if (ipq == NULL) {
-        ipq = newIpQueue (iph);
-        if (ipq == NULL) {
-            LOGE ("Alloc new ipQueue error.\n");
+        if (ipQueueNum >= MAX_IPQUEUE_NUM) {
+            LOGE_RL ("Too many ipQueues.\n");
+            METRICS_DROP (DROP_REASON_IP_DEFRAG);
             *newIph = NULL;
             return -1;
         }
 
-        /* Add ipQueue to hash */
-        ret = addIpQueueToHash (ipq, freeIpQueue);
-        if (ret < 0) {
-            LOGE ("Add ipQueue to hash table error.\n");
+        ipq = newIpQueue (&key, &timestamp);
+        if (ipq == NULL) {
+            LOGE ("Alloc new ipQueue error.\n");
+            METRICS_DROP (DROP_REASON_NO_MEMORY);
             *newIph = NULL;
             return -1;
         }
-
-        /* Add ipQueue to expire timeout list */
-        addIpQueueToExpireTimeoutList (ipq, &timestamp);
     } else {
         /* Update ipQueue expire timeout */
         updateIpQueueExpireTimeout (ipq, &timestamp);
     }
 
     /* Alloc new ipFrag */
-    ipf = newIpFrag (iph);
+    ipf = newIpFrag (iph, &info);
     if (ipf == NULL) {
         LOGE ("Create ip fragment error.\n");
+        METRICS_DROP (DROP_REASON_NO_MEMORY);
         *newIph = NULL;
         return -1;
     }
 
     /* First packet of fragments */
-    if (offset == 0) {
-        ipq->iphLen = iphLen;
-        memcpy (ipq->iph, iph, iphLen + 8);
+    if (info.fragOffset == 0) {
+        if (info.src.family == AF_INET) {
+            ipq->iphLen = info.hdrLen;
+            memcpy (ipq->iph, iph, MIN_NUM (info.len, info.hdrLen + 8));
+        } else {
+            /* Unfragmentable part of ipv6 fragment is not kept */
+            ipq->iphLen = IP6_HEADER_LEN;
+            memcpy (ipq->iph, iph, IP6_HEADER_LEN);
+            ((ip6hdrPtr) ipq->iph)->ip6NextHeader = info.proto;
+        }
     }
 
     /* Last packet of fragments */
-    if ((flags & IP_MF) == 0)
-        ipq->dataLen = end;
+    if (!info.moreFrags) {
+        /* Conflicting last fragment or received data beyond its end */
+        tailEntry = listTailEntry (&ipq->fragments, ipFrag, node);
+        if ((ipq->dataLen && ipq->dataLen != ipf->end) ||
+            (tailEntry && tailEntry->end > ipf->end)) {
+            LOGE_RL ("Inconsistent last ip fragment.\n");
+            METRICS_DROP (DROP_REASON_IP_DEFRAG);
+            freeIpFrag (ipf);
+            *newIph = NULL;
+            return -1;
+        }
+        ipq->dataLen = ipf->end;
+    } else if (ipq->dataLen && ipf->end > ipq->dataLen) {
+        LOGE_RL ("Ip fragment beyond end of ip packet.\n");
+        METRICS_DROP (DROP_REASON_IP_DEFRAG);
+        freeIpFrag (ipf);
+        *newIph = NULL;
+        return -1;
+    }
 
     /* Find the proper position to insert fragment */
     listForEachEntrySafeKeepPrev (prevEntry, entry, pos, npos, &ipq->fragments, node) {
@@ -463,9 +689,11 @@ ipDefragProcess (iphdrPtr iph, timeValPtr tm, iphdrPtr *newIph) {
         gap = ipf->end - entry->offset;
         /* If ipf overlap succeeding fragment completely, remove it */
         if (gap >= entry->dataLen) {
+            ipq->recvLen -= entry->dataLen;
             listDel (&entry->node);
             freeIpFrag (entry);
         } else {
+            ipq->recvLen -= gap;
             entry->offset += gap;
             entry->dataLen -= gap;
             entry->dataPtr += gap;
@@ -477,16 +705,28 @@ ipDefragProcess (iphdrPtr iph, timeValPtr tm, iphdrPtr *newIph) {
         listAdd (&ipf->node, &ipq->fragments);
     else
         listAdd (&ipf->node, &prevEntry->node);
+    ipq->recvLen += ipf->dataLen;
 
     if (ipQueueDone (ipq)) {
         tmpIph = (iphdrPtr) glueIpQueue (ipq);
         if (tmpIph == NULL) {
             LOGE ("glueIpQueue error.\n");
+            METRICS_DROP (DROP_REASON_IP_DEFRAG);
             *newIph = NULL;
             return -1;
         } else {
-            displayIphdr (tmpIph);
-            if (!doProtoDetect && ipPktShouldDrop (tmpIph)) {
+            ret = getIpPktInfo (tmpIph, &info);
+            if (ret < 0) {
+                LOGE_RL ("Invalid ip defragment packet.\n");
+                METRICS_DROP (DROP_REASON_IP_DEFRAG);
+                free (tmpIph);
+                *newIph = NULL;
+                return -1;
+            }
+
+            displayIphdr (&info);
+            if (!doProtoDetect && ipPktShouldDrop (tmpIph, &info)) {
+                METRICS_DROP (DROP_REASON_IP_FILTERED);
                 free (tmpIph);
                 *newIph = NULL;
             } else
@@ -499,10 +739,21 @@ ipDefragProcess (iphdrPtr iph, timeValPtr tm, iphdrPtr *newIph) {
     }
 }
 
+/* Free all ipQueues */
+static void
+cleanIpQueues (void) {
+    ipQueuePtr entry;
+    listHeadPtr pos, npos;
+
+    listForEachEntrySafe (entry, pos, npos, &ipQueueExpireTimeoutList, timeoutNode) {
+        freeIpQueue (entry);
+    }
+}
+
 /* Reset ip context */
 int
 resetIpContext (void) {
-    hashClean (ipQueueHashTable);
+    cleanIpQueues ();
 
     return 0;
 }
@@ -510,20 +761,38 @@ resetIpContext (void) {
 /* Init ip context */
 int
 initIpContext (boolean protoDetectFlag) {
+    u_int i;
+
     doProtoDetect = protoDetectFlag;
 
     initListHead (&ipQueueExpireTimeoutList);
+    initListHead (&ipFragPool);
+    ipFragPoolSize = 0;
+    ipQueueNum = 0;
 
-    ipQueueHashTable = hashNew (DEFAULT_IPQUEUE_HASH_TABLE_SIZE);
-    if (ipQueueHashTable == NULL)
+    ipQueueHashBuckets = (listHeadPtr) malloc (sizeof (listHead) * IPQUEUE_HASH_BUCKETS);
+    if (ipQueueHashBuckets == NULL)
         return -1;
 
+    for (i = 0; i < IPQUEUE_HASH_BUCKETS; i++)
+        initListHead (&ipQueueHashBuckets [i]);
+
     return 0;
 }
 
 /* Destroy ip context */
 void
 destroyIpContext (void) {
-    hashDestroy (ipQueueHashTable);
-    ipQueueHashTable = NULL;
+    ipFragPtr entry;
+    listHeadPtr pos, npos;
+
+    cleanIpQueues ();
+    free (ipQueueHashBuckets);
+    ipQueueHashBuckets = NULL;
+
+    listForEachEntrySafe (entry, pos, npos, &ipFragPool, node) {
+        listDel (&entry->node);
+        free (entry);
+    }
+    ipFragPoolSize = 0;
 }
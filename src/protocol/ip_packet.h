@@ -6,6 +6,31 @@
 #include "util.h"
 #include "list.h"
 #include "ip.h"
+#include "ip6.h"
+
+typedef struct _ipPktInfo ipPktInfo;
+typedef ipPktInfo *ipPktInfoPtr;
+
+/*
+ * Ipv4 or ipv6 packet info. For ipv6 packet, extension headers are
+ * walked until upper layer header or fragment header, so hdrLen is
+ * the offset of upper layer header or fragmentable part.
+ */
+struct _ipPktInfo {
+    ipAddr src;                         /**< Ip source */
+    ipAddr dest;                        /**< Ip dest */
+    u_char proto;                       /**< Upper layer proto */
+    u_int hdrLen;                       /**< Ip header length including ipv6 extension headers */
+    u_int len;                          /**< Ip packet length */
+    u_short fragOffset;                 /**< Ip fragment offset in bytes */
+    boolean moreFrags;                  /**< Ip more fragments flag */
+    u_int fragId;                       /**< Ip fragment id */
+};
+
+/* Data buffer size of pooled ip fragment, larger fragment is not pooled */
+#define IPFRAG_POOL_BUFFER_SIZE 2048
+/* Ip header buffer size of ipQueue (plus 8 octets for ICMP) */
+#define IPQUEUE_IPH_BUFFER_SIZE (64 + 8)
 
 typedef struct _ipFrag ipFrag;
 typedef ipFrag *ipFragPtr;
@@ -15,33 +40,49 @@ struct _ipFrag {
     u_short end;                        /**< Ip fragment end */
     u_short dataLen;                    /**< Ip fragment length */
     u_char *dataPtr;                    /**< Ip fragment data */
-    u_char *skbuf;                      /**< Ip fragment packet buffer */
-    listHead node;                      /**< Ipqueue fragments list node */
+    u_int bufSize;                      /**< Ip fragment data buffer size */
+    listHead node;                      /**< Ipqueue fragments list or pool node */
+    u_char buf [];                      /**< Ip fragment data buffer */
+};
+
+typedef struct _ipQueueKey ipQueueKey;
+typedef ipQueueKey *ipQueueKeyPtr;
+
+struct _ipQueueKey {
+    ipAddr ipSrc;                       /**< Ip source */
+    ipAddr ipDest;                      /**< Ip dest */
+    u_int id;                           /**< Ip id, ipv6 fragment identification for ipv6 */
+    u_char proto;                       /**< Ip proto */
 };
 
 typedef struct _ipQueue ipQueue;
 typedef ipQueue *ipQueuePtr;
 
 struct _ipQueue {
-    struct in_addr ipSrc;               /**< Ip source */
-    struct in_addr ipDest;              /**< Ip dest */
-    u_short id;                         /**< Ip id */
-    iphdrPtr iph;                       /**< Ip header */
+    ipQueueKey key;                     /**< IpQueue key */
     u_short iphLen;                     /**< Ip header length */
-    u_short dataLen;                    /**< Ip data length */
-    listHead fragments;                 /**< Ip fragments list */
-};
-
-typedef struct _ipQueueTimeout ipQueueTimeout;
-typedef ipQueueTimeout *ipQueueTimeoutPtr;
-
-struct _ipQueueTimeout {
-    ipQueuePtr queue;                   /**< Ip fragment queue */
+    u_short dataLen;                    /**< Ip data length, 0 if last fragment not received */
+    u_int recvLen;                      /**< Ip data length received */
     u_long_long timeout;                /**< Ip fragment queue timeout */
-    listHead node;                      /**< Ip fragment queue timout list node */
+    u_char iph [IPQUEUE_IPH_BUFFER_SIZE]; /**< Ip header of the first fragment */
+    listHead fragments;                 /**< Ip fragments list ordered by offset */
+    listHead hashNode;                  /**< IpQueue hash bucket node */
+    listHead timeoutNode;               /**< IpQueue expire timeout list node */
 };
 
 /*========================Interfaces definition============================*/
+boolean
+ipAddrIsEqual (ipAddrPtr addr1, ipAddrPtr addr2);
+u_int
+ipAddrHash (ipAddrPtr addr);
+u_int
+ipPktDispatchHash (iphdrPtr iph, ipPktInfoPtr info);
+char *
+ipAddrToStr (ipAddrPtr addr, char *buf, u_int bufLen);
+u_int
+getIpPktLen (iphdrPtr iph);
+int
+getIpPktInfo (iphdrPtr iph, ipPktInfoPtr info);
 int
 ipDefragProcess (iphdrPtr iph, timeValPtr tm, iphdrPtr *newIph);
 int
@@ -3,81 +3,51 @@
 #include "properties.h"
 #include "signals.h"
 #include "log.h"
+#include "metrics.h"
+#include "probes.h"
 #include "zmq_hub.h"
 #include "task_manager.h"
 #include "ownership_manager.h"
 #include "ip.h"
 #include "tcp.h"
 #include "ip_packet.h"
+#include "packet_dedup.h"
+#include "packet_reorder.h"
 #include "ip_process_service.h"
 
-static u_int
-dispatchHash (const char *key1, const char *key2) {
-    u_int sum, hash = 0;
-    u_int seed = 16777619;
-    const char *tmp;
-
-    if (strlen (key1) < strlen (key2)) {
-        tmp = key1;
-        key1 = key2;
-        key2 = tmp;
-    }
-
-    while (*key2) {
-        hash *= seed;
-        sum = *key1 + *key2;
-        hash ^= sum;
-        key1++;
-        key2++;
-    }
-
-    while (*key1) {
-        hash *= seed;
-        hash ^= (size_t) (*key1);
-        key1++;
-    }
-
-    return hash;
-}
-
 /**
  * @brief Dispatch timestamp and ip packet to local or remote
  *        tcp packet dispatch service.
  *
  * @param iph -- ip packet to dispatch
- * @param tm -- timestamp to dispatch
+ * @param info -- ip packet info
+ * @param timestamp -- packet timestamp to dispatch
  */
 static void
-tcpPacketDispatch (iphdrPtr iph, timeValPtr tm) {
+tcpPacketDispatch (iphdrPtr iph, ipPktInfoPtr info, pktTimestampPtr timestamp) {
     int ret;
     u_int hash;
     u_int ipPktLen;
-    tcphdrPtr tcph;
-    char ipSrcStr [16], ipDestStr [16];
-    char key1 [32], key2 [32];
     zframe_t *frame;
     void *tcpPktSendSock = NULL;
 
-    ipPktLen = ntohs (iph->ipLen);
-
-    tcph = (tcphdrPtr) ((u_char *) iph + (iph->iphLen * 4));
-    inet_ntop (AF_INET, (void *) &iph->ipSrc, ipSrcStr, sizeof (ipSrcStr));
-    inet_ntop (AF_INET, (void *) &iph->ipDest, ipDestStr, sizeof (ipDestStr));
-    snprintf (key1, sizeof (key1), "%s:%d", ipSrcStr, ntohs (tcph->source));
-    snprintf (key2, sizeof (key2), "%s:%d", ipDestStr, ntohs (tcph->dest));
+    ipPktLen = info->len;
 
-    hash = dispatchHash (key1, key2);
+    hash = ipPktDispatchHash (iph, info);
     tcpPktSendSock = getOwnershipPktDispatchSock (hash);
+    NTRACE_PROBE2 (tcp__dispatch, hash, ipPktLen);
 
     /* Send tm zframe */
-    frame = zframe_new (tm, sizeof (timeVal));
+    frame = zframe_new (timestamp, sizeof (pktTimestamp));
     if (frame == NULL) {
         LOGE ("Create timestamp zframe error.\n");
+        METRICS_DROP (DROP_REASON_NO_MEMORY);
         return;
     }
     ret = zframe_send (&frame, tcpPktSendSock, ZFRAME_MORE);
     if (ret < 0) {
         LOGE ("Send tm zframe error.\n");
+        METRICS_DROP (DROP_REASON_SEND);
         return;
     }
 
@@ -85,13 +55,17 @@ tcpPacketDispatch (iphdrPtr iph, timeValPtr tm) {
     frame = zframe_new (iph, ipPktLen);
     if (frame == NULL) {
         LOGE ("Create ip packet zframe error.");
+        METRICS_DROP (DROP_REASON_NO_MEMORY);
         return;
     }
     ret = zframe_send (&frame, tcpPktSendSock, 0);
     if (ret < 0) {
         LOGE ("Send ip packet zframe error.\n");
+        METRICS_DROP (DROP_REASON_SEND);
         return;
     }
+
+    METRICS_COUNTER_INC (METRIC_PACKETS_SENT);
 }
 
 /**
@@ -99,10 +73,10 @@ tcpPacketDispatch (iphdrPtr iph, timeValPtr tm) {
  *        packet process service.
  *
  * @param iph -- ip packet to dispatch
- * @param tm -- capture timestamp to dispatch
+ * @param timestamp -- packet timestamp to dispatch
  */
 static void
-icmpPacketDispatch (iphdrPtr iph, timeValPtr tm) {
+icmpPacketDispatch (iphdrPtr iph, pktTimestampPtr timestamp) {
     int ret;
     u_int ipPktLen;
     zframe_t *frame;
@@ -114,14 +88,16 @@ icmpPacketDispatch (iphdrPtr iph, timeValPtr tm) {
     icmpPktSendSock = getIcmpPktSendSock ();
 
     /* Send tm zframe */
-    frame = zframe_new (tm, sizeof (timeVal));
+    frame = zframe_new (timestamp, sizeof (pktTimestamp));
     if (frame == NULL) {
         LOGE ("Create timestamp zframe error.\n");
+        METRICS_DROP (DROP_REASON_NO_MEMORY);
         return;
     }
     ret = zframe_send (&frame, icmpPktSendSock, ZFRAME_MORE);
     if (ret < 0) {
         LOGE ("Send tm zframe error.\n");
+        METRICS_DROP (DROP_REASON_SEND);
         return;
     }
 
@@ -129,30 +105,102 @@ icmpPacketDispatch (iphdrPtr iph, timeValPtr tm) {
     frame = zframe_new (iph, ipPktLen);
     if (frame == NULL) {
         LOGE ("Create ip packet zframe error.");
+        METRICS_DROP (DROP_REASON_NO_MEMORY);
         return;
     }
     ret = zframe_send (&frame, icmpPktSendSock, 0);
     if (ret < 0) {
         LOGE ("Send ip packet zframe error.\n");
+        METRICS_DROP (DROP_REASON_SEND);
         return;
     }
+
+    METRICS_COUNTER_INC (METRIC_PACKETS_SENT);
+    METRICS_COUNTER_INC (METRIC_ICMP_QUEUE_ENQUEUED);
+}
+
+/**
+ * @brief Process ip packet received from rawCaptureService, do ip
+ *        defrag process, suppress duplicate tcp packet of mirror ports
+ *        and dispatch it.
+ *
+ * @param tmFrame -- packet timestamp zframe
+ * @param ipPktFrame -- ip packet zframe
+ */
+static void
+ipPacketProcess (zframe_t *tmFrame, zframe_t *ipPktFrame) {
+    int ret;
+    pktTimestampPtr timestamp;
+    timeValPtr tm;
+    iphdrPtr iph;
+    iphdrPtr newIph;
+    ipPktInfo ipInfo;
+
+    timestamp = (pktTimestampPtr) zframe_data (tmFrame);
+    tm = &timestamp->captureTime;
+    iph = (iphdrPtr) zframe_data (ipPktFrame);
+
+    /* Ip packet defrag process */
+    ret = ipDefragProcess (iph, tm, &newIph);
+    if (ret < 0)
+        LOGE_RL ("Ip packet defragment error.\n");
+    else if (newIph) {
+        timestamp->dispatchTime = getMonotonicTime ();
+
+        /* Ip header has been validated by ipDefragProcess */
+        getIpPktInfo (newIph, &ipInfo);
+        switch (ipInfo.proto) {
+            /* Tcp packet dispatch, duplicate packet is suppressed */
+            case IPPROTO_TCP:
+                if (!packetDedupProcess (newIph, &ipInfo, tm))
+                    tcpPacketDispatch (newIph, &ipInfo, timestamp);
+                break;
+
+                /* Icmp packet dispatch, icmpv6 is not supported */
+            case IPPROTO_ICMP:
+                if (ipInfo.src.family == AF_INET)
+                    icmpPacketDispatch (newIph, timestamp);
+
+            default:
+                break;
+        }
+
+        /* Free new ip packet after defragment */
+        if (newIph != iph)
+            free (newIph);
+    }
+}
+
+/* Process packets released by packet reorder stage */
+static void
+ipPacketReorderProcess (void) {
+    zframe_t *tmFrame;
+    zframe_t *ipPktFrame;
+
+    while (packetReorderPop (False, &tmFrame, &ipPktFrame)) {
+        ipPacketProcess (tmFrame, ipPktFrame);
+        zframe_destroy (&tmFrame);
+        zframe_destroy (&ipPktFrame);
+    }
 }
 
 /*
  * Ip packet process service.
- * Receive ip packet send by rawCaptureService, then do ip
- * defrag process and dispatch timestamp and ip packet to
- * specific tcpProcessService thread.
+ * Receive ip packet send by rawCaptureService, merge packets of
+ * multiple interfaces in capture timestamp order, then do ip
+ * defrag process, suppress duplicate tcp packet of mirror
+ * ports and dispatch timestamp and ip packet to specific
+ * tcpProcessService thread.
  */
 void *
 ipProcessService (void *args) {
     int ret;
+    u_int reorderWindow;
     void *ipPktRecvSock;
     zframe_t *tmFrame = NULL;
     zframe_t *ipPktFrame = NULL;
-    timeValPtr tm;
-    iphdrPtr iph;
-    iphdrPtr newIph;
+    pktTimestampPtr timestamp;
+    zmq_pollitem_t items [1];
 
     /* Reset signals flag */
     resetSignalsFlag ();
@@ -163,21 +211,65 @@ ipProcessService (void *args) {
         fprintf (stderr, "Init log context error.\n");
         goto exit;
     }
+    setLogComponent ("IpProcessService");
+
+    /* Init metrics context */
+    ret = initMetricsContext ("IpProcessService");
+    if (ret < 0) {
+        LOGE ("Init metrics context error.\n");
+        goto destroyLogContext;
+    }
 
     /* Display task schedule policy info */
     displayTaskSchedPolicyInfo ("IpProcessService");
 
     /* Get ipPktRecvSock */
     ipPktRecvSock = getIpPktRecvSock ();
+    items [0].socket = ipPktRecvSock;
+    items [0].fd = 0;
+    items [0].events = ZMQ_POLLIN;
 
     /* Init ip context */
     ret = initIpContext (False);
     if (ret < 0) {
         LOGE ("Init ip context error.\n");
-        goto destroyLogContext;
+        goto destroyMetricsContext;
+    }
+
+    /* Init packet dedup context */
+    ret = initPacketDedupContext (getPropertiesPacketDedupWindow ());
+    if (ret < 0) {
+        LOGE ("Init packet dedup context error.\n");
+        goto destroyIpContext;
+    }
+
+    /* Init packet reorder context, packets of single interface are in order */
+    if (getPropertiesSniffLive () && getPropertiesInterfacesNum () > 1)
+        reorderWindow = getPropertiesReorderWindow ();
+    else
+        reorderWindow = 0;
+    ret = initPacketReorderContext (reorderWindow);
+    if (ret < 0) {
+        LOGE ("Init packet reorder context error.\n");
+        goto destroyPacketDedupContext;
     }
 
     while (!taskShouldExit ()) {
+        /* Release packets out of reorder window, wait at most reorder
+         * window for new packet if there are packets held */
+        if (packetReorderEnabled ()) {
+            ipPacketReorderProcess ();
+
+            ret = zmq_poll (items, 1,
+                            packetReorderPending () ? reorderWindow * ZMQ_POLL_MSEC : -1);
+            if (ret < 0) {
+                if (!taskShouldExit ())
+                    LOGE ("Poll ip packet with fatal error.\n");
+                break;
+            } else if (ret == 0)
+                continue;
+        }
+
         /* Receive timestamp zframe */
         if (tmFrame == NULL) {
             tmFrame = zframe_recv (ipPktRecvSock);
@@ -205,40 +297,49 @@ ipProcessService (void *args) {
             continue;
         }
 
-        tm = (timeValPtr) zframe_data (tmFrame);
-        iph = (iphdrPtr) zframe_data (ipPktFrame);
-
-        /* Ip packet defrag process */
-        ret = ipDefragProcess (iph, tm, &newIph);
-        if (ret < 0)
-            LOGE ("Ip packet defragment error.\n");
-        else if (newIph) {
-            switch (newIph->ipProto) {
-                /* Tcp packet dispatch */
-                case IPPROTO_TCP:
-                    tcpPacketDispatch (newIph, tm);
-                    break;
-
-                    /* Icmp packet dispatch */
-                case IPPROTO_ICMP:
-                    icmpPacketDispatch (newIph, tm);
-
-                default:
-                    break;
-            }
+        if (zframe_size (tmFrame) != sizeof (pktTimestamp)) {
+            LOGE_RL ("Wrong packet timestamp zframe size: %u.\n", (u_int) zframe_size (tmFrame));
+            zframe_destroy (&tmFrame);
+            zframe_destroy (&ipPktFrame);
+            continue;
+        }
+
+        timestamp = (pktTimestampPtr) zframe_data (tmFrame);
 
-            /* Free new ip packet after defragment */
-            if (newIph != iph)
-                free (newIph);
+        METRICS_COUNTER_INC (METRIC_PACKETS_RECEIVED);
+        METRICS_COUNTER_ADD (METRIC_BYTES_RECEIVED, zframe_size (ipPktFrame));
+        METRICS_COUNTER_INC (METRIC_IP_QUEUE_DEQUEUED);
+        METRICS_LATENCY_RECORD_SINCE (LATENCY_CAPTURE_TO_IP, timestamp->ingressTime);
+
+        /* Hold packet in reorder stage, it is never full after release */
+        if (packetReorderEnabled ()) {
+            ret = packetReorderPush (tmFrame, ipPktFrame);
+            if (ret < 0) {
+                LOGE_RL ("Push ip packet to reorder stage error.\n");
+                METRICS_DROP (DROP_REASON_NO_MEMORY);
+                zframe_destroy (&tmFrame);
+                zframe_destroy (&ipPktFrame);
+            }
+            tmFrame = NULL;
+            ipPktFrame = NULL;
+            continue;
         }
 
+        ipPacketProcess (tmFrame, ipPktFrame);
+
         /* Free zframe */
         zframe_destroy (&tmFrame);
         zframe_destroy (&ipPktFrame);
     }
 
     LOGI ("IpProcessService will exit ... .. .\n");
+    destroyPacketReorderContext ();
+destroyPacketDedupContext:
+    destroyPacketDedupContext ();
+destroyIpContext:
     destroyIpContext ();
+destroyMetricsContext:
+    destroyMetricsContext ();
 destroyLogContext:
     destroyLogContext ();
 exit:
@@ -0,0 +1,931 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <pthread.h>
+#include <byteswap.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "util.h"
+#include "list.h"
+#include "properties.h"
+#include "signals.h"
+#include "log.h"
+#include "metrics.h"
+#include "netdev.h"
+#include "zmq_hub.h"
+#include "task_manager.h"
+#include "ip.h"
+#include "raw_packet.h"
+#include "ip_packet.h"
+#include "icmp_packet.h"
+#include "tcp_packet.h"
+#include "packet_dedup.h"
+#include "proto_analyzer_stats.h"
+#include "heavy_hitter.h"
+#include "analysis_record.h"
+#include "offline_process_service.h"
+
+/* Classic pcap file magic numbers */
+#define PCAP_MAGIC_USEC 0xa1b2c3d4
+#define PCAP_MAGIC_NSEC 0xa1b23c4d
+#define PCAP_FILE_HEADER_SIZE 24
+#define PCAP_RECORD_HEADER_SIZE 16
+/* Max capture length of pcap record, larger one means corrupted file */
+#define PCAP_RECORD_MAX_CAPLEN (256 * 1024)
+
+/* Max queued records of each worker for merged output */
+#define OFFLINE_MERGE_QUEUE_MAX_RECORDS 65536
+/* Wait interval in microseconds of coordinator and blocked workers */
+#define OFFLINE_WAIT_INTERVAL 1000
+
+typedef struct _offlinePcap offlinePcap;
+typedef offlinePcap *offlinePcapPtr;
+
+/* Classic pcap file mapped in memory */
+struct _offlinePcap {
+    int fd;                             /**< Pcap file descriptor */
+    u_char *data;                       /**< Pcap file data */
+    u_long_long size;                   /**< Pcap file size */
+    boolean swapped;                    /**< Pcap file is of different byte order */
+    boolean nsec;                       /**< Pcap timestamp is of nanosecond resolution */
+};
+
+typedef struct _offlinePacket offlinePacket;
+typedef offlinePacket *offlinePacketPtr;
+
+struct _offlinePacket {
+    u_long_long index;                  /**< Packet index in pcap file */
+    timeVal timestamp;                  /**< Packet capture timestamp in network order */
+    u_int capLen;                       /**< Packet capture length */
+    u_int len;                          /**< Packet original length */
+    u_char *data;                       /**< Raw packet */
+};
+
+typedef struct _offlineRecord offlineRecord;
+typedef offlineRecord *offlineRecordPtr;
+
+/* Analysis record spooled for merged output */
+struct _offlineRecord {
+    u_long_long pktIndex;               /**< Index of packet which generates record */
+    char *record;                       /**< Analysis record */
+    listHead node;                      /**< Record list node */
+};
+
+typedef struct _offlineWorker offlineWorker;
+typedef offlineWorker *offlineWorkerPtr;
+
+/*
+ * Offline process worker, every worker scans the whole pcap file and
+ * processes tcp flows of its own slice, all other packets only advance
+ * tcp closing timeout clock, so records are the same for any workers
+ * number.
+ */
+struct _offlineWorker {
+    u_int index;                        /**< Worker index */
+    pthread_t tid;                      /**< Worker thread id */
+    boolean started;                    /**< Worker thread has been created */
+    volatile boolean done;              /**< Worker has exited */
+    boolean error;                      /**< Worker exited with error */
+    u_long_long pktIndex;               /**< Index of packet in process */
+    volatile u_long_long progress;      /**< Records of packets before progress have been queued */
+    listHead pendingRecords;            /**< Records of packet in process, sorted */
+    pthread_mutex_t lock;               /**< Lock of records and recordsNum */
+    listHead records;                   /**< Records ready for merge */
+    volatile u_int recordsNum;          /**< Records number ready for merge */
+    void *tcpBreakdownSendSock;         /**< Tcp breakdown send sock */
+    void *icmpErrorSendSock;            /**< Icmp error send sock */
+};
+
+/* Mapped pcap file and its datalink type */
+static offlinePcap offlinePcapInstance;
+static int datalinkType = -1;
+
+/* Offline process workers */
+static offlineWorkerPtr offlineWorkers = NULL;
+static u_int offlineWorkersNum = 0;
+static boolean offlineMergedOutput = False;
+static volatile boolean offlineProcessStop = False;
+
+/* Thread local offline process worker */
+static __thread offlineWorkerPtr offlineWorkerInstance = NULL;
+
+static u_int
+pcapValue32 (u_char *data, boolean swapped) {
+    u_int value;
+
+    memcpy (&value, data, sizeof (value));
+    return swapped ? bswap_32 (value) : value;
+}
+
+/* Check classic pcap file header, pcapng is not supported */
+static int
+checkPcapFileHeader (u_char *header, boolean *swapped, boolean *nsec) {
+    u_int magic;
+
+    memcpy (&magic, header, sizeof (magic));
+    if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC) {
+        *swapped = False;
+        *nsec = magic == PCAP_MAGIC_NSEC ? True : False;
+        return 0;
+    }
+
+    magic = bswap_32 (magic);
+    if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC) {
+        *swapped = True;
+        *nsec = magic == PCAP_MAGIC_NSEC ? True : False;
+        return 0;
+    }
+
+    return -1;
+}
+
+static int
+openOfflinePcap (char *pcapFile, offlinePcapPtr pcap) {
+    int ret;
+    struct stat st;
+
+    pcap->fd = open (pcapFile, O_RDONLY);
+    if (pcap->fd < 0) {
+        LOGE ("Open pcap file %s error: %s.\n", pcapFile, strerror (errno));
+        return -1;
+    }
+
+    ret = fstat (pcap->fd, &st);
+    if (ret < 0 || st.st_size < PCAP_FILE_HEADER_SIZE) {
+        LOGE ("Wrong pcap file %s.\n", pcapFile);
+        goto closeFd;
+    }
+    pcap->size = st.st_size;
+
+    pcap->data = (u_char *) mmap (NULL, pcap->size, PROT_READ, MAP_PRIVATE, pcap->fd, 0);
+    if (pcap->data == MAP_FAILED) {
+        LOGE ("Mmap pcap file %s error: %s.\n", pcapFile, strerror (errno));
+        goto closeFd;
+    }
+    madvise (pcap->data, pcap->size, MADV_SEQUENTIAL);
+
+    ret = checkPcapFileHeader (pcap->data, &pcap->swapped, &pcap->nsec);
+    if (ret < 0) {
+        LOGE ("Pcap file %s is not classic pcap format.\n", pcapFile);
+        goto unmapData;
+    }
+
+    return 0;
+
+unmapData:
+    munmap (pcap->data, pcap->size);
+closeFd:
+    close (pcap->fd);
+    pcap->data = NULL;
+    pcap->fd = -1;
+    return -1;
+}
+
+static void
+closeOfflinePcap (offlinePcapPtr pcap) {
+    if (pcap->data)
+        munmap (pcap->data, pcap->size);
+    if (pcap->fd >= 0)
+        close (pcap->fd);
+    pcap->data = NULL;
+    pcap->fd = -1;
+}
+
+/**
+ * @brief Get next packet of mapped pcap file.
+ *
+ * @param pcap -- Mapped pcap file
+ * @param offset -- Offset of next packet record, will be advanced
+ * @param pkt -- Packet to return, index should be advanced by caller
+ *
+ * @return True if get packet else False for end of file
+ */
+static boolean
+offlinePcapNextPacket (offlinePcapPtr pcap, u_long_long *offset, offlinePacketPtr pkt) {
+    u_char *hdr;
+    u_int tvSec, tvFrac;
+
+    if (pcap->size - *offset < PCAP_RECORD_HEADER_SIZE)
+        return False;
+
+    hdr = pcap->data + *offset;
+    tvSec = pcapValue32 (hdr, pcap->swapped);
+    tvFrac = pcapValue32 (hdr + 4, pcap->swapped);
+    pkt->capLen = pcapValue32 (hdr + 8, pcap->swapped);
+    pkt->len = pcapValue32 (hdr + 12, pcap->swapped);
+
+    if (pkt->capLen > PCAP_RECORD_MAX_CAPLEN ||
+        pcap->size - *offset - PCAP_RECORD_HEADER_SIZE < pkt->capLen) {
+        LOGE ("Truncated or corrupted pcap record at offset: %llu.\n", *offset);
+        return False;
+    }
+
+    pkt->timestamp.tvSec = htonll ((u_long_long) tvSec);
+    pkt->timestamp.tvUsec = htonll ((u_long_long) (pcap->nsec ? tvFrac / 1000 : tvFrac));
+    pkt->data = hdr + PCAP_RECORD_HEADER_SIZE;
+    *offset += PCAP_RECORD_HEADER_SIZE + pkt->capLen;
+
+    return True;
+}
+
+/* Get worker which owns the flow of non-fragment ip packet */
+static u_int
+offlineFlowOwner (iphdrPtr iph, ipPktInfoPtr info, u_int ipCapLen) {
+    /* Tcp ports are required for flow hash */
+    if (info->proto != IPPROTO_TCP || ipCapLen < info->hdrLen + 4)
+        return 0;
+
+    return ipPktDispatchHash (iph, info) % offlineWorkersNum;
+}
+
+/* Insert record into pending records of packet in process, sorted by content */
+static void
+offlineSpoolRecord (offlineWorkerPtr worker, char *record) {
+    offlineRecordPtr entry, tmp;
+    listHeadPtr pos;
+
+    entry = (offlineRecordPtr) malloc (sizeof (offlineRecord));
+    if (entry == NULL) {
+        LOGE_RL ("Alloc offline record error.\n");
+        METRICS_COUNTER_INC (METRIC_RECORDS_DROPPED);
+        return;
+    }
+
+    entry->record = strdup (record);
+    if (entry->record == NULL) {
+        LOGE_RL ("Duplicate offline record error.\n");
+        METRICS_COUNTER_INC (METRIC_RECORDS_DROPPED);
+        free (entry);
+        return;
+    }
+    entry->pktIndex = worker->pktIndex;
+
+    listForEachEntry (tmp, pos, &worker->pendingRecords, node) {
+        if (strcmp (entry->record, tmp->record) < 0)
+            break;
+    }
+    /* Insert before pos, pos is list head if no larger record */
+    listAddTail (&entry->node, pos);
+}
+
+/* Move pending records to merge queue and advance progress of worker */
+static void
+offlineCommitRecords (offlineWorkerPtr worker, u_long_long progress) {
+    u_int num = 0;
+    offlineRecordPtr entry;
+    listHeadPtr pos, npos;
+
+    if (!listIsEmpty (&worker->pendingRecords)) {
+        pthread_mutex_lock (&worker->lock);
+        listForEachEntrySafe (entry, pos, npos, &worker->pendingRecords, node) {
+            listDel (&entry->node);
+            listAddTail (&entry->node, &worker->records);
+            num++;
+        }
+        worker->recordsNum += num;
+        pthread_mutex_unlock (&worker->lock);
+    }
+
+    /* Records must be visible before progress */
+    __sync_synchronize ();
+    worker->progress = progress;
+
+    /* Wait for coordinator to merge records */
+    while (worker->recordsNum >= OFFLINE_MERGE_QUEUE_MAX_RECORDS && !offlineProcessStop)
+        usleep (OFFLINE_WAIT_INTERVAL);
+}
+
+static void
+offlineOutputRecord (void *sendSock, char *record) {
+    if (offlineMergedOutput)
+        offlineSpoolRecord (offlineWorkerInstance, record);
+    else
+        publishAnalysisRecord (sendSock, record);
+}
+
+static void
+offlineTcpProcessCallback (tcpProcessCallbackArgsPtr callbackArgs) {
+    switch (callbackArgs->type) {
+        case PUBLISH_TCP_BREAKDOWN:
+            offlineOutputRecord (offlineWorkerInstance->tcpBreakdownSendSock,
+                                 (char *) callbackArgs->args);
+            break;
+
+        default:
+            LOGE ("Wrong tcp process callback args type.\n");
+            break;
+    }
+}
+
+static void
+offlineIcmpProcessCallback (icmpProcessCallbackArgsPtr callbackArgs) {
+    switch (callbackArgs->type) {
+        case PUBLISH_ICMP_ERROR:
+            offlineOutputRecord (offlineWorkerInstance->icmpErrorSendSock,
+                                 (char *) callbackArgs->args);
+            break;
+
+        default:
+            LOGE ("Wrong icmp process callback args type.\n");
+            break;
+    }
+}
+
+/*
+ * Process one packet by worker. Fragments are defragmented by all workers
+ * and the reassembled packet is processed by owner of its flow, icmp and
+ * invalid packets are owned by worker 0. Packets not processed by tcp
+ * context of worker still advance its closing timeout clock.
+ */
+static void
+offlineProcessPacket (offlineWorkerPtr worker, offlinePacketPtr pkt) {
+    int ret;
+    u_int ipCapLen;
+    boolean fragment = False;
+    boolean tcpProcessed = False;
+    iphdrPtr iph, newIph;
+    ipPktInfo info;
+
+    if (pkt->capLen != pkt->len) {
+        if (worker->index == 0)
+            METRICS_DROP (DROP_REASON_INCOMPLETE);
+        goto timeout;
+    }
+
+    iph = (iphdrPtr) getIpPacket (pkt->data, datalinkType);
+    if (iph == NULL) {
+        if (worker->index == 0)
+            METRICS_DROP (DROP_REASON_NOT_IP);
+        goto timeout;
+    }
+    ipCapLen = pkt->capLen - ((u_char *) iph - pkt->data);
+
+    ret = getIpPktInfo (iph, &info);
+    if (!ret && (info.moreFrags || info.fragOffset))
+        fragment = True;
+    else if ((ret < 0 ? 0 : offlineFlowOwner (iph, &info, ipCapLen)) != worker->index) {
+        /* Dedup table of every worker records tcp packets of all flows */
+        if (!ret && info.proto == IPPROTO_TCP)
+            packetDedupUpdate (iph, &info, &pkt->timestamp);
+        goto timeout;
+    }
+
+    if (!fragment || worker->index == 0) {
+        METRICS_COUNTER_INC (METRIC_PACKETS_RECEIVED);
+        METRICS_COUNTER_ADD (METRIC_BYTES_RECEIVED, pkt->len);
+    }
+
+    /* Duplicate packet is suppressed before ip filter, like other workers record it */
+    if (!ret && !fragment && info.proto == IPPROTO_TCP &&
+        packetDedupProcess (iph, &info, &pkt->timestamp))
+        goto timeout;
+
+    /* Ip packet defrag process */
+    ret = ipDefragProcess (iph, &pkt->timestamp, &newIph);
+    if (ret < 0)
+        LOGE_RL ("Ip packet defragment error.\n");
+    else if (newIph) {
+        /* Ip header has been validated by ipDefragProcess */
+        getIpPktInfo (newIph, &info);
+        if (newIph == iph || offlineFlowOwner (newIph, &info, info.len) == worker->index) {
+            switch (info.proto) {
+                case IPPROTO_TCP:
+                    /* Duplicate defragment packet is suppressed */
+                    if (newIph != iph && packetDedupProcess (newIph, &info, &pkt->timestamp))
+                        break;
+                    tcpProcess (newIph, &pkt->timestamp);
+                    tcpProcessed = True;
+                    break;
+
+                    /* Icmpv6 is not supported */
+                case IPPROTO_ICMP:
+                    if (info.src.family == AF_INET)
+                        icmpProcess (newIph, &pkt->timestamp);
+
+                default:
+                    break;
+            }
+        } else if (info.proto == IPPROTO_TCP)
+            packetDedupUpdate (newIph, &info, &pkt->timestamp);
+
+        /* Free new ip packet after defragment */
+        if (newIph != iph)
+            free (newIph);
+    }
+
+timeout:
+    if (!tcpProcessed)
+        tcpProcessTimeout (&pkt->timestamp);
+}
+
+static void *
+offlineProcessWorker (void *args) {
+    int ret;
+    cpu_set_t cpuset;
+    u_long_long offset = PCAP_FILE_HEADER_SIZE;
+    offlinePacket pkt;
+    timeVal lastTime = {0, 0};
+    offlineWorkerPtr worker = (offlineWorkerPtr) args;
+
+    offlineWorkerInstance = worker;
+    worker->error = True;
+
+    /* Init log context */
+    ret = initLogContext (getPropertiesLogLevel ());
+    if (ret < 0) {
+        fprintf (stderr, "Init log context error.\n");
+        goto exit;
+    }
+    setLogComponent ("OfflineProcessWorker:%u", worker->index);
+
+    /* Init metrics context */
+    ret = initMetricsContext ("OfflineProcessWorker:%u", worker->index);
+    if (ret < 0) {
+        LOGE ("Init metrics context error.\n");
+        goto destroyLogContext;
+    }
+
+    /* Init proto analyzer stats context */
+    ret = initProtoAnalyzerStatsContext ("OfflineProcessWorker:%u", worker->index);
+    if (ret < 0) {
+        LOGE ("Init proto analyzer stats context error.\n");
+        goto destroyMetricsContext;
+    }
+
+    /* Init heavy hitter context */
+    ret = initHeavyHitterContext ("OfflineProcessWorker:%u", worker->index);
+    if (ret < 0) {
+        LOGE ("Init heavy hitter context error.\n");
+        goto destroyProtoAnalyzerStatsContext;
+    }
+
+    /* Bind offlineProcessWorker to CPU# */
+    CPU_ZERO (&cpuset);
+    CPU_SET (worker->index, &cpuset);
+    ret = pthread_setaffinity_np (pthread_self (), sizeof (cpu_set_t), &cpuset);
+    if (ret)
+        LOGW ("Binding offlineProcessWorker:%u to CPU%u error.\n", worker->index, worker->index);
+
+    /* Init ip context */
+    ret = initIpContext (False);
+    if (ret < 0) {
+        LOGE ("Init ip context error.\n");
+        goto destroyHeavyHitterContext;
+    }
+
+    /* Init icmp context */
+    ret = initIcmpContext (offlineIcmpProcessCallback);
+    if (ret < 0) {
+        LOGE ("Init icmp context error.\n");
+        goto destroyIpContext;
+    }
+
+    /* Init tcp context */
+    ret = initTcpContext (False, offlineTcpProcessCallback);
+    if (ret < 0) {
+        LOGE ("Init tcp context error.\n");
+        goto destroyIcmpContext;
+    }
+    setTcpConnIdFromFlow (True);
+    /* Tcp streams of each worker must not depend on workers number */
+    setTcpStreamsEviction (False);
+
+    /* Init packet dedup context */
+    ret = initPacketDedupContext (getPropertiesPacketDedupWindow ());
+    if (ret < 0) {
+        LOGE ("Init packet dedup context error.\n");
+        goto destroyTcpContext;
+    }
+
+    /* Records of offline process have no live ingress time */
+    setAnalysisRecordIngressTime (0);
+
+    for (worker->pktIndex = 0; !offlineProcessStop; worker->pktIndex++) {
+        if (!offlinePcapNextPacket (&offlinePcapInstance, &offset, &pkt))
+            break;
+        pkt.index = worker->pktIndex;
+        lastTime = pkt.timestamp;
+
+        offlineProcessPacket (worker, &pkt);
+
+        if (offlineMergedOutput)
+            offlineCommitRecords (worker, worker->pktIndex + 1);
+    }
+
+    if (!offlineProcessStop) {
+        /* Expire closing tcp streams at the end of pcap file */
+        lastTime.tvSec = htonll (ntohll (lastTime.tvSec) + TCP_STREAM_CLOSING_TIMEOUT);
+        tcpProcessTimeout (&lastTime);
+        worker->error = False;
+    }
+
+    LOGI ("OfflineProcessWorker:%u will exit ... .. .\n", worker->index);
+    destroyPacketDedupContext ();
+destroyTcpContext:
+    destroyTcpContext ();
+destroyIcmpContext:
+    destroyIcmpContext ();
+destroyIpContext:
+    destroyIpContext ();
+destroyHeavyHitterContext:
+    destroyHeavyHitterContext ();
+destroyProtoAnalyzerStatsContext:
+    destroyProtoAnalyzerStatsContext ();
+destroyMetricsContext:
+    destroyMetricsContext ();
+destroyLogContext:
+    destroyLogContext ();
+exit:
+    if (offlineMergedOutput)
+        offlineCommitRecords (worker, (u_long_long) -1);
+    worker->done = True;
+
+    return NULL;
+}
+
+/* Get worker of the smallest record to merge, or NULL if not ready */
+static offlineWorkerPtr
+offlineMergeCandidate (void) {
+    u_int i;
+    u_long_long progress [offlineWorkersNum];
+    offlineRecordPtr head, min = NULL;
+    offlineWorkerPtr owner = NULL;
+
+    for (i = 0; i < offlineWorkersNum; i++)
+        progress [i] = offlineWorkers [i].progress;
+    /* Heads must be checked after progress */
+    __sync_synchronize ();
+
+    for (i = 0; i < offlineWorkersNum; i++) {
+        pthread_mutex_lock (&offlineWorkers [i].lock);
+        head = listHeadEntry (&offlineWorkers [i].records, offlineRecord, node);
+        pthread_mutex_unlock (&offlineWorkers [i].lock);
+
+        if (head == NULL)
+            continue;
+        /* Worker with queued records will never queue smaller records */
+        progress [i] = (u_long_long) -1;
+
+        if (min == NULL || head->pktIndex < min->pktIndex ||
+            (head->pktIndex == min->pktIndex && strcmp (head->record, min->record) < 0)) {
+            min = head;
+            owner = &offlineWorkers [i];
+        }
+    }
+
+    if (min == NULL)
+        return NULL;
+
+    /* Workers without queued records may still generate records of min->pktIndex */
+    for (i = 0; i < offlineWorkersNum; i++) {
+        if (progress [i] <= min->pktIndex)
+            return NULL;
+    }
+
+    return owner;
+}
+
+/* Merge records of all workers ordered by packet index, return merged records number */
+static u_int
+offlineMergeRecords (void *sendSock) {
+    u_int num = 0;
+    offlineRecordPtr entry;
+    offlineWorkerPtr worker;
+
+    while (!taskShouldExit ()) {
+        worker = offlineMergeCandidate ();
+        if (worker == NULL)
+            break;
+
+        pthread_mutex_lock (&worker->lock);
+        entry = listHeadEntry (&worker->records, offlineRecord, node);
+        listDel (&entry->node);
+        worker->recordsNum--;
+        pthread_mutex_unlock (&worker->lock);
+
+        publishAnalysisRecord (sendSock, entry->record);
+        free (entry->record);
+        free (entry);
+        num++;
+    }
+
+    return num;
+}
+
+static void
+freeOfflineRecords (listHeadPtr head) {
+    offlineRecordPtr entry;
+    listHeadPtr pos, npos;
+
+    listForEachEntrySafe (entry, pos, npos, head, node) {
+        listDel (&entry->node);
+        free (entry->record);
+        free (entry);
+    }
+}
+
+static int
+startOfflineWorkers (void) {
+    int ret;
+    u_int i;
+
+    offlineWorkers = (offlineWorkerPtr) calloc (offlineWorkersNum, sizeof (offlineWorker));
+    if (offlineWorkers == NULL) {
+        LOGE ("Alloc offline process workers error.\n");
+        return -1;
+    }
+
+    for (i = 0; i < offlineWorkersNum; i++) {
+        offlineWorkers [i].index = i;
+        initListHead (&offlineWorkers [i].pendingRecords);
+        initListHead (&offlineWorkers [i].records);
+        pthread_mutex_init (&offlineWorkers [i].lock, NULL);
+        offlineWorkers [i].tcpBreakdownSendSock = getTcpBreakdownSendSock (i);
+        offlineWorkers [i].icmpErrorSendSock = getIcmpErrorSendSock ();
+    }
+
+    for (i = 0; i < offlineWorkersNum; i++) {
+        ret = pthread_create (&offlineWorkers [i].tid, NULL, offlineProcessWorker, &offlineWorkers [i]);
+        if (ret) {
+            LOGE ("Create offlineProcessWorker:%u error.\n", i);
+            return -1;
+        }
+        offlineWorkers [i].started = True;
+    }
+
+    return 0;
+}
+
+/* Stop and free offline workers, return -1 if any worker exited with error */
+static int
+stopOfflineWorkers (void) {
+    int ret = 0;
+    u_int i;
+
+    if (offlineWorkers == NULL)
+        return -1;
+
+    for (i = 0; i < offlineWorkersNum; i++) {
+        if (offlineWorkers [i].started) {
+            pthread_join (offlineWorkers [i].tid, NULL);
+            if (offlineWorkers [i].error)
+                ret = -1;
+        } else
+            ret = -1;
+
+        freeOfflineRecords (&offlineWorkers [i].pendingRecords);
+        freeOfflineRecords (&offlineWorkers [i].records);
+        pthread_mutex_destroy (&offlineWorkers [i].lock);
+    }
+
+    free (offlineWorkers);
+    offlineWorkers = NULL;
+    return ret;
+}
+
+static boolean
+offlineWorkersDone (void) {
+    u_int i;
+
+    for (i = 0; i < offlineWorkersNum; i++) {
+        if (offlineWorkers [i].started && !offlineWorkers [i].done)
+            return False;
+    }
+
+    return True;
+}
+
+static void
+offlineProtoDetectCallback (tcpProcessCallbackArgsPtr callbackArgs) {
+    switch (callbackArgs->type) {
+        case PUBLISH_TOPOLOGY_ENTRY:
+            publishAnalysisRecord (getTopologyEntrySendSock (), (char *) callbackArgs->args);
+            break;
+
+        case PUBLISH_APP_SERVICE:
+            publishAnalysisRecord (getAppServiceSendSock (), (char *) callbackArgs->args);
+            break;
+
+        default:
+            LOGE ("Wrong proto detect callback args type.\n");
+            break;
+    }
+}
+
+/*
+ * Scan the whole pcap file to detect application services before
+ * parallel process, so services filter is the same for all workers.
+ */
+static int
+offlineProtoDetect (void) {
+    int ret;
+    u_long_long offset = PCAP_FILE_HEADER_SIZE;
+    offlinePacket pkt;
+    iphdrPtr iph, newIph;
+    ipPktInfo info;
+
+    /* Init ip context */
+    ret = initIpContext (True);
+    if (ret < 0) {
+        LOGE ("Init ip context error.\n");
+        return -1;
+    }
+
+    /* Init tcp context */
+    ret = initTcpContext (True, offlineProtoDetectCallback);
+    if (ret < 0) {
+        LOGE ("Init tcp context error.\n");
+        destroyIpContext ();
+        return -1;
+    }
+
+    while (!taskShouldExit () && offlinePcapNextPacket (&offlinePcapInstance, &offset, &pkt)) {
+        /* Filter out incomplete raw packet */
+        if (pkt.capLen != pkt.len)
+            continue;
+
+        iph = (iphdrPtr) getIpPacket (pkt.data, datalinkType);
+        if (iph == NULL)
+            continue;
+
+        ret = ipDefragProcess (iph, &pkt.timestamp, &newIph);
+        if (ret < 0)
+            LOGE_RL ("Ip packet defragment error.\n");
+        else if (newIph) {
+            /* Ip header has been validated by ipDefragProcess */
+            getIpPktInfo (newIph, &info);
+            if (info.proto == IPPROTO_TCP)
+                tcpProcess (newIph, &pkt.timestamp);
+
+            /* Free new ip packet after defragment */
+            if (newIph != iph)
+                free (newIph);
+        }
+    }
+
+    destroyTcpContext ();
+    destroyIpContext ();
+    return taskShouldExit () ? -1 : 0;
+}
+
+/* Wait for analysis record service to consume all published records */
+static void
+waitForRecordsConsumed (void) {
+    while (!taskShouldExit () &&
+           getMetricsTotal (METRIC_RECORD_QUEUE_DEQUEUED) < getMetricsTotal (METRIC_RECORD_QUEUE_ENQUEUED))
+        usleep (OFFLINE_WAIT_INTERVAL);
+}
+
+/**
+ * @brief Check whether offline pcap file will be processed by parallel
+ *        offline process service instead of capture pipeline.
+ *
+ * @return True if enabled and pcap file is of classic pcap format else False
+ */
+boolean
+offlineProcessEnabled (void) {
+    int fd;
+    ssize_t len;
+    boolean swapped, nsec;
+    struct stat st;
+    u_char header [PCAP_FILE_HEADER_SIZE];
+
+    if (getPropertiesPcapFile () == NULL || getPropertiesBenchMode () ||
+        getPropertiesOfflineParallelThreads () == 0)
+        return False;
+
+    /* Pipe and fifo input can only be consumed by capture pipeline */
+    if (stat (getPropertiesPcapFile (), &st) < 0 || !S_ISREG (st.st_mode))
+        return False;
+
+    fd = open (getPropertiesPcapFile (), O_RDONLY);
+    if (fd < 0)
+        return False;
+    len = read (fd, header, sizeof (header));
+    close (fd);
+
+    if (len != sizeof (header) || checkPcapFileHeader (header, &swapped, &nsec) < 0) {
+        LOGW ("Pcap file %s is not classic pcap format, fall back to capture pipeline.\n",
+              getPropertiesPcapFile ());
+        return False;
+    }
+
+    return True;
+}
+
+/*
+ * Offline process service.
+ * Map offline pcap file in memory, detect application services, then
+ * process packets at full speed by parallel workers sliced by flow
+ * hash with packet timestamp driven timeouts, and optionally merge
+ * records of all workers in packet order.
+ */
+void *
+offlineProcessService (void *args) {
+    int ret;
+    u_int merged = 0;
+    u_long_long startTime, duration;
+    void *mergedSendSock;
+    boolean complete = False;
+
+    /* Reset signals flag */
+    resetSignalsFlag ();
+
+    /* Init log context */
+    ret = initLogContext (getPropertiesLogLevel ());
+    if (ret < 0) {
+        fprintf (stderr, "Init log context error.\n");
+        goto exit;
+    }
+    setLogComponent ("OfflineProcessService");
+
+    /* Init metrics context */
+    ret = initMetricsContext ("OfflineProcessService");
+    if (ret < 0) {
+        LOGE ("Init metrics context error.\n");
+        goto destroyLogContext;
+    }
+
+    /* Display task schedule policy info */
+    displayTaskSchedPolicyInfo ("OfflineProcessService");
+
+    /* Map pcap file */
+    ret = openOfflinePcap (getPropertiesPcapFile (), &offlinePcapInstance);
+    if (ret < 0)
+        goto destroyMetricsContext;
+    datalinkType = getNetDevDatalinkTypeForSniff (0);
+
+    offlineWorkersNum = MIN_NUM (getPropertiesOfflineParallelThreads (), getTcpProcessThreadsNum ());
+    offlineMergedOutput = getPropertiesOfflineMergedOutput ();
+    offlineProcessStop = False;
+    mergedSendSock = getTcpBreakdownSendSock (0);
+    startTime = getMonotonicTime ();
+
+    /* Detect application services */
+    ret = offlineProtoDetect ();
+    if (ret < 0) {
+        LOGE ("Offline proto detection error.\n");
+        goto closeOfflinePcap;
+    }
+    LOGI ("Offline proto detection complete in %.3lfs.\n",
+          (double) (getMonotonicTime () - startTime) / 1000000000);
+
+    /* Start workers */
+    LOGI ("Start %u offline process workers with %s output.\n",
+          offlineWorkersNum, offlineMergedOutput ? "merged" : "unordered");
+    ret = startOfflineWorkers ();
+    while (!ret && !offlineWorkersDone ()) {
+        if (taskShouldExit ())
+            break;
+
+        if (offlineMergedOutput)
+            merged += offlineMergeRecords (mergedSendSock);
+        else
+            usleep (OFFLINE_WAIT_INTERVAL);
+    }
+    if (!ret && offlineMergedOutput)
+        merged += offlineMergeRecords (mergedSendSock);
+
+    /* Stop workers */
+    offlineProcessStop = True;
+    if (stopOfflineWorkers () < 0 || taskShouldExit ()) {
+        LOGE ("Offline process workers exit abnormally.\n");
+        goto closeOfflinePcap;
+    }
+
+    waitForRecordsConsumed ();
+    duration = getMonotonicTime () - startTime;
+    LOGI ("\n"
+          "==Offline process complete==\n"
+          "--pcapFile: %s\n"
+          "--workers: %u\n"
+          "--duration: %.3lfs\n"
+          "--packets: %llu\n"
+          "--bytes: %llu\n"
+          "--records: %llu\n"
+          "--recordsMerged: %u\n\n",
+          getPropertiesPcapFile (), offlineWorkersNum, (double) duration / 1000000000,
+          getMetricsTotal (METRIC_PACKETS_RECEIVED), getMetricsTotal (METRIC_BYTES_RECEIVED),
+          getMetricsTotal (METRIC_RECORDS_EMITTED), merged);
+    complete = True;
+
+    LOGI ("OfflineProcessService will exit ... .. .\n");
+closeOfflinePcap:
+    closeOfflinePcap (&offlinePcapInstance);
+destroyMetricsContext:
+    destroyMetricsContext ();
+destroyLogContext:
+    destroyLogContext ();
+exit:
+    if (complete)
+        sendTaskStatus (TASK_STATUS_COMPLETE);
+    else if (!taskShouldExit ())
+        sendTaskStatus (TASK_STATUS_EXIT_ABNORMALLY);
+
+    return NULL;
+}
@@ -0,0 +1,13 @@
+#ifndef __OFFLINE_PROCESS_SERVICE_H__
+#define __OFFLINE_PROCESS_SERVICE_H__
+
+#include "util.h"
+
+/*========================Interfaces definition============================*/
+boolean
+offlineProcessEnabled (void);
+void *
+offlineProcessService (void *args);
+/*=======================Interfaces definition end=========================*/
+
+#endif /* __OFFLINE_PROCESS_SERVICE_H__ */
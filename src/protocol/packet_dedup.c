@@ -0,0 +1,240 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "util.h"
+#include "log.h"
+#include "metrics.h"
+#include "ip.h"
+#include "ip6.h"
+#include "tcp.h"
+#include "ip_packet.h"
+#include "packet_dedup.h"
+
+/* Multiplier of fingerprint mix */
+#define PACKET_DEDUP_HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+/* Dedup window in microseconds of each thread, 0 for disabled */
+static __thread u_long_long dedupWindow = 0;
+/* Dedup table of each thread */
+static __thread packetDedupBucketPtr dedupBuckets = NULL;
+
+/* Mix 64 bits value into fingerprint */
+static inline u_long_long
+packetDedupMix (u_long_long hash, u_long_long value) {
+    hash = (hash ^ value) * PACKET_DEDUP_HASH_MULTIPLIER;
+    return hash ^ (hash >> 32);
+}
+
+/* Mix ip address into fingerprint */
+static u_long_long
+packetDedupMixAddr (u_long_long hash, ipAddrPtr addr) {
+    u_long_long words [2];
+
+    if (addr->family == AF_INET)
+        return packetDedupMix (hash, addr->u.ip4.s_addr);
+
+    memcpy (words, &addr->u.ip6, sizeof (words));
+    hash = packetDedupMix (hash, words [0]);
+    return packetDedupMix (hash, words [1]);
+}
+
+/* Mix bytes into fingerprint */
+static u_long_long
+packetDedupMixBytes (u_long_long hash, u_char *data, u_int len) {
+    u_int i;
+    u_long_long word;
+
+    for (i = 0; i + sizeof (word) <= len; i += sizeof (word)) {
+        memcpy (&word, data + i, sizeof (word));
+        hash = packetDedupMix (hash, word);
+    }
+    if (i < len) {
+        word = 0;
+        memcpy (&word, data + i, len - i);
+        hash = packetDedupMix (hash, word);
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Get fingerprint of tcp packet. Copies of the same frame from
+ *        mirror ports have the same fingerprint, since ttl and checksum
+ *        which may be changed by router are not included. The whole tcp
+ *        header except checksum is included, so real dup acks which
+ *        differ in window, timestamps or sack blocks are not suppressed.
+ *        Ipv6 has no ip id for non-fragment packet, flow label is used
+ *        instead.
+ *
+ * @param iph -- tcp packet
+ * @param info -- ip packet info
+ *
+ * @return Tcp packet fingerprint, never be 0
+ */
+static u_long_long
+packetDedupFingerprint (iphdrPtr iph, ipPktInfoPtr info) {
+    u_int tcpHdrLen, offset, payloadLen;
+    u_long_long hash;
+    tcphdrPtr tcph;
+
+    tcph = (tcphdrPtr) ((u_char *) iph + info->hdrLen);
+    tcpHdrLen = tcph->doff * 4;
+    /* Packet with invalid data offset will be dropped by tcpProcess */
+    if (tcpHdrLen < sizeof (tcphdr) || info->hdrLen + tcpHdrLen > info->len)
+        tcpHdrLen = sizeof (tcphdr);
+
+    hash = packetDedupMixAddr (0, &info->src);
+    hash = packetDedupMixAddr (hash, &info->dest);
+    if (info->src.family == AF_INET)
+        hash = packetDedupMix (hash, ((u_long_long) info->len << 32) | info->fragId);
+    else
+        hash = packetDedupMix (hash, ((u_long_long) info->len << 32) |
+                               (ntohl (((ip6hdrPtr) iph)->ip6Flow) & IP6_FLOW_LABEL_MASK));
+
+    /* Mix tcp header and options except checksum */
+    hash = packetDedupMixBytes (hash, (u_char *) tcph, offsetof (tcphdr, chkSum));
+    hash = packetDedupMixBytes (hash, (u_char *) &tcph->urgPtr,
+                                tcpHdrLen - offsetof (tcphdr, urgPtr));
+
+    /* Mix payload prefix of tcp packet */
+    offset = info->hdrLen + tcpHdrLen;
+    payloadLen = MIN_NUM (info->len - offset, PACKET_DEDUP_PAYLOAD_HASH_LENGTH);
+    hash = packetDedupMixBytes (hash, (u_char *) iph + offset, payloadLen);
+
+    return hash ? hash : 1;
+}
+
+/**
+ * @brief Look up tcp packet in dedup table and record it. Fingerprint of
+ *        tcp packet is kept in a fixed size table of each thread, the
+ *        oldest entry of bucket will be replaced.
+ *
+ * @param iph -- tcp packet to look up
+ * @param info -- ip packet info
+ * @param tm -- packet capture timestamp
+ * @param evicted -- pointer to return whether entry within dedup window
+ *                   is replaced
+ *
+ * @return True if duplicate packet else False
+ */
+static boolean
+packetDedupLookup (iphdrPtr iph, ipPktInfoPtr info, timeValPtr tm, boolean *evicted) {
+    u_int i;
+    u_long_long fingerprint, timestamp, age;
+    packetDedupBucketPtr bucket;
+    packetDedupEntryPtr entry, victim;
+
+    *evicted = False;
+    fingerprint = packetDedupFingerprint (iph, info);
+    timestamp = ntohll (tm->tvSec) * 1000000 + ntohll (tm->tvUsec);
+    bucket = &dedupBuckets [fingerprint & (PACKET_DEDUP_BUCKETS - 1)];
+
+    victim = &bucket->entries [0];
+    for (i = 0; i < PACKET_DEDUP_BUCKET_ENTRIES; i++) {
+        entry = &bucket->entries [i];
+        /* Packets of multiple mirror ports may be slightly out of order */
+        age = timestamp > entry->timestamp ?
+                timestamp - entry->timestamp : entry->timestamp - timestamp;
+        if (entry->fingerprint == fingerprint && age <= dedupWindow)
+            return True;
+
+        if (entry->timestamp < victim->timestamp)
+            victim = entry;
+    }
+
+    /* Entry replaced within dedup window means dedup table is too small */
+    if (victim->fingerprint &&
+        timestamp >= victim->timestamp && timestamp - victim->timestamp <= dedupWindow)
+        *evicted = True;
+
+    victim->fingerprint = fingerprint;
+    victim->timestamp = timestamp;
+    return False;
+}
+
+/**
+ * @brief Check whether tcp packet is a duplicate of packet seen within
+ *        dedup window, like frames delivered twice by ingress and egress
+ *        SPAN.
+ *
+ * @param iph -- tcp packet to check
+ * @param info -- ip packet info
+ * @param tm -- packet capture timestamp
+ *
+ * @return True if duplicate packet else False
+ */
+boolean
+packetDedupProcess (iphdrPtr iph, ipPktInfoPtr info, timeValPtr tm) {
+    boolean duplicated, evicted;
+
+    if (dedupBuckets == NULL)
+        return False;
+
+    /* Tcp header will be validated by tcpProcess */
+    if (info->len < info->hdrLen + sizeof (tcphdr))
+        return False;
+
+    METRICS_COUNTER_INC (METRIC_DEDUP_PACKETS_CHECKED);
+
+    duplicated = packetDedupLookup (iph, info, tm, &evicted);
+    if (duplicated)
+        METRICS_COUNTER_INC (METRIC_DEDUP_PACKETS_DUPLICATED);
+    else if (evicted)
+        METRICS_COUNTER_INC (METRIC_DEDUP_ENTRIES_EVICTED);
+
+    return duplicated;
+}
+
+/**
+ * @brief Record tcp packet processed by other thread in dedup table
+ *        without counting it, so that dedup table of each thread is the
+ *        same no matter how flows are sliced to threads.
+ *
+ * @param iph -- tcp packet to record
+ * @param info -- ip packet info
+ * @param tm -- packet capture timestamp
+ */
+void
+packetDedupUpdate (iphdrPtr iph, ipPktInfoPtr info, timeValPtr tm) {
+    boolean evicted;
+
+    if (dedupBuckets == NULL)
+        return;
+
+    if (info->len < info->hdrLen + sizeof (tcphdr))
+        return;
+
+    packetDedupLookup (iph, info, tm, &evicted);
+}
+
+/**
+ * @brief Init packet dedup context of current thread.
+ *
+ * @param window -- dedup window in milliseconds, 0 for disabled
+ *
+ * @return 0 if success else -1
+ */
+int
+initPacketDedupContext (u_int window) {
+    dedupWindow = (u_long_long) window * 1000;
+    if (window == 0)
+        return 0;
+
+    dedupBuckets = (packetDedupBucketPtr) calloc (PACKET_DEDUP_BUCKETS,
+                                                  sizeof (packetDedupBucket));
+    if (dedupBuckets == NULL) {
+        LOGE ("Alloc packet dedup table error.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Destroy packet dedup context of current thread */
+void
+destroyPacketDedupContext (void) {
+    free (dedupBuckets);
+    dedupBuckets = NULL;
+    dedupWindow = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef __PACKET_DEDUP_H__
+#define __PACKET_DEDUP_H__
+
+#include "util.h"
+#include "ip.h"
+#include "ip_packet.h"
+
+/* Dedup table buckets of each thread, must be power of 2 */
+#define PACKET_DEDUP_BUCKETS 16384
+/* Dedup entries of each bucket */
+#define PACKET_DEDUP_BUCKET_ENTRIES 4
+/* Max payload bytes of tcp packet hashed into fingerprint */
+#define PACKET_DEDUP_PAYLOAD_HASH_LENGTH 64
+
+typedef struct _packetDedupEntry packetDedupEntry;
+typedef packetDedupEntry *packetDedupEntryPtr;
+
+/* Fingerprint of tcp packet seen recently */
+struct _packetDedupEntry {
+    u_long_long fingerprint;            /**< Tcp packet fingerprint, 0 for empty entry */
+    u_long_long timestamp;              /**< Capture timestamp in microseconds */
+};
+
+typedef struct _packetDedupBucket packetDedupBucket;
+typedef packetDedupBucket *packetDedupBucketPtr;
+
+struct _packetDedupBucket {
+    packetDedupEntry entries [PACKET_DEDUP_BUCKET_ENTRIES]; /**< Bucket entries */
+};
+
+/*========================Interfaces definition============================*/
+boolean
+packetDedupProcess (iphdrPtr iph, ipPktInfoPtr info, timeValPtr tm);
+void
+packetDedupUpdate (iphdrPtr iph, ipPktInfoPtr info, timeValPtr tm);
+int
+initPacketDedupContext (u_int window);
+void
+destroyPacketDedupContext (void);
+/*=======================Interfaces definition end=========================*/
+
+#endif /* __PACKET_DEDUP_H__ */
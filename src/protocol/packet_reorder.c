@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <czmq.h>
+#include "util.h"
+#include "log.h"
+#include "packet_reorder.h"
+
+/* Reorder window in microseconds of each thread, 0 for disabled */
+static __thread u_long_long reorderWindow = 0;
+/* Min heap of packets ordered by capture timestamp */
+static __thread packetReorderEntryPtr reorderHeap = NULL;
+/* Packets number in min heap */
+static __thread u_int reorderHeapSize = 0;
+/* Arrival order of the next packet */
+static __thread u_long_long reorderOrder = 0;
+/* Max capture timestamp of packets pushed */
+static __thread u_long_long reorderMaxCaptureTime = 0;
+
+/* Whether entry1 should be released before entry2 */
+static inline boolean
+packetReorderBefore (packetReorderEntryPtr entry1, packetReorderEntryPtr entry2) {
+    if (entry1->captureTime != entry2->captureTime)
+        return entry1->captureTime < entry2->captureTime;
+
+    return entry1->order < entry2->order;
+}
+
+static inline void
+packetReorderSwap (packetReorderEntryPtr entry1, packetReorderEntryPtr entry2) {
+    packetReorderEntry tmp;
+
+    tmp = *entry1;
+    *entry1 = *entry2;
+    *entry2 = tmp;
+}
+
+static void
+packetReorderSiftUp (u_int index) {
+    u_int parent;
+
+    while (index) {
+        parent = (index - 1) / 2;
+        if (!packetReorderBefore (&reorderHeap [index], &reorderHeap [parent]))
+            break;
+
+        packetReorderSwap (&reorderHeap [index], &reorderHeap [parent]);
+        index = parent;
+    }
+}
+
+static void
+packetReorderSiftDown (u_int index) {
+    u_int child, min;
+
+    for (;;) {
+        min = index;
+        child = index * 2 + 1;
+        if (child < reorderHeapSize &&
+            packetReorderBefore (&reorderHeap [child], &reorderHeap [min]))
+            min = child;
+        child++;
+        if (child < reorderHeapSize &&
+            packetReorderBefore (&reorderHeap [child], &reorderHeap [min]))
+            min = child;
+        if (min == index)
+            break;
+
+        packetReorderSwap (&reorderHeap [index], &reorderHeap [min]);
+        index = min;
+    }
+}
+
+/* Whether packet reorder stage of current thread is enabled */
+boolean
+packetReorderEnabled (void) {
+    return reorderWindow ? True : False;
+}
+
+/* Get packets number held by packet reorder stage of current thread */
+u_int
+packetReorderPending (void) {
+    return reorderHeapSize;
+}
+
+/**
+ * @brief Push packet into reorder stage, packet will be released in
+ *        capture timestamp order by packetReorderPop.
+ *
+ * @param tmFrame -- packet timestamp zframe
+ * @param ipPktFrame -- ip packet zframe
+ *
+ * @return 0 if success else -1 if reorder stage is full
+ */
+int
+packetReorderPush (zframe_t *tmFrame, zframe_t *ipPktFrame) {
+    pktTimestampPtr timestamp;
+    packetReorderEntryPtr entry;
+
+    if (reorderHeapSize == PACKET_REORDER_MAX_ENTRIES)
+        return -1;
+
+    timestamp = (pktTimestampPtr) zframe_data (tmFrame);
+    entry = &reorderHeap [reorderHeapSize];
+    entry->captureTime = (ntohll (timestamp->captureTime.tvSec) * 1000000 +
+                          ntohll (timestamp->captureTime.tvUsec));
+    entry->arrivalTime = getMonotonicTime ();
+    entry->order = reorderOrder++;
+    entry->tmFrame = tmFrame;
+    entry->ipPktFrame = ipPktFrame;
+    if (entry->captureTime > reorderMaxCaptureTime)
+        reorderMaxCaptureTime = entry->captureTime;
+
+    packetReorderSiftUp (reorderHeapSize++);
+    return 0;
+}
+
+/**
+ * @brief Pop packet with the min capture timestamp from reorder stage if
+ *        it is out of reorder window, which means packet newer than it
+ *        by reorder window has been pushed, or it has been held for
+ *        reorder window, or reorder stage is full.
+ *
+ * @param flush -- pop packet regardless of reorder window
+ * @param tmFrame -- pointer to return packet timestamp zframe
+ * @param ipPktFrame -- pointer to return ip packet zframe
+ *
+ * @return True if packet is popped else False
+ */
+boolean
+packetReorderPop (boolean flush, zframe_t **tmFrame, zframe_t **ipPktFrame) {
+    packetReorderEntryPtr top;
+
+    if (reorderHeapSize == 0)
+        return False;
+
+    top = &reorderHeap [0];
+    if (!flush &&
+        reorderHeapSize < PACKET_REORDER_MAX_ENTRIES &&
+        reorderMaxCaptureTime - top->captureTime < reorderWindow &&
+        getMonotonicTime () - top->arrivalTime < reorderWindow * 1000)
+        return False;
+
+    *tmFrame = top->tmFrame;
+    *ipPktFrame = top->ipPktFrame;
+    reorderHeap [0] = reorderHeap [--reorderHeapSize];
+    packetReorderSiftDown (0);
+    return True;
+}
+
+/**
+ * @brief Init packet reorder context of current thread.
+ *
+ * @param window -- reorder window in milliseconds, 0 for disabled
+ *
+ * @return 0 if success else -1
+ */
+int
+initPacketReorderContext (u_int window) {
+    reorderWindow = (u_long_long) window * 1000;
+    reorderHeapSize = 0;
+    reorderOrder = 0;
+    reorderMaxCaptureTime = 0;
+    if (window == 0)
+        return 0;
+
+    reorderHeap = (packetReorderEntryPtr) malloc (sizeof (packetReorderEntry) *
+                                                  PACKET_REORDER_MAX_ENTRIES);
+    if (reorderHeap == NULL) {
+        LOGE ("Alloc packet reorder heap error.\n");
+        reorderWindow = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Destroy packet reorder context of current thread, packets held are freed */
+void
+destroyPacketReorderContext (void) {
+    u_int i;
+
+    for (i = 0; i < reorderHeapSize; i++) {
+        zframe_destroy (&reorderHeap [i].tmFrame);
+        zframe_destroy (&reorderHeap [i].ipPktFrame);
+    }
+    free (reorderHeap);
+    reorderHeap = NULL;
+    reorderHeapSize = 0;
+    reorderWindow = 0;
+}
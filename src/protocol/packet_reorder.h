@@ -0,0 +1,37 @@
+#ifndef __PACKET_REORDER_H__
+#define __PACKET_REORDER_H__
+
+#include <czmq.h>
+#include "util.h"
+
+/* Max packets held by reorder stage of each thread */
+#define PACKET_REORDER_MAX_ENTRIES 65536
+
+typedef struct _packetReorderEntry packetReorderEntry;
+typedef packetReorderEntry *packetReorderEntryPtr;
+
+/* Packet held by reorder stage */
+struct _packetReorderEntry {
+    u_long_long captureTime;            /**< Capture timestamp in microseconds */
+    u_long_long arrivalTime;            /**< Monotonic timestamp of arrival in nanoseconds */
+    u_long_long order;                  /**< Arrival order of packets with the same capture timestamp */
+    zframe_t *tmFrame;                  /**< Packet timestamp zframe */
+    zframe_t *ipPktFrame;               /**< Ip packet zframe */
+};
+
+/*========================Interfaces definition============================*/
+boolean
+packetReorderEnabled (void);
+u_int
+packetReorderPending (void);
+int
+packetReorderPush (zframe_t *tmFrame, zframe_t *ipPktFrame);
+boolean
+packetReorderPop (boolean flush, zframe_t **tmFrame, zframe_t **ipPktFrame);
+int
+initPacketReorderContext (u_int window);
+void
+destroyPacketReorderContext (void);
+/*=======================Interfaces definition end=========================*/
+
+#endif /* __PACKET_REORDER_H__ */
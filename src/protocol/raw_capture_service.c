@@ -1,35 +1,71 @@
 #include <stdlib.h>
+#include <unistd.h>
 #include <pcap.h>
 #include <czmq.h>
 #include "util.h"
 #include "properties.h"
 #include "signals.h"
 #include "log.h"
+#include "metrics.h"
+#include "probes.h"
 #include "zmq_hub.h"
 #include "task_manager.h"
 #include "app_service_manager.h"
 #include "netdev.h"
 #include "ip.h"
+#include "ip_packet.h"
 #include "raw_packet.h"
 #include "raw_capture_service.h"
 
-/* NetDev pcap descriptor and datalink type */
-static pcap_t *pcapDev = NULL;
-static int datalinkType = -1;
+/* NetDev index, pcap descriptor and datalink type of raw capture thread */
+static __thread u_int netDevIndex = 0;
+static __thread pcap_t *pcapDev = NULL;
+static __thread int datalinkType = -1;
 
-static u_long_long rawPktCaptureSize = 0;
-static u_long_long rawPktCaptureStartTime = 0;
-static u_long_long rawPktCaptureEndTime = 0;
+static __thread u_long_long rawPktCaptureSize = 0;
+static __thread u_long_long rawPktCaptureStartTime = 0;
+static __thread u_long_long rawPktCaptureEndTime = 0;
+
+/* Replay benchmark checks duration every BENCH_TIME_CHECK_INTERVAL packets */
+#define BENCH_TIME_CHECK_INTERVAL 1024
+/* Timestamp gap in microseconds between two rounds of replay benchmark */
+#define BENCH_ROUND_GAP 1000000
+#define BENCH_PACKETS_INIT_SIZE 4096
+#define BENCH_PACKETS_BUF_INIT_SIZE (4 << 20)
+
+/* Pipeline drain check interval in microseconds after stream input complete */
+#define PIPELINE_DRAIN_CHECK_INTERVAL 100000
+
+typedef struct _benchPacket benchPacket;
+typedef benchPacket *benchPacketPtr;
+
+/* Ip packet preloaded in memory for replay benchmark */
+struct _benchPacket {
+    u_long_long timestamp;              /**< Capture timestamp in microseconds */
+    u_long_long offset;                 /**< Ip packet offset in bench packets buffer */
+    u_int len;                          /**< Raw packet length */
+};
+
+/* Preloaded packets of replay benchmark */
+static benchPacketPtr benchPackets = NULL;
+static u_int benchPacketsNum = 0;
+static u_int benchPacketsSize = 0;
+
+/* Ip packets buffer of replay benchmark */
+static u_char *benchPacketsBuf = NULL;
+static u_long_long benchPacketsBufLen = 0;
+static u_long_long benchPacketsBufSize = 0;
 
 static int
 resetPcapDev (void) {
     int ret;
     char *filter;
 
-    ret = resetNetDevForSniff ();
-    if (ret < 0) {
-        LOGE ("Reset netDev error.\n");
-        return -1;
+    ret = resetNetDevForSniff (netDevIndex);
+    if (ret) {
+        if (ret < 0 && !taskShouldExit ())
+            LOGE ("Reset netDev error.\n");
+        return ret;
     }
 
     filter = getAppServicesFilter ();
@@ -45,11 +81,42 @@ resetPcapDev (void) {
         return -1;
     }
 
-    pcapDev = getNetDevPcapDescForSniff ();
-    datalinkType = getNetDevDatalinkTypeForSniff ();
+    pcapDev = getNetDevPcapDescForSniff (netDevIndex);
+    datalinkType = getNetDevDatalinkTypeForSniff (netDevIndex);
     return 0;
 }
 
+/* Check whether all queues of pipeline are empty */
+static boolean
+pipelineDrained (void) {
+    return (getMetricsTotal (METRIC_IP_QUEUE_DEQUEUED) >=
+            getMetricsTotal (METRIC_IP_QUEUE_ENQUEUED) &&
+            getMetricsTotal (METRIC_ICMP_QUEUE_DEQUEUED) >=
+            getMetricsTotal (METRIC_ICMP_QUEUE_ENQUEUED) &&
+            getMetricsTotal (METRIC_TCP_QUEUE_DEQUEUED) >=
+            getMetricsTotal (METRIC_TCP_QUEUE_ENQUEUED) &&
+            getMetricsTotal (METRIC_RECORD_QUEUE_DEQUEUED) >=
+            getMetricsTotal (METRIC_RECORD_QUEUE_ENQUEUED)) ? True : False;
+}
+
+/*
+ * Wait for packets in flight to be processed after stream input complete,
+ * pipeline is drained if all queues are empty in two continuous checks,
+ * since packet may be in process between two queues.
+ */
+static void
+waitForPipelineDrained (void) {
+    u_int idle = 0;
+
+    while (!taskShouldExit () && idle < 2) {
+        usleep (PIPELINE_DRAIN_CHECK_INTERVAL);
+        if (pipelineDrained ())
+            idle++;
+        else
+            idle = 0;
+    }
+}
+
 static void
 displayRawCaptureStatisticInfo (void) {
     rawPktCaptureEndTime = getSysTime ();
@@ -65,11 +132,248 @@ displayRawCaptureStatisticInfo (void) {
            ((double) (rawPktCaptureEndTime - rawPktCaptureStartTime) / 1000)));
 }
 
+/**
+ * @brief Send packet timestamp and ip packet to ip process service.
+ *
+ * @param ipPktSendSock -- Ip packet send sock
+ * @param iph -- Ip packet to send
+ * @param tvSec -- Packet capture timestamp seconds
+ * @param tvUsec -- Packet capture timestamp microseconds
+ *
+ * @return 0 if success else -1
+ */
+static int
+sendIpPkt (void *ipPktSendSock, iphdrPtr iph, u_long_long tvSec, u_long_long tvUsec) {
+    int ret;
+    pktTimestamp timestamp;
+    zframe_t *frame;
+
+    /* Get packet capture and ingress timestamp */
+    timestamp.captureTime.tvSec = htonll (tvSec);
+    timestamp.captureTime.tvUsec = htonll (tvUsec);
+    timestamp.clockId = getMetricsClockId ();
+    timestamp.ingressTime = getMonotonicTime ();
+    timestamp.dispatchTime = 0;
+
+    /* Send packet timestamp zframe */
+    frame = zframe_new (&timestamp, sizeof (pktTimestamp));
+    if (frame == NULL) {
+        LOGE ("Create packet timestamp zframe error.\n");
+        METRICS_DROP (DROP_REASON_NO_MEMORY);
+        return -1;
+    }
+    ret = zframe_send (&frame, ipPktSendSock, ZFRAME_MORE);
+    if (ret < 0) {
+        LOGE ("Send packet timestamp zframe error.\n");
+        METRICS_DROP (DROP_REASON_SEND);
+        return -1;
+    }
+
+    /* Send ip packet zframe */
+    frame = zframe_new (iph, getIpPktLen (iph));
+    if (frame == NULL) {
+        LOGE ("Create ip packet zframe error.\n");
+        METRICS_DROP (DROP_REASON_NO_MEMORY);
+        return -1;
+    }
+    ret = zframe_send (&frame, ipPktSendSock, 0);
+    if (ret < 0) {
+        LOGE ("Send ip packet zframe error.\n");
+        METRICS_DROP (DROP_REASON_SEND);
+        return -1;
+    }
+
+    METRICS_COUNTER_INC (METRIC_PACKETS_SENT);
+    METRICS_COUNTER_INC (METRIC_IP_QUEUE_ENQUEUED);
+    return 0;
+}
+
+/* Free preloaded packets of replay benchmark */
+static void
+freeBenchPackets (void) {
+    free (benchPackets);
+    benchPackets = NULL;
+    benchPacketsNum = 0;
+    benchPacketsSize = 0;
+
+    free (benchPacketsBuf);
+    benchPacketsBuf = NULL;
+    benchPacketsBufLen = 0;
+    benchPacketsBufSize = 0;
+}
+
+/* Append ip packet to preloaded packets of replay benchmark */
+static int
+benchPacketAppend (struct pcap_pkthdr *capPktHdr, iphdrPtr iph) {
+    u_int size, len;
+    u_long_long bufSize;
+    benchPacketPtr packets;
+    u_char *buf;
+
+    if (benchPacketsNum == benchPacketsSize) {
+        size = benchPacketsSize ? benchPacketsSize * 2 : BENCH_PACKETS_INIT_SIZE;
+        packets = (benchPacketPtr) realloc (benchPackets, sizeof (benchPacket) * size);
+        if (packets == NULL)
+            return -1;
+        benchPackets = packets;
+        benchPacketsSize = size;
+    }
+
+    /* Keep ip packets 8 bytes aligned */
+    len = getIpPktLen (iph);
+    if (benchPacketsBufLen + len > benchPacketsBufSize) {
+        bufSize = benchPacketsBufSize ? benchPacketsBufSize : BENCH_PACKETS_BUF_INIT_SIZE;
+        while (benchPacketsBufLen + len > bufSize)
+            bufSize *= 2;
+        buf = (u_char *) realloc (benchPacketsBuf, bufSize);
+        if (buf == NULL)
+            return -1;
+        benchPacketsBuf = buf;
+        benchPacketsBufSize = bufSize;
+    }
+
+    memcpy (benchPacketsBuf + benchPacketsBufLen, iph, len);
+    benchPackets [benchPacketsNum].timestamp =
+            (u_long_long) capPktHdr->ts.tv_sec * 1000000 + capPktHdr->ts.tv_usec;
+    benchPackets [benchPacketsNum].offset = benchPacketsBufLen;
+    benchPackets [benchPacketsNum].len = capPktHdr->len;
+    benchPacketsNum++;
+    benchPacketsBufLen += (len + 7) & ~7;
+
+    return 0;
+}
+
+/*
+ * Preload ip packets of pcap file into memory for replay benchmark,
+ * packets are filtered by application services filter of pcapDev.
+ */
+static int
+loadBenchPackets (void) {
+    int ret;
+    u_int skipped = 0;
+    struct pcap_pkthdr *capPktHdr;
+    u_char *rawPkt;
+    iphdrPtr iph;
+
+    while (!taskShouldExit ()) {
+        ret = pcap_next_ex (pcapDev, &capPktHdr, (const u_char **) &rawPkt);
+        if (ret == 1) {
+            if (capPktHdr->caplen != capPktHdr->len) {
+                skipped++;
+                continue;
+            }
+
+            iph = (iphdrPtr) getIpPacket (rawPkt, datalinkType);
+            if (iph == NULL) {
+                skipped++;
+                continue;
+            }
+
+            ret = benchPacketAppend (capPktHdr, iph);
+            if (ret < 0) {
+                LOGE ("Alloc memory for replay benchmark packets error.\n");
+                freeBenchPackets ();
+                return -1;
+            }
+        } else if (ret == -1) {
+            LOGE ("Read pcap file for replay benchmark error.\n");
+            freeBenchPackets ();
+            return -1;
+        } else if (ret == -2)
+            break;
+    }
+
+    if (benchPacketsNum == 0) {
+        LOGE ("No packet to replay for benchmark.\n");
+        return -1;
+    }
+
+    LOGI ("\nPreload %u packets, %llu bytes for replay benchmark, skip %u packets.\n",
+          benchPacketsNum, benchPacketsBufLen, skipped);
+    return 0;
+}
+
+/**
+ * @brief Replay preloaded packets in a loop through pipeline as fast as
+ *        possible until benchmark duration elapses, then display replay
+ *        benchmark report. Capture timestamps of every round are shifted
+ *        by time span of pcap file, so flows timeout as in capture.
+ *
+ * @param ipPktSendSock -- Ip packet send sock
+ *
+ * @return 0 if complete, 1 if interrupted, -1 if error
+ */
+static int
+replayBenchPackets (void *ipPktSendSock) {
+    int ret;
+    u_int i;
+    u_long_long rounds = 0, replayed = 0;
+    u_long_long span, timestamp, endTime;
+    benchPacketPtr pkt;
+    metricsSnapshotPtr begin, end;
+
+    begin = (metricsSnapshotPtr) malloc (sizeof (metricsSnapshot));
+    end = (metricsSnapshotPtr) malloc (sizeof (metricsSnapshot));
+    if (begin == NULL || end == NULL) {
+        LOGE ("Alloc metrics snapshot error.\n");
+        free (begin);
+        free (end);
+        return -1;
+    }
+
+    span = benchPackets [benchPacketsNum - 1].timestamp - benchPackets [0].timestamp;
+    if ((long_long) span < 0)
+        span = 0;
+    span += BENCH_ROUND_GAP;
+
+    LOGI ("Start replay benchmark for %u seconds.\n", getPropertiesBenchDuration ());
+    metricsTakeSnapshot (begin);
+    endTime = begin->time + (u_long_long) getPropertiesBenchDuration () * 1000000000;
+    ret = 1;
+
+    while (!taskShouldExit ()) {
+        for (i = 0; i < benchPacketsNum; i++) {
+            pkt = &benchPackets [i];
+            NTRACE_PROBE2 (packet__received, pkt->len, pkt->len);
+            METRICS_COUNTER_INC (METRIC_PACKETS_RECEIVED);
+            METRICS_COUNTER_ADD (METRIC_BYTES_RECEIVED, pkt->len);
+            rawPktCaptureSize += pkt->len;
+
+            timestamp = pkt->timestamp + rounds * span;
+            sendIpPkt (ipPktSendSock, (iphdrPtr) (benchPacketsBuf + pkt->offset),
+                       timestamp / 1000000, timestamp % 1000000);
+
+            if ((++replayed & (BENCH_TIME_CHECK_INTERVAL - 1)) == 0 &&
+                (getMonotonicTime () >= endTime || taskShouldExit ()))
+                break;
+        }
+
+        if (i < benchPacketsNum) {
+            if (!taskShouldExit ())
+                ret = 0;
+            break;
+        }
+        rounds++;
+    }
+
+    if (ret == 0) {
+        metricsTakeSnapshot (end);
+        LOGI ("\nReplay %llu packets in %llu rounds.\n", replayed, rounds);
+        displayMetricsBenchReport (begin, end);
+    }
+
+    free (begin);
+    free (end);
+    return ret;
+}
+
 /*
  * Raw packet capture service.
- * Capture raw packets from pcap file or mirror interface,
- * then extract ip packet from raw packet and send it to
- * ip packet process service.
+ * Capture raw packets from pcap file, pcap directory, pipe or
+ * mirror interface, then extract ip packet from raw packet and
+ * send it to ip packet process service. There is one raw capture
+ * service for every mirror interface, ip packets of all interfaces
+ * are merged by ip packet process service.
  */
 void *
 rawCaptureService (void *args) {
@@ -80,8 +384,7 @@ rawCaptureService (void *args) {
     struct pcap_pkthdr *capPktHdr;
     u_char *rawPkt;
     iphdrPtr iph;
-    timeVal captureTime;
-    zframe_t *frame;
+    boolean captureComplete = False;
 
     /* Reset signals flag */
     resetSignalsFlag ();
@@ -93,17 +396,27 @@ rawCaptureService (void *args) {
         goto exit;
     }
 
+    netDevIndex = *((u_int *) args);
+    setLogComponent ("RawCaptureService:%u", netDevIndex);
+
+    /* Init metrics context */
+    ret = initMetricsContext ("RawCaptureService:%u", netDevIndex);
+    if (ret < 0) {
+        LOGE ("Init metrics context error.\n");
+        goto destroyLogContext;
+    }
+
     /* Display task schedule policy info */
     displayTaskSchedPolicyInfo ("RawCaptureService");
 
     /* Get net device pcap descriptor for sniff */
-    pcapDev = getNetDevPcapDescForSniff ();
+    pcapDev = getNetDevPcapDescForSniff (netDevIndex);
     /* Get net device datalink type for sniff */
-    datalinkType = getNetDevDatalinkTypeForSniff ();
+    datalinkType = getNetDevDatalinkTypeForSniff (netDevIndex);
     /* Get ipPktSendSock */
-    ipPktSendSock = getIpPktSendSock ();
+    ipPktSendSock = getIpPktSendSock (netDevIndex);
 
-    if (!getPropertiesSniffLive ()) {
+    if (!getPropertiesSniffLive () && !getNetDevStreamInput ()) {
         msgStr = zstr_recv (getProtoDetectionStatusRecvSock ());
         if (msgStr) {
             LOGI ("%s\n", msgStr);
@@ -112,21 +425,51 @@ rawCaptureService (void *args) {
             LOGE ("Receive proto detection status message with fatal error.\n");
     }
 
+    /* Open stream input, wait until first pcap segment or pipe is ready */
+    if (getNetDevStreamInput ()) {
+        ret = resetPcapDev ();
+        if (ret < 0)
+            goto destroyMetricsContext;
+        if (ret == 1) {
+            captureComplete = True;
+            goto destroyMetricsContext;
+        }
+    }
+
     /* Update application services filter */
     filter = getAppServicesFilter ();
     if (filter == NULL) {
         LOGE ("Get application services filter error.\n");
-        goto destroyLogContext;
+        goto destroyMetricsContext;
     }
     ret = updateNetDevFilterForSniff (filter);
     if (ret < 0) {
         LOGE ("Update application services filter error.\n");
         free (filter);
-        goto destroyLogContext;
+        goto destroyMetricsContext;
     }
     LOGI ("\nUpdate application services filter with:\n%s\n", filter);
     free (filter);
 
+    /* Replay benchmark */
+    if (getPropertiesBenchMode ()) {
+        ret = loadBenchPackets ();
+        if (ret < 0)
+            goto destroyMetricsContext;
+
+        rawPktCaptureSize = 0;
+        rawPktCaptureStartTime = getSysTime ();
+        ret = replayBenchPackets (ipPktSendSock);
+        freeBenchPackets ();
+        if (ret < 0)
+            goto destroyMetricsContext;
+        if (ret == 0)
+            captureComplete = True;
+
+        displayRawCaptureStatisticInfo ();
+        goto destroyMetricsContext;
+    }
+
     /* Init rawPktCaptureSize and rawPktCaptureStartTime */
     rawPktCaptureSize = 0;
     rawPktCaptureStartTime = getSysTime ();
@@ -134,59 +477,56 @@ rawCaptureService (void *args) {
     while (!taskShouldExit ()) {
         ret = pcap_next_ex (pcapDev, &capPktHdr, (const u_char **) &rawPkt);
         if (ret == 1) {
+            NTRACE_PROBE2 (packet__received, capPktHdr->caplen, capPktHdr->len);
+            METRICS_COUNTER_INC (METRIC_PACKETS_RECEIVED);
+            METRICS_COUNTER_ADD (METRIC_BYTES_RECEIVED, capPktHdr->len);
+
             /* Filter out incomplete raw packet */
-            if (capPktHdr->caplen != capPktHdr->len)
+            if (capPktHdr->caplen != capPktHdr->len) {
+                METRICS_DROP (DROP_REASON_INCOMPLETE);
                 continue;
+            }
 
             rawPktCaptureSize += capPktHdr->caplen;
 
             /* Get ip packet */
             iph = (iphdrPtr) getIpPacket (rawPkt, datalinkType);
-            if (iph == NULL)
-                continue;
-
-            /* Get packet capture timestamp */
-            captureTime.tvSec = htonll (capPktHdr->ts.tv_sec);
-            captureTime.tvUsec = htonll (capPktHdr->ts.tv_usec);
-
-            /* Send capture timestamp zframe */
-            frame = zframe_new (&captureTime, sizeof (timeVal));
-            if (frame == NULL) {
-                LOGE ("Create packet timestamp zframe error.\n");
-                continue;
-            }
-            ret = zframe_send (&frame, ipPktSendSock, ZFRAME_MORE);
-            if (ret < 0) {
-                LOGE ("Send packet timestamp zframe error.\n");
+            if (iph == NULL) {
+                METRICS_DROP (DROP_REASON_NOT_IP);
                 continue;
             }
 
-            /* Send ip packet zframe */
-            frame = zframe_new (iph, ntohs (iph->ipLen));
-            if (frame == NULL) {
-                LOGE ("Create ip packet zframe error.\n");
-                continue;
-            }
-            ret = zframe_send (&frame, ipPktSendSock, 0);
-            if (ret < 0) {
-                LOGE ("Send ip packet zframe error.\n");
-                continue;
-            }
+            sendIpPkt (ipPktSendSock, iph, capPktHdr->ts.tv_sec, capPktHdr->ts.tv_usec);
         } else if (ret == -1) {
             LOGE ("Capture raw packets for sniff with fatal error.\n");
             break;
-        } else if (ret == -2 && resetPcapDev () < 0)
-            break;
+        } else if (ret == -2) {
+            /* Carry on with next pcap segment or pipe writer */
+            ret = resetPcapDev ();
+            if (ret < 0)
+                break;
+            if (ret == 1) {
+                LOGI ("Stream input complete, wait for pipeline drained.\n");
+                waitForPipelineDrained ();
+                if (!taskShouldExit ())
+                    captureComplete = True;
+                break;
+            }
+        }
     }
 
     /* Show raw packets capture statistics info */
     displayRawCaptureStatisticInfo ();
 
     LOGI ("RawCaptureService will exit ... .. .\n");
+destroyMetricsContext:
+    destroyMetricsContext ();
 destroyLogContext:
     destroyLogContext ();
 exit:
-    if (!taskShouldExit ())
+    if (captureComplete)
+        sendTaskStatus (TASK_STATUS_COMPLETE);
+    else if (!taskShouldExit ())
         sendTaskStatus (TASK_STATUS_EXIT_ABNORMALLY);
 
     return NULL;
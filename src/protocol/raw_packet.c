@@ -2,6 +2,11 @@
 #include <pcap.h>
 #include "log.h"
 
+/* Check whether ether type is ipv4 (0x0800) or ipv6 (0x86DD) */
+#define ETHER_TYPE_IS_IP(type)                                          \
+    (((type) [0] == 0x08 && (type) [1] == 0x00) ||                      \
+     ((type) [0] == 0x86 && (type) [1] == 0xDD))
+
 /**
  * @brief Extract ip packet from raw packet
  *
@@ -20,10 +25,11 @@ getIpPacket (u_char *rawPkt, u_int datalinkType) {
             break;
 
         case DLT_EN10MB:  /* Ethernet (10Mb, 100Mb, 1000Mb or higher) protocol */
-            /* Regular ip frame */
-            if (rawPkt [12] == 0x08 && rawPkt [13] == 0x00)
+            /* Regular ipv4 or ipv6 frame */
+            if (ETHER_TYPE_IS_IP (rawPkt + 12))
                 offset = 14;
-            else if (rawPkt [12] == 0x81 && rawPkt [13] == 0x00) {
+            else if (rawPkt [12] == 0x81 && rawPkt [13] == 0x00 &&
+                     ETHER_TYPE_IS_IP (rawPkt + 16)) {
                 /*
                  * 802.1Q VLAN frame
                  * +----------------------------------------------------------------------+
@@ -38,7 +44,7 @@ getIpPacket (u_char *rawPkt, u_int datalinkType) {
                 offset = 18;
             } else {
                 /* Wrong ip packet */
-                LOGE ("Wrong ip packet.\n");
+                LOGE_RL ("Wrong ip packet.\n");
                 return NULL;
             }
             break;
@@ -72,7 +78,7 @@ getIpPacket (u_char *rawPkt, u_int datalinkType) {
             break;
 
         default:
-            LOGE ("Unknown datalink type.\n");
+            LOGE_RL ("Unknown datalink type.\n");
             return NULL;
     }
 
@@ -3,79 +3,48 @@
 #include "properties.h"
 #include "signals.h"
 #include "log.h"
+#include "metrics.h"
+#include "probes.h"
 #include "zmq_hub.h"
 #include "task_manager.h"
 #include "ip.h"
 #include "tcp.h"
+#include "ip_packet.h"
 #include "tcp_dispatch_service.h"
 
-static u_int
-dispatchHash (const char *key1, const char *key2) {
-    u_int sum, hash = 0;
-    u_int seed = 16777619;
-    const char *tmp;
-
-    if (strlen (key1) < strlen (key2)) {
-        tmp = key1;
-        key1 = key2;
-        key2 = tmp;
-    }
-
-    while (*key2) {
-        hash *= seed;
-        sum = *key1 + *key2;
-        hash ^= sum;
-        key1++;
-        key2++;
-    }
-
-    while (*key1) {
-        hash *= seed;
-        hash ^= (size_t) (*key1);
-        key1++;
-    }
-
-    return hash;
-}
-
 /**
  * @brief Dispatch timestamp and ip packet to specific tcp
  *        packet process service thread.
  *
  * @param iph -- ip packet to dispatch
- * @param tm -- capture timestamp to dispatch
+ * @param info -- ip packet info
+ * @param timestamp -- packet timestamp to dispatch
  */
 static void
-tcpPacketDispatch (iphdrPtr iph, timeValPtr tm) {
+tcpPacketDispatch (iphdrPtr iph, ipPktInfoPtr info, pktTimestampPtr timestamp) {
     int ret;
     u_int hash;
     u_int ipPktLen;
-    tcphdrPtr tcph;
-    char ipSrcStr [16], ipDestStr [16];
-    char key1 [32], key2 [32];
     zframe_t *frame;
     void *tcpPktSendSock = NULL;
 
-    ipPktLen = ntohs (iph->ipLen);
+    ipPktLen = info->len;
 
-    tcph = (tcphdrPtr) ((u_char *) iph + (iph->iphLen * 4));
-    inet_ntop (AF_INET, (void *) &iph->ipSrc, ipSrcStr, sizeof (ipSrcStr));
-    inet_ntop (AF_INET, (void *) &iph->ipDest, ipDestStr, sizeof (ipDestStr));
-    snprintf (key1, sizeof (key1), "%s:%d", ipSrcStr, ntohs (tcph->source));
-    snprintf (key2, sizeof (key2), "%s:%d", ipDestStr, ntohs (tcph->dest));
-
-    hash = dispatchHash (key1, key2);
+    hash = ipPktDispatchHash (iph, info);
     tcpPktSendSock = getTcpPktSendSock (hash % getTcpProcessThreadsNum ());
+    NTRACE_PROBE2 (tcp__dispatch, hash, ipPktLen);
 
     /* Send tm zframe*/
-    frame = zframe_new (tm, sizeof (timeVal));
+    frame = zframe_new (timestamp, sizeof (pktTimestamp));
     if (frame == NULL) {
         LOGE ("Create timestamp zframe error.\n");
+        METRICS_DROP (DROP_REASON_NO_MEMORY);
         return;
     }
     ret = zframe_send (&frame, tcpPktSendSock, ZFRAME_MORE);
     if (ret < 0) {
         LOGE ("Send tm zframe error.\n");
+        METRICS_DROP (DROP_REASON_SEND);
         return;
     }
 
@@ -83,13 +52,18 @@ tcpPacketDispatch (iphdrPtr iph, timeValPtr tm) {
     frame = zframe_new (iph, ipPktLen);
     if (frame == NULL) {
         LOGE ("Create ip packet zframe error.");
+        METRICS_DROP (DROP_REASON_NO_MEMORY);
         return;
     }
     ret = zframe_send (&frame, tcpPktSendSock, 0);
     if (ret < 0) {
         LOGE ("Send ip packet zframe error.\n");
+        METRICS_DROP (DROP_REASON_SEND);
         return;
     }
+
+    METRICS_COUNTER_INC (METRIC_PACKETS_SENT);
+    METRICS_COUNTER_INC (METRIC_TCP_QUEUE_ENQUEUED);
 }
 
 /*
@@ -104,6 +78,7 @@ tcpDispatchService (void *args) {
     zframe_t *tmFrame = NULL;
     zframe_t *pktFrame = NULL;
     iphdrPtr iph;
+    ipPktInfo ipInfo;
 
     /* Reset signals flag */
     resetSignalsFlag ();
@@ -114,6 +89,14 @@ tcpDispatchService (void *args) {
         fprintf (stderr, "Init log context error.\n");
         goto exit;
     }
+    setLogComponent ("TcpDispatchService");
+
+    /* Init metrics context */
+    ret = initMetricsContext ("TcpDispatchService");
+    if (ret < 0) {
+        LOGE ("Init metrics context error.\n");
+        goto destroyLogContext;
+    }
 
     /* Display task schedule policy info */
     displayTaskSchedPolicyInfo ("TcpDispatchService");
@@ -149,11 +132,31 @@ tcpDispatchService (void *args) {
             continue;
         }
 
+        if (zframe_size (tmFrame) != sizeof (pktTimestamp)) {
+            LOGE_RL ("Wrong packet timestamp zframe size: %u.\n", (u_int) zframe_size (tmFrame));
+            zframe_destroy (&tmFrame);
+            zframe_destroy (&pktFrame);
+            continue;
+        }
+
         iph = (iphdrPtr) zframe_data (pktFrame);
+        METRICS_COUNTER_INC (METRIC_PACKETS_RECEIVED);
+        METRICS_COUNTER_ADD (METRIC_BYTES_RECEIVED, zframe_size (pktFrame));
+
+        /* Ip packet from remote node may be malformed */
+        ret = getIpPktInfo (iph, &ipInfo);
+        if (ret < 0 || ipInfo.len > zframe_size (pktFrame)) {
+            LOGE_RL ("Invalid ip packet.\n");
+            METRICS_DROP (DROP_REASON_IP_HEADER);
+            zframe_destroy (&tmFrame);
+            zframe_destroy (&pktFrame);
+            continue;
+        }
+
         /* Dispatch ip packet and tmFrame */
-        switch (iph->ipProto) {
+        switch (ipInfo.proto) {
             case IPPROTO_TCP:
-                tcpPacketDispatch (iph, (timeValPtr) zframe_data (tmFrame));
+                tcpPacketDispatch (iph, &ipInfo, (pktTimestampPtr) zframe_data (tmFrame));
                 break;
 
             default:
@@ -166,6 +169,8 @@ tcpDispatchService (void *args) {
     }
 
     LOGI ("TcpDispatchService will exit ... .. .\n");
+    destroyMetricsContext ();
+destroyLogContext:
     destroyLogContext ();
 exit:
     if (!taskShouldExit ())
@@ -12,23 +12,26 @@
 #include "list.h"
 #include "hash.h"
 #include "atomic.h"
+#include "metrics.h"
+#include "probes.h"
 #include "checksum.h"
 #include "log.h"
 #include "ip.h"
 #include "tcp.h"
+#include "ip_packet.h"
 #include "tcp_options.h"
 #include "proto_analyzer.h"
+#include "proto_analyzer_stats.h"
+#include "heavy_hitter.h"
 #include "app_service_manager.h"
 #include "topology_entry.h"
 #include "topology_manager.h"
 #include "analysis_record.h"
 #include "tcp_packet.h"
 
-/* Tcp stream hash key format string */
-#define TCP_STREAM_HASH_KEY_FORMAT "%s:%u:%s:%u"
-
-/* Closing timeout of tcp stream */
-#define TCP_STREAM_CLOSING_TIMEOUT 30
+/* Ip address argument of probes, ipv4 address or hash of ipv6 address */
+#define PROBE_IP_ADDR(addr)                                             \
+    ((addr).family == AF_INET ? (addr).u.ip4.s_addr : ipAddrHash (&(addr)))
 
 /* Tcp stream hash table size */
 #define TCP_STREAM_HASH_TABLE_SIZE (1 << 17)
@@ -63,6 +66,11 @@ static __thread boolean doProtoDetect = False;
 /* Tcp process callback function */
 static __thread tcpProcessCB tcpProcessCallback;
 
+/* Derive connection id from flow instead of random uuid */
+static __thread boolean connIdFromFlow = False;
+/* Remove the oldest tcp stream when tcp streams exceed limit */
+static __thread boolean streamsEviction = True;
+
 static boolean
 before (u_int seq1, u_int seq2) {
     int ret;
@@ -87,10 +95,10 @@ after (u_int seq1, u_int seq2) {
 
 static boolean
 tuple4IsEqual (tuple4Ptr addr1, tuple4Ptr addr2) {
-    if (addr1->saddr.s_addr == addr2->saddr.s_addr &&
-        addr1->source == addr2->source &&
-        addr1->daddr.s_addr == addr2->daddr.s_addr &&
-        addr1->dest == addr2->dest)
+    if (addr1->source == addr2->source &&
+        addr1->dest == addr2->dest &&
+        ipAddrIsEqual (&addr1->saddr, &addr2->saddr) &&
+        ipAddrIsEqual (&addr1->daddr, &addr2->daddr))
         return True;
 
     return False;
@@ -174,7 +182,8 @@ delTcpStreamFromClosingTimeoutList (tcpStreamPtr stream) {
 }
 
 /**
- * @brief Lookup tcp stream from global tcp stream hash table.
+ * @brief Lookup tcp stream from global tcp stream hash table, 4 tuple
+ *        address is used as binary key so it must be zeroed before set.
  *
  * @param addr -- tcp stream 4 tuple address
  *
@@ -182,15 +191,7 @@ delTcpStreamFromClosingTimeoutList (tcpStreamPtr stream) {
  */
 static tcpStreamPtr
 lookupTcpStreamFromHash (tuple4Ptr addr) {
-    char ipSrcStr [16], ipDestStr [16];
-    char key [64];
-
-    inet_ntop (AF_INET, (void *) &addr->saddr, ipSrcStr, sizeof (ipSrcStr));
-    inet_ntop (AF_INET, (void *) &addr->daddr, ipDestStr, sizeof (ipDestStr));
-
-    snprintf (key, sizeof (key), TCP_STREAM_HASH_KEY_FORMAT,
-              ipSrcStr, addr->source, ipDestStr, addr->dest);
-    return (tcpStreamPtr) hashLookup (tcpStreamHashTable, key);
+    return (tcpStreamPtr) hashLookupBinKey (tcpStreamHashTable, addr, sizeof (tuple4));
 }
 
 /**
@@ -205,23 +206,22 @@ static int
 addTcpStreamToHash (tcpStreamPtr stream, hashItemFreeCB freeFun) {
     int ret;
     tuple4Ptr addr;
-    char ipSrcStr [16], ipDestStr [16];
-    char key [64];
 
     addr = &stream->addr;
-    inet_ntop (AF_INET, (void *) &addr->saddr, ipSrcStr, sizeof (ipSrcStr));
-    inet_ntop (AF_INET, (void *) &addr->daddr, ipDestStr, sizeof (ipDestStr));
-
-    snprintf (key, sizeof (key), TCP_STREAM_HASH_KEY_FORMAT,
-              ipSrcStr, addr->source, ipDestStr, addr->dest);
-    ret = hashInsert (tcpStreamHashTable, key, stream, freeFun);
+    ret = hashInsertBinKey (tcpStreamHashTable, addr, sizeof (tuple4), stream, freeFun);
     if (ret < 0) {
         LOGE ("Insert stream to hash table error.\n");
         return -1;
     }
 
-    if (!doProtoDetect)
+    NTRACE_PROBE4 (stream__create, PROBE_IP_ADDR (addr->saddr), addr->source,
+                   PROBE_IP_ADDR (addr->daddr), addr->dest);
+
+    if (!doProtoDetect) {
         tcpStreamsAllocLocal++;
+        METRICS_COUNTER_INC (METRIC_TCP_STREAMS_ALLOC);
+        METRICS_GAUGE_SET (METRIC_TCP_STREAMS, hashSize (tcpStreamHashTable));
+    }
 
     return 0;
 }
@@ -235,8 +235,7 @@ static void
 delTcpStreamFromHash (tcpStreamPtr stream, timeValPtr tm) {
     int ret;
     tuple4Ptr addr;
-    char ipSrcStr [16], ipDestStr [16];
-    char key [64];
+    char ipDestStr [IP_ADDR_STR_MAX_LENGTH];
     char *record;
     tcpProcessCallbackArgs callbackArgs;
 
@@ -245,11 +244,10 @@ delTcpStreamFromHash (tcpStreamPtr stream, timeValPtr tm) {
         streamCache = NULL;
 
     addr = &stream->addr;
-    inet_ntop (AF_INET, (void *) &addr->saddr, ipSrcStr, sizeof (ipSrcStr));
-    inet_ntop (AF_INET, (void *) &addr->daddr, ipDestStr, sizeof (ipDestStr));
 
     if (doProtoDetect) {
         if (stream->proto) {
+            ipAddrToStr (&addr->daddr, ipDestStr, sizeof (ipDestStr));
             /* Add appService detected */
             if (getAppServiceDetected (ipDestStr, addr->dest) == NULL ||
                 (getAppServiceFromBlacklist (ipDestStr, addr->dest) == NULL &&
@@ -274,37 +272,43 @@ delTcpStreamFromHash (tcpStreamPtr stream, timeValPtr tm) {
         }
     }
 
-    snprintf (key, sizeof (key), TCP_STREAM_HASH_KEY_FORMAT,
-              ipSrcStr, addr->source, ipDestStr, addr->dest);
-    ret = hashRemove (tcpStreamHashTable, key);
+    NTRACE_PROBE5 (stream__close, PROBE_IP_ADDR (addr->saddr), addr->source,
+                   PROBE_IP_ADDR (addr->daddr), addr->dest, stream->state);
+
+    ret = hashRemoveBinKey (tcpStreamHashTable, addr, sizeof (tuple4));
     if (ret < 0)
         LOGE ("Delete stream from hash table error.\n");
-    else if (!doProtoDetect)
+    else if (!doProtoDetect) {
         tcpStreamsFreeLocal++;
+        METRICS_COUNTER_INC (METRIC_TCP_STREAMS_FREE);
+        METRICS_GAUGE_SET (METRIC_TCP_STREAMS, hashSize (tcpStreamHashTable));
+    }
 }
 
 /**
  * @brief Find tcp stream from global hash table.
  *
  * @param tcph -- tcp header
- * @param iph -- ip header
+ * @param info -- ip packet info
  * @param direction -- return stream direction
  *
  * @return Tcp stream if success else NULL
  */
 static tcpStreamPtr
-findTcpStream (tcphdrPtr tcph, iphdrPtr iph, streamDirection *direction) {
+findTcpStream (tcphdrPtr tcph, ipPktInfoPtr info, streamDirection *direction) {
     tuple4 addr, revAddr;
     tcpStreamPtr stream;
 
-    addr.saddr = iph->ipSrc;
+    memset (&addr, 0, sizeof (tuple4));
+    memset (&revAddr, 0, sizeof (tuple4));
+    addr.saddr = info->src;
     addr.source = ntohs (tcph->source);
-    addr.daddr = iph->ipDest;
+    addr.daddr = info->dest;
     addr.dest = ntohs (tcph->dest);
 
-    revAddr.saddr = iph->ipDest;
+    revAddr.saddr = info->dest;
     revAddr.source = ntohs (tcph->dest);
-    revAddr.daddr = iph->ipSrc;
+    revAddr.daddr = info->src;
     revAddr.dest = ntohs (tcph->source);
 
     /* Check stream cache */
@@ -337,6 +341,42 @@ findTcpStream (tcphdrPtr tcph, iphdrPtr iph, streamDirection *direction) {
     return NULL;
 }
 
+/* Fnv-1a hash of data */
+static u_long_long
+fnv1aHash (u_long_long hash, const void *data, u_int len) {
+    u_int i;
+    const u_char *p = (const u_char *) data;
+
+    for (i = 0; i < len; i++) {
+        hash ^= p [i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/*
+ * Generate connection id from 4-tuple address, syn timestamp and client
+ * initial sequence, so the same flow gets the same id in every process.
+ */
+static void
+generateFlowConnId (tcpStreamPtr stream, tcphdrPtr tcph, timeValPtr tm) {
+    u_int i;
+    u_long_long hash [2];
+
+    for (i = 0; i < 2; i++) {
+        hash [i] = fnv1aHash (0xcbf29ce484222325ULL + i, &stream->addr, sizeof (tuple4));
+        hash [i] = fnv1aHash (hash [i], &tm->tvSec, sizeof (tm->tvSec));
+        hash [i] = fnv1aHash (hash [i], &tm->tvUsec, sizeof (tm->tvUsec));
+        hash [i] = fnv1aHash (hash [i], &tcph->seq, sizeof (tcph->seq));
+    }
+    memcpy (stream->connId, hash, sizeof (uuid_t));
+
+    /* Set version 4 and RFC 4122 variant like uuid_generate */
+    stream->connId [6] = (stream->connId [6] & 0x0f) | 0x40;
+    stream->connId [8] = (stream->connId [8] & 0x3f) | 0x80;
+}
+
 static tcpStreamPtr
 newTcpStream (protoAnalyzerPtr analyzer) {
     tcpStreamPtr stream;
@@ -348,16 +388,15 @@ newTcpStream (protoAnalyzerPtr analyzer) {
     if (!doProtoDetect) {
         stream->proto = analyzer->proto;
         stream->analyzer = analyzer;
+        stream->analyzerStats = getProtoAnalyzerStats (analyzer);
     } else {
         stream->proto = NULL;
         stream->analyzer = NULL;
+        stream->analyzerStats = NULL;
     }
 
-    /* Init 4-tuple address */
-    stream->addr.saddr.s_addr = 0;
-    stream->addr.source = 0;
-    stream->addr.daddr.s_addr = 0;
-    stream->addr.dest = 0;
+    /* Init 4-tuple address, it is used as binary hash key */
+    memset (&stream->addr, 0, sizeof (tuple4));
     /* Generate connection id */
     uuid_generate (stream->connId);
     /* Set stream init state */
@@ -464,6 +503,7 @@ freeTcpStream (tcpStreamPtr stream) {
         free (entry);
     }
     free (stream->client.rcvBuf);
+    METRICS_GAUGE_SUB (METRIC_TCP_RECEIVE_BUFFER_BYTES, stream->client.bufSize);
 
     /* Free server halfStream */
     listForEachEntrySafe (entry, pos, npos, &stream->server.head, node) {
@@ -472,6 +512,7 @@ freeTcpStream (tcpStreamPtr stream) {
         free (entry);
     }
     free (stream->server.rcvBuf);
+    METRICS_GAUGE_SUB (METRIC_TCP_RECEIVE_BUFFER_BYTES, stream->server.bufSize);
 
     /* Free session detail */
     if (!doProtoDetect)
@@ -491,22 +532,22 @@ freeTcpStreamForHash (void *data) {
  * @brief Alloc new tcp stream and add it to tcp stream hash table.
  *
  * @param tcph -- tcp header for current packet
- * @param iph -- ip header for current packet
+ * @param info -- ip packet info for current packet
  * @param tm -- timestamp for current packet
  *
  * @return Tcp stream if success else NULL
  */
 static tcpStreamPtr
-addNewTcpStream (tcphdrPtr tcph, iphdrPtr iph, timeValPtr tm) {
+addNewTcpStream (tcphdrPtr tcph, ipPktInfoPtr info, timeValPtr tm) {
     int ret;
-    char ipSrcStr [16], ipDestStr [16];
+    char ipSrcStr [IP_ADDR_STR_MAX_LENGTH], ipDestStr [IP_ADDR_STR_MAX_LENGTH];
     char *record;
     protoAnalyzerPtr analyzer;
     tcpStreamPtr stream, tmp;
     tcpProcessCallbackArgs callbackArgs;
 
-    inet_ntop (AF_INET, (void *) &iph->ipSrc, ipSrcStr, sizeof (ipSrcStr));
-    inet_ntop (AF_INET, (void *) &iph->ipDest, ipDestStr, sizeof (ipDestStr));
+    ipAddrToStr (&info->src, ipSrcStr, sizeof (ipSrcStr));
+    ipAddrToStr (&info->dest, ipDestStr, sizeof (ipDestStr));
 
     if (doProtoDetect) {
         analyzer = NULL;
@@ -547,11 +588,14 @@ addNewTcpStream (tcphdrPtr tcph, iphdrPtr iph, timeValPtr tm) {
     }
 
     /* Set stream 4-tuple address */
-    stream->addr.saddr = iph->ipSrc;
+    stream->addr.saddr = info->src;
     stream->addr.source = ntohs (tcph->source);
-    stream->addr.daddr = iph->ipDest;
+    stream->addr.daddr = info->dest;
     stream->addr.dest = ntohs (tcph->dest);
 
+    if (connIdFromFlow)
+        generateFlowConnId (stream, tcph, tm);
+
     /* Set client halfStream */
     stream->client.state = TCP_SYN_PKT_SENT;
     stream->client.seq = ntohl (tcph->seq) + 1;
@@ -562,10 +606,10 @@ addNewTcpStream (tcphdrPtr tcph, iphdrPtr iph, timeValPtr tm) {
     if (!stream->client.wscaleOn)
         stream->client.wscale = 1;
     if (!getTcpMssOption (tcph, &stream->client.mss))
-        LOGW ("Tcp MSS from client is null.\n");
+        LOGW_RL ("Tcp MSS from client is null.\n");
     stream->synTime = timeVal2MilliSecond (tm);
     stream->retriesTime = timeVal2MilliSecond (tm);
-    stream->c2sBytes = ntohs (iph->ipLen);
+    stream->c2sBytes = info->len;
     stream->c2sPkts++;
     if (!stream->client.window)
         stream->zeroWindows++;
@@ -574,7 +618,8 @@ addNewTcpStream (tcphdrPtr tcph, iphdrPtr iph, timeValPtr tm) {
      * percent of tcpStreamHashTable limit size then remove the oldest tcp stream
      * from global tcp stream list.
      */
-    if (hashSize (tcpStreamHashTable) >= (hashLimit (tcpStreamHashTable) * 0.8)) {
+    if (streamsEviction &&
+        hashSize (tcpStreamHashTable) >= (hashLimit (tcpStreamHashTable) * 0.8)) {
         tmp = listHeadEntry (&tcpStreamList, tcpStream, node);
         delTcpStreamFromHash (tmp, tm);
     }
@@ -595,7 +640,7 @@ static char *
 tcpBreakdown2AnalysisRecord (tcpStreamPtr stream, tcpBreakdownPtr tbd) {
     char *out;
     json_t *root;
-    char ipStr [16];
+    char ipStr [IP_ADDR_STR_MAX_LENGTH];
     char buf [64];
 
     root = json_object ();
@@ -613,107 +658,135 @@ tcpBreakdown2AnalysisRecord (tcpStreamPtr stream, tcpBreakdownPtr tbd) {
                          json_string (ANALYSIS_RECORD_TYPE_TCP_BREAKDOWN));
 
     /* Tcp application level proto type */
-    json_object_set_new (root, TCP_BKD_PROTO,
-                         json_string (tbd->proto));
+    if (tcpBreakdownFieldSelected (TCP_BKD_PROTO))
+        json_object_set_new (root, TCP_BKD_PROTO,
+                             json_string (tbd->proto));
 
     /* Tcp source ip */
-    inet_ntop (AF_INET, (void *) &tbd->ipSrc, ipStr, sizeof (ipStr));
-    json_object_set_new (root, TCP_BKD_SOURCE_IP,
-                         json_string (ipStr));
+    if (tcpBreakdownFieldSelected (TCP_BKD_SOURCE_IP)) {
+        ipAddrToStr (&tbd->ipSrc, ipStr, sizeof (ipStr));
+        json_object_set_new (root, TCP_BKD_SOURCE_IP,
+                             json_string (ipStr));
+    }
 
     /* Tcp source port */
-    json_object_set_new (root, TCP_BKD_SOURCE_PORT,
-                         json_integer (tbd->source));
+    if (tcpBreakdownFieldSelected (TCP_BKD_SOURCE_PORT))
+        json_object_set_new (root, TCP_BKD_SOURCE_PORT,
+                             json_integer (tbd->source));
 
     /* Tcp service ip */
-    inet_ntop (AF_INET, (void *) &tbd->svcIp, ipStr, sizeof (ipStr));
-    json_object_set_new (root, TCP_BKD_SERVICE_IP,
-                         json_string (ipStr));
+    if (tcpBreakdownFieldSelected (TCP_BKD_SERVICE_IP)) {
+        ipAddrToStr (&tbd->svcIp, ipStr, sizeof (ipStr));
+        json_object_set_new (root, TCP_BKD_SERVICE_IP,
+                             json_string (ipStr));
+    }
 
     /* Tcp service port */
-    json_object_set_new (root, TCP_BKD_SERVICE_PORT,
-                         json_integer (tbd->svcPort));
+    if (tcpBreakdownFieldSelected (TCP_BKD_SERVICE_PORT))
+        json_object_set_new (root, TCP_BKD_SERVICE_PORT,
+                             json_integer (tbd->svcPort));
 
     /* Tcp connection id */
-    uuid_unparse (tbd->connId, buf);
-    json_object_set_new (root, TCP_BKD_TCP_CONNECTION_ID,
-                         json_string (buf));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_CONNECTION_ID)) {
+        uuid_unparse (tbd->connId, buf);
+        json_object_set_new (root, TCP_BKD_TCP_CONNECTION_ID,
+                             json_string (buf));
+    }
 
     /* Tcp state */
-    json_object_set_new (root, TCP_BKD_TCP_STATE,
-                         json_string (getTcpBreakdownStateName (tbd->state)));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_STATE))
+        json_object_set_new (root, TCP_BKD_TCP_STATE,
+                             json_string (getTcpBreakdownStateName (tbd->state)));
 
     /* Tcp retries */
-    json_object_set_new (root, TCP_BKD_TCP_RETRIES,
-                         json_integer (tbd->retries));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_RETRIES))
+        json_object_set_new (root, TCP_BKD_TCP_RETRIES,
+                             json_integer (tbd->retries));
 
     /* Tcp retries latency */
-    json_object_set_new (root, TCP_BKD_TCP_RETRIES_LATENCY,
-                         json_integer (tbd->retriesLatency));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_RETRIES_LATENCY))
+        json_object_set_new (root, TCP_BKD_TCP_RETRIES_LATENCY,
+                             json_integer (tbd->retriesLatency));
 
     /* Tcp duplicate syn/ack packets */
-    json_object_set_new (root, TCP_BKD_TCP_DUPLICATE_SYNACKS,
-                         json_integer (tbd->dupSynAcks));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_DUPLICATE_SYNACKS))
+        json_object_set_new (root, TCP_BKD_TCP_DUPLICATE_SYNACKS,
+                             json_integer (tbd->dupSynAcks));
 
     /* Tcp RTT */
-    json_object_set_new (root, TCP_BKD_TCP_RTT,
-                         json_integer (tbd->rtt));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_RTT))
+        json_object_set_new (root, TCP_BKD_TCP_RTT,
+                             json_integer (tbd->rtt));
 
     /* Tcp MSS */
-    json_object_set_new (root, TCP_BKD_TCP_MSS,
-                         json_integer (tbd->mss));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_MSS))
+        json_object_set_new (root, TCP_BKD_TCP_MSS,
+                             json_integer (tbd->mss));
 
     /* Tcp connection latency */
-    json_object_set_new (root, TCP_BKD_TCP_CONNECTION_LATENCY,
-                         json_integer (tbd->connLatency));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_CONNECTION_LATENCY))
+        json_object_set_new (root, TCP_BKD_TCP_CONNECTION_LATENCY,
+                             json_integer (tbd->connLatency));
 
     /* Tcp c2s bytes */
-    json_object_set_new (root, TCP_BKD_TCP_C2S_BYTES,
-                         json_integer (tbd->c2sBytes));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_C2S_BYTES))
+        json_object_set_new (root, TCP_BKD_TCP_C2S_BYTES,
+                             json_integer (tbd->c2sBytes));
 
     /* Tcp s2c bytes */
-    json_object_set_new (root, TCP_BKD_TCP_S2C_BYTES,
-                         json_integer (tbd->s2cBytes));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_S2C_BYTES))
+        json_object_set_new (root, TCP_BKD_TCP_S2C_BYTES,
+                             json_integer (tbd->s2cBytes));
 
     /* Tcp total bytes */
-    json_object_set_new (root, TCP_BKD_TCP_TOTAL_BYTES,
-                         json_integer (tbd->totalBytes));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_TOTAL_BYTES))
+        json_object_set_new (root, TCP_BKD_TCP_TOTAL_BYTES,
+                             json_integer (tbd->totalBytes));
 
     /* Tcp c2s packets */
-    json_object_set_new (root, TCP_BKD_TCP_C2S_PACKETS,
-                         json_integer (tbd->c2sPkts));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_C2S_PACKETS))
+        json_object_set_new (root, TCP_BKD_TCP_C2S_PACKETS,
+                             json_integer (tbd->c2sPkts));
 
     /* Tcp s2c packets */
-    json_object_set_new (root, TCP_BKD_TCP_S2C_PACKETS,
-                         json_integer (tbd->s2cPkts));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_S2C_PACKETS))
+        json_object_set_new (root, TCP_BKD_TCP_S2C_PACKETS,
+                             json_integer (tbd->s2cPkts));
 
     /* Tcp total packets */
-    json_object_set_new (root, TCP_BKD_TCP_TOTAL_PACKETS,
-                         json_integer (tbd->totalPkts));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_TOTAL_PACKETS))
+        json_object_set_new (root, TCP_BKD_TCP_TOTAL_PACKETS,
+                             json_integer (tbd->totalPkts));
 
     /* Tcp tiny packets */
-    json_object_set_new (root, TCP_BKD_TCP_TINY_PACKETS,
-                         json_integer (tbd->tinyPkts));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_TINY_PACKETS))
+        json_object_set_new (root, TCP_BKD_TCP_TINY_PACKETS,
+                             json_integer (tbd->tinyPkts));
 
     /* Tcp PAWS packets */
-    json_object_set_new (root, TCP_BKD_TCP_PAWS_PACKETS,
-                         json_integer (tbd->pawsPkts));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_PAWS_PACKETS))
+        json_object_set_new (root, TCP_BKD_TCP_PAWS_PACKETS,
+                             json_integer (tbd->pawsPkts));
 
     /* Tcp retransmitted packets */
-    json_object_set_new (root, TCP_BKD_TCP_RETRANSMITTED_PACKETS,
-                         json_integer (tbd->retransmittedPkts));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_RETRANSMITTED_PACKETS))
+        json_object_set_new (root, TCP_BKD_TCP_RETRANSMITTED_PACKETS,
+                             json_integer (tbd->retransmittedPkts));
 
     /* Tcp out of order packets */
-    json_object_set_new (root, TCP_BKD_TCP_OUT_OF_ORDER_PACKETS,
-                         json_integer (tbd->outOfOrderPkts));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_OUT_OF_ORDER_PACKETS))
+        json_object_set_new (root, TCP_BKD_TCP_OUT_OF_ORDER_PACKETS,
+                             json_integer (tbd->outOfOrderPkts));
 
     /* Tcp zero windows */
-    json_object_set_new (root, TCP_BKD_TCP_ZERO_WINDOWS,
-                         json_integer (tbd->zeroWindows));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_ZERO_WINDOWS))
+        json_object_set_new (root, TCP_BKD_TCP_ZERO_WINDOWS,
+                             json_integer (tbd->zeroWindows));
 
     /* Tcp duplicate acks */
-    json_object_set_new (root, TCP_BKD_TCP_DUPLICATE_ACKS,
-                         json_integer (tbd->dupAcks));
+    if (tcpBreakdownFieldSelected (TCP_BKD_TCP_DUPLICATE_ACKS))
+        json_object_set_new (root, TCP_BKD_TCP_DUPLICATE_ACKS,
+                             json_integer (tbd->dupAcks));
 
     if (tbd->state == TCP_BREAKDOWN_DATA_EXCHANGING ||
         tbd->state == TCP_BREAKDOWN_RESET_TYPE3 ||
@@ -728,7 +801,7 @@ tcpBreakdown2AnalysisRecord (tcpStreamPtr stream, tcpBreakdownPtr tbd) {
 }
 
 static void
-generateTcpBreakdown (tcpStreamPtr stream, timeValPtr tm) {
+doGenerateTcpBreakdown (tcpStreamPtr stream, timeValPtr tm) {
     int ret;
     tcpBreakdown tbd;
     char *record = NULL;
@@ -842,6 +915,7 @@ generateTcpBreakdown (tcpStreamPtr stream, timeValPtr tm) {
     callbackArgs.type = PUBLISH_TCP_BREAKDOWN;
     callbackArgs.args = record;
     (*tcpProcessCallback) (&callbackArgs);
+    NTRACE_PROBE3 (breakdown__emitted, tbd.proto, tbd.state, tbd.svcPort);
 
     /* Free record string and application layer session breakdown */
     free (record);
@@ -860,6 +934,16 @@ generateTcpBreakdown (tcpStreamPtr stream, timeValPtr tm) {
     stream->dupAcks = 0;
 }
 
+/* Generate tcp breakdown with proto analyzer stats */
+static void
+generateTcpBreakdown (tcpStreamPtr stream, timeValPtr tm) {
+    u_long_long startTime;
+
+    startTime = protoAnalyzerStatsBegin (stream->analyzerStats, PROTO_ANALYZER_CALL_BREAKDOWN);
+    doGenerateTcpBreakdown (stream, tm);
+    protoAnalyzerStatsEnd (stream->analyzerStats, PROTO_ANALYZER_CALL_BREAKDOWN, startTime, 0);
+}
+
 /**
  * @brief Check tcp stream timeout list and remove timeout
  *        tcp stream.
@@ -875,6 +959,10 @@ checkTcpStreamClosingTimeoutList (timeValPtr tm) {
         if (entry->timeout > tm->tvSec)
             return;
 
+        NTRACE_PROBE4 (stream__evict, PROBE_IP_ADDR (entry->stream->addr.saddr),
+                       entry->stream->addr.source, PROBE_IP_ADDR (entry->stream->addr.daddr),
+                       entry->stream->addr.dest);
+
         entry->stream->state = STREAM_TIME_OUT;
         entry->stream->closeTime = timeVal2MilliSecond (tm);
         if (!doProtoDetect)
@@ -886,6 +974,8 @@ checkTcpStreamClosingTimeoutList (timeValPtr tm) {
 /* Tcp connection establishment handler callback */
 static void
 handleEstb (tcpStreamPtr stream, timeValPtr tm) {
+    u_long_long startTime;
+
     /* Set tcp state */
     stream->client.state = TCP_CONN_ESTABLISHED;
     stream->server.state = TCP_CONN_ESTABLISHED;
@@ -894,7 +984,9 @@ handleEstb (tcpStreamPtr stream, timeValPtr tm) {
     stream->mss = MIN_NUM (stream->client.mss, stream->server.mss);
 
     if (!doProtoDetect) {
+        startTime = protoAnalyzerStatsBegin (stream->analyzerStats, PROTO_ANALYZER_CALL_ESTB);
         (*stream->analyzer->sessionProcessEstb) (tm, stream->sessionDetail);
+        protoAnalyzerStatsEnd (stream->analyzerStats, PROTO_ANALYZER_CALL_ESTB, startTime, 0);
         generateTcpBreakdown (stream, tm);
     }
 }
@@ -921,6 +1013,7 @@ handleData (tcpStreamPtr stream, halfStreamPtr snd,
             u_char *data, u_int dataLen, timeValPtr tm) {
     streamDirection direction;
     u_int parseCount;
+    u_long_long startTime;
     sessionState state = SESSION_ACTIVE;
 
     if (snd == &stream->client)
@@ -929,8 +1022,12 @@ handleData (tcpStreamPtr stream, halfStreamPtr snd,
         direction = STREAM_FROM_SERVER;
 
     if (!doProtoDetect) {
+        NTRACE_PROBE3 (session__process__entry, stream->proto, direction, dataLen);
+        startTime = protoAnalyzerStatsBegin (stream->analyzerStats, PROTO_ANALYZER_CALL_DATA);
         parseCount = (*stream->analyzer->sessionProcessData) (direction, data, dataLen,
                                                               tm, stream->sessionDetail, &state);
+        protoAnalyzerStatsEnd (stream->analyzerStats, PROTO_ANALYZER_CALL_DATA, startTime, dataLen);
+        NTRACE_PROBE3 (session__process__return, stream->proto, parseCount, state);
         if (state == SESSION_DONE)
             generateTcpBreakdown (stream, tm);
     } else {
@@ -947,6 +1044,7 @@ handleData (tcpStreamPtr stream, halfStreamPtr snd,
 static void
 handleReset (tcpStreamPtr stream, halfStreamPtr snd, timeValPtr tm) {
     streamDirection direction;
+    u_long_long startTime;
 
     if (snd == &stream->client)
         direction = STREAM_FROM_CLIENT;
@@ -964,9 +1062,12 @@ handleReset (tcpStreamPtr stream, halfStreamPtr snd, timeValPtr tm) {
         else
             stream->state = STREAM_RESET_TYPE4;
 
-        if (!doProtoDetect)
+        if (!doProtoDetect) {
+            startTime = protoAnalyzerStatsBegin (stream->analyzerStats, PROTO_ANALYZER_CALL_RESET);
             (*stream->analyzer->sessionProcessReset) (direction, tm,
                                                       stream->sessionDetail);
+            protoAnalyzerStatsEnd (stream->analyzerStats, PROTO_ANALYZER_CALL_RESET, startTime, 0);
+        }
     }
 
     stream->closeTime = timeVal2MilliSecond (tm);
@@ -979,6 +1080,7 @@ handleReset (tcpStreamPtr stream, halfStreamPtr snd, timeValPtr tm) {
 static void
 handleFin (tcpStreamPtr stream, halfStreamPtr snd, timeValPtr tm) {
     streamDirection direction;
+    u_long_long startTime;
     sessionState state = SESSION_ACTIVE;
 
     if (snd == &stream->client)
@@ -987,8 +1089,10 @@ handleFin (tcpStreamPtr stream, halfStreamPtr snd, timeValPtr tm) {
         direction = STREAM_FROM_SERVER;
 
     if (!doProtoDetect) {
+        startTime = protoAnalyzerStatsBegin (stream->analyzerStats, PROTO_ANALYZER_CALL_FIN);
         (*stream->analyzer->sessionProcessFin) (direction, tm,
                                                 stream->sessionDetail, &state);
+        protoAnalyzerStatsEnd (stream->analyzerStats, PROTO_ANALYZER_CALL_FIN, startTime, 0);
         if (state == SESSION_DONE)
             generateTcpBreakdown (stream, tm);
     }
@@ -1034,6 +1138,7 @@ addToBuf (halfStreamPtr rcv, u_char *data, u_int dataLen) {
             if (rcv->rcvBuf == NULL) {
                 LOGE ("Alloc memory for halfStream rcvBuf error: %s.\n",
                       strerror (errno));
+                METRICS_DROP (DROP_REASON_NO_MEMORY);
                 ret = -1;
             }
         } else {
@@ -1042,7 +1147,8 @@ addToBuf (halfStreamPtr rcv, u_char *data, u_int dataLen) {
              * free it in case exhausting too much memory.
              */
             if (rcv->bufSize >= TCP_RECEIVE_BUFFER_MAX_SIZE) {
-                LOGW ("Exceed maxium tcp stream receive buffer size.\n");
+                LOGW_RL ("Exceed maxium tcp stream receive buffer size.\n");
+                METRICS_DROP (DROP_REASON_TCP_RCV_BUF_OVERFLOW);
                 free (rcv->rcvBuf);
                 rcv->rcvBuf = NULL;
                 ret = -1;
@@ -1056,6 +1162,7 @@ addToBuf (halfStreamPtr rcv, u_char *data, u_int dataLen) {
                 if (tmp == NULL) {
                     LOGE ("Realloc memory for halfStream rcvBuf error: %s.\n",
                           strerror (errno));
+                    METRICS_DROP (DROP_REASON_NO_MEMORY);
                     free (rcv->rcvBuf);
                     rcv->rcvBuf = NULL;
                     ret = -1;
@@ -1064,10 +1171,12 @@ addToBuf (halfStreamPtr rcv, u_char *data, u_int dataLen) {
             }
         }
 
+        METRICS_GAUGE_SUB (METRIC_TCP_RECEIVE_BUFFER_BYTES, rcv->bufSize);
         if (ret < 0)
             rcv->bufSize = 0;
         else
             rcv->bufSize = toAlloc;
+        METRICS_GAUGE_ADD (METRIC_TCP_RECEIVE_BUFFER_BYTES, rcv->bufSize);
     }
 
     if (!ret)
@@ -1285,7 +1394,9 @@ tcpQueue (tcpStreamPtr stream,
  */
 void
 tcpProcess (iphdrPtr iph, timeValPtr tm) {
+    int ret;
     u_int ipLen;
+    ipPktInfo info;
     tcphdrPtr tcph;
     u_int tcpLen;
     u_char *tcpData;
@@ -1296,11 +1407,18 @@ tcpProcess (iphdrPtr iph, timeValPtr tm) {
     halfStreamPtr snd, rcv;
     streamDirection direction;
 
-    ipLen = ntohs (iph->ipLen);
-    tcph = (tcphdrPtr) ((u_char *) iph + iph->iphLen * 4);
-    tcpLen = ipLen - iph->iphLen * 4;
+    ret = getIpPktInfo (iph, &info);
+    if (ret < 0 || info.proto != IPPROTO_TCP) {
+        LOGE_RL ("Invalid ip packet.\n");
+        METRICS_DROP (DROP_REASON_TCP_INVALID);
+        return;
+    }
+
+    ipLen = info.len;
+    tcph = (tcphdrPtr) ((u_char *) iph + info.hdrLen);
+    tcpLen = ipLen - info.hdrLen;
     tcpData = (u_char *) tcph + tcph->doff * 4;
-    tcpDataLen = ipLen - (iph->iphLen * 4) - (tcph->doff * 4);
+    tcpDataLen = ipLen - info.hdrLen - (tcph->doff * 4);
 
     timestamp.tvSec = ntohll (tm->tvSec);
     timestamp.tvUsec = ntohll (tm->tvUsec);
@@ -1308,42 +1426,53 @@ tcpProcess (iphdrPtr iph, timeValPtr tm) {
     /* Tcp stream closing timout check */
     checkTcpStreamClosingTimeoutList (&timestamp);
 
-    if (ipLen < (iph->iphLen * 4 + sizeof (tcphdr))) {
-        LOGE ("Invalid tcp packet.\n");
+    if (ipLen < (info.hdrLen + sizeof (tcphdr))) {
+        LOGE_RL ("Invalid tcp packet.\n");
+        METRICS_DROP (DROP_REASON_TCP_INVALID);
         return;
     }
 
     if (tcpDataLen < 0) {
-        LOGE ("Invalid tcp data length, ipLen: %u, tcpLen: %u, "
-              "tcpHeaderLen: %u, tcpDataLen: %u.\n",
-              ipLen, tcpLen, (tcph->doff * 4), tcpDataLen);
+        LOGE_RL ("Invalid tcp data length, ipLen: %u, tcpLen: %u, "
+                 "tcpHeaderLen: %u, tcpDataLen: %u.\n",
+                 ipLen, tcpLen, (tcph->doff * 4), tcpDataLen);
+        METRICS_DROP (DROP_REASON_TCP_INVALID);
         return;
     }
 
-    if (iph->ipSrc.s_addr == 0 || iph->ipDest.s_addr == 0) {
-        LOGE ("Invalid ip address.\n");
+    if (info.src.family == AF_INET ?
+        (iph->ipSrc.s_addr == 0 || iph->ipDest.s_addr == 0) :
+        (IN6_IS_ADDR_UNSPECIFIED (&info.src.u.ip6) ||
+         IN6_IS_ADDR_UNSPECIFIED (&info.dest.u.ip6))) {
+        LOGE_RL ("Invalid ip address.\n");
+        METRICS_DROP (DROP_REASON_TCP_INVALID);
         return;
     }
 
 #ifdef DO_STRICT_CHECK
     /* Tcp checksum validation */
-    if (tcpFastCheckSum ((u_char *) tcph, tcpLen,
-                         iph->ipSrc.s_addr, iph->ipDest.s_addr)) {
-        LOGE ("Tcp fast checksum error, ipLen: %u, tcpLen: %u, "
-              "tcpHeaderLen: %u, tcpDataLen: %u.\n",
-              ipLen, tcpLen, (tcph->doff * 4), tcpDataLen);
+    if (info.src.family == AF_INET ?
+        tcpFastCheckSum ((u_char *) tcph, tcpLen,
+                         iph->ipSrc.s_addr, iph->ipDest.s_addr) :
+        tcp6FastCheckSum ((u_char *) tcph, tcpLen,
+                          info.src.u.ip6.s6_addr, info.dest.u.ip6.s6_addr)) {
+        LOGE_RL ("Tcp fast checksum error, ipLen: %u, tcpLen: %u, "
+                 "tcpHeaderLen: %u, tcpDataLen: %u.\n",
+                 ipLen, tcpLen, (tcph->doff * 4), tcpDataLen);
+        METRICS_DROP (DROP_REASON_TCP_INVALID);
         return;
     }
 #endif
 
-    stream = findTcpStream (tcph, iph, &direction);
+    stream = findTcpStream (tcph, &info, &direction);
     if (stream == NULL) {
         /* The first sync packet of tcp three handshakes */
         if (tcph->syn && !tcph->ack && !tcph->rst) {
-            stream = addNewTcpStream (tcph, iph, &timestamp);
+            stream = addNewTcpStream (tcph, &info, &timestamp);
             if (stream)
                 streamCache = stream;
-        }
+        } else
+            METRICS_DROP (DROP_REASON_TCP_NO_SYN);
 
         return;
     }
@@ -1362,17 +1491,20 @@ tcpProcess (iphdrPtr iph, timeValPtr tm) {
         return;
     }
 
+    heavyHitterUpdate (&stream->addr.saddr, stream->addr.source,
+                       &stream->addr.daddr, stream->addr.dest, ipLen);
+
     if (direction == STREAM_FROM_CLIENT) {
         snd = &stream->client;
         rcv = &stream->server;
 
-        stream->c2sBytes += ntohs (iph->ipLen);
+        stream->c2sBytes += ipLen;
         stream->c2sPkts++;
     } else {
         rcv = &stream->client;
         snd = &stream->server;
 
-        stream->s2cBytes += ntohs (iph->ipLen);
+        stream->s2cBytes += ipLen;
         stream->s2cPkts++;
     }
 
@@ -1404,7 +1536,7 @@ tcpProcess (iphdrPtr iph, timeValPtr tm) {
         } else {
             /* The second packet of tcp three handshakes */
             if (stream->client.seq != ntohl (tcph->ackSeq)) {
-                LOGW ("Wrong ack sequence number of syn/ack packet.\n");
+                LOGW_RL ("Wrong ack sequence number of syn/ack packet.\n");
                 return;
             }
 
@@ -1435,7 +1567,7 @@ tcpProcess (iphdrPtr iph, timeValPtr tm) {
             }
 
             if (!getTcpMssOption (tcph, &stream->server.mss))
-                LOGW ("Tcp MSS from server is null.\n");
+                LOGW_RL ("Tcp MSS from server is null.\n");
 
             stream->synAckTime = timeVal2MilliSecond (&timestamp);
         }
@@ -1453,8 +1585,11 @@ tcpProcess (iphdrPtr iph, timeValPtr tm) {
         (before (ntohl (tcph->seq) + tcpDataLen, rcv->ackSeq) ||
          !before (ntohl (tcph->seq), (rcv->ackSeq + rcv->window * rcv->wscale)))) {
         /* Accumulate retransmitted packets */
-        if (before (ntohl (tcph->seq) + tcpDataLen, rcv->ackSeq))
+        if (before (ntohl (tcph->seq) + tcpDataLen, rcv->ackSeq)) {
             stream->retransmittedPkts++;
+            METRICS_DROP (DROP_REASON_TCP_RETRANSMITTED);
+        } else
+            METRICS_DROP (DROP_REASON_TCP_OUT_OF_WINDOW);
         return;
     }
 
@@ -1463,6 +1598,7 @@ tcpProcess (iphdrPtr iph, timeValPtr tm) {
         getTimeStampOption (tcph, &tmOption) &&
         before (tmOption, snd->currTs)) {
         stream->pawsPkts++;
+        METRICS_DROP (DROP_REASON_TCP_PAWS);
         return;
     }
 
@@ -1514,6 +1650,49 @@ dispalyLocalStatisticInfo (void) {
           tcpStreamsAllocLocal, tcpStreamsFreeLocal);
 }
 
+/**
+ * @brief Tcp stream closing timeout check without tcp packet, used to
+ *        advance packet timestamp clock of tcp context by packets which
+ *        are not processed by this context.
+ *
+ * @param tm -- packet capture timestamp
+ */
+void
+tcpProcessTimeout (timeValPtr tm) {
+    timeVal timestamp;
+
+    timestamp.tvSec = ntohll (tm->tvSec);
+    timestamp.tvUsec = ntohll (tm->tvUsec);
+
+    checkTcpStreamClosingTimeoutList (&timestamp);
+}
+
+/**
+ * @brief Derive connection id of new tcp streams from 4-tuple address,
+ *        syn timestamp and client initial sequence instead of random
+ *        uuid, used for reproducible offline process.
+ *
+ * @param enable -- Enable flow connection id or not
+ */
+void
+setTcpConnIdFromFlow (boolean enable) {
+    connIdFromFlow = enable;
+}
+
+/**
+ * @brief Enable or disable removing the oldest tcp stream when tcp
+ *        streams exceed eighty percent of tcp stream hash table limit.
+ *        Without eviction, tcp stream hash table grows with concurrent
+ *        tcp streams, used for offline process whose records must not
+ *        depend on how flows are sliced to threads.
+ *
+ * @param enable -- Enable tcp streams eviction or not
+ */
+void
+setTcpStreamsEviction (boolean enable) {
+    streamsEviction = enable;
+}
+
 /* Reset tcp context */
 int
 resetTcpContext (void) {
@@ -7,6 +7,10 @@
 #include "list.h"
 #include "ip.h"
 #include "proto_analyzer.h"
+#include "proto_analyzer_stats.h"
+
+/* Closing timeout of tcp stream */
+#define TCP_STREAM_CLOSING_TIMEOUT 30
 
 typedef enum {
   TCP_SYN_PKT_SENT,
@@ -65,9 +69,9 @@ typedef struct _tuple4 tuple4;
 typedef tuple4 *tuple4Ptr;
 
 struct _tuple4 {
-    struct in_addr saddr;               /**< Source ip */
+    ipAddr saddr;                       /**< Source ip */
     u_short source;                     /**< Source tcp port */
-    struct in_addr daddr;               /**< Dest ip */
+    ipAddr daddr;                       /**< Dest ip */
     u_short dest;                       /**< Dest tcp port */
 };
 
@@ -91,6 +95,7 @@ typedef tcpStream *tcpStreamPtr;
 struct _tcpStream {
     char *proto;                        /**< Tcp application level proto name */
     protoAnalyzerPtr analyzer;          /**< Tcp Appliction level proto analyzer */
+    protoAnalyzerStatsPtr analyzerStats; /**< Proto analyzer stats of current thread */
     tuple4 addr;                        /**< Tcp stream 4-tuple address */
     uuid_t connId;                      /**< Tcp connection id */
     tcpStreamState state;               /**< Tcp stream state */
@@ -146,9 +151,9 @@ typedef tcpBreakdown *tcpBreakdownPtr;
 struct _tcpBreakdown {
     timeVal timestamp;                  /**< Timestamp */
     char *proto;                        /**< Tcp application level proto type */
-    struct in_addr ipSrc;               /**< Source ip */
+    ipAddr ipSrc;                       /**< Source ip */
     u_short source;                     /**< Source port */
-    struct in_addr svcIp;               /**< Service ip */
+    ipAddr svcIp;                       /**< Service ip */
     u_short svcPort;                    /**< Service port */
     uuid_t connId;                      /**< Tcp connection id */
     tcpBreakdownState state;            /**< Tcp state */
@@ -219,6 +224,12 @@ typedef void (*tcpProcessCB) (tcpProcessCallbackArgsPtr callbackArgs);
 /*========================Interfaces definition============================*/
 void
 tcpProcess (iphdrPtr iph, timeValPtr tm);
+void
+tcpProcessTimeout (timeValPtr tm);
+void
+setTcpConnIdFromFlow (boolean enable);
+void
+setTcpStreamsEviction (boolean enable);
 int
 resetTcpContext (void);
 int
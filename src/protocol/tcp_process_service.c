@@ -6,10 +6,13 @@
 #include "properties.h"
 #include "signals.h"
 #include "log.h"
+#include "metrics.h"
 #include "zmq_hub.h"
 #include "task_manager.h"
 #include "ip.h"
 #include "tcp_packet.h"
+#include "proto_analyzer_stats.h"
+#include "heavy_hitter.h"
 #include "analysis_record.h"
 #include "tcp_process_service.h"
 
@@ -43,7 +46,8 @@ tcpProcessService (void *args) {
     void *tcpPktRecvSock;
     zframe_t *tmFrame = NULL;
     zframe_t *ipPktFrame = NULL;
-    timeValPtr tm;
+    pktTimestampPtr timestamp;
+    u_long_long processTime;
     iphdrPtr iph;
 
     /* Reset signals flag */
@@ -57,6 +61,29 @@ tcpProcessService (void *args) {
     }
 
     dispatchIndex = *((u_int *) args);
+    setLogComponent ("TcpProcessService:%u", dispatchIndex);
+
+    /* Init metrics context */
+    ret = initMetricsContext ("TcpProcessService:%u", dispatchIndex);
+    if (ret < 0) {
+        LOGE ("Init metrics context error.\n");
+        goto destroyLogContext;
+    }
+
+    /* Init proto analyzer stats context */
+    ret = initProtoAnalyzerStatsContext ("TcpProcessService:%u", dispatchIndex);
+    if (ret < 0) {
+        LOGE ("Init proto analyzer stats context error.\n");
+        goto destroyMetricsContext;
+    }
+
+    /* Init heavy hitter context */
+    ret = initHeavyHitterContext ("TcpProcessService:%u", dispatchIndex);
+    if (ret < 0) {
+        LOGE ("Init heavy hitter context error.\n");
+        goto destroyProtoAnalyzerStatsContext;
+    }
+
     tcpPktRecvSock = getTcpPktRecvSock (dispatchIndex);
     tcpBreakdownSendSock = getTcpBreakdownSendSock (dispatchIndex);
 
@@ -66,7 +93,7 @@ tcpProcessService (void *args) {
     ret = pthread_setaffinity_np (pthread_self (), sizeof (cpu_set_t), &cpuset);
     if (ret < 0) {
         LOGE ("Binding tcpProcessService:%u to CPU%u error.\n", dispatchIndex, dispatchIndex);
-        goto destroyLogContext;
+        goto destroyHeavyHitterContext;
     }
     LOGI ("Binding tcpProcessService:%u to CPU%u success.\n", dispatchIndex, dispatchIndex);
 
@@ -77,7 +104,7 @@ tcpProcessService (void *args) {
     ret = initTcpContext (False, tcpProcessCallback);
     if (ret < 0) {
         LOGE ("Init tcp context error.\n");
-        goto destroyLogContext;
+        goto destroyHeavyHitterContext;
     }
 
     while (!taskShouldExit ()) {
@@ -108,11 +135,31 @@ tcpProcessService (void *args) {
             continue;
         }
 
-        tm = (timeValPtr) zframe_data (tmFrame);
+        if (zframe_size (tmFrame) != sizeof (pktTimestamp)) {
+            LOGE_RL ("Wrong packet timestamp zframe size: %u.\n", (u_int) zframe_size (tmFrame));
+            zframe_destroy (&tmFrame);
+            zframe_destroy (&ipPktFrame);
+            continue;
+        }
+
+        timestamp = (pktTimestampPtr) zframe_data (tmFrame);
         iph = (iphdrPtr) zframe_data (ipPktFrame);
 
+        METRICS_COUNTER_INC (METRIC_PACKETS_RECEIVED);
+        METRICS_COUNTER_ADD (METRIC_BYTES_RECEIVED, zframe_size (ipPktFrame));
+        METRICS_COUNTER_INC (METRIC_TCP_QUEUE_DEQUEUED);
+
+        /* Monotonic timestamps from remote node are not comparable */
+        if (timestamp->clockId == getMetricsClockId ()) {
+            METRICS_LATENCY_RECORD_SINCE (LATENCY_IP_TO_TCP, timestamp->dispatchTime);
+            setAnalysisRecordIngressTime (timestamp->ingressTime);
+        } else
+            setAnalysisRecordIngressTime (0);
+
         /* Do tcp process */
-        tcpProcess (iph, tm);
+        processTime = getMonotonicTime ();
+        tcpProcess (iph, &timestamp->captureTime);
+        METRICS_LATENCY_RECORD_SINCE (LATENCY_TCP_PROCESS, processTime);
 
         /* Free zframe */
         zframe_destroy (&tmFrame);
@@ -121,6 +168,12 @@ tcpProcessService (void *args) {
 
     LOGI ("TcpProcessService will exit ... .. .\n");
     destroyTcpContext ();
+destroyHeavyHitterContext:
+    destroyHeavyHitterContext ();
+destroyProtoAnalyzerStatsContext:
+    destroyProtoAnalyzerStatsContext ();
+destroyMetricsContext:
+    destroyMetricsContext ();
 destroyLogContext:
     destroyLogContext ();
 exit:
@@ -17,6 +17,9 @@
 /* Task manager hash table */
 static hashTablePtr taskManagerHashTable = NULL;
 
+/* Flag of task has completed work of nTrace service */
+static boolean taskServiceCompleteFlag = False;
+
 /* Mutext lock for task status send sock */
 static pthread_mutex_t taskStatusSendSockLock = PTHREAD_MUTEX_INITIALIZER;
 
@@ -245,6 +248,12 @@ displayTaskSchedPolicyInfo (char *taskName) {
           taskName, policyName, param.sched_priority);
 }
 
+/* Check whether task has completed work of nTrace service */
+boolean
+taskServiceComplete (void) {
+    return taskServiceCompleteFlag;
+}
+
 int
 taskStatusHandler (zloop_t *loop, zmq_pollitem_t *item, void *arg) {
     int ret;
@@ -276,6 +285,7 @@ taskStatusHandler (zloop_t *loop, zmq_pollitem_t *item, void *arg) {
     switch (taskStatus) {
         case TASK_STATUS_EXIT_NORMALLY:
             hashRemove (taskManagerHashTable, hashKey);
+            ret = 0;
             break;
 
         case TASK_STATUS_EXIT_ABNORMALLY:
@@ -299,6 +309,13 @@ taskStatusHandler (zloop_t *loop, zmq_pollitem_t *item, void *arg) {
             }
             break;
 
+        case TASK_STATUS_COMPLETE:
+            /* Cancel zloop of nTrace service to exit */
+            LOGI ("%s:%lu complete work of nTrace service.\n", task->name, tid);
+            taskServiceCompleteFlag = True;
+            ret = -1;
+            break;
+
         default:
             LOGE ("Unknown task status for %s.\n", task->name);
             ret = 0;
@@ -9,7 +9,8 @@ typedef void * (*taskRoutine) (void *args);
 
 typedef enum {
     TASK_STATUS_EXIT_NORMALLY,
-    TASK_STATUS_EXIT_ABNORMALLY
+    TASK_STATUS_EXIT_ABNORMALLY,
+    TASK_STATUS_COMPLETE                /**< Task has completed work of nTrace service */
 } taskStatus;
 
 typedef struct _taskItem taskItem;
@@ -34,6 +35,8 @@ void
 sendTaskStatus (taskStatus status);
 void
 displayTaskSchedPolicyInfo (char *taskName);
+boolean
+taskServiceComplete (void);
 int
 taskStatusHandler (zloop_t *loop, zmq_pollitem_t *item, void *arg);
 int
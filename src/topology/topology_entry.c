@@ -111,10 +111,12 @@ topologyEntryAnalysisRecord (timeValPtr tm, char *srcIp, char *destIp) {
                          json_string (ANALYSIS_RECORD_TYPE_TOPOLOGY_ENTRY));
 
     /* Topology entry source ip */
-    json_object_set_new (root, TOPOLOGY_ENTRY_SOURCE_IP, json_string (srcIp));
+    if (analysisRecordFieldSelected (ANALYSIS_RECORD_TYPE_TOPOLOGY_ENTRY, TOPOLOGY_ENTRY_SOURCE_IP))
+        json_object_set_new (root, TOPOLOGY_ENTRY_SOURCE_IP, json_string (srcIp));
 
     /* Topology entry dest ip */
-    json_object_set_new (root, TOPOLOGY_ENTRY_DEST_IP, json_string (destIp));
+    if (analysisRecordFieldSelected (ANALYSIS_RECORD_TYPE_TOPOLOGY_ENTRY, TOPOLOGY_ENTRY_DEST_IP))
+        json_object_set_new (root, TOPOLOGY_ENTRY_DEST_IP, json_string (destIp));
 
     out = json_dumps (root, JSON_COMPACT | JSON_PRESERVE_ORDER);
     json_object_clear (root);
@@ -22,7 +22,7 @@ static hashTablePtr topologyEntriesHashTable = NULL;
  */
 topologyEntryPtr
 getTopologyEntry (char *srcIp, char *destIp) {
-    char key [32];
+    char key [128];
     topologyEntryPtr entry;
 
     snprintf (key, sizeof (key), "%s:%s", srcIp, destIp);
@@ -87,7 +87,7 @@ int
 addTopologyEntry (char *srcIp, char *destIp) {
     int ret;
     topologyEntryPtr entry;
-    char key [32];
+    char key [128];
 
     entry = newTopologyEntry (srcIp, destIp);
     if (entry == NULL) {
@@ -10,6 +10,8 @@
 #define HASH_TABLE_LOAD_FACTOR 75
 /* Resize factor after splitting */
 #define HASH_TABLE_RESIZE_FACTOR 2
+/* Buckets of old hash table migrated by each insert, remove or update */
+#define HASH_TABLE_REHASH_STEP 4
 
 /* ========================================================================== */
 
@@ -32,18 +34,29 @@ typedef struct _hashItem hashItem;
 typedef hashItem *hashItemPtr;
 
 struct _hashItem {
-    char *key;                          /**< Hash key */
-    u_int index;                        /**< Hash Index */
+    u_int hash;                         /**< Hash of key */
+    u_int keyLen;                       /**< Hash key length */
     void *data;                         /**< Opaque item value */
     hashItemFreeCB fun;                 /**< Hash item free callback */
     hlistNode node;                     /**< Hash list node */
+    u_char key [];                      /**< Hash key, string key is terminated with NUL */
 };
 
+/*
+ * Hash table is resized incrementally. When size exceeds limit, a new
+ * hash list head array with larger capacity is created and items of
+ * old hash list heads are migrated HASH_TABLE_REHASH_STEP buckets by
+ * each insert, remove or update, lookup checks both of them during
+ * migration.
+ */
 struct _hashTable {
     u_int capacity;                     /**< Capacity of hash table */
     u_int limit;                        /**< Limit of hash table */
     u_int size;                         /**< Size of hash table */
     hlistHeadPtr heads;                 /**< Hash list head array */
+    u_int oldCapacity;                  /**< Capacity of old hash list head array */
+    u_int rehashIndex;                  /**< Next bucket of old hash list head array to migrate */
+    hlistHeadPtr oldHeads;              /**< Old hash list head array, NULL if not in migration */
 };
 
 /* ========================================================================== */
@@ -100,72 +113,137 @@ hlistDel (hlistNodePtr node) {
 
 /* ========================================================================== */
 
+/* Murmurhash3 of key */
 static u_int
-itemHash (char *key) {
-    u_int hash = 0;
-    u_int seed = 16777619;
-
-    while (*key) {
-        hash *= seed;
-        hash ^= (u_int) (*key);
-        key++;
+itemHash (const void *key, u_int keyLen) {
+    u_int i, k;
+    u_int hash = 0x9747B28C;
+    const u_char *data = (const u_char *) key;
+
+    for (i = 0; i + 4 <= keyLen; i += 4) {
+        memcpy (&k, data + i, sizeof (k));
+        k *= 0xCC9E2D51;
+        k = (k << 15) | (k >> 17);
+        k *= 0x1B873593;
+        hash ^= k;
+        hash = (hash << 13) | (hash >> 19);
+        hash = hash * 5 + 0xE6546B64;
+    }
+
+    k = 0;
+    switch (keyLen & 3) {
+        case 3:
+            k ^= data [i + 2] << 16;
+        case 2:
+            k ^= data [i + 1] << 8;
+        case 1:
+            k ^= data [i];
+            k *= 0xCC9E2D51;
+            k = (k << 15) | (k >> 17);
+            k *= 0x1B873593;
+            hash ^= k;
     }
 
+    hash ^= keyLen;
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6B;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35;
+    hash ^= hash >> 16;
+
     return hash;
 }
 
 static hashItemPtr
-hashItemLookup (hashTablePtr htbl, char *key, u_int *index) {
+hashBucketLookup (hlistHeadPtr head, const void *key, u_int keyLen, u_int hash) {
     hashItemPtr item;
-    hlistHeadPtr head;
-    hlistNodePtr hnode, tmp;
+    hlistNodePtr hnode;
 
-    *index = itemHash (key) % htbl->capacity;
-    head = &htbl->heads [*index];
-
-    hlistForEachEntrySafe (item, hnode, tmp, head, node) {
-        if (item && strEqual (item->key, key))
+    hlistForEachEntry (item, hnode, head, node) {
+        if (item->hash == hash && item->keyLen == keyLen &&
+            memcmp (item->key, key, keyLen) == 0)
             return item;
     }
 
     return NULL;
 }
 
-static int
-hashItemInsert (hashTablePtr htbl, char *key, void *data, hashItemFreeCB fun) {
-    u_int index;
-    hlistHeadPtr head;
+static hashItemPtr
+hashItemLookup (hashTablePtr htbl, const void *key, u_int keyLen, u_int hash) {
     hashItemPtr item;
 
-    /* First lookup if duplicate key */
-    item = hashItemLookup (htbl, key, &index);
+    item = hashBucketLookup (&htbl->heads [hash % htbl->capacity], key, keyLen, hash);
+    /* Buckets of old hash list heads migrated are empty */
+    if (item == NULL && htbl->oldHeads)
+        item = hashBucketLookup (&htbl->oldHeads [hash % htbl->oldCapacity], key, keyLen, hash);
 
-    if (item == NULL) {
-        item = (hashItemPtr ) malloc (sizeof (hashItem));
-        if (item == NULL) {
-            fun (data);
-            return -1;
+    return item;
+}
+
+/* Migrate buckets of old hash list heads to new hash list heads */
+static void
+hashRehashStep (hashTablePtr htbl, u_int buckets) {
+    hashItemPtr item;
+    hlistHeadPtr head;
+
+    while (htbl->oldHeads && buckets--) {
+        head = &htbl->oldHeads [htbl->rehashIndex];
+        while (head->first) {
+            item = hlistEntry (head->first, hashItem, node);
+            hlistDel (&item->node);
+            hlistAdd (&item->node, &htbl->heads [item->hash % htbl->capacity]);
         }
 
-        item->data = data;
-        item->key = strdup (key);
-        if (item->key == NULL) {
-            fun (data);
-            free (item);
-            return -1;
+        htbl->rehashIndex++;
+        if (htbl->rehashIndex == htbl->oldCapacity) {
+            free (htbl->oldHeads);
+            htbl->oldHeads = NULL;
+            htbl->oldCapacity = 0;
+            htbl->rehashIndex = 0;
         }
-        item->index = index;
-        item->fun = fun;
+    }
+}
 
-        head = &htbl->heads [index];
-        hlistAdd (&item->node, head);
-        htbl->size++;
-        return 0;
-    } else {
-        printf ("already added: %s\n", key);
-        fun (data);
+/* Start migration to new hash list heads with larger capacity */
+static int
+hashRehashStart (hashTablePtr htbl) {
+    u_int newCapacity;
+    hlistHeadPtr newHeads;
+
+    /* Finish previous migration first */
+    if (htbl->oldHeads)
+        hashRehashStep (htbl, htbl->oldCapacity - htbl->rehashIndex);
+
+    newCapacity = htbl->capacity * HASH_TABLE_RESIZE_FACTOR;
+    newHeads = (hlistHeadPtr) calloc (newCapacity, sizeof (hlistHead));
+    if (newHeads == NULL)
         return -1;
-    }
+
+    htbl->oldHeads = htbl->heads;
+    htbl->oldCapacity = htbl->capacity;
+    htbl->rehashIndex = 0;
+    htbl->heads = newHeads;
+    htbl->capacity = newCapacity;
+    htbl->limit = (newCapacity * HASH_TABLE_LOAD_FACTOR) / 100;
+
+    return 0;
+}
+
+static hashItemPtr
+hashItemNew (const void *key, u_int keyLen, u_int hash, void *data, hashItemFreeCB fun) {
+    hashItemPtr item;
+
+    item = (hashItemPtr) malloc (sizeof (hashItem) + keyLen);
+    if (item == NULL)
+        return NULL;
+
+    item->hash = hash;
+    item->keyLen = keyLen;
+    item->data = data;
+    item->fun = fun;
+    memcpy (item->key, key, keyLen);
+
+    return item;
 }
 
 static void
@@ -176,140 +254,86 @@ hashItemDel (hashTablePtr htbl, hashItemPtr item) {
     /* Free item */
     if (item->fun)
         (item->fun) (item->data);
-    free (item->key);
     free (item);
     htbl->size--;
 }
 
-static int
-hashItemAttach (hashTablePtr htbl, hashItemPtr item) {
-    u_int index;
-    hlistHeadPtr head;
-    hashItemPtr tmp;
-
-    /* Check hash duplicate key */
-    tmp = hashItemLookup (htbl, item->key, &index);
-
-    if (tmp == NULL) {
-        item->index = index;
-        head = &htbl->heads [index];
-        hlistAdd (&item->node, head);
-        htbl->size++;
-        return 0;
-    } else
-        return -1;
-}
-
-
-static void
-hashItemDetach (hashTablePtr htbl, hashItemPtr item) {
-    hlistDel (&item->node);
-    htbl->size--;
-}
-
 /**
- * @brief Insert new item.
- *        If current size is exceed limit size then recreate a new hash
- *        table and attach all items to new hash table.
+ * @brief Insert new item with binary key.
+ *        If current size is exceed limit size then start migration to a
+ *        new hash list heads with larger capacity.
  *
  * @param htbl -- hash table to insert
  * @param key -- hash key
+ * @param keyLen -- hash key length
  * @param data -- opaque data
  * @param func -- free function
  *
  * @return 0 if success, else reutrn -1
  */
 int
-hashInsert (hashTablePtr htbl, char *key, void *data, hashItemFreeCB fun) {
-    int ret;
-    u_int index;
-    u_int newMemSize;
-    u_int newLimit;
+hashInsertBinKey (hashTablePtr htbl, const void *key, u_int keyLen,
+                  void *data, hashItemFreeCB fun) {
+    u_int hash;
     hashItemPtr item;
-    u_int newCapacity, oldCapacity;
-    hlistHeadPtr newHeads, oldHeads, head;
 
     if (key == NULL || data == NULL || fun == NULL)
         return -1;
 
-    if (htbl->size >= htbl->limit) {
-        newCapacity = htbl->capacity * HASH_TABLE_RESIZE_FACTOR;
-        newLimit = (newCapacity * HASH_TABLE_LOAD_FACTOR) / 100;
-        newMemSize = newCapacity * sizeof (hlistHead);
-
-        newHeads = (hlistHeadPtr) malloc (newMemSize);
-        if (newHeads == NULL) {
-            ret = hashItemInsert (htbl, key, data, fun);
-            if (ret < 0)
-                return -1;
-
-            return 0;
-        }
+    hashRehashStep (htbl, HASH_TABLE_REHASH_STEP);
 
-        for (index = 0; index < newCapacity; index++)
-            newHeads [index].first = NULL;
+    /* Keep inserting to current hash list heads if migration fails */
+    if (htbl->size >= htbl->limit)
+        hashRehashStart (htbl);
 
-        /* Backup hash table */
-        oldCapacity = htbl->capacity;
-        oldHeads = htbl->heads;
-
-        /* Update hash table */
-        htbl->capacity = newCapacity;
-        htbl->limit = newLimit;
-
-        /* Update hash list heads */
-        htbl->heads = newHeads;
-
-        /* Attach items to new hash table */
-        for (index = 0; index < oldCapacity; index++) {
-            head = &oldHeads [index];
-
-            while (head->first) {
-                item = hlistEntry (head->first, hashItem, node);
-
-                hashItemDetach (htbl, item);
-
-                ret = hashItemAttach (htbl, item);
-                if (ret < 0) {
-                    hlistDel (&item->node);
-                    if (item->fun)
-                        (item->fun) (item->data);
-                    free (item->key);
-                    free (item);
-                    htbl->size--;
-                }
-            }
-        }
-        /* Destroy old hash list heads */
-        free (oldHeads);
+    /* First lookup if duplicate key */
+    hash = itemHash (key, keyLen);
+    item = hashItemLookup (htbl, key, keyLen, hash);
+    if (item) {
+        fun (data);
+        return -1;
     }
 
-    /* Finally, insert hash item */
-    ret = hashItemInsert (htbl, key, data, fun);
-    if (ret < 0)
+    item = hashItemNew (key, keyLen, hash, data, fun);
+    if (item == NULL) {
+        fun (data);
         return -1;
+    }
 
+    hlistAdd (&item->node, &htbl->heads [hash % htbl->capacity]);
+    htbl->size++;
     return 0;
 }
 
+/* Insert new item with string key */
+int
+hashInsert (hashTablePtr htbl, char *key, void *data, hashItemFreeCB fun) {
+    if (key == NULL)
+        return -1;
+
+    return hashInsertBinKey (htbl, key, strlen (key) + 1, data, fun);
+}
+
 /**
- * @brief Remove hash item.
+ * @brief Remove hash item with binary key.
  *        Lookup item with key and delete it from hash table.
  *
  * @param htbl -- hash table
- * @param key -- hash key.
+ * @param key -- hash key
+ * @param keyLen -- hash key length
  *
  * @return 0 if success else -1
  */
 int
-hashRemove (hashTablePtr htbl, char *key) {
-    u_int index;
+hashRemoveBinKey (hashTablePtr htbl, const void *key, u_int keyLen) {
     hashItemPtr item;
 
     if (key == NULL)
         return -1;
 
-    item = hashItemLookup (htbl, key, &index);
+    hashRehashStep (htbl, HASH_TABLE_REHASH_STEP);
+
+    item = hashItemLookup (htbl, key, keyLen, itemHash (key, keyLen));
     if (item == NULL)
         return -1;
 
@@ -317,29 +341,41 @@ hashRemove (hashTablePtr htbl, char *key) {
     return 0;
 }
 
+/* Remove hash item with string key */
+int
+hashRemove (hashTablePtr htbl, char *key) {
+    if (key == NULL)
+        return -1;
+
+    return hashRemoveBinKey (htbl, key, strlen (key) + 1);
+}
+
 /**
- * @brief Update item specified key.
+ * @brief Update item specified binary key.
  *        Lookup item with key, if key is present then destroy
  *        the old item and insert the new one.
  *
  * @param htbl -- hash table
  * @param key -- hash key
+ * @param keyLen -- hash key length
  * @param data -- new opaque data
  * @param fun -- data free function
  *
  * @return 0 if success else return -1
  */
 int
-hashUpdate (hashTablePtr htbl, char *key, void *data, hashItemFreeCB fun) {
-    u_int index;
+hashUpdateBinKey (hashTablePtr htbl, const void *key, u_int keyLen,
+                  void *data, hashItemFreeCB fun) {
     hashItemPtr item;
 
     if (key == NULL || data == NULL || fun == NULL)
         return -1;
 
-    item = hashItemLookup (htbl, key, &index);
+    hashRehashStep (htbl, HASH_TABLE_REHASH_STEP);
+
+    item = hashItemLookup (htbl, key, keyLen, itemHash (key, keyLen));
     if (item == NULL)
-        return hashInsert (htbl, key, data, fun);
+        return hashInsertBinKey (htbl, key, keyLen, data, fun);
 
     if (item->fun)
         (item->fun) (item->data);
@@ -348,31 +384,50 @@ hashUpdate (hashTablePtr htbl, char *key, void *data, hashItemFreeCB fun) {
     return 0;
 }
 
+/* Update item specified string key */
+int
+hashUpdate (hashTablePtr htbl, char *key, void *data, hashItemFreeCB fun) {
+    if (key == NULL)
+        return -1;
+
+    return hashUpdateBinKey (htbl, key, strlen (key) + 1, data, fun);
+}
+
 /**
- * @brief Lookup hash item.
+ * @brief Lookup hash item with binary key.
  *        Lookup hash item with key, if exists return opaque data of it
- *        else return NULL.
+ *        else return NULL. Lookup never modifies hash table, so it is
+ *        safe for concurrent readers.
  *
  * @param htbl -- hash table
  * @param key -- hash key
+ * @param keyLen -- hash key length
  *
  * @return opaque data if success, else return NULL;
  */
 void *
-hashLookup (hashTablePtr htbl, char *key) {
-    u_int index;
+hashLookupBinKey (hashTablePtr htbl, const void *key, u_int keyLen) {
     hashItemPtr item;
 
     if (key == NULL)
         return NULL;
 
-    item = hashItemLookup (htbl, key, &index);
+    item = hashItemLookup (htbl, key, keyLen, itemHash (key, keyLen));
     if (item)
         return item->data;
     else
         return NULL;
 }
 
+/* Lookup hash item with string key */
+void *
+hashLookup (hashTablePtr htbl, char *key) {
+    if (key == NULL)
+        return NULL;
+
+    return hashLookupBinKey (htbl, key, strlen (key) + 1);
+}
+
 /**
  * @brief Rename hash item key.
  *        Lookup hash item with old key and replace old key with new one.
@@ -385,45 +440,60 @@ hashLookup (hashTablePtr htbl, char *key) {
  */
 int
 hashRename (hashTablePtr htbl, char *oldKey, char *newKey) {
-    int ret;
-    u_int index;
-    hashItemPtr item;
+    u_int oldKeyLen, newKeyLen, newHash;
+    hashItemPtr item, newItem;
 
     if (oldKey == NULL || newKey == NULL)
         return -1;
 
-    item = hashItemLookup (htbl, newKey, &index);
+    hashRehashStep (htbl, HASH_TABLE_REHASH_STEP);
+
+    newKeyLen = strlen (newKey) + 1;
+    newHash = itemHash (newKey, newKeyLen);
+    item = hashItemLookup (htbl, newKey, newKeyLen, newHash);
     if (item)
         return -1;
 
-    item = hashItemLookup (htbl, oldKey, &index);
+    oldKeyLen = strlen (oldKey) + 1;
+    item = hashItemLookup (htbl, oldKey, oldKeyLen, itemHash (oldKey, oldKeyLen));
     if (item == NULL)
         return -1;
 
-    hashItemDetach (htbl, item);
-    free (item->key);
-    item->key = strdup (newKey);
-    if (item->key == NULL) {
-        if (item->fun)
-            (item->fun) (item->data);
-        free (item);
+    /* Key is stored in item, so move data to new item */
+    newItem = hashItemNew (newKey, newKeyLen, newHash, item->data, item->fun);
+    if (newItem == NULL)
         return -1;
-    }
 
-    ret = hashItemAttach (htbl, item);
-    if (ret < 0) {
-        if (item->fun)
-            (item->fun) (item->data);
-        free (item->key);
-        free (item);
-        return -1;
+    hlistDel (&item->node);
+    free (item);
+    hlistAdd (&newItem->node, &htbl->heads [newHash % htbl->capacity]);
+
+    return 0;
+}
+
+/* Apply fun to each item of hash list heads */
+static int
+hashBucketsLoopDo (hlistHeadPtr heads, u_int from, u_int to,
+                   hashLoopDoCB fun, void *args) {
+    int ret;
+    u_int index;
+    hashItemPtr item;
+    hlistNodePtr hnode, tmp;
+
+    for (index = from; index < to; index++) {
+        hlistForEachEntrySafe (item, hnode, tmp, &heads [index], node) {
+            ret = fun (item->data, args);
+            if (ret < 0)
+                return -1;
+        }
     }
 
     return 0;
 }
 
 /**
- * @brief Iterate each item and apply fun to it.
+ * @brief Iterate each item and apply fun to it, items of both old and
+ *        new hash list heads are iterated during migration.
  *
  * @param htbl -- hash table
  * @param fun -- callback function
@@ -434,30 +504,44 @@ hashRename (hashTablePtr htbl, char *oldKey, char *newKey) {
 int
 hashLoopDo (hashTablePtr htbl, hashLoopDoCB fun, void *args) {
     int ret;
-    u_int index;
-    hashItemPtr item;
-    hlistHeadPtr head;
-    hlistNodePtr hnode, tmp;
 
     if (fun == NULL)
         return -1;
 
-    for (index = 0; index < htbl->capacity; index++) {
-        head = & htbl->heads [index];
-        hlistForEachEntrySafe (item, hnode, tmp, head, node) {
-            ret = fun (item->data, args);
-            if (ret < 0)
-                return -1;
-        }
+    if (htbl->oldHeads) {
+        ret = hashBucketsLoopDo (htbl->oldHeads, htbl->rehashIndex, htbl->oldCapacity, fun, args);
+        if (ret < 0)
+            return -1;
     }
 
-    return 0;
+    return hashBucketsLoopDo (htbl->heads, 0, htbl->capacity, fun, args);
+}
+
+/* Remove items of hash list heads when check return true */
+static void
+hashBucketsLoopCheckToRemove (hashTablePtr htbl, hlistHeadPtr heads, u_int from, u_int to,
+                              hashLoopCheckToRemoveCB fun, void *args) {
+    u_int index;
+    hashItemPtr item;
+    hlistNodePtr hnode, tmp;
+
+    for (index = from; index < to; index++) {
+        hlistForEachEntrySafe (item, hnode, tmp, &heads [index], node) {
+            if (fun (item->data, args)) {
+                hlistDel (&item->node);
+                free (item);
+                htbl->size--;
+            }
+        }
+    }
 }
 
 /**
  * @brief Iterate each item and remove it when check return ture.
  *        Iterate each item and do remove check, if check return ture then
- *        remove it from hash table else do nothing.
+ *        remove it from hash table else do nothing. Data of item removed
+ *        is not freed, items of both old and new hash list heads are
+ *        checked during migration.
  *
  * @param htbl -- hash table
  * @param fun -- check function
@@ -465,23 +549,13 @@ hashLoopDo (hashTablePtr htbl, hashLoopDoCB fun, void *args) {
  */
 void
 hashLoopCheckToRemove (hashTablePtr htbl, hashLoopCheckToRemoveCB fun, void *args) {
-    u_int index;
-    hashItemPtr item;
-    hlistHeadPtr head;
-    hlistNodePtr hnode, tmp;
-
     if (fun == NULL)
         return;
 
-    for (index = 0; index < htbl->capacity; index++) {
-        head = & htbl->heads [index];
-        hlistForEachEntrySafe (item, hnode, tmp, head, node) {
-            if (fun (item->data, args)) {
-                hlistDel (&item->node);
-                htbl->size--;
-            }
-        }
-    }
+    if (htbl->oldHeads)
+        hashBucketsLoopCheckToRemove (htbl, htbl->oldHeads, htbl->rehashIndex,
+                                      htbl->oldCapacity, fun, args);
+    hashBucketsLoopCheckToRemove (htbl, htbl->heads, 0, htbl->capacity, fun, args);
 }
 
 u_int
@@ -505,9 +579,6 @@ hashLimit (hashTablePtr htbl) {
  */
 hashTablePtr
 hashNew (u_int capacity) {
-    u_int i;
-    u_int memSize;
-
     hashTablePtr htbl = (hashTablePtr ) malloc (sizeof (hashTable));
     if (htbl == NULL)
         return NULL;
@@ -515,15 +586,15 @@ hashNew (u_int capacity) {
     htbl->capacity = capacity ? capacity : DEFAULT_HASH_TABLE_CAPACITY;
     htbl->limit = (htbl->capacity * HASH_TABLE_LOAD_FACTOR) / 100;
     htbl->size = 0;
+    htbl->oldCapacity = 0;
+    htbl->rehashIndex = 0;
+    htbl->oldHeads = NULL;
 
-    memSize = htbl->capacity * sizeof (hlistHead);
-    htbl->heads = (hlistHeadPtr) malloc (memSize);
+    htbl->heads = (hlistHeadPtr) calloc (htbl->capacity, sizeof (hlistHead));
     if (htbl->heads == NULL) {
         free (htbl);
         return NULL;
     }
-    for (i = 0; i < htbl->capacity; i++)
-        htbl->heads [i].first = NULL;
 
     return htbl;
 }
@@ -535,6 +606,10 @@ hashClean (hashTablePtr htbl) {
     hlistHeadPtr head;
     hashItemPtr item;
 
+    /* Finish migration, then all items are in current hash list heads */
+    if (htbl->oldHeads)
+        hashRehashStep (htbl, htbl->oldCapacity - htbl->rehashIndex);
+
     if (!htbl->size)
         return;
 
@@ -12,12 +12,22 @@ typedef boolean (*hashLoopCheckToRemoveCB) (void *data, void *args);
 
 /*========================Interfaces definition============================*/
 int
+hashInsertBinKey (hashTablePtr htbl, const void *key, u_int keyLen,
+                  void *data, hashItemFreeCB fun);
+int
 hashInsert (hashTablePtr htbl, char *key, void *data, hashItemFreeCB fun);
 int
+hashRemoveBinKey (hashTablePtr htbl, const void *key, u_int keyLen);
+int
 hashRemove (hashTablePtr htbl, char *key);
 int
+hashUpdateBinKey (hashTablePtr htbl, const void *key, u_int keyLen,
+                  void *data, hashItemFreeCB fun);
+int
 hashUpdate (hashTablePtr htbl, char *key, void *data, hashItemFreeCB fun);
 void *
+hashLookupBinKey (hashTablePtr htbl, const void *key, u_int keyLen);
+void *
 hashLookup (hashTablePtr htbl, char *key);
 int
 hashRename (hashTablePtr htbl, char *old_key, char *new_key);
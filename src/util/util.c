@@ -39,6 +39,15 @@ getSysTime (void) {
     return (u_long_long) ((u_long_long) tv.tv_sec * 1000 + (u_long_long) tv.tv_usec / 1000);
 }
 
+/* Get monotonic time in nanoseconds */
+u_long_long
+getMonotonicTime (void) {
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (u_long_long) ts.tv_sec * 1000000000ULL + (u_long_long) ts.tv_nsec;
+}
+
 void
 formatLocalTimeStr (timeValPtr timestamp, char *buf, u_int bufLen) {
     time_t seconds = (time_t) timestamp->tvSec;
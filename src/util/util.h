@@ -24,6 +24,22 @@ struct _timeVal {
     u_long_long tvUsec;
 };
 
+typedef struct _pktTimestamp pktTimestamp;
+typedef pktTimestamp *pktTimestampPtr;
+
+/*
+ * Packet timestamp carried by timestamp zframe between pipeline stages,
+ * captureTime must be the first member so timestamp zframe can still be
+ * used as timeVal. Monotonic timestamps are only comparable on the node
+ * with the same clockId.
+ */
+struct _pktTimestamp {
+    timeVal captureTime;                /**< Packet capture timestamp in network byte order */
+    u_long_long clockId;                /**< Monotonic clock id of ingress node */
+    u_long_long ingressTime;            /**< Monotonic timestamp captured by rawCaptureService */
+    u_long_long dispatchTime;           /**< Monotonic timestamp dispatched by ipProcessService */
+};
+
 #define TABLE_SIZE(x) (sizeof (x) / sizeof ((x) [0]))
 
 #define STRPREFIX(s1, s2) (!strncmp (s1, s2, strlen (s2)))
@@ -74,6 +90,8 @@ u_long_long
 timeVal2MicoSecond (timeValPtr tm);
 u_long_long
 getSysTime (void);
+u_long_long
+getMonotonicTime (void);
 void
 formatLocalTimeStr (timeValPtr timestamp, char *buf, u_int bufLen);
 time_t
@@ -8,11 +8,6 @@
 /* Zmq hub instance */
 static zmqHubPtr zmqHubIntance = NULL;
 
-void *
-getLogRecvSock (void) {
-    return zmqHubIntance->logRecvSock;
-}
-
 void *
 getLogPubSock (void) {
     return zmqHubIntance->logPubSock;
@@ -48,6 +43,11 @@ getAnalysisRecordRecvSock (void) {
     return zmqHubIntance->analysisRecordRecvSock;
 }
 
+void *
+getAnalysisRecordPubSock (void) {
+    return zmqHubIntance->analysisRecordPubSock;
+}
+
 void *
 getTopologyEntrySendSock (void) {
     return zmqHubIntance->topologyEntrySendSock;
@@ -58,9 +58,19 @@ getAppServiceSendSock (void) {
     return zmqHubIntance->appServiceSendSock;
 }
 
+u_int
+getRawCaptureThreadsNum (void) {
+    return zmqHubIntance->rawCaptureThreadsNum;
+}
+
+u_int *
+getRawCaptureThreadIDHolder (u_int index) {
+    return &zmqHubIntance->rawCaptureThreadIDsHolder [index];
+}
+
 void *
-getIpPktSendSock (void) {
-    return zmqHubIntance->ipPktSendSock;
+getIpPktSendSock (u_int index) {
+    return zmqHubIntance->ipPktSendSocks [index];
 }
 
 void *
@@ -117,6 +127,9 @@ int
 initZmqHub (void) {
     int ret;
     u_int i, size;
+#ifdef ZMQ_XPUB_NODROP
+    int noDrop;
+#endif
 
     /* Alloc zmqHubIntance */
     zmqHubIntance = (zmqHubPtr) malloc (sizeof (zmqHub));
@@ -133,18 +146,6 @@ initZmqHub (void) {
     }
     zctx_set_linger (zmqHubIntance->zmqCtxt, 0);
 
-    /* Create logRecvSock */
-    zmqHubIntance->logRecvSock = zsocket_new (zmqHubIntance->zmqCtxt, ZMQ_PULL);
-    if (zmqHubIntance->logRecvSock == NULL) {
-        LOGE ("Create logRecvSock error.\n");
-        goto destroyZmqCtxt;
-    }
-    ret = zsocket_bind (zmqHubIntance->logRecvSock, "tcp://*:%u", LOG_RECV_PORT);
-    if (ret < 0) {
-        LOGE ("Bind logRecvSock to tcp://*:%u error.\n", LOG_RECV_PORT);
-        goto destroyZmqCtxt;
-    }
-
     /* Create logPubSock */
     zmqHubIntance->logPubSock = zsocket_new (zmqHubIntance->zmqCtxt, ZMQ_PUB);
     if (zmqHubIntance->logPubSock == NULL) {
@@ -251,6 +252,38 @@ initZmqHub (void) {
         goto destroyZmqCtxt;
     }
 
+    /* Create analysis record pub sock */
+    if (getPropertiesPubOutputPort ()) {
+        zmqHubIntance->analysisRecordPubSock = zsocket_new (zmqHubIntance->zmqCtxt, ZMQ_XPUB);
+        if (zmqHubIntance->analysisRecordPubSock == NULL) {
+            LOGE ("Create analysisRecordPubSock error.\n");
+            goto destroyZmqCtxt;
+        }
+        zsocket_set_sndhwm (zmqHubIntance->analysisRecordPubSock, 500000);
+        /*
+         * By default records are dropped silently for each slow subscriber only,
+         * with noDrop sending fails once any subscriber reaches high water mark,
+         * so records are dropped for all subscribers but drops can be counted.
+         */
+        if (getPropertiesPubOutputNoDrop ()) {
+#ifdef ZMQ_XPUB_NODROP
+            noDrop = 1;
+            zmq_setsockopt (zmqHubIntance->analysisRecordPubSock, ZMQ_XPUB_NODROP,
+                            &noDrop, sizeof (noDrop));
+#else
+            LOGW ("ZMQ_XPUB_NODROP is not supported, ignore pubOutput noDrop.\n");
+#endif
+        }
+        ret = zsocket_bind (zmqHubIntance->analysisRecordPubSock, "tcp://*:%u",
+                            getPropertiesPubOutputPort ());
+        if (ret < 0) {
+            LOGE ("Bind analysisRecordPubSock to tcp://*:%u error.\n",
+                  getPropertiesPubOutputPort ());
+            goto destroyZmqCtxt;
+        }
+    } else
+        zmqHubIntance->analysisRecordPubSock = NULL;
+
     /* Create topologyEntrySendSock */
     zmqHubIntance->topologyEntrySendSock = zsocket_new (zmqHubIntance->zmqCtxt, ZMQ_PUSH);
     if (zmqHubIntance->topologyEntrySendSock == NULL) {
@@ -279,36 +312,6 @@ initZmqHub (void) {
         goto destroyZmqCtxt;
     }
 
-    /* Create ipPktSendSock */
-    zmqHubIntance->ipPktSendSock = zsocket_new (zmqHubIntance->zmqCtxt, ZMQ_PUSH);
-    if (zmqHubIntance->ipPktSendSock == NULL) {
-        LOGE ("Create ipPktSendSock error.\n");
-        goto destroyZmqCtxt;
-    }
-    /* Set ipPktSendSock sndhwm to 500,000 */
-    zsocket_set_sndhwm (zmqHubIntance->ipPktSendSock, 500000);
-    ret = zsocket_bind (zmqHubIntance->ipPktSendSock, IP_PACKET_EXCHANGE_CHANNEL);
-    if (ret < 0) {
-        LOGE ("Bind ipPktSendSock to %s error.\n",
-              IP_PACKET_EXCHANGE_CHANNEL);
-        goto destroyZmqCtxt;
-    }
-
-    /* Create ipPktRecvSock */
-    zmqHubIntance->ipPktRecvSock = zsocket_new (zmqHubIntance->zmqCtxt, ZMQ_PULL);
-    if (zmqHubIntance->ipPktRecvSock == NULL) {
-        LOGE ("Create ipPktRecvSock error.\n");
-        goto destroyZmqCtxt;
-    }
-    /* Set ipPktRecvSock rcvhwm to 500,000 */
-    zsocket_set_rcvhwm (zmqHubIntance->ipPktRecvSock, 500000);
-    ret = zsocket_connect (zmqHubIntance->ipPktRecvSock, IP_PACKET_EXCHANGE_CHANNEL);
-    if (ret < 0) {
-        LOGE ("Connect ipPktRecvSock to %s error.\n",
-              IP_PACKET_EXCHANGE_CHANNEL);
-        goto destroyZmqCtxt;
-    }
-
     /* Create icmpPktSendSock */
     zmqHubIntance->icmpPktSendSock = zsocket_new (zmqHubIntance->zmqCtxt, ZMQ_PUSH);
     if (zmqHubIntance->icmpPktSendSock == NULL) {
@@ -447,8 +450,68 @@ initZmqHub (void) {
         }
     }
 
+    /* Get raw capture threads number, one for every network interface */
+    zmqHubIntance->rawCaptureThreadsNum =
+            getPropertiesSniffLive () ? getPropertiesInterfacesNum () : 1;
+
+    /* Alloc rawCaptureThreadIDsHolder */
+    zmqHubIntance->rawCaptureThreadIDsHolder =
+            (u_int *) malloc (sizeof (u_int) * zmqHubIntance->rawCaptureThreadsNum);
+    if (zmqHubIntance->rawCaptureThreadIDsHolder == NULL) {
+        LOGE ("Alloc rawCaptureThreadIDsHolder error: %s.\n", strerror (errno));
+        goto freeTcpBreakdownSendSocks;
+    }
+    for (i = 0; i < zmqHubIntance->rawCaptureThreadsNum; i++) {
+        zmqHubIntance->rawCaptureThreadIDsHolder [i] = i;
+    }
+
+    /* Create ipPktRecvSock */
+    zmqHubIntance->ipPktRecvSock = zsocket_new (zmqHubIntance->zmqCtxt, ZMQ_PULL);
+    if (zmqHubIntance->ipPktRecvSock == NULL) {
+        LOGE ("Create ipPktRecvSock error.\n");
+        goto freeRawCaptureThreadIDsHolder;
+    }
+    /* Set ipPktRecvSock rcvhwm to 500,000 */
+    zsocket_set_rcvhwm (zmqHubIntance->ipPktRecvSock, 500000);
+
+    /* Alloc ipPktSendSocks, ip packets of all raw capture threads are merged by ipPktRecvSock */
+    zmqHubIntance->ipPktSendSocks =
+            (void **) malloc (sizeof (void *) * zmqHubIntance->rawCaptureThreadsNum);
+    if (zmqHubIntance->ipPktSendSocks == NULL) {
+        LOGE ("Alloc ipPktSendSocks error: %s\n", strerror (errno));
+        goto freeRawCaptureThreadIDsHolder;
+    }
+    for (i = 0; i < zmqHubIntance->rawCaptureThreadsNum; i++) {
+        zmqHubIntance->ipPktSendSocks [i] = zsocket_new (zmqHubIntance->zmqCtxt, ZMQ_PUSH);
+        if (zmqHubIntance->ipPktSendSocks [i] == NULL) {
+            LOGE ("Create ipPktSendSocks [%u] error.\n", i);
+            goto freeIpPktSendSocks;
+        }
+        zsocket_set_sndhwm (zmqHubIntance->ipPktSendSocks [i], 500000);
+        ret = zsocket_bind (zmqHubIntance->ipPktSendSocks [i], "%s%u", IP_PACKET_EXCHANGE_CHANNEL, i);
+        if (ret < 0) {
+            LOGE ("Bind ipPktSendSocks [%u] to %s%u error.\n",
+                  i, IP_PACKET_EXCHANGE_CHANNEL, i);
+            goto freeIpPktSendSocks;
+        }
+
+        ret = zsocket_connect (zmqHubIntance->ipPktRecvSock, "%s%u", IP_PACKET_EXCHANGE_CHANNEL, i);
+        if (ret < 0) {
+            LOGE ("Connect ipPktRecvSock to %s%u error.\n",
+                  IP_PACKET_EXCHANGE_CHANNEL, i);
+            goto freeIpPktSendSocks;
+        }
+    }
+
     return 0;
 
+freeIpPktSendSocks:
+    free (zmqHubIntance->ipPktSendSocks);
+    zmqHubIntance->ipPktSendSocks = NULL;
+freeRawCaptureThreadIDsHolder:
+    free (zmqHubIntance->rawCaptureThreadIDsHolder);
+    zmqHubIntance->rawCaptureThreadIDsHolder = NULL;
+    zmqHubIntance->rawCaptureThreadsNum = 0;
 freeTcpBreakdownSendSocks:
     free (zmqHubIntance->tcpBreakdownSendSocks);
     zmqHubIntance->tcpBreakdownSendSocks = NULL;
@@ -472,6 +535,10 @@ freeZmqHubInstance:
 
 void
 destroyZmqHub (void) {
+    free (zmqHubIntance->rawCaptureThreadIDsHolder);
+    zmqHubIntance->rawCaptureThreadIDsHolder = NULL;
+    free (zmqHubIntance->ipPktSendSocks);
+    zmqHubIntance->ipPktSendSocks = NULL;
     free (zmqHubIntance->tcpProcessThreadIDsHolder);
     zmqHubIntance->tcpProcessThreadIDsHolder = NULL;
     free (zmqHubIntance->tcpPktSendSocks);
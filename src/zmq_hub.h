@@ -11,7 +11,6 @@
 #define TCP_PACKET_EXCHANGE_CHANNEL "inproc://tcpPacketExchangeChannel"
 #define ANALYSIS_RECORD_EXCHANGE_CHANNEL "inproc://analysisRecordExchangeChannel"
 
-#define LOG_RECV_PORT 50001
 #define LOG_PUB_PORT 50002
 #define TCP_PACKET_DISPATCH_RECV_PORT 51001
 
@@ -21,7 +20,6 @@ typedef zmqHub *zmqHubPtr;
 struct _zmqHub {
     zctx_t *zmqCtxt;                    /**< Zmq context */
 
-    void *logRecvSock;                  /**< Log recv sock */
     void *logPubSock;                   /**< Log pub sock */
 
     void *managementReplySock;          /**< Management reply sock */
@@ -33,12 +31,15 @@ struct _zmqHub {
     void *protoDetectionStatusRecvSock; /**< Proto detection status recv sock */
 
     void *analysisRecordRecvSock;       /**< Analysis record recv sock */
+    void *analysisRecordPubSock;        /**< Analysis record pub sock */
 
     void *topologyEntrySendSock;        /**< Topology entry send sock */
 
     void *appServiceSendSock;           /**< Application service send sock */
 
-    void *ipPktSendSock;                /**< Ip packet send sock */
+    u_int rawCaptureThreadsNum;         /**< Raw capture threads number */
+    u_int *rawCaptureThreadIDsHolder;   /**< Raw capture thread IDs holder */
+    void **ipPktSendSocks;              /**< Ip packet send socks of raw capture threads */
     void *ipPktRecvSock;                /**< Ip packet recv sock */
 
     void *icmpPktSendSock;              /**< Icmp packet send sock */
@@ -56,8 +57,6 @@ struct _zmqHub {
 
 /*========================Interfaces definition============================*/
 void *
-getLogRecvSock (void);
-void *
 getLogPubSock (void);
 void *
 getManagementReplySock (void);
@@ -72,11 +71,17 @@ getProtoDetectionStatusRecvSock (void);
 void *
 getAnalysisRecordRecvSock (void);
 void *
+getAnalysisRecordPubSock (void);
+void *
 getTopologyEntrySendSock (void);
 void *
 getAppServiceSendSock (void);
+u_int
+getRawCaptureThreadsNum (void);
+u_int *
+getRawCaptureThreadIDHolder (u_int index);
 void *
-getIpPktSendSock (void);
+getIpPktSendSock (u_int index);
 void *
 getIpPktRecvSock (void);
 void *
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pcap.h>
+#include "util.h"
+#include "hash.h"
+#include "app_service.h"
+
+static void
+addAppService (hashTablePtr htbl, char *ip, u_short port) {
+    int ret;
+    char key [64];
+    appServicePtr svc;
+
+    svc = (appServicePtr) malloc (sizeof (appService));
+    assert (svc);
+    svc->proto = "HTTP";
+    svc->analyzer = NULL;
+    svc->ip = strdup (ip);
+    assert (svc->ip);
+    svc->port = port;
+
+    snprintf (key, sizeof (key), "%s:%u", ip, port);
+    ret = hashInsert (htbl, key, svc, freeAppServiceForHash);
+    assert (!ret);
+}
+
+/* Check appServices filter is accepted by pcap_compile */
+static void
+compileFilter (char *filter) {
+    int ret;
+    pcap_t *pcap;
+    struct bpf_program fcode;
+
+    pcap = pcap_open_dead (DLT_EN10MB, 65535);
+    assert (pcap);
+
+    ret = pcap_compile (pcap, &fcode, filter, 1, 0);
+    if (ret < 0)
+        printf ("Compile filter \"%s\" error: %s\n", filter, pcap_geterr (pcap));
+    assert (!ret);
+
+    pcap_freecode (&fcode);
+    pcap_close (pcap);
+}
+
+static void
+appServicesFilterTest (void) {
+    char *filter;
+    hashTablePtr htbl;
+
+    htbl = hashNew (0);
+    assert (htbl);
+
+    /* Ipv4 appServices only */
+    addAppService (htbl, "10.0.0.1", 80);
+    addAppService (htbl, "10.0.0.2", 3306);
+    filter = getAppServicesBpfFilter (htbl);
+    assert (filter);
+    printf ("Ipv4 appServices filter: %s\n", filter);
+    assert (strstr (filter, "ip host 10.0.0.1"));
+    assert (strstr (filter, "icmp6"));
+    compileFilter (filter);
+    free (filter);
+    printf ("Test ipv4 appServices filter success.\n");
+
+    /* Ipv4 and ipv6 appServices */
+    addAppService (htbl, "2001:db8::1", 80);
+    addAppService (htbl, "fe80::1:2:3:4", 8080);
+    filter = getAppServicesBpfFilter (htbl);
+    assert (filter);
+    printf ("Ipv4 and ipv6 appServices filter: %s\n", filter);
+    assert (strstr (filter, "ip6 host 2001:db8::1"));
+    assert (strstr (filter, "ip6[6] == 44"));
+    compileFilter (filter);
+    free (filter);
+    printf ("Test ipv6 appServices filter success.\n");
+
+    hashDestroy (htbl);
+}
+
+int
+main (int argc, char *argv []) {
+    appServicesFilterTest ();
+
+    printf ("AppServiceFilterTest [Passed]\n");
+    return 0;
+}
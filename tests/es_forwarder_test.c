@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "util.h"
+#include "es_forwarder.h"
+
+/* Max bulk requests handled by stub server of one test */
+#define ES_TEST_MAX_REQUESTS 16
+/* Max bytes of bulk request handled by stub server */
+#define ES_TEST_MAX_REQUEST_LENGTH (64 << 10)
+/* Documents of each bulk batch */
+#define ES_TEST_BULK_SIZE 3
+
+typedef struct _esTestResponse esTestResponse;
+typedef esTestResponse *esTestResponsePtr;
+
+/* Canned bulk response of stub server */
+struct _esTestResponse {
+    u_int status;                       /**< Http status */
+    char *body;                         /**< Response body */
+};
+
+typedef struct _esTestServer esTestServer;
+typedef esTestServer *esTestServerPtr;
+
+/* Elasticsearch bulk api stub server, one request for each connection */
+struct _esTestServer {
+    int sock;                           /**< Listen socket */
+    u_short port;                       /**< Listen port */
+    esTestResponsePtr responses;        /**< Canned responses in order of requests */
+    u_int responsesNum;                 /**< Canned responses number */
+    volatile u_int requestsNum;         /**< Bulk requests handled */
+    u_int docs [ES_TEST_MAX_REQUESTS];  /**< Documents of each bulk request */
+    char *bodies [ES_TEST_MAX_REQUESTS]; /**< Body of each bulk request */
+    u_long_long times [ES_TEST_MAX_REQUESTS]; /**< Receive time of each bulk request */
+    pthread_t tid;                      /**< Server thread */
+};
+
+/* Read http request, return body length or -1 */
+static int
+readHttpRequest (int sock, char *buf, u_int bufSize, char **body) {
+    int ret;
+    u_int len = 0, contentLen = 0, headerLen;
+    char *end, *field;
+    boolean expectContinue;
+
+    for (;;) {
+        ret = recv (sock, buf + len, bufSize - len - 1, 0);
+        if (ret <= 0)
+            return -1;
+        len += ret;
+        buf [len] = 0;
+
+        end = strstr (buf, "\r\n\r\n");
+        if (end)
+            break;
+    }
+
+    headerLen = end + 4 - buf;
+    field = strcasestr (buf, "Content-Length:");
+    assert (field && field < end);
+    contentLen = strtoul (field + strlen ("Content-Length:"), NULL, 10);
+    assert (headerLen + contentLen < bufSize);
+
+    expectContinue = strcasestr (buf, "Expect: 100-continue") ? True : False;
+    if (expectContinue && len == headerLen) {
+        ret = send (sock, "HTTP/1.1 100 Continue\r\n\r\n", 25, 0);
+        assert (ret == 25);
+    }
+
+    while (len < headerLen + contentLen) {
+        ret = recv (sock, buf + len, bufSize - len - 1, 0);
+        if (ret <= 0)
+            return -1;
+        len += ret;
+    }
+    buf [headerLen + contentLen] = 0;
+
+    *body = buf + headerLen;
+    return contentLen;
+}
+
+static void *
+esTestServerService (void *args) {
+    int ret, sock;
+    u_int i, index;
+    char *buf, *body;
+    char header [256];
+    esTestServerPtr server = (esTestServerPtr) args;
+    esTestResponsePtr response;
+
+    buf = (char *) malloc (ES_TEST_MAX_REQUEST_LENGTH);
+    assert (buf);
+
+    while (server->requestsNum < server->responsesNum) {
+        sock = accept (server->sock, NULL, NULL);
+        if (sock < 0)
+            break;
+
+        ret = readHttpRequest (sock, buf, ES_TEST_MAX_REQUEST_LENGTH, &body);
+        if (ret < 0) {
+            close (sock);
+            continue;
+        }
+
+        index = server->requestsNum;
+        server->times [index] = getSysTime ();
+        server->bodies [index] = strdup (body);
+        assert (server->bodies [index]);
+        /* Every document is action line and document line */
+        server->docs [index] = 0;
+        for (i = 0; i < ret; i++) {
+            if (body [i] == '\n')
+                server->docs [index]++;
+        }
+        server->docs [index] /= 2;
+
+        response = &server->responses [index];
+        ret = snprintf (header, sizeof (header),
+                        "HTTP/1.1 %u Test\r\n"
+                        "Content-Type: application/json\r\n"
+                        "Content-Length: %u\r\n"
+                        "Connection: close\r\n\r\n",
+                        response->status, (u_int) strlen (response->body));
+        ret = send (sock, header, ret, 0);
+        assert (ret > 0);
+        ret = send (sock, response->body, strlen (response->body), 0);
+        assert (ret >= 0);
+        close (sock);
+
+        __sync_synchronize ();
+        server->requestsNum++;
+    }
+
+    free (buf);
+    return NULL;
+}
+
+static void
+startEsTestServer (esTestServerPtr server, esTestResponsePtr responses, u_int responsesNum) {
+    int ret;
+    socklen_t addrLen;
+    struct sockaddr_in addr;
+
+    assert (responsesNum <= ES_TEST_MAX_REQUESTS);
+    memset (server, 0, sizeof (*server));
+    server->responses = responses;
+    server->responsesNum = responsesNum;
+
+    server->sock = socket (AF_INET, SOCK_STREAM, 0);
+    assert (server->sock >= 0);
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    ret = bind (server->sock, (struct sockaddr *) &addr, sizeof (addr));
+    assert (!ret);
+    ret = listen (server->sock, 16);
+    assert (!ret);
+    addrLen = sizeof (addr);
+    ret = getsockname (server->sock, (struct sockaddr *) &addr, &addrLen);
+    assert (!ret);
+    server->port = ntohs (addr.sin_port);
+
+    ret = pthread_create (&server->tid, NULL, esTestServerService, server);
+    assert (!ret);
+}
+
+static void
+stopEsTestServer (esTestServerPtr server) {
+    u_int i;
+
+    shutdown (server->sock, SHUT_RDWR);
+    pthread_join (server->tid, NULL);
+    close (server->sock);
+    for (i = 0; i < server->requestsNum; i++)
+        free (server->bodies [i]);
+}
+
+/* Append docs with id from first and send them by forced flush */
+static esForwarderPtr
+forwardDocs (esTestServerPtr server, u_int first, u_int docs) {
+    int ret;
+    u_int i;
+    char url [64], doc [64];
+    esForwarderPtr forwarder;
+
+    snprintf (url, sizeof (url), "http://127.0.0.1:%u/", server->port);
+    forwarder = newEsForwarder (url, ES_TEST_BULK_SIZE, 1 << 20, 1000, 1);
+    assert (forwarder);
+
+    for (i = first; i < first + docs; i++) {
+        snprintf (doc, sizeof (doc), "{\"id\":%u}", i);
+        ret = esForwarderAppend (forwarder, "ntrace-test", doc, strlen (doc));
+        assert (!ret);
+    }
+    esForwarderFlush (forwarder, True);
+
+    return forwarder;
+}
+
+/* Documents of bulk batch are all indexed */
+static void
+esForwarderIndexedTest (void) {
+    esTestServer server;
+    esForwarderPtr forwarder;
+    esTestResponse responses [] = {
+        {200, "{\"took\":1,\"errors\":false,\"items\":[]}"},
+    };
+
+    startEsTestServer (&server, responses, TABLE_SIZE (responses));
+    forwarder = forwardDocs (&server, 0, ES_TEST_BULK_SIZE);
+
+    assert (server.requestsNum == 1);
+    assert (server.docs [0] == ES_TEST_BULK_SIZE);
+    assert (strstr (server.bodies [0], "{\"index\":{\"_index\":\"ntrace-test\"}}\n{\"id\":0}\n"));
+    assert (forwarder->stat.bulkRequests == 1);
+    assert (forwarder->stat.docsIndexed == ES_TEST_BULK_SIZE);
+    assert (forwarder->stat.docsDropped == 0);
+
+    freeEsForwarder (forwarder);
+    stopEsTestServer (&server);
+    printf ("Test elasticsearch bulk indexed success.\n");
+}
+
+/* Only items failed with retryable status are retried */
+static void
+esForwarderPartialFailureTest (void) {
+    esTestServer server;
+    esForwarderPtr forwarder;
+    esTestResponse responses [] = {
+        {200, "{\"took\":1,\"errors\":true,\"items\":["
+         "{\"index\":{\"status\":201}},"
+         "{\"index\":{\"status\":429,\"error\":{\"type\":\"es_rejected_execution_exception\"}}},"
+         "{\"index\":{\"status\":400,\"error\":{\"type\":\"mapper_parsing_exception\"}}}]}"},
+        {200, "{\"took\":1,\"errors\":false,\"items\":[{\"index\":{\"status\":201}}]}"},
+    };
+
+    startEsTestServer (&server, responses, TABLE_SIZE (responses));
+    forwarder = forwardDocs (&server, 0, ES_TEST_BULK_SIZE);
+
+    assert (server.requestsNum == 2);
+    assert (server.docs [0] == ES_TEST_BULK_SIZE);
+    assert (server.docs [1] == 1);
+    assert (strstr (server.bodies [1], "{\"id\":1}\n"));
+    assert (server.times [1] - server.times [0] >= 500);
+    assert (forwarder->stat.bulkRequests == 2);
+    assert (forwarder->stat.bulkErrors == 0);
+    assert (forwarder->stat.docsIndexed == 2);
+    assert (forwarder->stat.docsRetried == 1);
+    assert (forwarder->stat.docsDropped == 1);
+
+    freeEsForwarder (forwarder);
+    stopEsTestServer (&server);
+    printf ("Test elasticsearch bulk partial failure success.\n");
+}
+
+/* Bulk batch failed with 429 or 5xx status is retried with backoff */
+static void
+esForwarderBackoffTest (void) {
+    esTestServer server;
+    esForwarderPtr forwarder;
+    esTestResponse responses [] = {
+        {429, "{\"error\":\"too many requests\"}"},
+        {503, "{\"error\":\"unavailable\"}"},
+        {200, "{\"took\":1,\"errors\":false,\"items\":[]}"},
+    };
+
+    startEsTestServer (&server, responses, TABLE_SIZE (responses));
+    forwarder = forwardDocs (&server, 0, ES_TEST_BULK_SIZE);
+
+    assert (server.requestsNum == 3);
+    assert (server.docs [1] == ES_TEST_BULK_SIZE && server.docs [2] == ES_TEST_BULK_SIZE);
+    assert (strEqual (server.bodies [0], server.bodies [2]));
+    /* Backoff is doubled for each retry */
+    assert (server.times [1] - server.times [0] >= 500);
+    assert (server.times [2] - server.times [1] >= 1000);
+    assert (forwarder->stat.bulkRequests == 3);
+    assert (forwarder->stat.bulkErrors == 2);
+    assert (forwarder->stat.docsIndexed == ES_TEST_BULK_SIZE);
+    assert (forwarder->stat.docsRetried == ES_TEST_BULK_SIZE * 2);
+    assert (forwarder->stat.docsDropped == 0);
+
+    freeEsForwarder (forwarder);
+    stopEsTestServer (&server);
+    printf ("Test elasticsearch bulk retry backoff success.\n");
+}
+
+/* Documents of bulk batch rejected or with unparseable response are dropped without retry */
+static void
+esForwarderDropTest (void) {
+    esTestServer server;
+    esForwarderPtr forwarder;
+    esTestResponse responses [] = {
+        {200, "<html>proxy error</html>"},
+        {400, "{\"error\":\"bad request\"}"},
+    };
+
+    startEsTestServer (&server, responses, TABLE_SIZE (responses));
+    forwarder = forwardDocs (&server, 0, ES_TEST_BULK_SIZE * 2);
+
+    assert (server.requestsNum == 2);
+    assert (strstr (server.bodies [0], "{\"id\":0}\n"));
+    assert (strstr (server.bodies [1], "{\"id\":3}\n"));
+    assert (forwarder->stat.bulkRequests == 2);
+    assert (forwarder->stat.bulkErrors == 2);
+    assert (forwarder->stat.docsIndexed == 0);
+    assert (forwarder->stat.docsRetried == 0);
+    assert (forwarder->stat.docsDropped == ES_TEST_BULK_SIZE * 2);
+
+    freeEsForwarder (forwarder);
+    stopEsTestServer (&server);
+    printf ("Test elasticsearch bulk drop success.\n");
+}
+
+int
+main (int argc, char *argv []) {
+    esForwarderIndexedTest ();
+    esForwarderPartialFailureTest ();
+    esForwarderBackoffTest ();
+    esForwarderDropTest ();
+
+    printf ("EsForwarderTest [Passed]\n");
+    return 0;
+}
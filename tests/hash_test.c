@@ -1,8 +1,30 @@
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include "util.h"
 #include "hash.h"
 
+/* Items inserted for resize and latency benchmark */
+#define HASH_BENCH_ITEMS 200000
+
+typedef struct _binKey binKey;
+typedef binKey *binKeyPtr;
+
+struct _binKey {
+    u_int ip1;
+    u_int ip2;
+    u_short port1;
+    u_short port2;
+};
+
+typedef struct _binItem binItem;
+typedef binItem *binItemPtr;
+
+struct _binItem {
+    binKey key;
+    int val;
+};
+
 typedef struct _hItem hItem;
 typedef hItem *hItemPtr;
 
@@ -50,6 +72,138 @@ hashLoopCheckToRemoveFun (void *data, void *args) {
         return False;
 }
 
+static void
+binItemFree (void *data) {
+    free (data);
+}
+
+static void
+binKeyInit (binKeyPtr key, u_int i) {
+    memset (key, 0, sizeof (binKey));
+    key->ip1 = i;
+    key->ip2 = ~i;
+    key->port1 = i & 0xFFFF;
+    key->port2 = i >> 16;
+}
+
+static int
+binItemCountFun (void *data, void *args) {
+    (*(u_int *) args)++;
+    return 0;
+}
+
+static boolean
+binItemCheckToRemoveFun (void *data, void *args) {
+    binItemPtr ptr = (binItemPtr) data;
+
+    if (ptr->val % 2) {
+        free (ptr);
+        return True;
+    } else
+        return False;
+}
+
+/* Test binary key and hash table resize with items in migration */
+static void
+hashBinKeyTest (void) {
+    u_int i, count;
+    binKey key;
+    binItemPtr ptr;
+    hashTablePtr htbl;
+
+    htbl = hashNew (0);
+    assert (htbl);
+
+    for (i = 0; i < HASH_BENCH_ITEMS; i++) {
+        ptr = (binItemPtr) malloc (sizeof (binItem));
+        assert (ptr);
+        binKeyInit (&ptr->key, i);
+        ptr->val = i;
+        assert (!hashInsertBinKey (htbl, &ptr->key, sizeof (binKey), ptr, binItemFree));
+
+        /* Every item is reachable whether it has been migrated or not */
+        if (i % 997 == 0) {
+            binKeyInit (&key, i / 2);
+            ptr = (binItemPtr) hashLookupBinKey (htbl, &key, sizeof (binKey));
+            assert (ptr && ptr->val == i / 2);
+
+            count = 0;
+            assert (!hashLoopDo (htbl, binItemCountFun, &count));
+            assert (count == i + 1);
+        }
+    }
+    assert (hashSize (htbl) == HASH_BENCH_ITEMS);
+    printf ("Test hashInsertBinKey success.\n");
+
+    /* Duplicate key is rejected */
+    ptr = (binItemPtr) malloc (sizeof (binItem));
+    assert (ptr);
+    binKeyInit (&ptr->key, 7);
+    assert (hashInsertBinKey (htbl, &ptr->key, sizeof (binKey), ptr, binItemFree) < 0);
+
+    binKeyInit (&key, 7);
+    ptr = (binItemPtr) malloc (sizeof (binItem));
+    assert (ptr);
+    binKeyInit (&ptr->key, 7);
+    ptr->val = -7;
+    assert (!hashUpdateBinKey (htbl, &key, sizeof (binKey), ptr, binItemFree));
+    ptr = (binItemPtr) hashLookupBinKey (htbl, &key, sizeof (binKey));
+    assert (ptr && ptr->val == -7);
+    printf ("Test hashUpdateBinKey success.\n");
+
+    for (i = 0; i < HASH_BENCH_ITEMS; i += 3) {
+        binKeyInit (&key, i);
+        assert (!hashRemoveBinKey (htbl, &key, sizeof (binKey)));
+        assert (hashLookupBinKey (htbl, &key, sizeof (binKey)) == NULL);
+    }
+    assert (hashRemoveBinKey (htbl, &key, sizeof (binKey)) < 0);
+    assert (hashSize (htbl) == HASH_BENCH_ITEMS - (HASH_BENCH_ITEMS + 2) / 3);
+    printf ("Test hashRemoveBinKey success.\n");
+
+    hashLoopCheckToRemove (htbl, binItemCheckToRemoveFun, NULL);
+    count = 0;
+    assert (!hashLoopDo (htbl, binItemCountFun, &count));
+    assert (count == hashSize (htbl));
+    for (i = 1; i < HASH_BENCH_ITEMS; i += 6) {
+        binKeyInit (&key, i);
+        assert (hashLookupBinKey (htbl, &key, sizeof (binKey)) == NULL);
+    }
+    printf ("Test hashLoopCheckToRemove with binary key success.\n");
+
+    hashDestroy (htbl);
+}
+
+/* Benchmark of insert latency, resize must not stall a single insert */
+static void
+hashInsertLatencyBench (void) {
+    u_int i;
+    u_long_long start, latency, total = 0, max = 0;
+    binItemPtr ptr;
+    hashTablePtr htbl;
+
+    htbl = hashNew (0);
+    assert (htbl);
+
+    for (i = 0; i < HASH_BENCH_ITEMS; i++) {
+        ptr = (binItemPtr) malloc (sizeof (binItem));
+        assert (ptr);
+        binKeyInit (&ptr->key, i);
+        ptr->val = i;
+
+        start = getMonotonicTime ();
+        assert (!hashInsertBinKey (htbl, &ptr->key, sizeof (binKey), ptr, binItemFree));
+        latency = getMonotonicTime () - start;
+
+        total += latency;
+        if (latency > max)
+            max = latency;
+    }
+
+    printf ("Bench hashInsertBinKey: %u items, avg latency: %llu ns, max latency: %llu ns\n",
+            HASH_BENCH_ITEMS, total / HASH_BENCH_ITEMS, max);
+    hashDestroy (htbl);
+}
+
 int main (int argc, char *argv[]) {
     int i, cnt;
     hashTablePtr htbl;
@@ -109,6 +263,9 @@ int main (int argc, char *argv[]) {
     printf ("Test hashClean success\n");
 
     hashDestroy (htbl);
+
+    hashBinKeyTest ();
+    hashInsertLatencyBench ();
     printf ("HashTest [Passed]\n");
     return 0;
 }
@@ -0,0 +1,1138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <pcap.h>
+#include "util.h"
+#include "properties.h"
+#include "log.h"
+#include "hash.h"
+#include "ip.h"
+#include "ip6.h"
+#include "tcp.h"
+#include "raw_packet.h"
+#include "ip_packet.h"
+#include "packet_dedup.h"
+#include "tcp_packet.h"
+#include "proto_analyzer.h"
+#include "app_service_manager.h"
+
+/*
+ * Microbenchmarks of packet processing hot paths. Every benchmark is run
+ * BENCH_ROUNDS rounds and the best round is reported as one json object
+ * per line on stdout, like:
+ *
+ * {"name": "hash_lookup_bin/65536", "ops": 1048576, "rounds": 5, "ns_per_op": 21.35, "ops_per_sec": 46838407}
+ *
+ * so results of different commits on the same box can be compared by name.
+ * Usage: ntrace_bench [name_filter]
+ */
+
+/* Config file for properties, defined by build */
+#ifndef NTRACE_BENCH_CONFIG_FILE
+#define NTRACE_BENCH_CONFIG_FILE "config/ntrace.conf"
+#endif
+
+/* Rounds of each benchmark, the best round is reported */
+#define BENCH_ROUNDS 5
+/* Min operations of each round for small inputs */
+#define BENCH_MIN_OPS (1 << 20)
+/* Distinct packets of each packet level benchmark */
+#define BENCH_PACKETS 1024
+/* Synthetic tcp flows in flight of tcpProcess benchmark */
+#define BENCH_TCP_FLOWS 4096
+/* Packets of each synthetic tcp flow */
+#define BENCH_TCP_FLOW_PACKETS 9
+/* Request/response exchanges of each proto analyzer round */
+#define BENCH_SESSIONS 100000
+/* Payload size of fragmented ip packet */
+#define BENCH_FRAG_PAYLOAD_SIZE 4000
+/* Data size of ip fragment, must be multiple of 8 */
+#define BENCH_FRAG_SIZE 1480
+#define BENCH_FRAME_SIZE 2048
+
+#define BENCH_SERVICE_IP "10.255.0.1"
+#define BENCH_SERVICE_IP6 "fd00::1"
+#define BENCH_HTTP_PORT 80
+#define BENCH_MYSQL_PORT 3306
+
+/* Tcp flags of synthetic tcp packet */
+#define BENCH_TCP_FIN 0x01
+#define BENCH_TCP_SYN 0x02
+#define BENCH_TCP_RST 0x04
+#define BENCH_TCP_PSH 0x08
+#define BENCH_TCP_ACK 0x10
+
+typedef u_long_long (*benchRoundCB) (void *args);
+
+typedef struct _benchPayload benchPayload;
+typedef benchPayload *benchPayloadPtr;
+
+/* Recorded payload of one direction */
+struct _benchPayload {
+    streamDirection direction;          /**< Payload direction */
+    u_char *data;                       /**< Payload data */
+    u_int len;                          /**< Payload length */
+};
+
+typedef struct _benchRecording benchRecording;
+typedef benchRecording *benchRecordingPtr;
+
+/* Recorded payloads of one proto */
+struct _benchRecording {
+    char *proto;                        /**< Proto name */
+    benchPayloadPtr setup;              /**< Payloads before exchange, like handshake */
+    u_int setupNum;                     /**< Setup payloads number */
+    benchPayloadPtr exchange;           /**< Payloads of one request/response exchange */
+    u_int exchangeNum;                  /**< Exchange payloads number */
+};
+
+typedef struct _benchPackets benchPackets;
+typedef benchPackets *benchPacketsPtr;
+
+/* Packets packed in one buffer */
+struct _benchPackets {
+    u_char *buf;                        /**< Packets buffer */
+    u_int size;                         /**< Packets buffer size */
+    u_int used;                         /**< Packets buffer used */
+    u_int *offsets;                     /**< Packet offsets in buffer */
+    ipPktInfo *infos;                   /**< Packet infos */
+    u_int num;                          /**< Packets number */
+    u_int limit;                        /**< Max packets number */
+};
+
+typedef struct _benchHashArgs benchHashArgs;
+typedef benchHashArgs *benchHashArgsPtr;
+
+struct _benchHashArgs {
+    u_int size;                         /**< Hash table items */
+    u_int reps;                         /**< Repeats of inserting all items */
+    boolean binKey;                     /**< Binary tuple4 key or string key */
+    char (*strKeys) [32];               /**< String keys */
+    tuple4Ptr binKeys;                  /**< Binary keys */
+    hashTablePtr htbl;                  /**< Hash table for lookup */
+};
+
+typedef struct _benchPacketArgs benchPacketArgs;
+typedef benchPacketArgs *benchPacketArgsPtr;
+
+struct _benchPacketArgs {
+    benchPacketsPtr pkts;               /**< Packets to process */
+    u_int datalinkType;                 /**< Datalink type of frames */
+    u_int reps;                         /**< Repeats of processing all packets */
+    u_int round;                        /**< Round number */
+};
+
+typedef struct _benchAnalyzerArgs benchAnalyzerArgs;
+typedef benchAnalyzerArgs *benchAnalyzerArgsPtr;
+
+struct _benchAnalyzerArgs {
+    protoAnalyzerPtr analyzer;          /**< Proto analyzer */
+    benchRecordingPtr recording;        /**< Recorded payloads */
+    u_long_long sessions;               /**< Sessions done in last round */
+};
+
+typedef struct _benchDetectArgs benchDetectArgs;
+typedef benchDetectArgs *benchDetectArgsPtr;
+
+struct _benchDetectArgs {
+    benchPayloadPtr payload;            /**< Payload to detect */
+};
+
+/* Benchmark name filter */
+static char *benchFilter = NULL;
+
+/* Sink of benchmark results to keep them from being optimized out */
+static volatile u_long_long benchSink;
+
+/* Analysis records published by tcpProcess */
+static u_long_long benchTcpRecords;
+
+/* App services of benchmark and its lock */
+static hashTablePtr benchAppServices = NULL;
+static pthread_rwlock_t benchAppServicesRWLock;
+
+/*=============================Recorded payloads=============================*/
+
+static char httpRequest [] =
+        "GET /api/v1/orders?customer=1024&limit=20 HTTP/1.1\r\n"
+        "Host: shop.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+        "Accept: application/json\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+
+static char httpResponse [] =
+        "HTTP/1.1 200 OK\r\n"
+        "Server: nginx/1.10.1\r\n"
+        "Date: Mon, 04 Jul 2016 08:00:00 GMT\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 256\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n"
+        "{\"orders\":[{\"id\":1,\"status\":\"paid\",\"amount\":100},"
+        "{\"id\":2,\"status\":\"paid\",\"amount\":200},"
+        "{\"id\":3,\"status\":\"shipped\",\"amount\":300},"
+        "{\"id\":4,\"status\":\"shipped\",\"amount\":400},"
+        "{\"id\":5,\"status\":\"done\",\"amount\":500}],\"total\":5,\"more\":false}"
+        "                         ";
+
+/* Mysql v10 initial handshake with mysql_native_password */
+static u_char mysqlServerHandshake [] = {
+    0x4a, 0x00, 0x00, 0x00, 0x0a, 0x35, 0x2e, 0x37, 0x2e, 0x33, 0x30, 0x00,
+    0x08, 0x00, 0x00, 0x00, 0x3b, 0x1e, 0x52, 0x2f, 0x0d, 0x35, 0x5f, 0x37,
+    0x00, 0xff, 0xf7, 0x21, 0x02, 0x00, 0xff, 0x81, 0x15, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x1d, 0x49, 0x4d, 0x6c,
+    0x3f, 0x61, 0x7b, 0x2e, 0x3c, 0x54, 0x6a, 0x00, 0x6d, 0x79, 0x73, 0x71,
+    0x6c, 0x5f, 0x6e, 0x61, 0x74, 0x69, 0x76, 0x65, 0x5f, 0x70, 0x61, 0x73,
+    0x73, 0x77, 0x6f, 0x72, 0x64, 0x00
+};
+
+/* Mysql handshake response 41 of user "bench" */
+static u_char mysqlClientHandshake [] = {
+    0x51, 0x00, 0x00, 0x01, 0x05, 0xa2, 0x08, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x62, 0x65, 0x6e, 0x63, 0x68, 0x00, 0x14, 0x8c, 0x3a, 0x5e, 0x21, 0x70,
+    0x0e, 0x6b, 0x44, 0x19, 0x93, 0x2d, 0x57, 0xa0, 0x7f, 0x12, 0x66, 0x38,
+    0x4b, 0xc1, 0x09, 0x6d, 0x79, 0x73, 0x71, 0x6c, 0x5f, 0x6e, 0x61, 0x74,
+    0x69, 0x76, 0x65, 0x5f, 0x70, 0x61, 0x73, 0x73, 0x77, 0x6f, 0x72, 0x64,
+    0x00
+};
+
+/* Mysql ok of handshake */
+static u_char mysqlServerOk [] = {
+    0x07, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00
+};
+
+/* Mysql COM_QUERY "select id, name from users where id = 1" */
+static u_char mysqlQuery [] = {
+    0x28, 0x00, 0x00, 0x00, 0x03, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x20,
+    0x69, 0x64, 0x2c, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x20, 0x66, 0x72, 0x6f,
+    0x6d, 0x20, 0x75, 0x73, 0x65, 0x72, 0x73, 0x20, 0x77, 0x68, 0x65, 0x72,
+    0x65, 0x20, 0x69, 0x64, 0x20, 0x3d, 0x20, 0x31
+};
+
+/* Mysql text result set of 2 columns and 1 row */
+static u_char mysqlResultSet [] = {
+    /* Column count */
+    0x01, 0x00, 0x00, 0x01, 0x02,
+    /* Column definition of id */
+    0x28, 0x00, 0x00, 0x02, 0x03, 0x64, 0x65, 0x66, 0x04, 0x74, 0x65, 0x73,
+    0x74, 0x05, 0x75, 0x73, 0x65, 0x72, 0x73, 0x05, 0x75, 0x73, 0x65, 0x72,
+    0x73, 0x02, 0x69, 0x64, 0x02, 0x69, 0x64, 0x0c, 0x3f, 0x00, 0x0b, 0x00,
+    0x00, 0x00, 0x03, 0x03, 0x42, 0x00, 0x00, 0x00,
+    /* Column definition of name */
+    0x2c, 0x00, 0x00, 0x03, 0x03, 0x64, 0x65, 0x66, 0x04, 0x74, 0x65, 0x73,
+    0x74, 0x05, 0x75, 0x73, 0x65, 0x72, 0x73, 0x05, 0x75, 0x73, 0x65, 0x72,
+    0x73, 0x04, 0x6e, 0x61, 0x6d, 0x65, 0x04, 0x6e, 0x61, 0x6d, 0x65, 0x0c,
+    0x21, 0x00, 0xfd, 0x02, 0x00, 0x00, 0xfd, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* EOF of column definitions */
+    0x05, 0x00, 0x00, 0x04, 0xfe, 0x00, 0x00, 0x02, 0x00,
+    /* Row */
+    0x08, 0x00, 0x00, 0x05, 0x01, 0x31, 0x05, 0x61, 0x6c, 0x69, 0x63, 0x65,
+    /* EOF of rows */
+    0x05, 0x00, 0x00, 0x06, 0xfe, 0x00, 0x00, 0x02, 0x00
+};
+
+static u_char unknownPayload [] = {
+    0x17, 0x03, 0x03, 0x00, 0x40, 0x8a, 0x1f, 0x3c, 0x90, 0x5e, 0x71, 0x02,
+    0xd4, 0x66, 0xb8, 0x2a, 0x0c, 0xe3, 0x45, 0x19, 0x7d, 0xa6, 0x3b, 0xf0,
+    0x58, 0x11, 0x9c, 0x74, 0x2e, 0x87, 0xc5, 0x0a, 0x63, 0xfd, 0x39, 0x4e
+};
+
+static benchPayload httpExchange [] = {
+    {STREAM_FROM_CLIENT, (u_char *) httpRequest, sizeof (httpRequest) - 1},
+    {STREAM_FROM_SERVER, (u_char *) httpResponse, sizeof (httpResponse) - 1}
+};
+
+static benchPayload mysqlSetup [] = {
+    {STREAM_FROM_SERVER, mysqlServerHandshake, sizeof (mysqlServerHandshake)},
+    {STREAM_FROM_CLIENT, mysqlClientHandshake, sizeof (mysqlClientHandshake)},
+    {STREAM_FROM_SERVER, mysqlServerOk, sizeof (mysqlServerOk)}
+};
+
+static benchPayload mysqlExchange [] = {
+    {STREAM_FROM_CLIENT, mysqlQuery, sizeof (mysqlQuery)},
+    {STREAM_FROM_SERVER, mysqlResultSet, sizeof (mysqlResultSet)}
+};
+
+static benchPayload unknownExchange [] = {
+    {STREAM_FROM_CLIENT, unknownPayload, sizeof (unknownPayload)}
+};
+
+/* Recordings of proto analyzers, the last one is for other proto analyzers */
+static benchRecording benchRecordings [] = {
+    {"HTTP", NULL, 0, httpExchange, TABLE_SIZE (httpExchange)},
+    {"MYSQL", mysqlSetup, TABLE_SIZE (mysqlSetup), mysqlExchange, TABLE_SIZE (mysqlExchange)},
+    {NULL, NULL, 0, httpExchange, TABLE_SIZE (httpExchange)}
+};
+
+/*==========================Fake app service manager=========================*/
+
+/* Hash items of benchmark are not owned by hash table */
+static void
+benchItemFree (void *data) {
+    return;
+}
+
+/*
+ * App service manager is faked so that no app service cache is loaded or
+ * synced by benchmark, services lookup mirrors the real one.
+ */
+protoAnalyzerPtr
+getAppServiceProtoAnalyzer (char *ip, u_short port) {
+    char key [64];
+    protoAnalyzerPtr analyzer;
+
+    snprintf (key, sizeof (key), "%s:%u", ip, port);
+    pthread_rwlock_rdlock (&benchAppServicesRWLock);
+    analyzer = (protoAnalyzerPtr) hashLookup (benchAppServices, key);
+    pthread_rwlock_unlock (&benchAppServicesRWLock);
+
+    return analyzer;
+}
+
+appServicePtr
+getAppServiceDetected (char *ip, u_short port) {
+    return NULL;
+}
+
+appServicePtr
+getAppServiceFromBlacklist (char *ip, u_short port) {
+    return NULL;
+}
+
+int
+addAppServiceDetected (char *ip, u_short port, char *proto) {
+    return 0;
+}
+
+static void
+benchAddAppService (char *ip, u_short port, char *proto) {
+    int ret;
+    char key [64];
+    protoAnalyzerPtr analyzer;
+
+    analyzer = getProtoAnalyzer (proto);
+    if (analyzer == NULL)
+        return;
+
+    snprintf (key, sizeof (key), "%s:%u", ip, port);
+    ret = hashInsert (benchAppServices, key, analyzer, benchItemFree);
+    assert (!ret);
+}
+
+/*================================Framework==================================*/
+
+static boolean
+benchEnabled (const char *name) {
+    return benchFilter == NULL || strstr (name, benchFilter) != NULL;
+}
+
+static void
+benchReport (const char *name, u_long_long ops, u_long_long bestTime) {
+    double nsPerOp;
+
+    nsPerOp = ops ? (double) bestTime / ops : 0;
+    printf ("{\"name\": \"%s\", \"ops\": %llu, \"rounds\": %u, "
+            "\"ns_per_op\": %.2f, \"ops_per_sec\": %.0f}\n",
+            name, ops, BENCH_ROUNDS, nsPerOp, nsPerOp > 0 ? 1000000000.0 / nsPerOp : 0);
+    fflush (stdout);
+}
+
+/* Run benchmark rounds and report the best round */
+static void
+benchRun (const char *name, u_long_long ops, benchRoundCB fun, void *args) {
+    u_int i;
+    u_long_long elapsed, best = 0;
+
+    for (i = 0; i < BENCH_ROUNDS; i++) {
+        elapsed = (*fun) (args);
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    benchReport (name, ops, best);
+}
+
+/*=============================Synthetic packets=============================*/
+
+static benchPacketsPtr
+benchPacketsNew (u_int limit, u_int size) {
+    benchPacketsPtr pkts;
+
+    pkts = (benchPacketsPtr) calloc (1, sizeof (benchPackets));
+    assert (pkts);
+    pkts->buf = (u_char *) malloc (size);
+    pkts->offsets = (u_int *) malloc (limit * sizeof (u_int));
+    pkts->infos = (ipPktInfo *) malloc (limit * sizeof (ipPktInfo));
+    assert (pkts->buf && pkts->offsets && pkts->infos);
+    pkts->size = size;
+    pkts->limit = limit;
+
+    return pkts;
+}
+
+static void
+benchPacketsFree (benchPacketsPtr pkts) {
+    free (pkts->buf);
+    free (pkts->offsets);
+    free (pkts->infos);
+    free (pkts);
+}
+
+static u_char *
+benchPacketsAt (benchPacketsPtr pkts, u_int index) {
+    return pkts->buf + pkts->offsets [index];
+}
+
+/* Reserve buffer for next packet, packets are 8 bytes aligned */
+static u_char *
+benchPacketsReserve (benchPacketsPtr pkts, u_int len) {
+    u_char *pkt;
+
+    assert (pkts->num < pkts->limit && pkts->used + len <= pkts->size);
+    pkt = pkts->buf + pkts->used;
+    memset (pkt, 0, len);
+    pkts->offsets [pkts->num] = pkts->used;
+    pkts->used += (len + 7) & ~7;
+    pkts->num++;
+
+    return pkt;
+}
+
+static void
+benchTcpHeaderInit (tcphdrPtr tcph, u_short sport, u_short dport,
+                    u_int seq, u_int ackSeq, u_char flags) {
+    tcph->source = htons (sport);
+    tcph->dest = htons (dport);
+    tcph->seq = htonl (seq);
+    tcph->ackSeq = htonl (ackSeq);
+    tcph->doff = sizeof (tcphdr) / 4;
+    tcph->fin = (flags & BENCH_TCP_FIN) ? 1 : 0;
+    tcph->syn = (flags & BENCH_TCP_SYN) ? 1 : 0;
+    tcph->rst = (flags & BENCH_TCP_RST) ? 1 : 0;
+    tcph->psh = (flags & BENCH_TCP_PSH) ? 1 : 0;
+    tcph->ack = (flags & BENCH_TCP_ACK) ? 1 : 0;
+    tcph->window = htons (65535);
+}
+
+/* Build ipv4 tcp packet at buf, return packet length */
+static u_int
+benchBuildTcp4 (u_char *buf, u_int saddr, u_int daddr, u_short sport, u_short dport,
+                u_int seq, u_int ackSeq, u_char flags, u_char *data, u_int dataLen) {
+    iphdrPtr iph = (iphdrPtr) buf;
+
+    iph->ipVer = 4;
+    iph->iphLen = sizeof (iphdr) / 4;
+    iph->ipLen = htons (sizeof (iphdr) + sizeof (tcphdr) + dataLen);
+    iph->ipTTL = 64;
+    iph->ipProto = IPPROTO_TCP;
+    iph->ipSrc.s_addr = htonl (saddr);
+    iph->ipDest.s_addr = htonl (daddr);
+    benchTcpHeaderInit ((tcphdrPtr) (buf + sizeof (iphdr)), sport, dport, seq, ackSeq, flags);
+    if (dataLen)
+        memcpy (buf + sizeof (iphdr) + sizeof (tcphdr), data, dataLen);
+
+    return sizeof (iphdr) + sizeof (tcphdr) + dataLen;
+}
+
+/* Build ipv6 tcp packet at buf, return packet length */
+static u_int
+benchBuildTcp6 (u_char *buf, u_int saddr, char *daddr, u_short sport, u_short dport,
+                u_int seq, u_int ackSeq, u_char flags, u_char *data, u_int dataLen) {
+    int ret;
+    ip6hdrPtr ip6h = (ip6hdrPtr) buf;
+
+    ip6h->ip6Flow = htonl (6 << 28);
+    ip6h->ip6PayloadLen = htons (sizeof (tcphdr) + dataLen);
+    ip6h->ip6NextHeader = IPPROTO_TCP;
+    ip6h->ip6HopLimit = 64;
+    ret = inet_pton (AF_INET6, "fd00::", &ip6h->ip6Src);
+    assert (ret == 1);
+    memcpy (&ip6h->ip6Src.s6_addr [12], &saddr, sizeof (saddr));
+    ret = inet_pton (AF_INET6, daddr, &ip6h->ip6Dest);
+    assert (ret == 1);
+    benchTcpHeaderInit ((tcphdrPtr) (buf + IP6_HEADER_LEN), sport, dport, seq, ackSeq, flags);
+    if (dataLen)
+        memcpy (buf + IP6_HEADER_LEN + sizeof (tcphdr), data, dataLen);
+
+    return IP6_HEADER_LEN + sizeof (tcphdr) + dataLen;
+}
+
+/* Build http request packets of different clients to service */
+static benchPacketsPtr
+benchBuildRequests (boolean ip6) {
+    int ret;
+    u_int i, len;
+    u_char *pkt;
+    u_char tmp [BENCH_FRAME_SIZE];
+    benchPacketsPtr pkts;
+
+    pkts = benchPacketsNew (BENCH_PACKETS, BENCH_PACKETS * BENCH_FRAME_SIZE);
+    for (i = 0; i < BENCH_PACKETS; i++) {
+        if (ip6)
+            len = benchBuildTcp6 (tmp, htonl (i + 1), BENCH_SERVICE_IP6,
+                                  10000 + i, BENCH_HTTP_PORT, i, i, BENCH_TCP_ACK | BENCH_TCP_PSH,
+                                  (u_char *) httpRequest, sizeof (httpRequest) - 1);
+        else
+            len = benchBuildTcp4 (tmp, 0x0a000001 + i, ntohl (inet_addr (BENCH_SERVICE_IP)),
+                                  10000 + i, BENCH_HTTP_PORT, i, i, BENCH_TCP_ACK | BENCH_TCP_PSH,
+                                  (u_char *) httpRequest, sizeof (httpRequest) - 1);
+        pkt = benchPacketsReserve (pkts, len);
+        memcpy (pkt, tmp, len);
+        ret = getIpPktInfo ((iphdrPtr) pkt, &pkts->infos [i]);
+        assert (!ret);
+    }
+
+    return pkts;
+}
+
+/* Build frames of request packets with ether or 802.1Q header */
+static benchPacketsPtr
+benchBuildFrames (benchPacketsPtr requests, boolean ip6, boolean vlan) {
+    u_int i, len, hdrLen;
+    u_char *frame;
+    benchPacketsPtr frames;
+
+    frames = benchPacketsNew (BENCH_PACKETS, BENCH_PACKETS * BENCH_FRAME_SIZE);
+    hdrLen = vlan ? 18 : 14;
+    for (i = 0; i < requests->num; i++) {
+        len = getIpPktLen ((iphdrPtr) benchPacketsAt (requests, i));
+        frame = benchPacketsReserve (frames, hdrLen + len);
+        memset (frame, 0x02, 12);
+        if (vlan) {
+            frame [12] = 0x81;
+            frame [13] = 0x00;
+            frame [15] = 0x64;
+        }
+        frame [hdrLen - 2] = ip6 ? 0x86 : 0x08;
+        frame [hdrLen - 1] = ip6 ? 0xDD : 0x00;
+        memcpy (frame + hdrLen, benchPacketsAt (requests, i), len);
+    }
+
+    return frames;
+}
+
+/* Build ipv4 fragments of tcp packets with BENCH_FRAG_PAYLOAD_SIZE data */
+static benchPacketsPtr
+benchBuildFragments (void) {
+    u_int i, offset, len, fragLen;
+    u_char *frag;
+    u_char data [BENCH_FRAG_PAYLOAD_SIZE];
+    u_char tmp [sizeof (iphdr) + sizeof (tcphdr) + BENCH_FRAG_PAYLOAD_SIZE];
+    iphdrPtr iph, fragIph;
+    benchPacketsPtr pkts;
+    u_int fragsNum = (sizeof (tcphdr) + BENCH_FRAG_PAYLOAD_SIZE + BENCH_FRAG_SIZE - 1) / BENCH_FRAG_SIZE;
+
+    memset (data, 'x', sizeof (data));
+    pkts = benchPacketsNew (BENCH_PACKETS * fragsNum,
+                            BENCH_PACKETS * fragsNum * (sizeof (iphdr) + BENCH_FRAG_SIZE + 8));
+    for (i = 0; i < BENCH_PACKETS; i++) {
+        len = benchBuildTcp4 (tmp, 0x0a000001 + i, ntohl (inet_addr (BENCH_SERVICE_IP)),
+                              10000 + i, BENCH_HTTP_PORT, i, i, BENCH_TCP_ACK | BENCH_TCP_PSH,
+                              data, sizeof (data));
+        iph = (iphdrPtr) tmp;
+        iph->ipId = htons (i);
+
+        for (offset = 0; offset < len - sizeof (iphdr); offset += BENCH_FRAG_SIZE) {
+            fragLen = MIN_NUM (BENCH_FRAG_SIZE, len - sizeof (iphdr) - offset);
+            frag = benchPacketsReserve (pkts, sizeof (iphdr) + fragLen);
+            memcpy (frag, tmp, sizeof (iphdr));
+            memcpy (frag + sizeof (iphdr), tmp + sizeof (iphdr) + offset, fragLen);
+
+            fragIph = (iphdrPtr) frag;
+            fragIph->ipLen = htons (sizeof (iphdr) + fragLen);
+            fragIph->ipOff = htons ((offset >> 3) |
+                                    (offset + fragLen < len - sizeof (iphdr) ? IP_MF : 0));
+        }
+    }
+
+    return pkts;
+}
+
+/*
+ * Build packets of synthetic http flows, every flow has handshake, one
+ * request/response exchange and close. Packets of all flows are
+ * interleaved step by step like flows in flight.
+ */
+static benchPacketsPtr
+benchBuildTcpFlows (u_int round) {
+    u_int i, step, len;
+    u_int client, server;
+    u_int cseq, sseq, reqLen, respLen;
+    u_short sport;
+    u_char *pkt;
+    u_char tmp [BENCH_FRAME_SIZE];
+    benchPacketsPtr pkts;
+
+    reqLen = sizeof (httpRequest) - 1;
+    respLen = sizeof (httpResponse) - 1;
+    server = ntohl (inet_addr (BENCH_SERVICE_IP));
+    pkts = benchPacketsNew (BENCH_TCP_FLOWS * BENCH_TCP_FLOW_PACKETS,
+                            BENCH_TCP_FLOWS * (BENCH_TCP_FLOW_PACKETS * 72 + reqLen + respLen));
+
+    for (step = 0; step < BENCH_TCP_FLOW_PACKETS; step++) {
+        for (i = 0; i < BENCH_TCP_FLOWS; i++) {
+            /* Flows of each round have different clients */
+            client = 0x0a000000 | ((round & 0x7f) << 16) | (i + 1);
+            sport = 10000 + i;
+            cseq = i * 7919;
+            sseq = i * 104729;
+
+            switch (step) {
+                case 0:
+                    len = benchBuildTcp4 (tmp, client, server, sport, BENCH_HTTP_PORT,
+                                          cseq, 0, BENCH_TCP_SYN, NULL, 0);
+                    break;
+
+                case 1:
+                    len = benchBuildTcp4 (tmp, server, client, BENCH_HTTP_PORT, sport,
+                                          sseq, cseq + 1, BENCH_TCP_SYN | BENCH_TCP_ACK, NULL, 0);
+                    break;
+
+                case 2:
+                    len = benchBuildTcp4 (tmp, client, server, sport, BENCH_HTTP_PORT,
+                                          cseq + 1, sseq + 1, BENCH_TCP_ACK, NULL, 0);
+                    break;
+
+                case 3:
+                    len = benchBuildTcp4 (tmp, client, server, sport, BENCH_HTTP_PORT,
+                                          cseq + 1, sseq + 1, BENCH_TCP_ACK | BENCH_TCP_PSH,
+                                          (u_char *) httpRequest, reqLen);
+                    break;
+
+                case 4:
+                    len = benchBuildTcp4 (tmp, server, client, BENCH_HTTP_PORT, sport,
+                                          sseq + 1, cseq + 1 + reqLen, BENCH_TCP_ACK | BENCH_TCP_PSH,
+                                          (u_char *) httpResponse, respLen);
+                    break;
+
+                case 5:
+                    len = benchBuildTcp4 (tmp, client, server, sport, BENCH_HTTP_PORT,
+                                          cseq + 1 + reqLen, sseq + 1 + respLen, BENCH_TCP_ACK,
+                                          NULL, 0);
+                    break;
+
+                case 6:
+                    len = benchBuildTcp4 (tmp, client, server, sport, BENCH_HTTP_PORT,
+                                          cseq + 1 + reqLen, sseq + 1 + respLen,
+                                          BENCH_TCP_FIN | BENCH_TCP_ACK, NULL, 0);
+                    break;
+
+                case 7:
+                    len = benchBuildTcp4 (tmp, server, client, BENCH_HTTP_PORT, sport,
+                                          sseq + 1 + respLen, cseq + 2 + reqLen,
+                                          BENCH_TCP_FIN | BENCH_TCP_ACK, NULL, 0);
+                    break;
+
+                default:
+                    len = benchBuildTcp4 (tmp, client, server, sport, BENCH_HTTP_PORT,
+                                          cseq + 2 + reqLen, sseq + 2 + respLen, BENCH_TCP_ACK,
+                                          NULL, 0);
+                    break;
+            }
+
+            pkt = benchPacketsReserve (pkts, len);
+            memcpy (pkt, tmp, len);
+        }
+    }
+
+    return pkts;
+}
+
+/*===============================Hash table==================================*/
+
+static void
+benchHashKeysInit (benchHashArgsPtr args) {
+    u_int i;
+
+    args->strKeys = malloc (args->size * sizeof (*args->strKeys));
+    args->binKeys = (tuple4Ptr) calloc (args->size, sizeof (tuple4));
+    assert (args->strKeys && args->binKeys);
+
+    for (i = 0; i < args->size; i++) {
+        snprintf (args->strKeys [i], sizeof (args->strKeys [i]), "10.%u.%u.%u:%u",
+                  (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff, 10000 + (i % 50000));
+
+        args->binKeys [i].saddr.family = AF_INET;
+        args->binKeys [i].saddr.u.ip4.s_addr = htonl (0x0a000000 + i);
+        args->binKeys [i].source = 10000 + (i % 50000);
+        args->binKeys [i].daddr.family = AF_INET;
+        args->binKeys [i].daddr.u.ip4.s_addr = inet_addr (BENCH_SERVICE_IP);
+        args->binKeys [i].dest = BENCH_HTTP_PORT;
+    }
+}
+
+static void
+benchHashInsertAll (benchHashArgsPtr args, hashTablePtr htbl) {
+    u_int i;
+
+    for (i = 0; i < args->size; i++) {
+        if (args->binKey)
+            hashInsertBinKey (htbl, &args->binKeys [i], sizeof (tuple4), &args->binKeys [i], benchItemFree);
+        else
+            hashInsert (htbl, args->strKeys [i], args->strKeys [i], benchItemFree);
+    }
+}
+
+static u_long_long
+benchHashInsertRound (void *data) {
+    u_int i;
+    u_long_long start, elapsed = 0;
+    hashTablePtr htbl;
+    benchHashArgsPtr args = (benchHashArgsPtr) data;
+
+    for (i = 0; i < args->reps; i++) {
+        htbl = hashNew (0);
+        assert (htbl);
+
+        start = getMonotonicTime ();
+        benchHashInsertAll (args, htbl);
+        elapsed += getMonotonicTime () - start;
+
+        assert (hashSize (htbl) == args->size);
+        hashDestroy (htbl);
+    }
+
+    return elapsed;
+}
+
+static u_long_long
+benchHashLookupRound (void *data) {
+    u_int i, index;
+    u_long_long start;
+    benchHashArgsPtr args = (benchHashArgsPtr) data;
+
+    start = getMonotonicTime ();
+    for (i = 0; i < args->size * args->reps; i++) {
+        /* Multiplying by odd number permutes indexes of power of 2 size */
+        index = (i * 2654435761U) & (args->size - 1);
+        if (args->binKey)
+            benchSink += (u_long) hashLookupBinKey (args->htbl, &args->binKeys [index],
+                                                    sizeof (tuple4));
+        else
+            benchSink += (u_long) hashLookup (args->htbl, args->strKeys [index]);
+    }
+
+    return getMonotonicTime () - start;
+}
+
+static void
+benchHash (void) {
+    u_int i, j;
+    char name [64];
+    benchHashArgs args;
+    u_int sizes [] = {1024, 65536, 1048576};
+
+    for (i = 0; i < TABLE_SIZE (sizes); i++) {
+        memset (&args, 0, sizeof (args));
+        args.size = sizes [i];
+        args.reps = MAX_NUM (1, BENCH_MIN_OPS / args.size);
+        benchHashKeysInit (&args);
+
+        for (j = 0; j < 2; j++) {
+            args.binKey = j ? True : False;
+
+            snprintf (name, sizeof (name), "hash_insert_%s/%u", j ? "bin" : "str", args.size);
+            if (benchEnabled (name))
+                benchRun (name, (u_long_long) args.size * args.reps, benchHashInsertRound, &args);
+
+            snprintf (name, sizeof (name), "hash_lookup_%s/%u", j ? "bin" : "str", args.size);
+            if (benchEnabled (name)) {
+                args.htbl = hashNew (0);
+                assert (args.htbl);
+                benchHashInsertAll (&args, args.htbl);
+                benchRun (name, (u_long_long) args.size * args.reps, benchHashLookupRound, &args);
+                hashDestroy (args.htbl);
+                args.htbl = NULL;
+            }
+        }
+
+        free (args.strKeys);
+        free (args.binKeys);
+    }
+}
+
+/*=============================Packet processing=============================*/
+
+static u_long_long
+benchDispatchHashRound (void *data) {
+    u_int i, j;
+    u_long_long start;
+    benchPacketArgsPtr args = (benchPacketArgsPtr) data;
+
+    start = getMonotonicTime ();
+    for (i = 0; i < args->reps; i++) {
+        for (j = 0; j < args->pkts->num; j++)
+            benchSink += ipPktDispatchHash ((iphdrPtr) benchPacketsAt (args->pkts, j),
+                                            &args->pkts->infos [j]);
+    }
+
+    return getMonotonicTime () - start;
+}
+
+static u_long_long
+benchGetIpPacketRound (void *data) {
+    u_int i, j;
+    u_long_long start;
+    benchPacketArgsPtr args = (benchPacketArgsPtr) data;
+
+    start = getMonotonicTime ();
+    for (i = 0; i < args->reps; i++) {
+        for (j = 0; j < args->pkts->num; j++)
+            benchSink += (u_long) getIpPacket (benchPacketsAt (args->pkts, j), args->datalinkType);
+    }
+
+    return getMonotonicTime () - start;
+}
+
+static u_long_long
+benchIpDefragRound (void *data) {
+    u_int i, j;
+    u_long_long start;
+    timeVal tm;
+    iphdrPtr iph, newIph;
+    benchPacketArgsPtr args = (benchPacketArgsPtr) data;
+
+    tm.tvSec = htonll (1467619200);
+    tm.tvUsec = 0;
+
+    start = getMonotonicTime ();
+    for (i = 0; i < args->reps; i++) {
+        for (j = 0; j < args->pkts->num; j++) {
+            iph = (iphdrPtr) benchPacketsAt (args->pkts, j);
+            ipDefragProcess (iph, &tm, &newIph);
+            if (newIph) {
+                benchSink += newIph->ipLen;
+                if (newIph != iph)
+                    free (newIph);
+            }
+        }
+    }
+
+    return getMonotonicTime () - start;
+}
+
+static u_long_long
+benchPacketDedupRound (void *data) {
+    u_int i, j;
+    u_long_long start;
+    timeVal tm;
+    benchPacketArgsPtr args = (benchPacketArgsPtr) data;
+
+    tm.tvSec = htonll (1467619200);
+    tm.tvUsec = 0;
+
+    start = getMonotonicTime ();
+    for (i = 0; i < args->reps; i++) {
+        for (j = 0; j < args->pkts->num; j++)
+            benchSink += packetDedupProcess ((iphdrPtr) benchPacketsAt (args->pkts, j),
+                                             &args->pkts->infos [j], &tm);
+    }
+
+    return getMonotonicTime () - start;
+}
+
+static void
+benchIpPackets (void) {
+    int ret;
+    u_int i;
+    benchPacketArgs args;
+    benchPacketsPtr requests, requests6, frames;
+    struct {
+        char *name;
+        boolean ip6;
+        boolean vlan;
+    } frameTypes [] = {
+        {"get_ip_packet/ether_ipv4", False, False},
+        {"get_ip_packet/vlan_ipv4", False, True},
+        {"get_ip_packet/ether_ipv6", True, False}
+    };
+
+    requests = benchBuildRequests (False);
+    requests6 = benchBuildRequests (True);
+    memset (&args, 0, sizeof (args));
+    args.reps = BENCH_MIN_OPS / BENCH_PACKETS;
+
+    if (benchEnabled ("dispatch_hash/ipv4")) {
+        args.pkts = requests;
+        benchRun ("dispatch_hash/ipv4", (u_long_long) args.pkts->num * args.reps,
+                  benchDispatchHashRound, &args);
+    }
+
+    if (benchEnabled ("dispatch_hash/ipv6")) {
+        args.pkts = requests6;
+        benchRun ("dispatch_hash/ipv6", (u_long_long) args.pkts->num * args.reps,
+                  benchDispatchHashRound, &args);
+    }
+
+    for (i = 0; i < TABLE_SIZE (frameTypes); i++) {
+        if (!benchEnabled (frameTypes [i].name))
+            continue;
+
+        frames = benchBuildFrames (frameTypes [i].ip6 ? requests6 : requests,
+                                   frameTypes [i].ip6, frameTypes [i].vlan);
+        args.pkts = frames;
+        args.datalinkType = DLT_EN10MB;
+        benchRun (frameTypes [i].name, (u_long_long) args.pkts->num * args.reps,
+                  benchGetIpPacketRound, &args);
+        benchPacketsFree (frames);
+    }
+
+    if (benchEnabled ("ip_defrag/unfragmented")) {
+        ret = initIpContext (False);
+        assert (!ret);
+        args.pkts = requests;
+        benchRun ("ip_defrag/unfragmented", (u_long_long) args.pkts->num * args.reps,
+                  benchIpDefragRound, &args);
+        destroyIpContext ();
+    }
+
+    if (benchEnabled ("ip_defrag/fragmented")) {
+        ret = initIpContext (False);
+        assert (!ret);
+        args.pkts = benchBuildFragments ();
+        args.reps = MAX_NUM (1, BENCH_MIN_OPS / args.pkts->num);
+        benchRun ("ip_defrag/fragmented", (u_long_long) args.pkts->num * args.reps,
+                  benchIpDefragRound, &args);
+        benchPacketsFree (args.pkts);
+        destroyIpContext ();
+    }
+
+    if (benchEnabled ("packet_dedup/ipv4")) {
+        ret = initPacketDedupContext (10);
+        assert (!ret);
+        args.pkts = requests;
+        args.reps = BENCH_MIN_OPS / BENCH_PACKETS;
+        benchRun ("packet_dedup/ipv4", (u_long_long) args.pkts->num * args.reps,
+                  benchPacketDedupRound, &args);
+        destroyPacketDedupContext ();
+    }
+
+    benchPacketsFree (requests);
+    benchPacketsFree (requests6);
+}
+
+static void
+benchTcpProcessCallback (tcpProcessCallbackArgsPtr callbackArgs) {
+    benchTcpRecords++;
+}
+
+static u_long_long
+benchTcpProcessRound (void *data) {
+    u_int i, step;
+    u_long_long start;
+    timeVal tm;
+    benchPacketsPtr pkts;
+    benchPacketArgsPtr args = (benchPacketArgsPtr) data;
+
+    pkts = benchBuildTcpFlows (args->round++);
+
+    start = getMonotonicTime ();
+    for (i = 0; i < pkts->num; i++) {
+        /* Packets of the same step share timestamp */
+        step = i / BENCH_TCP_FLOWS;
+        tm.tvSec = htonll (1467619200 + args->round);
+        tm.tvUsec = htonll (step * 1000);
+        tcpProcess ((iphdrPtr) benchPacketsAt (pkts, i), &tm);
+    }
+    start = getMonotonicTime () - start;
+
+    resetTcpContext ();
+    benchPacketsFree (pkts);
+
+    return start;
+}
+
+static void
+benchTcpProcess (void) {
+    int ret;
+    benchPacketArgs args;
+
+    if (!benchEnabled ("tcp_process/http_flows"))
+        return;
+
+    memset (&args, 0, sizeof (args));
+    ret = initTcpContext (False, benchTcpProcessCallback);
+    assert (!ret);
+    benchTcpRecords = 0;
+    benchRun ("tcp_process/http_flows",
+              (u_long_long) BENCH_TCP_FLOWS * BENCH_TCP_FLOW_PACKETS,
+              benchTcpProcessRound, &args);
+    if (benchTcpRecords == 0)
+        fprintf (stderr, "Warning: tcp_process/http_flows published no analysis records.\n");
+    destroyTcpContext ();
+}
+
+/*==============================Proto analysis===============================*/
+
+static u_long_long
+benchProtoDetectRound (void *data) {
+    u_int i;
+    u_long_long start;
+    timeVal tm;
+    benchDetectArgsPtr args = (benchDetectArgsPtr) data;
+
+    tm.tvSec = 1467619200;
+    tm.tvUsec = 0;
+
+    start = getMonotonicTime ();
+    for (i = 0; i < BENCH_MIN_OPS; i++)
+        benchSink += (u_long) protoDetect (args->payload->direction, &tm,
+                                           args->payload->data, args->payload->len);
+
+    return getMonotonicTime () - start;
+}
+
+static void
+benchProtoDetect (void) {
+    u_int i;
+    benchDetectArgs args;
+    struct {
+        char *name;
+        benchPayloadPtr payload;
+    } payloads [] = {
+        {"proto_detect/http_request", &httpExchange [0]},
+        {"proto_detect/mysql_handshake", &mysqlSetup [0]},
+        {"proto_detect/unknown", &unknownExchange [0]}
+    };
+
+    for (i = 0; i < TABLE_SIZE (payloads); i++) {
+        if (!benchEnabled (payloads [i].name))
+            continue;
+
+        args.payload = payloads [i].payload;
+        benchRun (payloads [i].name, BENCH_MIN_OPS, benchProtoDetectRound, &args);
+    }
+}
+
+static void
+benchAnalyzerFeed (protoAnalyzerPtr analyzer, void *sd, benchPayloadPtr payload,
+                   timeValPtr tm, u_long_long *sessions) {
+    int ret;
+    void *sbd;
+    sessionState state = SESSION_ACTIVE;
+
+    benchSink += (*analyzer->sessionProcessData) (payload->direction, payload->data,
+                                                  payload->len, tm, sd, &state);
+    if (state == SESSION_DONE) {
+        /* Generate session breakdown like tcp packet processor */
+        sbd = (*analyzer->newSessionBreakdown) ();
+        if (sbd) {
+            ret = (*analyzer->generateSessionBreakdown) (sd, sbd);
+            if (ret == 0)
+                (*sessions)++;
+            (*analyzer->freeSessionBreakdown) (sbd);
+        }
+    }
+}
+
+static u_long_long
+benchAnalyzerRound (void *data) {
+    u_int i, j;
+    u_long_long start, elapsed;
+    u_long_long setupSessions = 0;
+    void *sd;
+    timeVal tm;
+    benchAnalyzerArgsPtr args = (benchAnalyzerArgsPtr) data;
+    protoAnalyzerPtr analyzer = args->analyzer;
+    benchRecordingPtr recording = args->recording;
+
+    tm.tvSec = 1467619200;
+    tm.tvUsec = 0;
+
+    sd = (*analyzer->newSessionDetail) ();
+    assert (sd);
+    (*analyzer->sessionProcessEstb) (&tm, sd);
+    for (i = 0; i < recording->setupNum; i++)
+        benchAnalyzerFeed (analyzer, sd, &recording->setup [i], &tm, &setupSessions);
+
+    args->sessions = 0;
+    start = getMonotonicTime ();
+    for (i = 0; i < BENCH_SESSIONS; i++) {
+        for (j = 0; j < recording->exchangeNum; j++)
+            benchAnalyzerFeed (analyzer, sd, &recording->exchange [j], &tm, &args->sessions);
+    }
+    elapsed = getMonotonicTime () - start;
+
+    (*analyzer->freeSessionDetail) (sd);
+
+    return elapsed;
+}
+
+static void
+benchAnalyzers (void) {
+    int ret;
+    u_int i, j;
+    char name [64];
+    protoAnalyzerInfo info;
+    benchAnalyzerArgs args;
+
+    ret = getProtoAnalyzerInfo (&info);
+    assert (!ret);
+
+    for (i = 0; i < info.protoNum; i++) {
+        snprintf (name, sizeof (name), "analyzer/%s", info.protos [i]);
+        if (!benchEnabled (name))
+            continue;
+
+        args.analyzer = getProtoAnalyzer (info.protos [i]);
+        assert (args.analyzer);
+        for (j = 0; j < TABLE_SIZE (benchRecordings) - 1; j++) {
+            if (strEqual (benchRecordings [j].proto, info.protos [i]))
+                break;
+        }
+        args.recording = &benchRecordings [j];
+
+        benchRun (name, BENCH_SESSIONS, benchAnalyzerRound, &args);
+        if (benchRecordings [j].proto && args.sessions != BENCH_SESSIONS)
+            fprintf (stderr, "Warning: %s completed %llu of %u sessions.\n",
+                     name, args.sessions, BENCH_SESSIONS);
+    }
+}
+
+int
+main (int argc, char *argv []) {
+    int ret;
+
+    if (argc > 1)
+        benchFilter = argv [1];
+
+    /*
+     * Log context of error level, debug and trace logs of packet
+     * processing paths are checked and skipped like running ntrace.
+     */
+    ret = initProperties (NTRACE_BENCH_CONFIG_FILE);
+    assert (!ret);
+    ret = initLogContext (LOG_ERR_LEVEL);
+    assert (!ret);
+
+    ret = initProtoAnalyzer ();
+    assert (!ret);
+
+    ret = pthread_rwlock_init (&benchAppServicesRWLock, NULL);
+    assert (!ret);
+    benchAppServices = hashNew (0);
+    assert (benchAppServices);
+    benchAddAppService (BENCH_SERVICE_IP, BENCH_HTTP_PORT, "HTTP");
+    benchAddAppService (BENCH_SERVICE_IP6, BENCH_HTTP_PORT, "HTTP");
+    benchAddAppService (BENCH_SERVICE_IP, BENCH_MYSQL_PORT, "MYSQL");
+
+    benchHash ();
+    benchIpPackets ();
+    benchTcpProcess ();
+    benchProtoDetect ();
+    benchAnalyzers ();
+
+    hashDestroy (benchAppServices);
+    pthread_rwlock_destroy (&benchAppServicesRWLock);
+    destroyProtoAnalyzer ();
+    destroyLogContext ();
+    destroyProperties ();
+
+    return 0;
+}
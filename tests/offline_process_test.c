@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <pcap.h>
+#include <czmq.h>
+#include "util.h"
+#include "properties.h"
+#include "metrics.h"
+#include "zmq_hub.h"
+#include "netdev.h"
+#include "task_manager.h"
+#include "proto_analyzer.h"
+#include "topology_manager.h"
+#include "app_service_manager.h"
+#include "offline_process_service.h"
+
+/* Generated traffic, with fragments, reordering, loss and syn flood */
+#define OFFLINE_TEST_GEN_OPTIONS "-c 500 -S 8 -f 2000 -n 6000 -L 16 -l 1 -o 2 -F 5 -y 2"
+/* Parallel threads number compared with single thread */
+#define OFFLINE_TEST_PARALLEL_THREADS 4
+/* Channel of analysis records published by offline process service */
+#define OFFLINE_TEST_RECORDS_CHANNEL "inproc://offlineProcessTestRecords"
+
+static zctx_t *recordsCtxt = NULL;
+static void *recordsSendSock = NULL;
+static volatile boolean offlineProcessComplete = False;
+
+/* Application services are resolved by well-known ports of generator */
+protoAnalyzerPtr
+getAppServiceProtoAnalyzer (char *ip, u_short port) {
+    if (port == 80)
+        return getProtoAnalyzer ("HTTP");
+    else if (port == 3306)
+        return getProtoAnalyzer ("MYSQL");
+    else
+        return NULL;
+}
+
+appServicePtr
+getAppServiceDetected (char *ip, u_short port) {
+    return NULL;
+}
+
+appServicePtr
+getAppServiceFromBlacklist (char *ip, u_short port) {
+    return NULL;
+}
+
+int
+addAppServiceDetected (char *ip, u_short port, char *proto) {
+    return 0;
+}
+
+/* All records are published from offline process service thread */
+void *
+getTcpBreakdownSendSock (u_int index) {
+    return recordsSendSock;
+}
+
+void *
+getIcmpErrorSendSock (void) {
+    return recordsSendSock;
+}
+
+void *
+getTopologyEntrySendSock (void) {
+    return recordsSendSock;
+}
+
+void *
+getAppServiceSendSock (void) {
+    return recordsSendSock;
+}
+
+u_int
+getTcpProcessThreadsNum (void) {
+    return OFFLINE_TEST_PARALLEL_THREADS;
+}
+
+int
+getNetDevDatalinkTypeForSniff (u_int index) {
+    return DLT_EN10MB;
+}
+
+void
+sendTaskStatus (taskStatus status) {
+    assert (status == TASK_STATUS_COMPLETE);
+    offlineProcessComplete = True;
+}
+
+void
+displayTaskSchedPolicyInfo (char *taskName) {
+    return;
+}
+
+static void
+writeConfigFile (char *configFile, char *dir, char *pcapFile, u_int threads) {
+    FILE *fp;
+
+    fp = fopen (configFile, "w");
+    assert (fp);
+    fprintf (fp,
+             "[default]\n"
+             "daemonMode = false\n"
+             "[schedulePolicy]\n"
+             "priority = 0\n"
+             "[managementService]\n"
+             "port = 53001\n"
+             "[offlineInput]\n"
+             "pcapFile = %s\n"
+             "parallelThreads = %u\n"
+             "mergedOutput = true\n"
+             "[packetDedup]\n"
+             "window = 5\n"
+             "[log]\n"
+             "logDir = %s\n"
+             "logFileName = ntrace.log\n"
+             "logLevel = 0\n",
+             pcapFile, threads, dir);
+    fclose (fp);
+}
+
+/* Run offline process service and write records it published to outputFile */
+static int
+runOfflineProcess (char *configFile, char *outputFile) {
+    int ret;
+    FILE *fp;
+    zframe_t *frame;
+    pthread_t tid;
+    zmq_pollitem_t items [1];
+
+    ret = initProperties (configFile);
+    assert (!ret);
+    ret = initMetrics ();
+    assert (!ret);
+    ret = initMetricsContext ("OfflineProcessTest");
+    assert (!ret);
+    ret = initProtoAnalyzer ();
+    assert (!ret);
+    ret = initTopologyManager ();
+    assert (!ret);
+    assert (offlineProcessEnabled ());
+
+    recordsCtxt = zctx_new ();
+    assert (recordsCtxt);
+    items [0].socket = zsocket_new (recordsCtxt, ZMQ_PULL);
+    assert (items [0].socket);
+    zsocket_set_rcvhwm (items [0].socket, 0);
+    ret = zsocket_bind (items [0].socket, OFFLINE_TEST_RECORDS_CHANNEL);
+    assert (!ret);
+    recordsSendSock = zsocket_new (recordsCtxt, ZMQ_PUSH);
+    assert (recordsSendSock);
+    zsocket_set_sndhwm (recordsSendSock, 0);
+    ret = zsocket_connect (recordsSendSock, OFFLINE_TEST_RECORDS_CHANNEL);
+    assert (!ret);
+    items [0].events = ZMQ_POLLIN;
+
+    fp = fopen (outputFile, "w");
+    assert (fp);
+
+    ret = pthread_create (&tid, NULL, offlineProcessService, NULL);
+    assert (!ret);
+
+    /* Offline process service completes after all records are consumed */
+    while (!offlineProcessComplete) {
+        ret = zmq_poll (items, 1, 10 * ZMQ_POLL_MSEC);
+        if (ret <= 0)
+            continue;
+
+        /* Skip timestamp frame */
+        frame = zframe_recv (items [0].socket);
+        assert (frame && zframe_more (frame));
+        zframe_destroy (&frame);
+
+        frame = zframe_recv (items [0].socket);
+        assert (frame && !zframe_more (frame));
+        fprintf (fp, "%.*s\n", (int) zframe_size (frame), (char *) zframe_data (frame));
+        zframe_destroy (&frame);
+        METRICS_COUNTER_INC (METRIC_RECORD_QUEUE_DEQUEUED);
+    }
+    pthread_join (tid, NULL);
+
+    fclose (fp);
+    zctx_destroy (&recordsCtxt);
+    return 0;
+}
+
+/* Run offline process in child process, so every run starts from scratch */
+static void
+forkOfflineProcess (char *configFile, char *outputFile) {
+    int status;
+    pid_t pid, ret;
+
+    pid = fork ();
+    assert (pid >= 0);
+    if (pid == 0)
+        _exit (runOfflineProcess (configFile, outputFile));
+
+    ret = waitpid (pid, &status, 0);
+    assert (ret == pid);
+    assert (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+}
+
+static u_long_long
+compareFiles (char *file1, char *file2) {
+    int ch1, ch2;
+    u_long_long lines = 0;
+    FILE *fp1, *fp2;
+
+    fp1 = fopen (file1, "r");
+    assert (fp1);
+    fp2 = fopen (file2, "r");
+    assert (fp2);
+
+    do {
+        ch1 = fgetc (fp1);
+        ch2 = fgetc (fp2);
+        assert (ch1 == ch2);
+        if (ch1 == '\n')
+            lines++;
+    } while (ch1 != EOF);
+
+    fclose (fp1);
+    fclose (fp2);
+    return lines;
+}
+
+/* Records of single thread and parallel threads must be byte-identical */
+static void
+offlineProcessDeterminismTest (char *trafficGen) {
+    int ret;
+    u_long_long records;
+    char dir [] = "/tmp/ntrace_offline_test.XXXXXX";
+    char *tmpDir;
+    char pcapFile [128], configFile [128], output1 [128], outputN [128], cmd [512];
+
+    tmpDir = mkdtemp (dir);
+    assert (tmpDir);
+    snprintf (pcapFile, sizeof (pcapFile), "%s/traffic.pcap", dir);
+    snprintf (configFile, sizeof (configFile), "%s/ntrace.conf", dir);
+    snprintf (output1, sizeof (output1), "%s/records.1", dir);
+    snprintf (outputN, sizeof (outputN), "%s/records.%u", dir, OFFLINE_TEST_PARALLEL_THREADS);
+
+    snprintf (cmd, sizeof (cmd), "%s -w %s %s > /dev/null",
+              trafficGen, pcapFile, OFFLINE_TEST_GEN_OPTIONS);
+    ret = system (cmd);
+    assert (!ret);
+
+    writeConfigFile (configFile, dir, pcapFile, 1);
+    forkOfflineProcess (configFile, output1);
+    writeConfigFile (configFile, dir, pcapFile, OFFLINE_TEST_PARALLEL_THREADS);
+    forkOfflineProcess (configFile, outputN);
+
+    records = compareFiles (output1, outputN);
+    assert (records > 0);
+    printf ("Test %u threads offline process with %llu records success.\n",
+            OFFLINE_TEST_PARALLEL_THREADS, records);
+
+    snprintf (cmd, sizeof (cmd), "rm -rf %s", dir);
+    ret = system (cmd);
+    assert (!ret);
+}
+
+int
+main (int argc, char *argv []) {
+    if (argc != 2) {
+        fprintf (stderr, "Usage: %s <ntrace_traffic_gen>\n", argv [0]);
+        return -1;
+    }
+
+    offlineProcessDeterminismTest (argv [1]);
+
+    printf ("OfflineProcessTest [Passed]\n");
+    return 0;
+}
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <arpa/inet.h>
+#include "util.h"
+#include "ip.h"
+#include "ip6.h"
+#include "tcp.h"
+#include "ip_packet.h"
+#include "packet_dedup.h"
+#include "app_service_manager.h"
+
+/* Dedup window in milliseconds */
+#define DEDUP_TEST_WINDOW 5
+/* Max length of tcp packet built by test */
+#define DEDUP_TEST_PACKET_LENGTH 256
+/* Tcp header length with nop, nop, sack option of one block */
+#define DEDUP_TEST_SACK_TCP_HEADER_LENGTH (sizeof (tcphdr) + 12)
+
+/* Ip packet is resolved by getIpPktInfo only */
+protoAnalyzerPtr
+getAppServiceProtoAnalyzer (char *ip, u_short port) {
+    return NULL;
+}
+
+typedef struct _dedupTestPacket dedupTestPacket;
+typedef dedupTestPacket *dedupTestPacketPtr;
+
+struct _dedupTestPacket {
+    u_char data [DEDUP_TEST_PACKET_LENGTH];
+    u_int hdrLen;                       /**< Ip header length */
+    u_int len;                          /**< Ip packet length */
+};
+
+/* Build tcp ack packet with payload length of payloadLen */
+static void
+buildTcpPacket (dedupTestPacketPtr pkt, boolean ipv6, u_int seq, u_int payloadLen) {
+    iphdrPtr iph;
+    ip6hdrPtr ip6h;
+    tcphdrPtr tcph;
+
+    memset (pkt, 0, sizeof (*pkt));
+    if (ipv6) {
+        pkt->hdrLen = IP6_HEADER_LEN;
+        pkt->len = pkt->hdrLen + sizeof (tcphdr) + payloadLen;
+        ip6h = (ip6hdrPtr) pkt->data;
+        ip6h->ip6Flow = htonl ((6 << 28) | 0x12345);
+        ip6h->ip6PayloadLen = htons (pkt->len - pkt->hdrLen);
+        ip6h->ip6NextHeader = IPPROTO_TCP;
+        ip6h->ip6HopLimit = 64;
+        inet_pton (AF_INET6, "2001:db8::1", &ip6h->ip6Src);
+        inet_pton (AF_INET6, "2001:db8::2", &ip6h->ip6Dest);
+    } else {
+        pkt->hdrLen = sizeof (iphdr);
+        pkt->len = pkt->hdrLen + sizeof (tcphdr) + payloadLen;
+        iph = (iphdrPtr) pkt->data;
+        iph->ipVer = 4;
+        iph->iphLen = pkt->hdrLen / 4;
+        iph->ipLen = htons (pkt->len);
+        iph->ipId = htons (1000);
+        iph->ipTTL = 64;
+        iph->ipProto = IPPROTO_TCP;
+        iph->ipSrc.s_addr = inet_addr ("10.0.0.1");
+        iph->ipDest.s_addr = inet_addr ("10.0.0.2");
+    }
+
+    tcph = (tcphdrPtr) (pkt->data + pkt->hdrLen);
+    tcph->source = htons (40000);
+    tcph->dest = htons (80);
+    tcph->seq = htonl (seq);
+    tcph->ackSeq = htonl (5000);
+    tcph->doff = sizeof (tcphdr) / 4;
+    tcph->ack = 1;
+    tcph->window = htons (1024);
+    memset (pkt->data + pkt->hdrLen + sizeof (tcphdr), 'x', payloadLen);
+}
+
+/* Add sack option of one block to tcp packet without payload */
+static void
+addSackOption (dedupTestPacketPtr pkt, u_int left, u_int right) {
+    u_char *opt;
+    tcphdrPtr tcph;
+    ip6hdrPtr ip6h;
+    iphdrPtr iph;
+
+    tcph = (tcphdrPtr) (pkt->data + pkt->hdrLen);
+    opt = (u_char *) tcph + sizeof (tcphdr);
+    opt [0] = 1;
+    opt [1] = 1;
+    opt [2] = 5;
+    opt [3] = 10;
+    left = htonl (left);
+    right = htonl (right);
+    memcpy (opt + 4, &left, sizeof (left));
+    memcpy (opt + 8, &right, sizeof (right));
+    tcph->doff = DEDUP_TEST_SACK_TCP_HEADER_LENGTH / 4;
+
+    pkt->len = pkt->hdrLen + DEDUP_TEST_SACK_TCP_HEADER_LENGTH;
+    if (pkt->hdrLen == IP6_HEADER_LEN) {
+        ip6h = (ip6hdrPtr) pkt->data;
+        ip6h->ip6PayloadLen = htons (pkt->len - pkt->hdrLen);
+    } else {
+        iph = (iphdrPtr) pkt->data;
+        iph->ipLen = htons (pkt->len);
+    }
+}
+
+/* Change fields which may differ between mirror copies of the same frame */
+static void
+mirrorTcpPacket (dedupTestPacketPtr pkt) {
+    tcphdrPtr tcph;
+
+    tcph = (tcphdrPtr) (pkt->data + pkt->hdrLen);
+    tcph->chkSum = htons (0xbeef);
+    if (pkt->hdrLen == IP6_HEADER_LEN)
+        ((ip6hdrPtr) pkt->data)->ip6HopLimit--;
+    else {
+        ((iphdrPtr) pkt->data)->ipTTL--;
+        ((iphdrPtr) pkt->data)->ipChkSum = htons (0xbeef);
+    }
+}
+
+static boolean
+dedupTcpPacket (dedupTestPacketPtr pkt, u_long_long timestamp) {
+    int ret;
+    timeVal tm;
+    ipPktInfo info;
+
+    ret = getIpPktInfo ((iphdrPtr) pkt->data, &info);
+    assert (!ret);
+    assert (info.proto == IPPROTO_TCP && info.len == pkt->len);
+
+    tm.tvSec = htonll (timestamp / 1000000);
+    tm.tvUsec = htonll (timestamp % 1000000);
+    return packetDedupProcess ((iphdrPtr) pkt->data, &info, &tm);
+}
+
+static void
+packetDedupTest (boolean ipv6) {
+    int ret;
+    dedupTestPacket pkt, copy;
+    tcphdrPtr tcph;
+    u_long_long now = 1500000000ULL * 1000000;
+    u_long_long window = DEDUP_TEST_WINDOW * 1000;
+
+    ret = initPacketDedupContext (DEDUP_TEST_WINDOW);
+    assert (!ret);
+
+    /* Mirror copy of the same frame is duplicate */
+    buildTcpPacket (&pkt, ipv6, 1000, 100);
+    assert (!dedupTcpPacket (&pkt, now));
+    copy = pkt;
+    mirrorTcpPacket (&copy);
+    assert (dedupTcpPacket (&copy, now + 10));
+
+    /* Retransmission with different payload is not duplicate */
+    copy = pkt;
+    memset (copy.data + copy.hdrLen + sizeof (tcphdr), 'y', 10);
+    assert (!dedupTcpPacket (&copy, now + 20));
+
+    /* Real dup acks differ in sack blocks */
+    buildTcpPacket (&pkt, ipv6, 2000, 0);
+    addSackOption (&pkt, 6000, 7000);
+    assert (!dedupTcpPacket (&pkt, now));
+    copy = pkt;
+    addSackOption (&copy, 6000, 8000);
+    assert (!dedupTcpPacket (&copy, now + 100));
+    copy = pkt;
+    mirrorTcpPacket (&copy);
+    assert (dedupTcpPacket (&copy, now + 200));
+
+    /* Real dup acks differ in window */
+    buildTcpPacket (&pkt, ipv6, 3000, 0);
+    assert (!dedupTcpPacket (&pkt, now));
+    copy = pkt;
+    tcph = (tcphdrPtr) (copy.data + copy.hdrLen);
+    tcph->window = htons (2048);
+    assert (!dedupTcpPacket (&copy, now + 100));
+
+    /* Real dup acks differ in ip id or flow label */
+    buildTcpPacket (&pkt, ipv6, 4000, 0);
+    assert (!dedupTcpPacket (&pkt, now));
+    copy = pkt;
+    if (ipv6)
+        ((ip6hdrPtr) copy.data)->ip6Flow = htonl ((6 << 28) | 0x54321);
+    else
+        ((iphdrPtr) copy.data)->ipId = htons (1001);
+    assert (!dedupTcpPacket (&copy, now + 100));
+
+    /* Traffic class is not part of fingerprint, it may be remarked */
+    if (ipv6) {
+        copy = pkt;
+        ((ip6hdrPtr) copy.data)->ip6Flow = htonl ((6 << 28) | (0x2e << 20) | 0x12345);
+        assert (dedupTcpPacket (&copy, now + 200));
+    }
+
+    /* Copy at the edge of dedup window after the first one is duplicate */
+    buildTcpPacket (&pkt, ipv6, 5000, 10);
+    assert (!dedupTcpPacket (&pkt, now));
+    assert (dedupTcpPacket (&pkt, now + window));
+    buildTcpPacket (&pkt, ipv6, 6000, 10);
+    assert (!dedupTcpPacket (&pkt, now));
+    assert (!dedupTcpPacket (&pkt, now + window + 1));
+
+    /* Copy at the edge of dedup window before the first one is duplicate */
+    buildTcpPacket (&pkt, ipv6, 7000, 10);
+    assert (!dedupTcpPacket (&pkt, now + window));
+    assert (dedupTcpPacket (&pkt, now));
+    buildTcpPacket (&pkt, ipv6, 8000, 10);
+    assert (!dedupTcpPacket (&pkt, now + window + 1));
+    assert (!dedupTcpPacket (&pkt, now));
+
+    destroyPacketDedupContext ();
+
+    /* Dedup is disabled with window 0 */
+    ret = initPacketDedupContext (0);
+    assert (!ret);
+    buildTcpPacket (&pkt, ipv6, 1000, 100);
+    assert (!dedupTcpPacket (&pkt, now));
+    assert (!dedupTcpPacket (&pkt, now));
+    destroyPacketDedupContext ();
+
+    printf ("Test %s packet dedup success.\n", ipv6 ? "ipv6" : "ipv4");
+}
+
+/* Ipv4 and ipv6 packets with the same tcp header are different */
+static void
+packetDedupFamilyTest (void) {
+    int ret;
+    dedupTestPacket pkt4, pkt6;
+    u_long_long now = 1500000000ULL * 1000000;
+
+    ret = initPacketDedupContext (DEDUP_TEST_WINDOW);
+    assert (!ret);
+
+    buildTcpPacket (&pkt4, False, 1000, 0);
+    buildTcpPacket (&pkt6, True, 1000, 0);
+    assert (!dedupTcpPacket (&pkt4, now));
+    assert (!dedupTcpPacket (&pkt6, now));
+    assert (dedupTcpPacket (&pkt4, now + 1));
+    assert (dedupTcpPacket (&pkt6, now + 1));
+
+    destroyPacketDedupContext ();
+    printf ("Test ipv4 and ipv6 packet dedup success.\n");
+}
+
+int
+main (int argc, char *argv []) {
+    packetDedupTest (False);
+    packetDedupTest (True);
+    packetDedupFamilyTest ();
+
+    printf ("PacketDedupTest [Passed]\n");
+    return 0;
+}
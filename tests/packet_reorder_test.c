@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <czmq.h>
+#include "util.h"
+#include "packet_reorder.h"
+
+/* Reorder window in milliseconds */
+#define REORDER_TEST_WINDOW 20
+/* Reorder window in milliseconds long enough to hold packets regardless of arrival */
+#define REORDER_TEST_HOLD_WINDOW 1000
+/* Packets of each directional stream */
+#define REORDER_TEST_STREAM_PACKETS 1000
+/* Capture interval of packets in microseconds */
+#define REORDER_TEST_PACKET_INTERVAL 100
+/* Packets of each interface delivered in a burst */
+#define REORDER_TEST_BURST_PACKETS 64
+
+/* Packet marker, even id from client interface and odd id from server interface */
+typedef struct _reorderTestPacket reorderTestPacket;
+typedef reorderTestPacket *reorderTestPacketPtr;
+
+struct _reorderTestPacket {
+    u_int id;
+    u_long_long captureTime;
+};
+
+static u_int releasedPackets;
+static u_long_long lastReleasedTime;
+
+static void
+pushPacket (u_int id, u_long_long captureTime) {
+    int ret;
+    pktTimestamp timestamp;
+    reorderTestPacket pkt;
+    zframe_t *tmFrame, *ipPktFrame;
+
+    memset (&timestamp, 0, sizeof (timestamp));
+    timestamp.captureTime.tvSec = htonll (captureTime / 1000000);
+    timestamp.captureTime.tvUsec = htonll (captureTime % 1000000);
+    pkt.id = id;
+    pkt.captureTime = captureTime;
+
+    tmFrame = zframe_new (&timestamp, sizeof (timestamp));
+    assert (tmFrame);
+    ipPktFrame = zframe_new (&pkt, sizeof (pkt));
+    assert (ipPktFrame);
+
+    ret = packetReorderPush (tmFrame, ipPktFrame);
+    assert (!ret);
+}
+
+/* Pop packets released by reorder stage and check capture timestamp order */
+static void
+popPackets (boolean flush) {
+    zframe_t *tmFrame, *ipPktFrame;
+    reorderTestPacketPtr pkt;
+
+    while (packetReorderPop (flush, &tmFrame, &ipPktFrame)) {
+        pkt = (reorderTestPacketPtr) zframe_data (ipPktFrame);
+        assert (pkt->captureTime >= lastReleasedTime);
+        lastReleasedTime = pkt->captureTime;
+        releasedPackets++;
+
+        zframe_destroy (&tmFrame);
+        zframe_destroy (&ipPktFrame);
+    }
+}
+
+/*
+ * Client to server packets are captured by one interface and server to
+ * client packets by another one, every interface delivers its packets
+ * in bursts, so syn/ack arrives before syn of the same flow.
+ */
+static void
+interleavedStreamsTest (void) {
+    int ret;
+    u_int i, client, server;
+    u_long_long baseTime = 1500000000ULL * 1000000;
+
+    ret = initPacketReorderContext (REORDER_TEST_WINDOW);
+    assert (!ret);
+    assert (packetReorderEnabled ());
+    releasedPackets = 0;
+    lastReleasedTime = 0;
+
+    client = 0;
+    server = 0;
+    while (client < REORDER_TEST_STREAM_PACKETS || server < REORDER_TEST_STREAM_PACKETS) {
+        /* Burst of server interface first */
+        for (i = 0; i < REORDER_TEST_BURST_PACKETS && server < REORDER_TEST_STREAM_PACKETS; i++) {
+            pushPacket (server * 2 + 1, baseTime + server * 2 * REORDER_TEST_PACKET_INTERVAL + 1);
+            server++;
+            popPackets (False);
+        }
+
+        for (i = 0; i < REORDER_TEST_BURST_PACKETS && client < REORDER_TEST_STREAM_PACKETS; i++) {
+            pushPacket (client * 2, baseTime + client * 2 * REORDER_TEST_PACKET_INTERVAL);
+            client++;
+            popPackets (False);
+        }
+    }
+    popPackets (True);
+
+    assert (releasedPackets == REORDER_TEST_STREAM_PACKETS * 2);
+    assert (packetReorderPending () == 0);
+    destroyPacketReorderContext ();
+    printf ("Test interleaved directional streams reorder success.\n");
+}
+
+/* Packets older than reorder window are released at once */
+static void
+reorderWindowTest (void) {
+    int ret;
+    zframe_t *tmFrame, *ipPktFrame;
+    reorderTestPacketPtr pkt;
+    u_long_long baseTime = 1500000000ULL * 1000000;
+
+    ret = initPacketReorderContext (REORDER_TEST_HOLD_WINDOW);
+    assert (!ret);
+
+    /* Packets within reorder window are held */
+    pushPacket (0, baseTime);
+    pushPacket (1, baseTime + REORDER_TEST_HOLD_WINDOW * 1000 - 1);
+    assert (!packetReorderPop (False, &tmFrame, &ipPktFrame));
+    assert (packetReorderPending () == 2);
+
+    /* Packet newer by reorder window releases the oldest one */
+    pushPacket (2, baseTime + REORDER_TEST_HOLD_WINDOW * 1000);
+    assert (packetReorderPop (False, &tmFrame, &ipPktFrame));
+    pkt = (reorderTestPacketPtr) zframe_data (ipPktFrame);
+    assert (pkt->id == 0);
+    zframe_destroy (&tmFrame);
+    zframe_destroy (&ipPktFrame);
+    assert (!packetReorderPop (False, &tmFrame, &ipPktFrame));
+
+    /* Packet late beyond reorder window is released at once */
+    pushPacket (3, baseTime);
+    assert (packetReorderPop (False, &tmFrame, &ipPktFrame));
+    pkt = (reorderTestPacketPtr) zframe_data (ipPktFrame);
+    assert (pkt->id == 3);
+    zframe_destroy (&tmFrame);
+    zframe_destroy (&ipPktFrame);
+
+    /* Packets held are freed by destroy */
+    assert (packetReorderPending () == 2);
+    destroyPacketReorderContext ();
+    assert (packetReorderPending () == 0);
+    assert (!packetReorderEnabled ());
+    printf ("Test packet reorder window success.\n");
+}
+
+int
+main (int argc, char *argv []) {
+    interleavedStreamsTest ();
+    reorderWindowTest ();
+
+    printf ("PacketReorderTest [Passed]\n");
+    return 0;
+}
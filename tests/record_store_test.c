@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#include <jansson.h>
+#include "util.h"
+#include "properties.h"
+#include "record_store.h"
+
+/* Records appended by test */
+#define RECORD_STORE_TEST_RECORDS 2000
+/* Records of each replay call */
+#define RECORD_STORE_TEST_REPLAY_LIMIT 100
+/* Record corrupted on disk */
+#define RECORD_STORE_TEST_CORRUPTED_RECORD 500
+/* Record type appended by test */
+#define RECORD_STORE_TEST_RECORD_TYPE "ICMP_ERROR"
+
+static char testDir [] = "/tmp/ntrace_record_store_test.XXXXXX";
+
+static void
+writeConfigFile (char *configFile, char *dir) {
+    FILE *fp;
+
+    fp = fopen (configFile, "w");
+    assert (fp);
+    fprintf (fp,
+             "[default]\n"
+             "daemonMode = false\n"
+             "[recordStore]\n"
+             "dir = %s/store\n"
+             "segmentSize = 64\n"
+             "indexInterval = 4\n"
+             "retentionSize = 0\n"
+             "retentionTime = 0\n"
+             "[log]\n"
+             "logDir = %s\n"
+             "logFileName = ntrace.log\n"
+             "logLevel = 0\n",
+             dir, dir);
+    fclose (fp);
+}
+
+/* Get size of stored record with index, all test records are padded to the same size */
+static u_long_long
+getTestRecordSize (u_int index, char *buf, u_int bufLen) {
+    snprintf (buf, bufLen, "{\"type\":\"%s\",\"index\":%5u}",
+              RECORD_STORE_TEST_RECORD_TYPE, index);
+    return (sizeof (recordStoreRecordHeader) + strlen (buf) + 7) & ~((u_long_long) 7);
+}
+
+static void
+appendRecords (void) {
+    int ret;
+    u_int i;
+    char record [128];
+
+    for (i = 0; i < RECORD_STORE_TEST_RECORDS; i++) {
+        getTestRecordSize (i, record, sizeof (record));
+        ret = recordStoreAppend (record, strlen (record), RECORD_STORE_TEST_RECORD_TYPE);
+        assert (!ret);
+    }
+}
+
+/* Replay all records with cursor and check records are in order */
+static u_int
+replayAllRecords (void) {
+    int ret;
+    u_int i, replayed = 0;
+    json_t *records, *record;
+    recordStoreCursor cursor;
+
+    memset (&cursor, 0, sizeof (cursor));
+    do {
+        records = json_array ();
+        assert (records);
+        ret = recordStoreReplay (0, (u_long_long) -1, RECORD_STORE_TEST_RECORD_TYPE,
+                                 RECORD_STORE_TEST_REPLAY_LIMIT, &cursor, records);
+        assert (ret >= 0);
+
+        for (i = 0; i < json_array_size (records); i++) {
+            record = json_array_get (records, i);
+            assert (json_integer_value (json_object_get (record, "index")) == replayed);
+            replayed++;
+        }
+        json_decref (records);
+    } while (ret);
+
+    return replayed;
+}
+
+/* Replay with cursor, return value of recordStoreReplay */
+static int
+replayWithCursor (u_long_long segment, u_long_long offset) {
+    int ret;
+    json_t *records;
+    recordStoreCursor cursor;
+
+    records = json_array ();
+    assert (records);
+    cursor.segment = segment;
+    cursor.offset = offset;
+    ret = recordStoreReplay (0, (u_long_long) -1, NULL,
+                             RECORD_STORE_TEST_REPLAY_LIMIT, &cursor, records);
+    json_decref (records);
+    return ret;
+}
+
+/* Cursor forged by management client must be rejected without reading out of records */
+static void
+recordStoreBogusCursorTest (void) {
+    int ret;
+    json_t *records;
+    recordStoreCursor cursor;
+    u_long_long recordSize;
+    char record [128];
+
+    recordSize = getTestRecordSize (0, record, sizeof (record));
+
+    /* Cursor returned by replay is valid */
+    records = json_array ();
+    assert (records);
+    memset (&cursor, 0, sizeof (cursor));
+    ret = recordStoreReplay (0, (u_long_long) -1, NULL,
+                             RECORD_STORE_TEST_REPLAY_LIMIT, &cursor, records);
+    assert (ret == 1);
+    assert (json_array_size (records) == RECORD_STORE_TEST_REPLAY_LIMIT);
+    json_decref (records);
+    ret = replayWithCursor (cursor.segment, cursor.offset);
+    assert (ret == 1);
+
+    /* Cursor inside segment header */
+    ret = replayWithCursor (cursor.segment, 8);
+    assert (ret < 0);
+    /* Cursor not aligned */
+    ret = replayWithCursor (cursor.segment, 1);
+    assert (ret < 0);
+    ret = replayWithCursor (cursor.segment, cursor.offset + 1);
+    assert (ret < 0);
+    /* Cursor aligned in the middle of record */
+    ret = replayWithCursor (cursor.segment, cursor.offset + 8);
+    assert (ret < 0);
+    ret = replayWithCursor (cursor.segment, cursor.offset + recordSize - 8);
+    assert (ret < 0);
+    /* Cursor beyond records */
+    ret = replayWithCursor (cursor.segment, (u_long_long) 1 << 40);
+    assert (ret < 0);
+    ret = replayWithCursor (cursor.segment, (u_long_long) -8);
+    assert (ret < 0);
+
+    /* Cursor of record is valid */
+    ret = replayWithCursor (cursor.segment, cursor.offset + recordSize);
+    assert (ret == 1);
+
+    printf ("Test record store bogus cursor success.\n");
+}
+
+/* Records after corrupted record length are not replayed */
+static void
+recordStoreCorruptedRecordTest (char *dir) {
+    int fd;
+    ssize_t n;
+    u_int len = 0x7fffffff;
+    u_long_long offset;
+    char path [256], record [128];
+
+    offset = sizeof (recordStoreSegmentHeader) +
+             getTestRecordSize (0, record, sizeof (record)) * RECORD_STORE_TEST_CORRUPTED_RECORD;
+    snprintf (path, sizeof (path), "%s/store/%020llu.seg", dir, 1ULL);
+    fd = open (path, O_WRONLY);
+    assert (fd >= 0);
+    n = pwrite (fd, &len, sizeof (len), offset);
+    assert (n == sizeof (len));
+    close (fd);
+
+    assert (replayAllRecords () == RECORD_STORE_TEST_CORRUPTED_RECORD);
+    printf ("Test record store corrupted record success.\n");
+}
+
+int
+main (int argc, char *argv []) {
+    int ret;
+    char *dir;
+    char configFile [128], cmd [256];
+
+    dir = mkdtemp (testDir);
+    assert (dir);
+    snprintf (configFile, sizeof (configFile), "%s/ntrace.conf", dir);
+    writeConfigFile (configFile, dir);
+
+    ret = initProperties (configFile);
+    assert (!ret);
+    ret = initRecordStore ();
+    assert (!ret);
+    assert (recordStoreEnabled ());
+
+    appendRecords ();
+    assert (replayAllRecords () == RECORD_STORE_TEST_RECORDS);
+    recordStoreBogusCursorTest ();
+    recordStoreCorruptedRecordTest (dir);
+
+    destroyRecordStore ();
+    destroyProperties ();
+
+    snprintf (cmd, sizeof (cmd), "rm -rf %s", dir);
+    ret = system (cmd);
+    assert (!ret);
+
+    printf ("RecordStoreTest [Passed]\n");
+    return 0;
+}
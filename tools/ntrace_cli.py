@@ -61,6 +61,21 @@ def cmdTopologyEntriesInfo(sock):
     sock.send_json(req)
     print sock.recv_string()
 
+def cmdMetricsInfo(sock):
+    req = {'command':'metrics_info'}
+    sock.send_json(req)
+    print sock.recv_string()
+
+def cmdAnalyzerStatsInfo(sock):
+    req = {'command':'analyzer_stats_info'}
+    sock.send_json(req)
+    print sock.recv_string()
+
+def cmdHeavyHittersInfo(sock):
+    req = {'command':'heavy_hitters_info'}
+    sock.send_json(req)
+    print sock.recv_string()
+
 def cmdUpdateServices(sock):
     try:
         with open("services.json") as servicesFile:
@@ -113,6 +128,9 @@ if __name__ == '__main__':
                                  "servicesBlacklistInfo",
                                  "detectedServicesInfo",
                                  "topologyEntriesInfo",
+                                 "metricsInfo",
+                                 "analyzerStatsInfo",
+                                 "heavyHittersInfo",
                                  "updateServices",
                                  "updateServicesBlacklist"],
                         help="nTrace request command")
@@ -144,6 +162,12 @@ if __name__ == '__main__':
         cmdDetectedServicesInfo(zmqSock)
     elif cmd == 'topologyEntriesInfo':
         cmdTopologyEntriesInfo(zmqSock)
+    elif cmd == 'metricsInfo':
+        cmdMetricsInfo(zmqSock)
+    elif cmd == 'analyzerStatsInfo':
+        cmdAnalyzerStatsInfo(zmqSock)
+    elif cmd == 'heavyHittersInfo':
+        cmdHeavyHittersInfo(zmqSock)
     elif cmd == 'updateServices':
         cmdUpdateServices(zmqSock)
     elif cmd == 'updateServicesBlacklist':
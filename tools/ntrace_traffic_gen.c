@@ -0,0 +1,1337 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <getopt.h>
+#include <pcap.h>
+#include "util.h"
+#include "ip.h"
+#include "tcp.h"
+#include "checksum.h"
+
+/*
+ * Synthetic traffic generator for scale testing of ntrace. It models
+ * clients talking to http and mysql services over ipv4 tcp, with http
+ * keep-alive requests, mysql sessions with result sets, packet loss,
+ * reordering, ip fragments, syn floods and long-lived connections.
+ * Flows are interleaved by picking a random flow in flight for every
+ * packet, and all randomness comes from the seed, so the same options
+ * always generate the same packets.
+ *
+ * Usage: ntrace_traffic_gen -w <pcap_file> | -i <interface> [options]
+ */
+
+#define GEN_DEFAULT_SEED 1
+#define GEN_DEFAULT_CLIENTS 1000
+#define GEN_DEFAULT_SERVICES 16
+#define GEN_DEFAULT_FLOWS 1000
+#define GEN_DEFAULT_SESSIONS 10000
+#define GEN_DEFAULT_REQUESTS 4
+#define GEN_DEFAULT_ROWS 16
+#define GEN_DEFAULT_HTTP_BODY 2048
+#define GEN_DEFAULT_MSS 1460
+#define GEN_DEFAULT_FRAG_SIZE 576
+#define GEN_DEFAULT_PPS 100000
+/* Default start time of packet timestamps, 2016-07-04 08:00:00 UTC */
+#define GEN_DEFAULT_START_TIME 1467619200
+
+#define GEN_MAX_MSS 8960
+#define GEN_FRAME_SIZE 9216
+#define GEN_ETHER_HEADER_LEN 14
+#define GEN_ETHERTYPE_IP 0x0800
+#define GEN_TCP_WINDOW 65535
+#define GEN_TCP_MSS_OPTION_LEN 4
+
+#define GEN_HTTP_PORT 80
+#define GEN_MYSQL_PORT 3306
+/* Source network of syn flood, 198.18.0.0/15 benchmark network */
+#define GEN_SYN_FLOOD_NET 0xC6120000
+#define GEN_SYN_FLOOD_MASK 0x0001FFFF
+
+/* Tcp flags of generated tcp packet */
+#define GEN_TCP_FIN 0x01
+#define GEN_TCP_SYN 0x02
+#define GEN_TCP_RST 0x04
+#define GEN_TCP_PSH 0x08
+#define GEN_TCP_ACK 0x10
+
+/* Pace injected packets every GEN_PACE_INTERVAL packets */
+#define GEN_PACE_INTERVAL 256
+
+typedef enum {
+    GEN_PROTO_HTTP,
+    GEN_PROTO_MYSQL
+} genProto;
+
+typedef enum {
+    GEN_FLOW_SYN,
+    GEN_FLOW_SYN_ACK,
+    GEN_FLOW_ACK,
+    GEN_FLOW_MESSAGE,
+    GEN_FLOW_MESSAGE_ACK,
+    GEN_FLOW_FIN,
+    GEN_FLOW_FIN_ACK,
+    GEN_FLOW_LAST_ACK,
+    GEN_FLOW_CLOSED
+} genFlowState;
+
+typedef struct _genOptions genOptions;
+typedef genOptions *genOptionsPtr;
+
+struct _genOptions {
+    char *outputFile;                   /**< Pcap file to write, "-" for stdout */
+    char *interface;                    /**< Interface to inject packets */
+    u_long_long seed;                   /**< Random seed */
+    u_int clients;                      /**< Clients number */
+    u_int services;                     /**< Services number */
+    double mysqlRatio;                  /**< Percentage of mysql services */
+    u_int flows;                        /**< Concurrent flows number */
+    u_int sessions;                     /**< Total flows number */
+    u_int requests;                     /**< Max requests of each flow */
+    u_int rows;                         /**< Max rows of mysql result set */
+    u_int httpBody;                     /**< Max http response body size */
+    u_int longLived;                    /**< Long-lived flows number */
+    double loss;                        /**< Percentage of lost packets */
+    double reorder;                     /**< Percentage of reordered packets */
+    double frag;                        /**< Percentage of fragmented packets */
+    double synFlood;                    /**< Percentage of syn flood packets */
+    u_int mss;                          /**< Tcp max segment size */
+    u_int fragSize;                     /**< Data size of ip fragment */
+    u_int pps;                          /**< Packets per second */
+    u_int startTime;                    /**< Start time of packet timestamps */
+};
+
+typedef struct _genService genService;
+typedef genService *genServicePtr;
+
+struct _genService {
+    genProto proto;                     /**< Service proto */
+    u_int ip;                           /**< Service ip in host order */
+    u_short port;                       /**< Service port */
+};
+
+typedef struct _genFlow genFlow;
+typedef genFlow *genFlowPtr;
+
+struct _genFlow {
+    genFlowState state;                 /**< Flow state */
+    genServicePtr service;              /**< Service of flow */
+    u_int clientIp;                     /**< Client ip in host order */
+    u_short clientPort;                 /**< Client port */
+    u_int clientSeq;                    /**< Next client sequence */
+    u_int serverSeq;                    /**< Next server sequence */
+    u_short clientIpId;                 /**< Next client ip id */
+    u_short serverIpId;                 /**< Next server ip id */
+    boolean longLived;                  /**< Long-lived flow */
+    u_int requests;                     /**< Requests of flow */
+    u_int exchanges;                    /**< Request/response exchanges done */
+    u_int step;                         /**< Messages generated by flow */
+    boolean quit;                       /**< Mysql quit has been sent */
+    boolean pendingMessage;             /**< Message pending after ack */
+    boolean ackFromClient;              /**< Ack direction of MESSAGE_ACK */
+    boolean msgFromClient;              /**< Direction of current message */
+    u_char *msg;                        /**< Current message */
+    u_int msgSize;                      /**< Current message buffer size */
+    u_int msgLen;                       /**< Current message stored length */
+    u_int msgFill;                      /**< Current message filler length */
+    u_int msgOffset;                    /**< Current message bytes sent */
+};
+
+typedef struct _genStats genStats;
+typedef genStats *genStatsPtr;
+
+struct _genStats {
+    u_long_long packets;                /**< Packets written */
+    u_long_long bytes;                  /**< Bytes written */
+    u_long_long lost;                   /**< Packets lost */
+    u_long_long reordered;              /**< Packets reordered */
+    u_long_long fragments;              /**< Ip fragments written */
+    u_long_long synFlood;               /**< Syn flood packets */
+    u_long_long flows;                  /**< Flows closed */
+    u_long_long httpRequests;           /**< Http requests */
+    u_long_long mysqlQueries;           /**< Mysql queries */
+};
+
+static genOptions options = {
+    .outputFile = NULL,
+    .interface = NULL,
+    .seed = GEN_DEFAULT_SEED,
+    .clients = GEN_DEFAULT_CLIENTS,
+    .services = GEN_DEFAULT_SERVICES,
+    .mysqlRatio = 25.0,
+    .flows = GEN_DEFAULT_FLOWS,
+    .sessions = GEN_DEFAULT_SESSIONS,
+    .requests = GEN_DEFAULT_REQUESTS,
+    .rows = GEN_DEFAULT_ROWS,
+    .httpBody = GEN_DEFAULT_HTTP_BODY,
+    .longLived = 0,
+    .loss = 0.0,
+    .reorder = 0.0,
+    .frag = 0.0,
+    .synFlood = 0.0,
+    .mss = GEN_DEFAULT_MSS,
+    .fragSize = GEN_DEFAULT_FRAG_SIZE,
+    .pps = GEN_DEFAULT_PPS,
+    .startTime = GEN_DEFAULT_START_TIME,
+};
+
+static genStats stats;
+
+/* Random state of splitmix64 */
+static u_long_long genRandomState;
+
+static genServicePtr genServices = NULL;
+static u_short *genClientPorts = NULL;
+
+/* Flows in flight */
+static genFlowPtr *genFlows = NULL;
+static u_int genFlowsNum = 0;
+/* Flows in flight which are not long-lived */
+static u_int genShortFlowsNum = 0;
+/* Long-lived flows are closed after all other flows are closed */
+static boolean genClosing = False;
+
+/* Output of generated packets */
+static pcap_t *genPcap = NULL;
+static pcap_dumper_t *genDumper = NULL;
+
+/* Virtual clock of packet timestamps in nanoseconds */
+static u_long_long genClock;
+static u_long_long genPaceStart;
+
+/* Frame held back for reordering */
+static u_char genDelayedFrame [GEN_FRAME_SIZE];
+static u_int genDelayedFrameLen = 0;
+
+static u_char genFrame [GEN_FRAME_SIZE];
+static u_char genFragFrame [GEN_FRAME_SIZE];
+
+/*===============================Random===============================*/
+
+static u_long_long
+genRandom (void) {
+    u_long_long z;
+
+    genRandomState += 0x9E3779B97F4A7C15ULL;
+    z = genRandomState;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+/* Random number in [0, range) */
+static u_int
+genRandomRange (u_int range) {
+    if (range == 0)
+        return 0;
+
+    return (u_int) (genRandom () % range);
+}
+
+/* Return True with probability of percent */
+static boolean
+genChance (double percent) {
+    if (percent <= 0.0)
+        return False;
+
+    return ((double) (genRandom () >> 11) / (double) (1ULL << 53)) * 100.0 < percent;
+}
+
+/*===============================Output===============================*/
+
+static u_long_long
+genMonotonicTime (void) {
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (u_long_long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Sleep until wall clock catches up virtual clock of injected packets */
+static void
+genPace (void) {
+    u_long_long now, elapsed;
+    struct timespec ts;
+
+    now = genMonotonicTime ();
+    elapsed = now - genPaceStart;
+    if (genClock > elapsed) {
+        ts.tv_sec = (genClock - elapsed) / 1000000000ULL;
+        ts.tv_nsec = (genClock - elapsed) % 1000000000ULL;
+        nanosleep (&ts, NULL);
+    }
+}
+
+static void
+genWriteFrame (u_char *frame, u_int len) {
+    struct pcap_pkthdr hdr;
+
+    stats.packets++;
+    stats.bytes += len;
+
+    if (genDumper) {
+        hdr.ts.tv_sec = options.startTime + genClock / 1000000000ULL;
+        hdr.ts.tv_usec = (genClock % 1000000000ULL) / 1000;
+        hdr.caplen = len;
+        hdr.len = len;
+        pcap_dump ((u_char *) genDumper, &hdr, frame);
+    } else {
+        if ((stats.packets % GEN_PACE_INTERVAL) == 0)
+            genPace ();
+        if (pcap_inject (genPcap, frame, len) < 0)
+            fprintf (stderr, "Inject packet error: %s.\n", pcap_geterr (genPcap));
+    }
+
+    genClock += 1000000000ULL / options.pps;
+}
+
+/*
+ * Emit frame with loss and reordering, a reordered frame is held back
+ * and written after the next frame.
+ */
+static void
+genEmitFrame (u_char *frame, u_int len) {
+    if (genChance (options.loss)) {
+        stats.lost++;
+        return;
+    }
+
+    if (genDelayedFrameLen) {
+        genWriteFrame (frame, len);
+        genWriteFrame (genDelayedFrame, genDelayedFrameLen);
+        genDelayedFrameLen = 0;
+    } else if (genChance (options.reorder)) {
+        memcpy (genDelayedFrame, frame, len);
+        genDelayedFrameLen = len;
+        stats.reordered++;
+    } else
+        genWriteFrame (frame, len);
+}
+
+static void
+genFlushFrames (void) {
+    if (genDelayedFrameLen) {
+        genWriteFrame (genDelayedFrame, genDelayedFrameLen);
+        genDelayedFrameLen = 0;
+    }
+}
+
+/*==============================Packets===============================*/
+
+static void
+genEtherHeaderInit (u_char *frame, u_int srcIp, u_int destIp) {
+    /* Locally administered mac addresses derived from ip addresses */
+    frame [0] = 0x02;
+    frame [1] = 0x00;
+    frame [2] = (destIp >> 24) & 0xff;
+    frame [3] = (destIp >> 16) & 0xff;
+    frame [4] = (destIp >> 8) & 0xff;
+    frame [5] = destIp & 0xff;
+    frame [6] = 0x02;
+    frame [7] = 0x00;
+    frame [8] = (srcIp >> 24) & 0xff;
+    frame [9] = (srcIp >> 16) & 0xff;
+    frame [10] = (srcIp >> 8) & 0xff;
+    frame [11] = srcIp & 0xff;
+    frame [12] = GEN_ETHERTYPE_IP >> 8;
+    frame [13] = GEN_ETHERTYPE_IP & 0xff;
+}
+
+/* Emit ip packet in frame as fragments of options.fragSize */
+static void
+genEmitFragments (u_char *frame, u_int len) {
+    u_int offset, size, dataLen;
+    iphdrPtr iph, fragIph;
+
+    iph = (iphdrPtr) (frame + GEN_ETHER_HEADER_LEN);
+    dataLen = ntohs (iph->ipLen) - sizeof (iphdr);
+
+    for (offset = 0; offset < dataLen; offset += size) {
+        size = MIN_NUM (options.fragSize, dataLen - offset);
+
+        memcpy (genFragFrame, frame, GEN_ETHER_HEADER_LEN + sizeof (iphdr));
+        memcpy (genFragFrame + GEN_ETHER_HEADER_LEN + sizeof (iphdr),
+                frame + GEN_ETHER_HEADER_LEN + sizeof (iphdr) + offset, size);
+
+        fragIph = (iphdrPtr) (genFragFrame + GEN_ETHER_HEADER_LEN);
+        fragIph->ipLen = htons (sizeof (iphdr) + size);
+        fragIph->ipOff = htons ((offset >> 3) |
+                                ((offset + size < dataLen) ? IP_MF : 0));
+        fragIph->ipChkSum = 0;
+        fragIph->ipChkSum = ipFastCheckSum ((u_char *) fragIph, fragIph->iphLen);
+
+        stats.fragments++;
+        genEmitFrame (genFragFrame, GEN_ETHER_HEADER_LEN + sizeof (iphdr) + size);
+    }
+}
+
+/*
+ * Build and emit tcp packet, payload is dataLen bytes of data followed
+ * by fillLen filler bytes.
+ */
+static void
+genEmitTcp (u_int srcIp, u_short srcPort, u_int destIp, u_short destPort,
+            u_short ipId, u_int seq, u_int ackSeq, u_char flags,
+            u_char *data, u_int dataLen, u_int fillLen) {
+    u_int i, tcpHdrLen, tcpLen, len;
+    u_char *payload;
+    iphdrPtr iph;
+    tcphdrPtr tcph;
+
+    genEtherHeaderInit (genFrame, srcIp, destIp);
+
+    tcpHdrLen = sizeof (tcphdr);
+    if (flags & GEN_TCP_SYN)
+        tcpHdrLen += GEN_TCP_MSS_OPTION_LEN;
+    tcpLen = tcpHdrLen + dataLen + fillLen;
+    len = GEN_ETHER_HEADER_LEN + sizeof (iphdr) + tcpLen;
+
+    iph = (iphdrPtr) (genFrame + GEN_ETHER_HEADER_LEN);
+    memset (iph, 0, sizeof (iphdr));
+    iph->ipVer = 4;
+    iph->iphLen = sizeof (iphdr) >> 2;
+    iph->ipLen = htons (sizeof (iphdr) + tcpLen);
+    iph->ipId = htons (ipId);
+    iph->ipTTL = 64;
+    iph->ipProto = IPPROTO_TCP;
+    iph->ipSrc.s_addr = htonl (srcIp);
+    iph->ipDest.s_addr = htonl (destIp);
+
+    tcph = (tcphdrPtr) ((u_char *) iph + sizeof (iphdr));
+    memset (tcph, 0, sizeof (tcphdr));
+    tcph->source = htons (srcPort);
+    tcph->dest = htons (destPort);
+    tcph->seq = htonl (seq);
+    tcph->ackSeq = htonl (ackSeq);
+    tcph->doff = tcpHdrLen >> 2;
+    tcph->fin = (flags & GEN_TCP_FIN) ? 1 : 0;
+    tcph->syn = (flags & GEN_TCP_SYN) ? 1 : 0;
+    tcph->rst = (flags & GEN_TCP_RST) ? 1 : 0;
+    tcph->psh = (flags & GEN_TCP_PSH) ? 1 : 0;
+    tcph->ack = (flags & GEN_TCP_ACK) ? 1 : 0;
+    tcph->window = htons (GEN_TCP_WINDOW);
+
+    payload = (u_char *) tcph + sizeof (tcphdr);
+    if (flags & GEN_TCP_SYN) {
+        /* Mss option */
+        payload [0] = 2;
+        payload [1] = GEN_TCP_MSS_OPTION_LEN;
+        payload [2] = options.mss >> 8;
+        payload [3] = options.mss & 0xff;
+        payload += GEN_TCP_MSS_OPTION_LEN;
+    }
+    if (dataLen)
+        memcpy (payload, data, dataLen);
+    for (i = 0; i < fillLen; i++)
+        payload [dataLen + i] = 'a' + (i % 26);
+
+    tcph->chkSum = tcpFastCheckSum ((u_char *) tcph, tcpLen,
+                                    iph->ipSrc.s_addr, iph->ipDest.s_addr);
+
+    if (tcpLen > options.fragSize && genChance (options.frag)) {
+        genEmitFragments (genFrame, len);
+        return;
+    }
+
+    iph->ipOff = htons (IP_DF);
+    iph->ipChkSum = ipFastCheckSum ((u_char *) iph, iph->iphLen);
+    genEmitFrame (genFrame, len);
+}
+
+/* Emit tcp packet of flow */
+static void
+genFlowEmit (genFlowPtr flow, boolean fromClient, u_char flags,
+             u_char *data, u_int dataLen, u_int fillLen) {
+    if (fromClient)
+        genEmitTcp (flow->clientIp, flow->clientPort,
+                    flow->service->ip, flow->service->port,
+                    flow->clientIpId++, flow->clientSeq,
+                    (flags & GEN_TCP_ACK) ? flow->serverSeq : 0,
+                    flags, data, dataLen, fillLen);
+    else
+        genEmitTcp (flow->service->ip, flow->service->port,
+                    flow->clientIp, flow->clientPort,
+                    flow->serverIpId++, flow->serverSeq, flow->clientSeq,
+                    flags, data, dataLen, fillLen);
+}
+
+/* Emit syn of random spoofed client which is never answered */
+static void
+genEmitSynFlood (void) {
+    u_int srcIp;
+    genServicePtr service;
+
+    srcIp = GEN_SYN_FLOOD_NET | (genRandom () & GEN_SYN_FLOOD_MASK);
+    service = &genServices [genRandomRange (options.services)];
+
+    stats.synFlood++;
+    genEmitTcp (srcIp, 1024 + genRandomRange (64512), service->ip, service->port,
+                (u_short) genRandom (), (u_int) genRandom (), 0, GEN_TCP_SYN,
+                NULL, 0, 0);
+}
+
+/*==============================Messages==============================*/
+
+static void
+genMsgReset (genFlowPtr flow, boolean fromClient) {
+    flow->msgFromClient = fromClient;
+    flow->msgLen = 0;
+    flow->msgFill = 0;
+    flow->msgOffset = 0;
+}
+
+/* Reserve len bytes at the end of message */
+static u_char *
+genMsgReserve (genFlowPtr flow, u_int len) {
+    u_int size;
+    u_char *msg;
+
+    if (flow->msgLen + len > flow->msgSize) {
+        size = MAX_NUM (flow->msgSize * 2, flow->msgLen + len);
+        size = MAX_NUM (size, 256);
+        msg = (u_char *) realloc (flow->msg, size);
+        if (msg == NULL) {
+            fprintf (stderr, "Alloc message buffer error.\n");
+            exit (1);
+        }
+        flow->msg = msg;
+        flow->msgSize = size;
+    }
+
+    msg = flow->msg + flow->msgLen;
+    flow->msgLen += len;
+    return msg;
+}
+
+static void
+genMsgPutBytes (genFlowPtr flow, const void *data, u_int len) {
+    memcpy (genMsgReserve (flow, len), data, len);
+}
+
+static void
+genMsgPutByte (genFlowPtr flow, u_char value) {
+    *genMsgReserve (flow, 1) = value;
+}
+
+static void
+genMsgPutLe (genFlowPtr flow, u_int value, u_int len) {
+    u_int i;
+    u_char *p;
+
+    p = genMsgReserve (flow, len);
+    for (i = 0; i < len; i++)
+        p [i] = (value >> (i * 8)) & 0xff;
+}
+
+static void
+genMsgPrintf (genFlowPtr flow, const char *fmt, ...) {
+    int len;
+    char buf [512];
+    va_list va;
+
+    va_start (va, fmt);
+    len = vsnprintf (buf, sizeof (buf), fmt, va);
+    va_end (va);
+
+    if (len >= (int) sizeof (buf))
+        len = sizeof (buf) - 1;
+    if (len > 0)
+        genMsgPutBytes (flow, buf, len);
+}
+
+/* Mysql length encoded string shorter than 251 bytes */
+static void
+genMsgPutLenencStr (genFlowPtr flow, const char *str) {
+    u_int len = strlen (str);
+
+    genMsgPutByte (flow, len);
+    genMsgPutBytes (flow, str, len);
+}
+
+/* Begin mysql packet, return offset of packet header */
+static u_int
+genMysqlBegin (genFlowPtr flow, u_char seq) {
+    u_int offset = flow->msgLen;
+
+    genMsgPutLe (flow, 0, 3);
+    genMsgPutByte (flow, seq);
+    return offset;
+}
+
+/* End mysql packet, set payload length of packet header */
+static void
+genMysqlEnd (genFlowPtr flow, u_int offset) {
+    u_int len = flow->msgLen - offset - 4;
+
+    flow->msg [offset] = len & 0xff;
+    flow->msg [offset + 1] = (len >> 8) & 0xff;
+    flow->msg [offset + 2] = (len >> 16) & 0xff;
+}
+
+static void
+genHttpRequest (genFlowPtr flow) {
+    u_int bodyLen = 0;
+    boolean post;
+
+    genMsgReset (flow, True);
+    post = genChance (10.0);
+    if (post)
+        bodyLen = 16 + genRandomRange (512);
+
+    genMsgPrintf (flow,
+                  "%s /api/v1/items/%u HTTP/1.1\r\n"
+                  "Host: svc%u.ntrace.test\r\n"
+                  "User-Agent: ntrace-traffic-gen/1.0\r\n"
+                  "Accept: */*\r\n"
+                  "Connection: keep-alive\r\n",
+                  post ? "POST" : "GET", genRandomRange (1000000),
+                  (u_int) (flow->service - genServices));
+    if (post)
+        genMsgPrintf (flow,
+                      "Content-Type: application/octet-stream\r\n"
+                      "Content-Length: %u\r\n", bodyLen);
+    genMsgPrintf (flow, "\r\n");
+    flow->msgFill = bodyLen;
+
+    stats.httpRequests++;
+}
+
+static void
+genHttpResponse (genFlowPtr flow) {
+    u_int r, bodyLen;
+    char *status;
+
+    genMsgReset (flow, False);
+    r = genRandomRange (100);
+    if (r < 90)
+        status = "200 OK";
+    else if (r < 97)
+        status = "404 Not Found";
+    else
+        status = "500 Internal Server Error";
+    bodyLen = genRandomRange (options.httpBody + 1);
+
+    genMsgPrintf (flow,
+                  "HTTP/1.1 %s\r\n"
+                  "Server: ntrace-traffic-gen/1.0\r\n"
+                  "Content-Type: text/plain\r\n"
+                  "Content-Length: %u\r\n"
+                  "Connection: keep-alive\r\n"
+                  "\r\n",
+                  status, bodyLen);
+    flow->msgFill = bodyLen;
+}
+
+/* Mysql v10 initial handshake with mysql_native_password */
+static void
+genMysqlGreeting (genFlowPtr flow) {
+    u_int i, pkt;
+
+    genMsgReset (flow, False);
+    pkt = genMysqlBegin (flow, 0);
+    genMsgPutByte (flow, 10);
+    genMsgPutBytes (flow, "5.7.30", 7);
+    genMsgPutLe (flow, genRandomRange (1000000), 4);
+    for (i = 0; i < 8; i++)
+        genMsgPutByte (flow, 0x21 + genRandomRange (94));
+    genMsgPutByte (flow, 0);
+    genMsgPutLe (flow, 0xf7ff, 2);
+    genMsgPutByte (flow, 0x21);
+    genMsgPutLe (flow, 0x0002, 2);
+    genMsgPutLe (flow, 0x81ff, 2);
+    genMsgPutByte (flow, 21);
+    for (i = 0; i < 10; i++)
+        genMsgPutByte (flow, 0);
+    for (i = 0; i < 12; i++)
+        genMsgPutByte (flow, 0x21 + genRandomRange (94));
+    genMsgPutByte (flow, 0);
+    genMsgPutBytes (flow, "mysql_native_password", 22);
+    genMysqlEnd (flow, pkt);
+}
+
+/* Mysql handshake response 41 */
+static void
+genMysqlAuth (genFlowPtr flow) {
+    u_int i, pkt;
+
+    genMsgReset (flow, True);
+    pkt = genMysqlBegin (flow, 1);
+    genMsgPutLe (flow, 0x0008a205, 4);
+    genMsgPutLe (flow, 0x01000000, 4);
+    genMsgPutByte (flow, 0x21);
+    for (i = 0; i < 23; i++)
+        genMsgPutByte (flow, 0);
+    genMsgPrintf (flow, "user%u", genRandomRange (100));
+    genMsgPutByte (flow, 0);
+    genMsgPutByte (flow, 20);
+    for (i = 0; i < 20; i++)
+        genMsgPutByte (flow, genRandomRange (256));
+    genMsgPutBytes (flow, "mysql_native_password", 22);
+    genMysqlEnd (flow, pkt);
+}
+
+static void
+genMysqlOk (genFlowPtr flow, u_char seq) {
+    u_int pkt;
+
+    pkt = genMysqlBegin (flow, seq);
+    genMsgPutByte (flow, 0x00);
+    genMsgPutByte (flow, 0);
+    genMsgPutByte (flow, 0);
+    genMsgPutLe (flow, 0x0002, 2);
+    genMsgPutLe (flow, 0, 2);
+    genMysqlEnd (flow, pkt);
+}
+
+static void
+genMysqlEof (genFlowPtr flow, u_char seq) {
+    u_int pkt;
+
+    pkt = genMysqlBegin (flow, seq);
+    genMsgPutByte (flow, 0xfe);
+    genMsgPutLe (flow, 0, 2);
+    genMsgPutLe (flow, 0x0002, 2);
+    genMysqlEnd (flow, pkt);
+}
+
+static void
+genMysqlColumnDef (genFlowPtr flow, u_char seq, const char *name,
+                   u_short charset, u_int length, u_char type) {
+    u_int pkt;
+
+    pkt = genMysqlBegin (flow, seq);
+    genMsgPutLenencStr (flow, "def");
+    genMsgPutLenencStr (flow, "ntrace");
+    genMsgPutLenencStr (flow, "items");
+    genMsgPutLenencStr (flow, "items");
+    genMsgPutLenencStr (flow, name);
+    genMsgPutLenencStr (flow, name);
+    genMsgPutByte (flow, 0x0c);
+    genMsgPutLe (flow, charset, 2);
+    genMsgPutLe (flow, length, 4);
+    genMsgPutByte (flow, type);
+    genMsgPutLe (flow, 0, 2);
+    genMsgPutByte (flow, 0);
+    genMsgPutLe (flow, 0, 2);
+    genMysqlEnd (flow, pkt);
+}
+
+static void
+genMysqlQuery (genFlowPtr flow) {
+    u_int pkt;
+
+    genMsgReset (flow, True);
+    pkt = genMysqlBegin (flow, 0);
+    genMsgPutByte (flow, 0x03);
+    genMsgPrintf (flow, "SELECT id, name FROM items WHERE id >= %u LIMIT %u",
+                  genRandomRange (1000000), options.rows);
+    genMysqlEnd (flow, pkt);
+
+    stats.mysqlQueries++;
+}
+
+/* Mysql text result set of 2 columns or error */
+static void
+genMysqlResult (genFlowPtr flow) {
+    u_int i, id, rows, pkt;
+    u_char seq = 1;
+    char value [32];
+
+    genMsgReset (flow, False);
+    if (genChance (5.0)) {
+        pkt = genMysqlBegin (flow, seq);
+        genMsgPutByte (flow, 0xff);
+        genMsgPutLe (flow, 1146, 2);
+        genMsgPrintf (flow, "#42S02Table 'ntrace.items' doesn't exist");
+        genMysqlEnd (flow, pkt);
+        return;
+    }
+
+    pkt = genMysqlBegin (flow, seq++);
+    genMsgPutByte (flow, 2);
+    genMysqlEnd (flow, pkt);
+    genMysqlColumnDef (flow, seq++, "id", 0x3f, 11, 0x03);
+    genMysqlColumnDef (flow, seq++, "name", 0x21, 765, 0xfd);
+    genMysqlEof (flow, seq++);
+
+    rows = genRandomRange (options.rows + 1);
+    id = genRandomRange (1000000);
+    for (i = 0; i < rows; i++) {
+        pkt = genMysqlBegin (flow, seq++);
+        snprintf (value, sizeof (value), "%u", id + i);
+        genMsgPutLenencStr (flow, value);
+        snprintf (value, sizeof (value), "item-%u", id + i);
+        genMsgPutLenencStr (flow, value);
+        genMysqlEnd (flow, pkt);
+    }
+    genMysqlEof (flow, seq);
+}
+
+static void
+genMysqlQuit (genFlowPtr flow) {
+    u_int pkt;
+
+    genMsgReset (flow, True);
+    pkt = genMysqlBegin (flow, 0);
+    genMsgPutByte (flow, 0x01);
+    genMysqlEnd (flow, pkt);
+}
+
+/*
+ * Check whether flow has more request/response exchanges, long-lived
+ * flow keeps exchanging until closing.
+ */
+static boolean
+genFlowHasExchange (genFlowPtr flow) {
+    if (flow->longLived && !genClosing)
+        return True;
+
+    return flow->exchanges < flow->requests;
+}
+
+/*
+ * Generate next message of flow.
+ *
+ * @return True if next message is generated, False if flow is done
+ */
+static boolean
+genFlowNextMessage (genFlowPtr flow) {
+    u_int step;
+
+    if (flow->quit)
+        return False;
+
+    step = flow->step++;
+    if (flow->service->proto == GEN_PROTO_HTTP) {
+        if (step & 1) {
+            genHttpResponse (flow);
+            flow->exchanges++;
+            return True;
+        }
+
+        if (!genFlowHasExchange (flow))
+            return False;
+        genHttpRequest (flow);
+        return True;
+    }
+
+    switch (step) {
+        case 0:
+            genMysqlGreeting (flow);
+            return True;
+
+        case 1:
+            genMysqlAuth (flow);
+            return True;
+
+        case 2:
+            genMsgReset (flow, False);
+            genMysqlOk (flow, 2);
+            return True;
+
+        default:
+            /* Exchanges of mysql begin at step 3 */
+            if (!(step & 1)) {
+                genMysqlResult (flow);
+                flow->exchanges++;
+                return True;
+            }
+
+            if (genFlowHasExchange (flow)) {
+                genMysqlQuery (flow);
+                return True;
+            }
+
+            genMysqlQuit (flow);
+            flow->quit = True;
+            return True;
+    }
+}
+
+/*===============================Flows================================*/
+
+static genFlowPtr
+genFlowNew (boolean longLived) {
+    u_int client;
+    genFlowPtr flow;
+
+    flow = (genFlowPtr) calloc (1, sizeof (genFlow));
+    if (flow == NULL) {
+        fprintf (stderr, "Alloc flow error.\n");
+        exit (1);
+    }
+
+    client = genRandomRange (options.clients);
+    /* Clients are 10.0.0.1 and up */
+    flow->clientIp = 0x0A000001 + client;
+    flow->clientPort = 1024 + (genClientPorts [client]++ % 64512);
+    flow->service = &genServices [genRandomRange (options.services)];
+    flow->clientSeq = (u_int) genRandom ();
+    flow->serverSeq = (u_int) genRandom ();
+    flow->clientIpId = (u_short) genRandom ();
+    flow->serverIpId = (u_short) genRandom ();
+    flow->longLived = longLived;
+    flow->requests = 1 + genRandomRange (options.requests);
+    flow->state = GEN_FLOW_SYN;
+
+    return flow;
+}
+
+static void
+genFlowFree (genFlowPtr flow) {
+    free (flow->msg);
+    free (flow);
+}
+
+/* Emit next segment of len bytes of current message */
+static void
+genFlowMessageSegment (genFlowPtr flow, u_int len, u_char flags) {
+    u_int dataLen = 0;
+
+    if (flow->msgOffset < flow->msgLen)
+        dataLen = MIN_NUM (len, flow->msgLen - flow->msgOffset);
+
+    genFlowEmit (flow, flow->msgFromClient, flags,
+                 flow->msg + flow->msgOffset, dataLen, len - dataLen);
+    if (flow->msgFromClient)
+        flow->clientSeq += len;
+    else
+        flow->serverSeq += len;
+    flow->msgOffset += len;
+}
+
+/* Emit next packet of flow */
+static void
+genFlowStep (genFlowPtr flow) {
+    u_int len;
+    boolean fromClient;
+
+    switch (flow->state) {
+        case GEN_FLOW_SYN:
+            genFlowEmit (flow, True, GEN_TCP_SYN, NULL, 0, 0);
+            flow->clientSeq++;
+            flow->state = GEN_FLOW_SYN_ACK;
+            break;
+
+        case GEN_FLOW_SYN_ACK:
+            genFlowEmit (flow, False, GEN_TCP_SYN | GEN_TCP_ACK, NULL, 0, 0);
+            flow->serverSeq++;
+            flow->state = GEN_FLOW_ACK;
+            break;
+
+        case GEN_FLOW_ACK:
+            genFlowEmit (flow, True, GEN_TCP_ACK, NULL, 0, 0);
+            flow->state = genFlowNextMessage (flow) ? GEN_FLOW_MESSAGE : GEN_FLOW_FIN;
+            break;
+
+        case GEN_FLOW_MESSAGE:
+            fromClient = flow->msgFromClient;
+            len = MIN_NUM (options.mss, flow->msgLen + flow->msgFill - flow->msgOffset);
+
+            if (flow->msgOffset + len == flow->msgLen + flow->msgFill)
+                genFlowMessageSegment (flow, len, GEN_TCP_ACK | GEN_TCP_PSH);
+            else
+                genFlowMessageSegment (flow, len, GEN_TCP_ACK);
+            if (flow->msgOffset < flow->msgLen + flow->msgFill)
+                break;
+
+            /*
+             * Message in reverse direction acks current message, else
+             * receiver acks current message first.
+             */
+            flow->pendingMessage = genFlowNextMessage (flow);
+            if (flow->pendingMessage && flow->msgFromClient != fromClient)
+                break;
+            flow->ackFromClient = !fromClient;
+            flow->state = GEN_FLOW_MESSAGE_ACK;
+            break;
+
+        case GEN_FLOW_MESSAGE_ACK:
+            genFlowEmit (flow, flow->ackFromClient, GEN_TCP_ACK, NULL, 0, 0);
+            flow->state = flow->pendingMessage ? GEN_FLOW_MESSAGE : GEN_FLOW_FIN;
+            break;
+
+        case GEN_FLOW_FIN:
+            genFlowEmit (flow, True, GEN_TCP_FIN | GEN_TCP_ACK, NULL, 0, 0);
+            flow->clientSeq++;
+            flow->state = GEN_FLOW_FIN_ACK;
+            break;
+
+        case GEN_FLOW_FIN_ACK:
+            genFlowEmit (flow, False, GEN_TCP_FIN | GEN_TCP_ACK, NULL, 0, 0);
+            flow->serverSeq++;
+            flow->state = GEN_FLOW_LAST_ACK;
+            break;
+
+        case GEN_FLOW_LAST_ACK:
+            genFlowEmit (flow, True, GEN_TCP_ACK, NULL, 0, 0);
+            flow->state = GEN_FLOW_CLOSED;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* Start flows until concurrent flows or total flows are reached */
+static void
+genStartFlows (u_int *started) {
+    while (genShortFlowsNum < options.flows && *started < options.sessions) {
+        genFlows [genFlowsNum++] = genFlowNew (False);
+        genShortFlowsNum++;
+        (*started)++;
+    }
+}
+
+static void
+genRun (void) {
+    u_int i, index, started = 0;
+    genFlowPtr flow;
+
+    for (i = 0; i < options.longLived; i++)
+        genFlows [genFlowsNum++] = genFlowNew (True);
+    genStartFlows (&started);
+
+    while (genFlowsNum) {
+        /* Close long-lived flows after all other flows are closed */
+        genClosing = (genShortFlowsNum == 0 && started == options.sessions);
+
+        if (genChance (options.synFlood)) {
+            genEmitSynFlood ();
+            continue;
+        }
+
+        index = genRandomRange (genFlowsNum);
+        flow = genFlows [index];
+        genFlowStep (flow);
+        if (flow->state != GEN_FLOW_CLOSED)
+            continue;
+
+        if (!flow->longLived)
+            genShortFlowsNum--;
+        genFlows [index] = genFlows [--genFlowsNum];
+        genFlowFree (flow);
+        stats.flows++;
+
+        genStartFlows (&started);
+    }
+
+    genFlushFrames ();
+}
+
+static void
+genServicesInit (void) {
+    u_int i;
+
+    for (i = 0; i < options.services; i++) {
+        /* Services are 172.16.0.1 and up */
+        genServices [i].ip = 0xAC100001 + i;
+        if (genChance (options.mysqlRatio)) {
+            genServices [i].proto = GEN_PROTO_MYSQL;
+            genServices [i].port = GEN_MYSQL_PORT;
+        } else {
+            genServices [i].proto = GEN_PROTO_HTTP;
+            genServices [i].port = GEN_HTTP_PORT;
+        }
+    }
+}
+
+static struct option genLongOptions [] = {
+    {"write", required_argument, NULL, 'w'},
+    {"interface", required_argument, NULL, 'i'},
+    {"seed", required_argument, NULL, 's'},
+    {"clients", required_argument, NULL, 'c'},
+    {"services", required_argument, NULL, 'S'},
+    {"mysql-ratio", required_argument, NULL, 'm'},
+    {"flows", required_argument, NULL, 'f'},
+    {"sessions", required_argument, NULL, 'n'},
+    {"requests", required_argument, NULL, 'r'},
+    {"rows", required_argument, NULL, 'R'},
+    {"http-body", required_argument, NULL, 'b'},
+    {"long-lived", required_argument, NULL, 'L'},
+    {"loss", required_argument, NULL, 'l'},
+    {"reorder", required_argument, NULL, 'o'},
+    {"frag", required_argument, NULL, 'F'},
+    {"syn-flood", required_argument, NULL, 'y'},
+    {"mss", required_argument, NULL, 'M'},
+    {"frag-size", required_argument, NULL, 'z'},
+    {"pps", required_argument, NULL, 'p'},
+    {"start-time", required_argument, NULL, 't'},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, no_argument, NULL, 0},
+};
+
+static void
+genShowHelpInfo (const char *cmd) {
+    const char *cmdName;
+
+    cmdName = strrchr (cmd, '/') ? (strrchr (cmd, '/') + 1) : cmd;
+    fprintf (stdout,
+             "Usage: %s -w <pcap_file> | -i <interface> [options]\n"
+             "Options: \n"
+             "  -w|--write, pcap file to write, \"-\" for stdout\n"
+             "  -i|--interface, interface to inject packets, like veth\n"
+             "  -s|--seed, random seed, default %u\n"
+             "  -c|--clients, clients number, default %u\n"
+             "  -S|--services, services number, default %u\n"
+             "  -m|--mysql-ratio, percentage of mysql services, default 25\n"
+             "  -f|--flows, concurrent flows number, default %u\n"
+             "  -n|--sessions, total flows number, default %u\n"
+             "  -r|--requests, max keep-alive requests of each flow, default %u\n"
+             "  -R|--rows, max rows of mysql result set, default %u\n"
+             "  -b|--http-body, max http response body size, default %u\n"
+             "  -L|--long-lived, long-lived flows kept open during the whole run, default 0\n"
+             "  -l|--loss, percentage of lost packets, default 0\n"
+             "  -o|--reorder, percentage of reordered packets, default 0\n"
+             "  -F|--frag, percentage of packets larger than frag size sent as ip fragments, default 0\n"
+             "  -y|--syn-flood, percentage of unanswered syn packets from spoofed clients, default 0\n"
+             "  -M|--mss, tcp max segment size, default %u\n"
+             "  -z|--frag-size, data size of ip fragment, multiple of 8, default %u\n"
+             "  -p|--pps, packets per second of timestamps or injection, default %u\n"
+             "  -t|--start-time, start time of packet timestamps in seconds, default %u\n"
+             "  -h|--help, help information\n",
+             cmdName, GEN_DEFAULT_SEED, GEN_DEFAULT_CLIENTS, GEN_DEFAULT_SERVICES,
+             GEN_DEFAULT_FLOWS, GEN_DEFAULT_SESSIONS, GEN_DEFAULT_REQUESTS,
+             GEN_DEFAULT_ROWS, GEN_DEFAULT_HTTP_BODY, GEN_DEFAULT_MSS,
+             GEN_DEFAULT_FRAG_SIZE, GEN_DEFAULT_PPS, GEN_DEFAULT_START_TIME);
+}
+
+static int
+genParseUint (const char *str, u_int *value) {
+    char *end;
+    unsigned long tmp;
+
+    tmp = strtoul (str, &end, 10);
+    if (*str == '\0' || *end != '\0' || tmp > 0xFFFFFFFFUL)
+        return -1;
+
+    *value = (u_int) tmp;
+    return 0;
+}
+
+static int
+genParsePercent (const char *str, double *value) {
+    char *end;
+    double tmp;
+
+    tmp = strtod (str, &end);
+    if (*str == '\0' || *end != '\0' || tmp < 0.0 || tmp > 100.0)
+        return -1;
+
+    *value = tmp;
+    return 0;
+}
+
+static int
+genParseOptions (int argc, char *argv []) {
+    int option, ret = 0;
+
+    while ((option = getopt_long (argc, argv, ":w:i:s:c:S:m:f:n:r:R:b:L:l:o:F:y:M:z:p:t:h?",
+                                  genLongOptions, NULL)) != -1) {
+        switch (option) {
+            case 'w':
+                options.outputFile = optarg;
+                break;
+
+            case 'i':
+                options.interface = optarg;
+                break;
+
+            case 's':
+                options.seed = strtoull (optarg, NULL, 10);
+                break;
+
+            case 'c':
+                ret = genParseUint (optarg, &options.clients);
+                break;
+
+            case 'S':
+                ret = genParseUint (optarg, &options.services);
+                break;
+
+            case 'm':
+                ret = genParsePercent (optarg, &options.mysqlRatio);
+                break;
+
+            case 'f':
+                ret = genParseUint (optarg, &options.flows);
+                break;
+
+            case 'n':
+                ret = genParseUint (optarg, &options.sessions);
+                break;
+
+            case 'r':
+                ret = genParseUint (optarg, &options.requests);
+                break;
+
+            case 'R':
+                ret = genParseUint (optarg, &options.rows);
+                break;
+
+            case 'b':
+                ret = genParseUint (optarg, &options.httpBody);
+                break;
+
+            case 'L':
+                ret = genParseUint (optarg, &options.longLived);
+                break;
+
+            case 'l':
+                ret = genParsePercent (optarg, &options.loss);
+                break;
+
+            case 'o':
+                ret = genParsePercent (optarg, &options.reorder);
+                break;
+
+            case 'F':
+                ret = genParsePercent (optarg, &options.frag);
+                break;
+
+            case 'y':
+                ret = genParsePercent (optarg, &options.synFlood);
+                break;
+
+            case 'M':
+                ret = genParseUint (optarg, &options.mss);
+                break;
+
+            case 'z':
+                ret = genParseUint (optarg, &options.fragSize);
+                break;
+
+            case 'p':
+                ret = genParseUint (optarg, &options.pps);
+                break;
+
+            case 't':
+                ret = genParseUint (optarg, &options.startTime);
+                break;
+
+            case 'h':
+                genShowHelpInfo (argv [0]);
+                exit (0);
+
+            case ':':
+                fprintf (stderr, "Miss option argument.\n");
+                genShowHelpInfo (argv [0]);
+                return -1;
+
+            case '?':
+                fprintf (stderr, "Unknown option.\n");
+                genShowHelpInfo (argv [0]);
+                return -1;
+        }
+
+        if (ret < 0) {
+            fprintf (stderr, "Wrong value \"%s\" of option -%c.\n", optarg, option);
+            return -1;
+        }
+    }
+
+    if ((options.outputFile == NULL) == (options.interface == NULL)) {
+        fprintf (stderr, "One of pcap file and interface should be specified.\n");
+        genShowHelpInfo (argv [0]);
+        return -1;
+    }
+
+    if (options.clients == 0 || options.clients > 0x00FFFFFE ||
+        options.services == 0 || options.services > 0x000FFFFE) {
+        fprintf (stderr, "Wrong clients or services number.\n");
+        return -1;
+    }
+
+    if (options.flows == 0 && options.longLived == 0) {
+        fprintf (stderr, "Flows number should be greater than 0.\n");
+        return -1;
+    }
+
+    if (options.mss == 0 || options.mss > GEN_MAX_MSS) {
+        fprintf (stderr, "Wrong mss, should be 1-%u.\n", GEN_MAX_MSS);
+        return -1;
+    }
+
+    if (options.fragSize < 8 || options.fragSize % 8 ||
+        options.fragSize > GEN_MAX_MSS) {
+        fprintf (stderr, "Wrong frag size, should be multiple of 8 and <= %u.\n",
+                 GEN_MAX_MSS);
+        return -1;
+    }
+
+    if (options.pps == 0) {
+        fprintf (stderr, "Pps should be greater than 0.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+main (int argc, char *argv []) {
+    int ret;
+    char errBuf [PCAP_ERRBUF_SIZE];
+
+    ret = genParseOptions (argc, argv);
+    if (ret < 0)
+        return 1;
+
+    genRandomState = options.seed;
+    genServices = (genServicePtr) calloc (options.services, sizeof (genService));
+    genClientPorts = (u_short *) calloc (options.clients, sizeof (u_short));
+    genFlows = (genFlowPtr *) calloc (options.flows + options.longLived, sizeof (genFlowPtr));
+    if (genServices == NULL || genClientPorts == NULL || genFlows == NULL) {
+        fprintf (stderr, "Alloc generator context error.\n");
+        ret = 1;
+        goto exit;
+    }
+    genServicesInit ();
+
+    if (options.outputFile) {
+        genPcap = pcap_open_dead (DLT_EN10MB, GEN_FRAME_SIZE);
+        if (genPcap == NULL) {
+            fprintf (stderr, "Open pcap error.\n");
+            ret = 1;
+            goto exit;
+        }
+
+        genDumper = pcap_dump_open (genPcap, options.outputFile);
+        if (genDumper == NULL) {
+            fprintf (stderr, "Open pcap file %s error: %s.\n",
+                     options.outputFile, pcap_geterr (genPcap));
+            ret = 1;
+            goto closePcap;
+        }
+    } else {
+        genPcap = pcap_open_live (options.interface, GEN_FRAME_SIZE, 0, 1000, errBuf);
+        if (genPcap == NULL) {
+            fprintf (stderr, "Open interface %s error: %s.\n", options.interface, errBuf);
+            ret = 1;
+            goto exit;
+        }
+    }
+
+    genPaceStart = genMonotonicTime ();
+    genRun ();
+
+    fprintf (stderr,
+             "Packets: %llu, bytes: %llu, flows: %llu, http requests: %llu, "
+             "mysql queries: %llu, lost: %llu, reordered: %llu, fragments: %llu, "
+             "syn flood: %llu.\n",
+             stats.packets, stats.bytes, stats.flows, stats.httpRequests,
+             stats.mysqlQueries, stats.lost, stats.reordered, stats.fragments,
+             stats.synFlood);
+    ret = 0;
+
+    if (genDumper)
+        pcap_dump_close (genDumper);
+closePcap:
+    pcap_close (genPcap);
+exit:
+    free (genFlows);
+    free (genClientPorts);
+    free (genServices);
+    return ret;
+}